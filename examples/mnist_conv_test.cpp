@@ -115,8 +115,8 @@ int main(int argc, char** argv) {
 
     network_def nn;
 
-    nn.configure(1, false);
-    if(!nn.load("leNet.model")) {
+    nn.configure_inference(1);
+    if(!nn.map_checkpoint("leNet.model")) {
         std::cerr << "No leNet model file exists- Please run training first.\n";
     } else {
         if(argc != 2) {
@@ -87,7 +87,7 @@ int main(int argc, char** argv) {
     std::cout << "The learning rate is: " << trainer.optimizer.alpha  << "\n\n";
 
     bool reset_network = true;
-    if(nn.load("leNet.model")) {
+    if(nn.load_checkpoint("leNet.model")) {
         std::cout << "Loading existing leNet.model...\n";
         reset_network = false;
     }
@@ -97,15 +97,17 @@ int main(int argc, char** argv) {
     (void)cm;
     std::cout << "Initial accuracy: " << correct << " / " << total << " (" << (static_cast<float>(correct) / total * 100)  << "%)\n\n";
 
+    /* Checkpoints are written in the background, training continues */
+    checkpoint_writer<network_def> checkpoints(nn);
+
     trainer.on_epoch = [&](const auto& e) {
         std::cout << "\nEpoch " << (e + 1) << " Finished. ";
         auto[correct, total, cm] = nn.test(test_images, test_labels);
         (void)cm;
         std::cout << "Accuracy: " << correct << " / " << total << " (" << (static_cast<float>(correct) / total * 100)  << "%)\n";
 
-        std::cout << "Persisting model...";
-        nn.save("leNet.model");
-        std::cout << "Done!\n\n";
+        checkpoints.save("leNet.model");
+        std::cout << "Persisting model in the background\n\n";
     };
 
     trainer.on_batch = [&](const auto& batch) {
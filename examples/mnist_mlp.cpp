@@ -37,7 +37,7 @@ int main(int argc, char** argv) {
             volume_dims<64>,
             10
         >,
-        tanh_layer<volume_dims<10>>
+        softmax_layer<volume_dims<10>>
     >;
 
     network_def nn;
@@ -55,7 +55,7 @@ int main(int argc, char** argv) {
     constexpr size_t batch_size = 15;
 
     const size_t batch_count = train_images.size()/batch_size;
-    training<batch_size, 50, ada_gradient_optimizer<std::ratio<4, 100>>, mean_square_error> trainer;
+    training<batch_size, 50, ada_gradient_optimizer<std::ratio<4, 100>>, cross_entropy> trainer;
 
     util::progress prog(batch_count);
 
@@ -80,4 +80,13 @@ int main(int argc, char** argv) {
         (void)cm;
         std::cout << "\n\nTotal correct: " << correct << " / " << total << " (" << (static_cast<float>(correct) / total)  << ")\n";
     }
-}
\ No newline at end of file
+
+    {
+        util::scoped_timer doing_tests("Quantized testing time");
+        /* Calibrated on a subset of the training set, evaluated held-out */
+        sample_vector_type calibration(train_images.begin(), train_images.begin() + 1000);
+        quantized_network<network_def> quantized(nn, calibration, 256);
+        const auto report = compare_quantization(nn, quantized, test_images, test_labels);
+        std::cout << "\nInt8 accuracy: " << report.quantized_accuracy() << " (delta " << report.accuracy_delta() << ")\n";
+    }
+}
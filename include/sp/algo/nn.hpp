@@ -15,6 +15,8 @@
 #include "nn/layer.hpp"
 #include "nn/network.hpp"
 #include "nn/training.hpp"
+#include "nn/checkpoint_writer.hpp"
+#include "nn/quantization.hpp"
 #include "nn/loss.hpp"
 
 #endif	/* SP_ALGO_NN_HPP */
@@ -0,0 +1,232 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_BATCH_LOADER_HPP
+#define SP_ALGO_NN_BATCH_LOADER_HPP
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <numeric>
+#include <condition_variable>
+#include <algorithm>
+#include <boost/assert.hpp>
+
+#include "config.hpp"
+#include "matrix.hpp"
+#include "types.hpp"
+#include "random.hpp"
+#include "layer/detail/layers.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Assembles the batches of training on a background thread
+ *
+ * The producer thread walks the samples in order, or in a new random
+ * permutation every epoch if shuffled, and fills a ring of Buffers batches
+ * ahead of the consumer, i.e. the training thread. Every batch holds the
+ * input and the expected output, labels set to the target range of the
+ * network as by prepare_labels. The ring is a lock free single producer,
+ * single consumer queue: the producer publishes a batch by advancing
+ * produced, the consumer returns it by advancing consumed. A side finding
+ * the ring full (the producer, most of the time) or empty sleeps on a
+ * condition variable rather than spinning on a core of the compute threads.
+ *
+ * \tparam Network the network type, determines the input and output volumes
+ * \tparam Buffers the number of batches in flight
+ */
+template<typename Network, size_t Buffers = 3>
+struct batch_loader {
+
+    static_assert(Buffers >= 2, "Buffers is at least two (double buffering)");
+
+    using input_dims = typename Network::input_dims;
+    using output_dims = typename Network::output_dims;
+
+    /**
+     * \brief A batch of the ring, sized for batch_size samples and holding
+     *        size samples, fewer in the last batch of an epoch if batch_size
+     *        is not a factor of the sample count
+     */
+    struct batch {
+
+        tensor_4_view input_view() {
+            return tensor_4_view(input.data(), size, input_dims::d, input_dims::h, input_dims::w);
+        }
+
+        tensor_4_view expected_view() {
+            return tensor_4_view(expected.data(), size, output_dims::size, 1, 1);
+        }
+
+        tensor_4 input;
+        tensor_4 expected;
+        size_t size = 0;
+    };
+
+    /**
+     * \brief Starts producing epochs times batches_per_epoch batches, the
+     *        samples and classes must outlive the loader
+     */
+    batch_loader(   const sample_vector_type& samples,
+                    const class_vector_type& classes,
+                    const size_t& batch_size,
+                    const size_t& epochs,
+                    const valid_range& target,
+                    bool shuffle = false) :
+            samples(samples),
+            classes(classes),
+            batch_size(batch_size),
+            batch_count(epochs * batches_per_epoch(samples.size(), batch_size)),
+            target(target),
+            shuffle(shuffle),
+            generator(random_generator::get()()) {
+        BOOST_ASSERT_MSG(batch_size > 0, "Batch size is greater than zero");
+        BOOST_ASSERT_MSG(samples.size() == classes.size(), "Samples and classes size match");
+        for(auto& b : ring) {
+            b.input.resize(batch_size, input_dims::d, input_dims::h, input_dims::w);
+            b.expected.resize(batch_size, output_dims::size, 1, 1);
+        }
+        producer = std::thread([this]() {
+            produce();
+        });
+    }
+
+    batch_loader(const batch_loader&) = delete;
+    batch_loader& operator=(const batch_loader&) = delete;
+
+    ~batch_loader() {
+        stopped.store(true, std::memory_order_relaxed);
+        notify(freed);
+        producer.join();
+    }
+
+    /**
+     * \brief The next batch, waits until it has been produced. Must be
+     *        released before the following batch is acquired
+     */
+    batch& acquire() {
+        BOOST_ASSERT_MSG(taken < batch_count, "Batches remain");
+        if(produced.load(std::memory_order_acquire) <= taken) {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this]() {
+                return produced.load(std::memory_order_acquire) > taken;
+            });
+        }
+        return ring[taken % Buffers];
+    }
+
+    /**
+     * \brief Hand the acquired batch back to the producer
+     */
+    void release() {
+        consumed.store(++taken, std::memory_order_release);
+        notify(freed);
+    }
+
+    /**
+     * \brief Number of batches covering count samples, the last one partial
+     *        if batch_size is not a factor of count
+     */
+    constexpr static size_t batches_per_epoch(const size_t& count, const size_t& batch_size) {
+        return (count + batch_size - 1) / batch_size;
+    }
+
+protected:
+
+    void produce() {
+        const size_t per_epoch = batches_per_epoch(samples.size(), batch_size);
+        std::vector<size_t> order(samples.size());
+        for(size_t n = 0; n < batch_count; ++n) {
+            if(n % per_epoch == 0) {
+                std::iota(order.begin(), order.end(), 0);
+                if(shuffle) {
+                    std::shuffle(order.begin(), order.end(), generator);
+                }
+            }
+            /* Wait for a free buffer */
+            if(n - consumed.load(std::memory_order_acquire) >= Buffers) {
+                std::unique_lock<std::mutex> lock(mutex);
+                freed.wait(lock, [this, n]() {
+                    return n - consumed.load(std::memory_order_acquire) < Buffers || stopped.load(std::memory_order_relaxed);
+                });
+            }
+            if(stopped.load(std::memory_order_relaxed)) {
+                return;
+            }
+            const size_t first = (n % per_epoch) * batch_size;
+            fill(ring[n % Buffers], order.data() + first, std::min(batch_size, samples.size() - first));
+            produced.store(n + 1, std::memory_order_release);
+            notify(ready);
+        }
+    }
+
+    /**
+     * \brief Wake the other side, the mutex orders the notification after
+     *        the check of a waiter about to sleep
+     */
+    void notify(std::condition_variable& condition) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        condition.notify_one();
+    }
+
+    void fill(batch& b, const size_t* indices, const size_t& size) {
+        b.size = size;
+        b.expected.setConstant(target.first);
+        for(size_t s = 0; s < size; ++s) {
+            const sample_type& sample = samples[indices[s]];
+            const size_t cls = classes[indices[s]];
+            BOOST_ASSERT(detail::validate_dimensions<input_dims>(sample));
+            BOOST_ASSERT_MSG(cls < output_dims::size, "Class value can not exceeds network output size");
+            std::copy(sample.data(), sample.data() + input_dims::size, b.input.data() + s * input_dims::size);
+            b.expected(s, cls, 0, 0) = target.second;
+        }
+    }
+
+    const sample_vector_type& samples;
+    const class_vector_type& classes;
+    const size_t batch_size;
+    const size_t batch_count;
+    const valid_range target;
+    const bool shuffle;
+
+    random_generator::random_generator_type generator;
+
+    std::array<batch, Buffers> ring;
+
+    /**
+     * \brief Batches published by the producer, and returned by the
+     *        consumer
+     */
+    std::atomic<size_t> produced{0};
+    std::atomic<size_t> consumed{0};
+    std::atomic<bool> stopped{false};
+
+    /**
+     * \brief Sleeping on an empty (ready) or full (freed) ring only, the
+     *        batches are handed over without the mutex
+     */
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable freed;
+
+    /**
+     * \brief Batches acquired by the consumer, consumer thread only
+     */
+    size_t taken = 0;
+
+    std::thread producer;
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_BATCH_LOADER_HPP */
@@ -0,0 +1,438 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_CHECKPOINT_HPP
+#define SP_ALGO_NN_CHECKPOINT_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <istream>
+#include <ostream>
+#include <algorithm>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sp/util/for_each.hpp"
+
+#include "config.hpp"
+#include "matrix.hpp"
+#include "types.hpp"
+#include "memory_plan.hpp"
+#include "fusion.hpp"
+#include "layer/detail/layers.hpp"
+
+/**
+ * \file Binary checkpoint format of the weights and biases of a network
+ *
+ * A checkpoint is a header, a table of entries (one per weights and biases
+ * tensor, in network order) and the data section. The data section starts
+ * at a page boundary and every tensor at an arena_alignment boundary, hence
+ * a checkpoint mapped into memory is used in place: the tensors of the
+ * layers view the mapped pages, which are shared through the page cache by
+ * every process mapping the file. Values are stored in the native byte
+ * order and float_t, both recorded in the header.
+ *
+ * Every entry records the layer, a hash of its descriptor (its kind, input
+ * and output dimensions, the dimensions of its weights and biases and
+ * float_t, see checkpoint_layer_descriptor) and the dimensions of the
+ * tensor, a checkpoint is only loaded into a network of the same layers. The checksum covers the
+ * entries and the data section.
+ */
+
+SP_ALGO_NN_DETAIL_NAMESPACE_BEGIN
+
+constexpr char checkpoint_magic[8] = {'S', 'P', 'N', 'N', 'C', 'K', 'P', 'T'};
+
+constexpr std::uint32_t checkpoint_version = 2;
+
+constexpr std::uint32_t checkpoint_byte_order = 0x01020304;
+
+/**
+ * \brief Alignment of the data section, the page size of the mapping
+ */
+constexpr std::uint64_t checkpoint_page = 4096;
+
+struct checkpoint_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t float_size;
+    std::uint32_t entry_count;
+
+    /**
+     * \brief Bytes from the start of the file, a multiple of checkpoint_page
+     */
+    std::uint64_t data_offset;
+    std::uint64_t data_size;
+    std::uint64_t checksum;
+};
+
+struct checkpoint_entry {
+    std::uint64_t layer;
+
+    /**
+     * \brief Hash of the descriptor of the layer
+     */
+    std::uint64_t type;
+
+    /**
+     * \brief 0 for the weights, 1 for the biases
+     */
+    std::uint32_t kind;
+    std::uint32_t rank;
+    std::uint64_t dims[4];
+
+    /**
+     * \brief Bytes from the start of the data section
+     */
+    std::uint64_t offset;
+    std::uint64_t count;
+};
+
+/**
+ * \brief FNV-1a over 64 bit words of a byte stream, the bytes are padded
+ *        with zeroes to a whole word
+ */
+struct checkpoint_checksum {
+
+    void update(const void* data, const std::size_t& bytes) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        std::size_t i = 0;
+        while(pending > 0 && i < bytes) {
+            push(p[i++]);
+        }
+        for(; i + 8 <= bytes; i += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, p + i, 8);
+            mix(word);
+        }
+        while(i < bytes) {
+            push(p[i++]);
+        }
+    }
+
+    std::uint64_t digest() {
+        while(pending > 0) {
+            push(0);
+        }
+        return value;
+    }
+
+private:
+
+    void mix(const std::uint64_t& word) {
+        value = (value ^ word) * 0x100000001b3ull;
+    }
+
+    /**
+     * \brief Shift a byte into the partial word, the first byte lowest as
+     *        the words read from (little endian) memory
+     */
+    void push(const unsigned char& byte) {
+        partial |= static_cast<std::uint64_t>(byte) << (8 * pending);
+        if(++pending == 8) {
+            mix(partial);
+            partial = 0;
+            pending = 0;
+        }
+    }
+
+    std::uint64_t value = 0xcbf29ce484222325ull;
+    std::uint64_t partial = 0;
+    std::size_t pending = 0;
+};
+
+inline std::uint64_t checkpoint_hash(const std::string& s) {
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    for(const char& c : s) {
+        h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+template<typename Layer>
+constexpr const char* checkpoint_layer_kind() {
+    if constexpr(is_fully_connected_layer<Layer>::value) {
+        return "fully_connected";
+    } else if constexpr(is_conv_layer<Layer>::value) {
+        return "convolution";
+    } else if constexpr(is_pooling_layer<Layer>::value) {
+        return "pooling";
+    } else {
+        return "layer";
+    }
+}
+
+template<typename Dims>
+std::string checkpoint_dims(const Dims& dims) {
+    std::string s;
+    for(size_t d = 0; d < dims.size(); ++d) {
+        s += (d == 0 ? "" : "x") + std::to_string(dims[d]);
+    }
+    return s;
+}
+
+/**
+ * \brief Descriptor of a layer, e.g. "convolution 1x32x32 6x28x28 w
+ *        6x1x5x5 b 6 f32". Unlike the (demangled) type name it does not
+ *        depend on the compiler, the standard library or namespaces.
+ */
+template<typename Layer>
+std::string checkpoint_layer_descriptor(const Layer& layer) {
+    using input_dims = typename Layer::input_dims;
+    using output_dims = typename Layer::output_dims;
+    std::string s = checkpoint_layer_kind<Layer>();
+    s += " " + checkpoint_dims(std::array<size_t, 3>{input_dims::d, input_dims::h, input_dims::w});
+    s += " " + checkpoint_dims(std::array<size_t, 3>{output_dims::d, output_dims::h, output_dims::w});
+    if constexpr(has_weight_and_delta_v<Layer>) {
+        s += " w " + checkpoint_dims(layer.w.dimensions());
+    }
+    if constexpr(has_bias_and_delta_v<Layer>) {
+        s += " b " + checkpoint_dims(layer.b.dimensions());
+    }
+    return s + " f" + std::to_string(8 * sizeof(float_t));
+}
+
+/**
+ * \brief Call f(layer index, weights or biases) for every tensor of a
+ *        checkpoint, in network order
+ */
+template<typename Layers, typename F>
+void for_each_checkpoint_tensor(Layers& layers, F f) {
+    size_t index = 0;
+    util::for_each(layers, [&](auto& layer) {
+        using layer_type = std::decay_t<decltype(layer)>;
+        if constexpr(has_weight_and_delta_v<layer_type>) {
+            f(index, layer, layer.w, 0u);
+        }
+        if constexpr(has_bias_and_delta_v<layer_type>) {
+            f(index, layer, layer.b, 1u);
+        }
+        ++index;
+    });
+}
+
+/**
+ * \brief The entries of the configured layers
+ */
+template<typename Layers>
+std::vector<checkpoint_entry> checkpoint_entries(Layers& layers) {
+    std::vector<checkpoint_entry> entries;
+    std::uint64_t offset = 0;
+    for_each_checkpoint_tensor(layers, [&](const size_t& index, auto& layer, auto& t, const std::uint32_t& kind) {
+        using tensor_type = std::decay_t<decltype(t)>;
+        checkpoint_entry e{};
+        e.layer = index;
+        e.type = checkpoint_hash(checkpoint_layer_descriptor(layer));
+        e.kind = kind;
+        e.rank = tensor_type::NumDimensions;
+        for(size_t d = 0; d < tensor_type::NumDimensions; ++d) {
+            e.dims[d] = t.dimension(d);
+        }
+        e.offset = offset;
+        e.count = t.size();
+        offset += arena_padded(t.size()) * sizeof(float_t);
+        entries.push_back(e);
+    });
+    return entries;
+}
+
+inline std::uint64_t checkpoint_data_offset(const size_t& entry_count) {
+    const std::uint64_t end = sizeof(checkpoint_header) + entry_count * sizeof(checkpoint_entry);
+    return (end + checkpoint_page - 1) / checkpoint_page * checkpoint_page;
+}
+
+inline std::uint64_t checkpoint_data_size(const std::vector<checkpoint_entry>& entries) {
+    return entries.empty() ? 0 : entries.back().offset + arena_padded(entries.back().count) * sizeof(float_t);
+}
+
+/**
+ * \brief Whether a header and the entries read match the expected
+ *        entries, the checksum is verified separately
+ */
+inline bool checkpoint_matches(const checkpoint_header& header, const checkpoint_entry* entries, const std::vector<checkpoint_entry>& expected) {
+    return std::equal(header.magic, header.magic + 8, checkpoint_magic)
+        && header.version == checkpoint_version
+        && header.byte_order == checkpoint_byte_order
+        && header.float_size == sizeof(float_t)
+        && header.entry_count == expected.size()
+        && header.data_offset == checkpoint_data_offset(expected.size())
+        && header.data_size == checkpoint_data_size(expected)
+        && std::memcmp(entries, expected.data(), expected.size() * sizeof(checkpoint_entry)) == 0;
+}
+
+/**
+ * \brief Copy the weights and biases of the layers into data, laid out as
+ *        the data section of a checkpoint of entries
+ */
+template<typename Layers>
+void snapshot_checkpoint(Layers& layers, const std::vector<checkpoint_entry>& entries, std::vector<float_t>& data) {
+    data.assign(checkpoint_data_size(entries) / sizeof(float_t), float_t(0));
+    size_t n = 0;
+    for_each_checkpoint_tensor(layers, [&](const size_t&, auto&, auto& t, const std::uint32_t&) {
+        std::copy(t.data(), t.data() + t.size(), data.data() + entries[n++].offset / sizeof(float_t));
+    });
+}
+
+/**
+ * \brief Write a checkpoint of entries, data is its data section
+ */
+inline bool write_checkpoint(std::ostream& os, const std::vector<checkpoint_entry>& entries, const float_t* data) {
+    checkpoint_header header{};
+    std::copy(checkpoint_magic, checkpoint_magic + 8, header.magic);
+    header.version = checkpoint_version;
+    header.byte_order = checkpoint_byte_order;
+    header.float_size = sizeof(float_t);
+    header.entry_count = entries.size();
+    header.data_offset = checkpoint_data_offset(entries.size());
+    header.data_size = checkpoint_data_size(entries);
+
+    checkpoint_checksum checksum;
+    checksum.update(entries.data(), entries.size() * sizeof(checkpoint_entry));
+    checksum.update(data, header.data_size);
+    header.checksum = checksum.digest();
+
+    const std::vector<char> page_padding(header.data_offset - sizeof(header) - entries.size() * sizeof(checkpoint_entry), 0);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(checkpoint_entry));
+    os.write(page_padding.data(), page_padding.size());
+    os.write(reinterpret_cast<const char*>(data), header.data_size);
+    return !!os;
+}
+
+/**
+ * \brief Write the weights and biases of the layers
+ */
+template<typename Layers>
+bool write_checkpoint(Layers& layers, std::ostream& os) {
+    const std::vector<checkpoint_entry> entries = checkpoint_entries(layers);
+    std::vector<float_t> data;
+    snapshot_checkpoint(layers, entries, data);
+    return write_checkpoint(os, entries, data.data());
+}
+
+/**
+ * \brief Read the weights and biases of the layers, configured for the
+ *        network the checkpoint was written by. The layers are left
+ *        unchanged if the checkpoint does not match or is corrupt.
+ */
+template<typename Layers>
+bool read_checkpoint(Layers& layers, std::istream& is) {
+    const std::vector<checkpoint_entry> expected = checkpoint_entries(layers);
+    checkpoint_header header;
+    std::vector<checkpoint_entry> entries(expected.size());
+    if(!is.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || !is.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(checkpoint_entry))
+            || !checkpoint_matches(header, entries.data(), expected)
+            || !is.ignore(header.data_offset - sizeof(header) - entries.size() * sizeof(checkpoint_entry))) {
+        return false;
+    }
+    std::vector<float_t> data(header.data_size / sizeof(float_t));
+    if(!is.read(reinterpret_cast<char*>(data.data()), header.data_size)) {
+        return false;
+    }
+    checkpoint_checksum checksum;
+    checksum.update(entries.data(), entries.size() * sizeof(checkpoint_entry));
+    checksum.update(data.data(), header.data_size);
+    if(checksum.digest() != header.checksum) {
+        return false;
+    }
+    size_t n = 0;
+    for_each_checkpoint_tensor(layers, [&](const size_t&, auto&, auto& t, const std::uint32_t&) {
+        const float_t* from = data.data() + entries[n++].offset / sizeof(float_t);
+        std::copy(from, from + t.size(), t.data());
+    });
+    return true;
+}
+
+/**
+ * \brief A checkpoint file mapped into memory, copy on write, i.e. pages
+ *        are shared until written
+ */
+struct mapped_checkpoint {
+
+    mapped_checkpoint(const mapped_checkpoint&) = delete;
+    mapped_checkpoint& operator=(const mapped_checkpoint&) = delete;
+
+    /**
+     * \brief Map the file, empty (see data) if it can not be mapped
+     */
+    explicit mapped_checkpoint(const std::string& file) {
+        const int fd = ::open(file.c_str(), O_RDONLY);
+        if(fd < 0) {
+            return;
+        }
+        struct stat st;
+        if(::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* ptr = ::mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if(ptr != MAP_FAILED) {
+                base = static_cast<unsigned char*>(ptr);
+                size = st.st_size;
+            }
+        }
+        ::close(fd);
+    }
+
+    ~mapped_checkpoint() {
+        if(base) {
+            ::munmap(base, size);
+        }
+    }
+
+    unsigned char* data() const {
+        return base;
+    }
+
+    unsigned char* base = nullptr;
+    std::size_t size = 0;
+};
+
+/**
+ * \brief Point the weights and biases of the layers at a mapped checkpoint,
+ *        see parameter_tensor::map. The layers are left unchanged if the
+ *        checkpoint does not match, or is corrupt and verify is set.
+ */
+template<typename Layers>
+bool map_checkpoint(Layers& layers, const mapped_checkpoint& mapping, bool verify) {
+    const std::vector<checkpoint_entry> expected = checkpoint_entries(layers);
+    if(!mapping.data() || mapping.size < checkpoint_data_offset(expected.size())) {
+        return false;
+    }
+    checkpoint_header header;
+    std::memcpy(&header, mapping.data(), sizeof(header));
+    const checkpoint_entry* entries = reinterpret_cast<const checkpoint_entry*>(mapping.data() + sizeof(header));
+    if(!checkpoint_matches(header, entries, expected) || mapping.size < header.data_offset + header.data_size) {
+        return false;
+    }
+    float_t* data = reinterpret_cast<float_t*>(mapping.data() + header.data_offset);
+    if(verify) {
+        checkpoint_checksum checksum;
+        checksum.update(entries, expected.size() * sizeof(checkpoint_entry));
+        checksum.update(data, header.data_size);
+        if(checksum.digest() != header.checksum) {
+            return false;
+        }
+    }
+    size_t n = 0;
+    for_each_checkpoint_tensor(layers, [&](const size_t&, auto&, auto& t, const std::uint32_t&) {
+        t.map(data + entries[n++].offset / sizeof(float_t));
+    });
+    return true;
+}
+
+SP_ALGO_NN_DETAIL_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_CHECKPOINT_HPP */
@@ -0,0 +1,202 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_CHECKPOINT_WRITER_HPP
+#define SP_ALGO_NN_CHECKPOINT_WRITER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "config.hpp"
+#include "checkpoint.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Writes binary checkpoints of a network on a background thread
+ *
+ * save copies the weights and biases into a snapshot buffer, i.e. a step
+ * boundary of training (e.g. on_epoch or on_batch) is the only time the
+ * network is read, and returns. The background thread writes the snapshot
+ * to a temporary file, syncs it to disk, renames it over the target and
+ * syncs the directory, hence the target is always a complete checkpoint.
+ * At most InFlight snapshots are pending, save waits for a buffer if all
+ * are. save is called from one thread, e.g. the training thread.
+ *
+ * \tparam Network the network type, must outlive the writer
+ * \tparam InFlight the number of snapshot buffers
+ */
+template<typename Network, size_t InFlight = 2>
+struct checkpoint_writer {
+
+    static_assert(InFlight > 0, "InFlight is greater than zero");
+
+    explicit checkpoint_writer(Network& network) : network(network) {
+        writer = std::thread([this]() {
+            write();
+        });
+    }
+
+    checkpoint_writer(const checkpoint_writer&) = delete;
+    checkpoint_writer& operator=(const checkpoint_writer&) = delete;
+
+    /**
+     * \brief Writes the pending snapshots, then stops
+     */
+    ~checkpoint_writer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+        changed.notify_all();
+        writer.join();
+    }
+
+    /**
+     * \brief Snapshot the weights of the network, written to file in the
+     *        background
+     */
+    void save(const std::string& file) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() {
+            return pending < InFlight;
+        });
+        snapshot& s = snapshots[(next + pending) % InFlight];
+        lock.unlock();
+
+        /* The buffer is not visible to the writer until published */
+        s.file = file;
+        s.entries = detail::checkpoint_entries(network.layers);
+        detail::snapshot_checkpoint(network.layers, s.entries, s.data);
+
+        lock.lock();
+        ++pending;
+        lock.unlock();
+        changed.notify_all();
+    }
+
+    /**
+     * \brief Wait until every snapshot taken has been written
+     */
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() {
+            return pending == 0;
+        });
+    }
+
+    /**
+     * \brief Checkpoints written, and failed to be written
+     */
+    std::atomic<size_t> written{0};
+    std::atomic<size_t> failed{0};
+
+protected:
+
+    struct snapshot {
+        std::string file;
+        std::vector<detail::checkpoint_entry> entries;
+        std::vector<float_t> data;
+    };
+
+    void write() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for(;;) {
+            changed.wait(lock, [this]() {
+                return pending > 0 || stopped;
+            });
+            if(pending == 0) {
+                return;
+            }
+            snapshot& s = snapshots[next];
+            lock.unlock();
+
+            if(write(s)) {
+                written.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                failed.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            lock.lock();
+            next = (next + 1) % InFlight;
+            --pending;
+            changed.notify_all();
+        }
+    }
+
+    /**
+     * \brief Write the snapshot to the temporary file, sync it, rename it
+     *        over the target and sync the directory, i.e. the rename, too.
+     *        The temporary file is removed on failure.
+     */
+    static bool write(const snapshot& s) {
+        const std::string temporary = s.file + ".tmp";
+        bool written;
+        {
+            std::ofstream fs(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+            written = detail::write_checkpoint(fs, s.entries, s.data.data()) && fs.flush();
+        }
+        if(!written || !sync(temporary) || std::rename(temporary.c_str(), s.file.c_str()) != 0) {
+            ::unlink(temporary.c_str());
+            return false;
+        }
+        return sync(directory_of(s.file));
+    }
+
+    /**
+     * \brief fsync a file or a directory
+     */
+    static bool sync(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) {
+            return false;
+        }
+        const bool synced = ::fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+    }
+
+    static std::string directory_of(const std::string& file) {
+        const size_t slash = file.find_last_of('/');
+        if(slash == std::string::npos) {
+            return ".";
+        }
+        return slash == 0 ? std::string("/") : file.substr(0, slash);
+    }
+
+    Network& network;
+
+    std::array<snapshot, InFlight> snapshots;
+
+    /**
+     * \brief The oldest pending snapshot, and the number pending, guarded
+     *        by mutex
+     */
+    size_t next = 0;
+    size_t pending = 0;
+    bool stopped = false;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    std::thread writer;
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_CHECKPOINT_WRITER_HPP */
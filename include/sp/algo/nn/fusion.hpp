@@ -0,0 +1,396 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_FUSION_HPP
+#define SP_ALGO_NN_FUSION_HPP
+
+#include <array>
+#include <tuple>
+#include <type_traits>
+
+#include "config.hpp"
+#include "matrix.hpp"
+#include "layer/convolution.hpp"
+#include "layer/fully_connected.hpp"
+#include "layer/pooling_layer/layer.hpp"
+#include "layer/activation/layer.hpp"
+#include "sp/util/hints.hpp"
+
+/**
+ * \file Compile time fusion of adjacent layers of a network
+ *
+ * Recognized sequences (unary activations only):
+ *  - conv, activation, pooling, activation (LeNet stage)
+ *  - conv, activation
+ *  - pooling, activation
+ *
+ * A fused stage runs the bias and activation epilogue of the convolution and
+ * the pooling of every (sample, channel) plane while the plane is hot in
+ * cache, instead of one pass over the whole batch per layer. Only tensors
+ * read by back propagation are written: the raw convolution output (its bias
+ * excluded, the engines accumulate into it) and the activation outputs.
+ * The pooling output before its activation is not materialized.
+ */
+
+SP_ALGO_NN_DETAIL_NAMESPACE_BEGIN
+
+template<typename T>
+struct is_conv_layer : std::false_type {};
+
+template<
+    typename InputVolume,
+    typename KernelParams,
+    bool Biased,
+    typename Connectivity,
+    size_t Dilation,
+    typename Engine
+>
+struct is_conv_layer<conv_layer<InputVolume, KernelParams, Biased, Connectivity, Dilation, Engine>> : std::true_type {};
+
+template<typename T>
+struct is_fully_connected_layer : std::false_type {};
+
+template<typename InputDims, size_t OutputSize, bool Biased, typename Precision>
+struct is_fully_connected_layer<fully_connected_layer<InputDims, OutputSize, Biased, Precision>> : std::true_type {};
+
+template<typename T>
+struct is_pooling_layer : std::false_type {};
+
+template<typename PoolingAlgorithm, typename InputVolume, typename KernelParams, bool Biased>
+struct is_pooling_layer<pooling_layer<PoolingAlgorithm, InputVolume, KernelParams, Biased>> : std::true_type {};
+
+template<typename T>
+struct is_unary_activation_layer : std::false_type {};
+
+template<typename InputVolume, typename ActivationOp>
+struct is_unary_activation_layer<activation_layer<InputVolume, ActivationOp>> : std::is_same<
+    typename ActivationOp::category,
+    activation_op_unary_category
+> {};
+
+template<typename T>
+struct is_softmax_layer : std::false_type {};
+
+template<typename InputVolume>
+struct is_softmax_layer<activation_layer<InputVolume, softmax_activation_op>> : std::true_type {};
+
+/**
+ * \brief Layer I of the tuple of layers, void if out of range
+ */
+template<size_t I, typename Layers, typename Enable = void>
+struct fusion_layer_at {
+    using type = void;
+};
+
+template<size_t I, typename Layers>
+struct fusion_layer_at<I, Layers, std::enable_if_t<(I < std::tuple_size_v<Layers>)>> {
+    using type = std::tuple_element_t<I, Layers>;
+};
+
+template<size_t I, typename Layers>
+using fusion_layer_at_t = typename fusion_layer_at<I, Layers>::type;
+
+/**
+ * \brief Number of layers fused into the stage starting at layer I, one
+ *        when layer I is not the head of a recognized sequence
+ */
+template<size_t I, typename Layers>
+constexpr size_t fused_stage_length() {
+    using first = fusion_layer_at_t<I, Layers>;
+    using second = fusion_layer_at_t<I + 1, Layers>;
+    using third = fusion_layer_at_t<I + 2, Layers>;
+    using fourth = fusion_layer_at_t<I + 3, Layers>;
+    if(     is_conv_layer<first>::value && is_unary_activation_layer<second>::value &&
+            is_pooling_layer<third>::value && is_unary_activation_layer<fourth>::value) {
+        return 4;
+    }
+    if((is_conv_layer<first>::value || is_pooling_layer<first>::value) && is_unary_activation_layer<second>::value) {
+        return 2;
+    }
+    return 1;
+}
+
+template<size_t I, typename Layers>
+constexpr size_t fused_stage_length_v = fused_stage_length<I, Layers>();
+
+/**
+ * \brief Adds the bias of the convolution to the raw output plane
+ *        (si, od) and activates it into output
+ */
+template<typename Conv, typename Activation>
+sp_hot void fused_conv_activation_plane(    Conv& conv,
+                                            tensor_4_view raw,
+                                            tensor_4_view output,
+                                            const size_t& si,
+                                            const size_t& od) {
+    using output_dims = typename Conv::output_dims;
+    typename Activation::activation_op_type op;
+    const float_t bias = Conv::biased ? conv.b(od) : float_t(0);
+    const float_t* in = raw.data() + (si * output_dims::d + od) * output_dims::area;
+    float_t* out = output.data() + (si * output_dims::d + od) * output_dims::area;
+    for(size_t i = 0; i < output_dims::area; ++i) {
+        out[i] = op(in[i] + bias);
+    }
+}
+
+/**
+ * \brief Pools the input plane (si, od) and activates the pooled plane
+ *        into output, with the bookkeeping of back propagation when Training
+ */
+template<typename Pool, typename Activation, bool Training>
+sp_hot void fused_pooling_activation_plane( Pool& pool,
+                                            tensor_4_view input,
+                                            tensor_4_view output,
+                                            const size_t& si,
+                                            const size_t& od) {
+    using output_dims = typename Pool::output_dims;
+    using kernel_params = typename Pool::kernel_params;
+    typename Activation::activation_op_type op;
+    const float_t weight = pool.w(od, 0, 0, 0);
+    const float_t bias = pool.b(od);
+    for (size_t oy = 0, iny = 0; oy < output_dims::h; ++oy, iny += kernel_params::s_h) {
+        for (size_t ox = 0, inx = 0; ox < output_dims::w; ++ox, inx += kernel_params::s_w) {
+            typename Pool::down_sampler_op_type sampler(kernel_params::h * kernel_params::w);
+            for (size_t ky = 0; ky < kernel_params::h; ++ky) {
+                for (size_t kx = 0; kx < kernel_params::w; ++kx) {
+                    sampler.sample(input, si, od, iny+ky, inx+kx);
+                }
+            }
+            float_t res = pool.pooling_algorithm.template subsample<Training>(sampler, si, od, oy, ox);
+            res *= weight;
+            res += bias;
+            output(si, od, oy, ox) = op(res);
+        }
+    }
+}
+
+/**
+ * \brief Back propagation of the activated pooling plane (si, d). The
+ *        delta of the pooled plane is written to pooled_delta, the
+ *        upsampled delta times the pooling weight of every input pixel is
+ *        passed to emit(iy, ix, value).
+ */
+template<typename Pool, typename Activation, typename Emit>
+sp_hot void fused_pooling_activation_plane_backward(    Pool& pool,
+                                                        tensor_4_view prev_out,
+                                                        tensor_4_view curr_out,
+                                                        tensor_4_view curr_delta,
+                                                        tensor_4_view pooled_delta,
+                                                        const size_t& slot,
+                                                        const size_t& si,
+                                                        const size_t& d,
+                                                        Emit&& emit) {
+    using input_dims = typename Pool::input_dims;
+    using output_dims = typename Pool::output_dims;
+    typename Activation::activation_op_deriv_type op_deriv;
+
+    for (size_t oy = 0; oy < output_dims::h; ++oy) {
+        for (size_t ox = 0; ox < output_dims::w; ++ox) {
+            const float_t delta = curr_delta(si, d, oy, ox) * op_deriv(curr_out(si, d, oy, ox));
+            pooled_delta(si, d, oy, ox) = delta;
+            pool.db(slot, d) += delta;
+        }
+    }
+
+    const float_t weight = pool.w(d, 0, 0, 0);
+    for (size_t iy = 0; iy < input_dims::h; ++iy) {
+        for (size_t ix = 0; ix < input_dims::w; ++ix) {
+            auto upsampled_cd = pool.pooling_algorithm.upsample(pooled_delta, si, d, iy, ix);
+            pool.dw(slot, d, 0, 0, 0) += prev_out(si, d, iy, ix) * upsampled_cd;
+            emit(iy, ix, weight * upsampled_cd);
+        }
+    }
+}
+
+/**
+ * \brief Forward propagation of the fused stage of Length layers starting at
+ *        layer I, values[I] is the input and values[I + Length] the output.
+ *        The pooling bookkeeping of back propagation is compiled out unless
+ *        Training.
+ */
+template<size_t I, size_t Length, bool Training, typename Layers, typename Values>
+sp_hot void fused_forward(Layers& layers, Values& values) {
+    using first_type = std::tuple_element_t<I, Layers>;
+    using second_type = std::tuple_element_t<I + 1, Layers>;
+
+    auto& first = std::get<I>(layers);
+    tensor_4_view input = values[I];
+    const size_t samples = input.dimension(0);
+
+    if constexpr(is_conv_layer<first_type>::value) {
+        using output_dims = typename first_type::output_dims;
+
+        /* Raw convolution, the engines accumulate */
+        values[I+1].setZero();
+        first.engine.forward(first, input, values[I+1]);
+
+        if constexpr(Length == 4) {
+            using pool_type = std::tuple_element_t<I + 2, Layers>;
+            using activation_type = std::tuple_element_t<I + 3, Layers>;
+            auto& pool = std::get<I + 2>(layers);
+
+            pool.pooling_algorithm.template before_forward<
+                typename pool_type::input_dims,
+                typename pool_type::output_dims,
+                typename pool_type::kernel_params,
+                Training
+            >(samples);
+
+            #pragma omp parallel for collapse(2)
+            for (size_t si = 0; si < samples; ++si) {
+                for (size_t od = 0; od < output_dims::d; ++od) {
+                    fused_conv_activation_plane<first_type, second_type>(first, values[I+1], values[I+2], si, od);
+                    fused_pooling_activation_plane<pool_type, activation_type, Training>(pool, values[I+2], values[I+4], si, od);
+                }
+            }
+        } else {
+            #pragma omp parallel for collapse(2)
+            for (size_t si = 0; si < samples; ++si) {
+                for (size_t od = 0; od < output_dims::d; ++od) {
+                    fused_conv_activation_plane<first_type, second_type>(first, values[I+1], values[I+2], si, od);
+                }
+            }
+        }
+    } else {
+        static_assert(Length == 2 && is_pooling_layer<first_type>::value, "Fused pooling stage is pooling and activation");
+
+        first.pooling_algorithm.template before_forward<
+            typename first_type::input_dims,
+            typename first_type::output_dims,
+            typename first_type::kernel_params,
+            Training
+        >(samples);
+
+        #pragma omp parallel for collapse(2)
+        for (size_t si = 0; si < samples; ++si) {
+            for (size_t od = 0; od < first_type::output_dims::d; ++od) {
+                fused_pooling_activation_plane<first_type, second_type, Training>(first, input, values[I+2], si, od);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Back propagation of the fused stage of Length layers starting at
+ *        layer I, deltas[I + Length] is the delta of the output and
+ *        deltas[I] receives the delta of the input
+ */
+template<size_t I, size_t Length, typename Layers, typename Values>
+sp_hot void fused_backward(Layers& layers, Values& values, Values& deltas) {
+    using first_type = std::tuple_element_t<I, Layers>;
+    using second_type = std::tuple_element_t<I + 1, Layers>;
+
+    auto& first = std::get<I>(layers);
+    const size_t samples = values[I].dimension(0);
+
+    if constexpr(is_conv_layer<first_type>::value) {
+        using output_dims = typename first_type::output_dims;
+
+        if constexpr(Length == 4) {
+            using pool_type = std::tuple_element_t<I + 2, Layers>;
+            using activation_type = std::tuple_element_t<I + 3, Layers>;
+            auto& pool = std::get<I + 2>(layers);
+
+            #pragma omp parallel for
+            for (size_t si = 0; si < samples; ++si) {
+                typename second_type::activation_op_deriv_type op_deriv;
+                const size_t slot = gradient_slot(pool.dw);
+                for (size_t d = 0; d < output_dims::d; ++d) {
+                    fused_pooling_activation_plane_backward<pool_type, activation_type>(
+                        pool, values[I+2], values[I+4], deltas[I+4], deltas[I+3], slot, si, d,
+                        [&](const size_t& iy, const size_t& ix, const float_t& delta) {
+                            deltas[I+1](si, d, iy, ix) = delta * op_deriv(values[I+2](si, d, iy, ix));
+                        }
+                    );
+                }
+            }
+            pool.accumulated_samples += samples;
+            std::get<I + 3>(layers).accumulated_samples += samples;
+        } else {
+            #pragma omp parallel for collapse(2)
+            for (size_t si = 0; si < samples; ++si) {
+                for (size_t od = 0; od < output_dims::d; ++od) {
+                    typename second_type::activation_op_deriv_type op_deriv;
+                    const size_t offset = (si * output_dims::d + od) * output_dims::area;
+                    const float_t* out = values[I+2].data() + offset;
+                    const float_t* cd = deltas[I+2].data() + offset;
+                    float_t* pd = deltas[I+1].data() + offset;
+                    for(size_t i = 0; i < output_dims::area; ++i) {
+                        pd[i] = cd[i] * op_deriv(out[i]);
+                    }
+                }
+            }
+        }
+        std::get<I + 1>(layers).accumulated_samples += samples;
+
+        /* The convolution back propagates the delta of its raw output */
+        deltas[I].setZero();
+        first.backward_prop(values[I], deltas[I], values[I+1], deltas[I+1]);
+    } else {
+        static_assert(Length == 2 && is_pooling_layer<first_type>::value, "Fused pooling stage is pooling and activation");
+
+        #pragma omp parallel for
+        for (size_t si = 0; si < samples; ++si) {
+            const size_t slot = gradient_slot(first.dw);
+            for (size_t d = 0; d < first_type::output_dims::d; ++d) {
+                fused_pooling_activation_plane_backward<first_type, second_type>(
+                    first, values[I], values[I+2], deltas[I+2], deltas[I+1], slot, si, d,
+                    [&](const size_t& iy, const size_t& ix, const float_t& delta) {
+                        deltas[I](si, d, iy, ix) = delta;
+                    }
+                );
+            }
+        }
+        first.accumulated_samples += samples;
+        std::get<I + 1>(layers).accumulated_samples += samples;
+    }
+}
+
+/**
+ * \brief Marks the values and deltas touched by the fused stage of Length
+ *        layers starting at layer I, forward propagation at step f and back
+ *        propagation at step b (only when Training), see
+ *        detail::memory_plan. The values and deltas not materialized by the
+ *        stage are left untouched.
+ */
+template<size_t I, size_t Length, typename Layers, bool Training, typename Plan>
+constexpr void fused_lifetimes(Plan& plan, const size_t& f, const size_t& b) {
+    using first_type = std::tuple_element_t<I, Layers>;
+
+    plan.touch(Plan::value(I), f);
+    plan.touch(Plan::value(I + Length), f);
+    if constexpr(is_conv_layer<first_type>::value) {
+        /* Raw convolution output and its activation */
+        plan.touch(Plan::value(I + 1), f);
+        plan.touch(Plan::value(I + 2), f);
+    }
+
+    if constexpr(Training) {
+        plan.touch(Plan::value(I + Length), b);
+        plan.touch(Plan::delta(I + Length), b);
+        plan.touch(Plan::delta(I + 1), b);
+        plan.touch(Plan::delta(I), b);
+        if constexpr(first_type::backward_reads_input) {
+            plan.touch(Plan::value(I), b);
+        }
+        if constexpr(is_conv_layer<first_type>::value) {
+            plan.touch(Plan::value(I + 2), b);
+            if constexpr(first_type::backward_reads_output) {
+                plan.touch(Plan::value(I + 1), b);
+            }
+            if constexpr(Length == 4) {
+                /* Pooled delta */
+                plan.touch(Plan::delta(I + 3), b);
+            }
+        }
+    }
+}
+
+SP_ALGO_NN_DETAIL_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_FUSION_HPP */
@@ -7,4 +7,5 @@
  */
 
 #include "activation/layer.hpp"
-#include "activation/tanh.hpp"
\ No newline at end of file
+#include "activation/tanh.hpp"
+#include "activation/softmax.hpp"
\ No newline at end of file
@@ -51,7 +51,7 @@ struct activation_op_helper<
     using op_type = Op;
     using op_deriv_type = typename Op::derivative;
 
-    void fprop(tensor_4& input, tensor_4& output) {
+    void fprop(tensor_4_view input, tensor_4_view output) {
         /* Number of samples in the input */
         const size_t samples = input.dimension(0);
         #pragma omp parallel for simd
@@ -66,10 +66,10 @@ struct activation_op_helper<
         }
     }
 
-    void bprop(     tensor_4& prev_out,
-                    tensor_4& prev_delta,
-                    tensor_4& curr_out,
-                    tensor_4& curr_delta) {
+    void bprop(     tensor_4_view prev_out,
+                    tensor_4_view prev_delta,
+                    tensor_4_view curr_out,
+                    tensor_4_view curr_delta) {
         /**
          * Number of samples in the previous output
          */
@@ -86,6 +86,35 @@ struct activation_op_helper<
         }
     }
 
+    /**
+     * \brief Element-wise forward propagation, independent of the layout
+     *        of the tensors (i.e. channel blocked)
+     */
+    void fprop_elements(tensor_4_view input, tensor_4_view output) {
+        const size_t size = input.size();
+        const float_t* in = input.data();
+        float_t* out = output.data();
+        #pragma omp parallel for simd
+        for(size_t i = 0; i < size; ++i) {
+            out[i] = op(in[i]);
+        }
+    }
+
+    /**
+     * \brief Element-wise back propagation, independent of the layout of
+     *        the tensors. Zero padding of the current delta stays zero.
+     */
+    void bprop_elements(tensor_4_view prev_delta, tensor_4_view curr_out, tensor_4_view curr_delta) {
+        const size_t size = curr_delta.size();
+        const float_t* out = curr_out.data();
+        const float_t* cd = curr_delta.data();
+        float_t* pd = prev_delta.data();
+        #pragma omp parallel for simd
+        for(size_t i = 0; i < size; ++i) {
+            pd[i] = cd[i] * op_deriv(out[i]);
+        }
+    }
+
     op_type op;
     op_deriv_type op_deriv;
 };
@@ -107,26 +136,51 @@ struct activation_op_helper<
     using op_type = Op;
     using op_deriv_type = typename Op::derivative;
 
-    void fprop(tensor_4& input, tensor_4& output) {
+    /**
+     * \brief Values of a sample, and of a depth slice
+     */
+    constexpr static size_t sample_size = input_dims::d * input_dims::h * input_dims::w;
+    constexpr static size_t area = input_dims::h * input_dims::w;
+
+    /**
+     * \brief Applies op to the depth slice of every spatial position of
+     *        every sample
+     */
+    void fprop(tensor_4_view input, tensor_4_view output) {
         /* Number of samples in the input */
         const size_t samples = input.dimension(0);
-        #pragma omp parallel for simd
+        const float_t* in = input.data();
+        float_t* out = output.data();
+        #pragma omp parallel for
         for(size_t si = 0; si < samples; ++si) {
-            throw std::runtime_error("Not implemented yet");
+            for(size_t i = 0; i < area; ++i) {
+                const size_t first = si * sample_size + i;
+                op(in + first, out + first, input_dims::d, area);
+            }
         }
     }
 
-    void bprop(     tensor_4& prev_out,
-                    tensor_4& prev_delta,
-                    tensor_4& curr_out,
-                    tensor_4& curr_delta) {
+    /**
+     * \brief Back propagates through the depth slices, from the current
+     *        output alone
+     */
+    void bprop(     tensor_4_view prev_out,
+                    tensor_4_view prev_delta,
+                    tensor_4_view curr_out,
+                    tensor_4_view curr_delta) {
         /**
          * Number of samples in the previous output
          */
         const size_t samples = prev_out.dimension(0);
-        #pragma omp parallel for simd
+        const float_t* out = curr_out.data();
+        const float_t* cd = curr_delta.data();
+        float_t* pd = prev_delta.data();
+        #pragma omp parallel for
         for(size_t si = 0; si < samples; ++si) {
-            throw std::runtime_error("Not implemented yet");
+            for(size_t i = 0; i < area; ++i) {
+                const size_t first = si * sample_size + i;
+                op_deriv(out + first, cd + first, pd + first, input_dims::d, area);
+            }
         }
     }
 
@@ -71,17 +71,34 @@ struct activation_layer : layer<
      */
     using output_dims = typename base::output_dims;
 
-    void forward_prop_impl(tensor_4& input, tensor_4& output) {
+    /**
+     * \brief Unary activations are element-wise, hence operate on the
+     *        channel blocked layout as is
+     */
+    constexpr static bool blocked_layout = std::is_same_v<
+        typename activation_op_type::category,
+        activation_op_unary_category
+    >;
+
+    /**
+     * \brief Activations back propagate from their output alone, the input
+     *        is not read, see detail::memory_plan
+     */
+    constexpr static bool backward_reads_input = false;
+
+    constexpr static bool backward_reads_output = true;
+
+    void forward_prop_impl(tensor_4_view input, tensor_4_view output) {
         detail::activation_op_helper<
             activation_op_type,
             input_dims
         >().fprop(input, output);
     }
 
-    void backward_prop_impl(    tensor_4& prev_out,
-                                tensor_4& prev_delta,
-                                tensor_4& curr_out,
-                                tensor_4& curr_delta) {
+    void backward_prop_impl(    tensor_4_view prev_out,
+                                tensor_4_view prev_delta,
+                                tensor_4_view curr_out,
+                                tensor_4_view curr_delta) {
         detail::activation_op_helper<
             activation_op_type,
             input_dims
@@ -89,6 +106,25 @@ struct activation_layer : layer<
     }
 
 
+    template<size_t Block>
+    void forward_blocked_impl(tensor_4_view input, tensor_4_view output) {
+        detail::activation_op_helper<
+            activation_op_type,
+            input_dims
+        >().fprop_elements(input, output);
+    }
+
+    template<size_t Block>
+    void backward_blocked_impl( tensor_4_view,
+                                tensor_4_view prev_delta,
+                                tensor_4_view curr_out,
+                                tensor_4_view curr_delta) {
+        detail::activation_op_helper<
+            activation_op_type,
+            input_dims
+        >().bprop_elements(prev_delta, curr_out, curr_delta);
+    }
+
     valid_range range_impl() {
         return activation_op_type().range();
     }
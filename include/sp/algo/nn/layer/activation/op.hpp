@@ -218,6 +218,10 @@ struct softmax_deriv_activation_op;
 /**
  * \brief SoftMax Activation Op
  *
+ * Applied to the n values of a depth slice, i.e. the channels of a spatial
+ * position of a sample, stride apart. The maximum is subtracted before
+ * exponentiation, hence large inputs do not overflow.
+ *
  * activation category : activation_op_depth_slice_category
  */
 struct softmax_activation_op
@@ -227,13 +231,29 @@ struct softmax_activation_op
         > {
 
     /**
-     * The derivation of tanh_activation_op
+     * The derivation of softmax_activation_op
      */
     using derivative = softmax_deriv_activation_op;
 
     template<typename T>
-    auto operator()(T&& x) const {
-        throw "Not implemented";
+    void operator()(const T* x, T* y, const size_t& n, const size_t& stride) const {
+        using namespace std;
+        T m = x[0];
+        #pragma omp simd reduction(max:m)
+        for(size_t i = 1; i < n; ++i) {
+            m = max(m, x[i * stride]);
+        }
+        T sum = 0;
+        #pragma omp simd reduction(+:sum)
+        for(size_t i = 0; i < n; ++i) {
+            y[i * stride] = exp(x[i * stride] - m);
+            sum += y[i * stride];
+        }
+        const T r = T(1) / sum;
+        #pragma omp simd
+        for(size_t i = 0; i < n; ++i) {
+            y[i * stride] *= r;
+        }
     }
 
     valid_range range() const {
@@ -244,6 +264,10 @@ struct softmax_activation_op
 /**
  * \brief SoftMax Derivative Activation Op
  *
+ * The product of the output delta dy with the Jacobian of the softmax y of a
+ * depth slice, dx_i = y_i * (dy_i - sum_j y_j * dy_j). The Jacobian is not
+ * formed.
+ *
  * activation category : activation_op_depth_slice_category
  */
 struct softmax_deriv_activation_op
@@ -251,10 +275,18 @@ struct softmax_deriv_activation_op
             softmax_deriv_activation_op,
             activation_op_depth_slice_category
         > {
-    
+
     template<typename T>
-    auto operator()(const T& x) const {
-        throw "Not implemented";
+    void operator()(const T* y, const T* dy, T* dx, const size_t& n, const size_t& stride) const {
+        T dot = 0;
+        #pragma omp simd reduction(+:dot)
+        for(size_t i = 0; i < n; ++i) {
+            dot += y[i * stride] * dy[i * stride];
+        }
+        #pragma omp simd
+        for(size_t i = 0; i < n; ++i) {
+            dx[i * stride] = y[i * stride] * (dy[i * stride] - dot);
+        }
     }
 
     valid_range range() const {
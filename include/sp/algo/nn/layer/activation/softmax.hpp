@@ -13,7 +13,7 @@
 #include "op.hpp"
 
 /**
- * @file Implements tanh activation layer using alias
+ * @file Implements softmax activation layer using alias
  *       and activation_op definition
  */
 
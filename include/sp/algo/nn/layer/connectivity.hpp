@@ -10,7 +10,6 @@
 #define SP_ALGO_NN_LAYER_CONNECTIVITY_HPP
 
 #include <array>
-#include <vector>
 #include "layer.hpp"
 
 SP_ALGO_NN_NAMESPACE_BEGIN
@@ -22,10 +21,18 @@ SP_ALGO_NN_NAMESPACE_BEGIN
 
 /**
  * \brief Group Connectivity of convolution
+ *
+ * The input (Rows) and output (Cols) channels are split into Groups equally
+ * sized groups, every output channel is connected to the input channels of
+ * its group only.
  */
 template<size_t Groups, size_t Rows, size_t Cols>
 struct ngroups_connectivity {
 
+    static_assert(Groups > 0, "Groups must be greater or equal to 1");
+    static_assert(Rows % Groups == 0, "Rows are divisible into groups");
+    static_assert(Cols % Groups == 0, "Cols are divisible into groups");
+
     /**
      * Groups in the sparsity tables
      */
@@ -46,31 +53,16 @@ struct ngroups_connectivity {
      */
     constexpr static size_t size = rows * cols;
 
-    ngroups_connectivity() : table(initialize()) {}
-    ngroups_connectivity(const ngroups_connectivity&) = default;
-    ngroups_connectivity(ngroups_connectivity&&) = default;
-    ngroups_connectivity& operator=(const ngroups_connectivity&) = default;
-    ngroups_connectivity& operator=(ngroups_connectivity&&) = default;
-
-    inline bool operator()(const size_t& x, const size_t& y) {
-        return table[x * rows + y];
+    /**
+     * \brief Whether output channel x is connected to input channel y
+     */
+    constexpr static bool connected(const size_t& x, const size_t& y) {
+        return x / (cols / groups) == y / (rows / groups);
     }
 
-    std::array<bool, size> initialize() {
-        std::array<bool, size> res;
-        auto row_group = rows / groups;
-        auto col_group = cols / groups;
-        for(size_t g = 0; g < groups; g++) {
-            for(size_t r = 0; r < row_group; r++) {
-                for(size_t c = 0; c < col_group; c++) {
-                    res[(r + g * row_group) * cols + c + g * col_group] = true;
-                }
-            }
-        }
-        return res;
+    inline bool operator()(const size_t& x, const size_t& y) const {
+        return connected(x, y);
     }
-
-    std::array<bool, size> table;
 };
 
 /**
@@ -78,9 +70,14 @@ struct ngroups_connectivity {
  *
  */
 struct full_connectivity {
-    inline bool operator()(const size_t&, const size_t&) {
+
+    constexpr static bool connected(const size_t&, const size_t&) {
         return true;
     }
+
+    inline bool operator()(const size_t& x, const size_t& y) const {
+        return connected(x, y);
+    }
 };
 
 /**
@@ -109,16 +106,207 @@ struct table_connectivity {
      */
     constexpr static size_t size = rows * cols;
 
-    table_connectivity() : table({Values...}) {}
-
-    inline bool operator()(const size_t& x, const size_t& y) {
+    /**
+     * \brief Whether output channel x is connected to input channel y
+     */
+    constexpr static bool connected(const size_t& x, const size_t& y) {
         return table[y * cols + x];
     }
 
-    std::vector<char> table;
+    inline bool operator()(const size_t& x, const size_t& y) const {
+        return connected(x, y);
+    }
+
+    constexpr static std::array<bool, size> table = {{Values...}};
 
 };
 
+namespace detail {
+
+    /**
+     * \brief Compiled tables of a connection_list
+     */
+    template<size_t Count, size_t Inputs, size_t Outputs>
+    struct connection_tables {
+
+        /**
+         * Kernels [offsets[od], offsets[od + 1]) belong to output channel od
+         */
+        std::array<size_t, Outputs + 1> offsets {};
+
+        /**
+         * Input channel of every kernel
+         */
+        std::array<size_t, Count> inputs {};
+
+        /**
+         * Output channel of every kernel
+         */
+        std::array<size_t, Count> outputs {};
+
+        /**
+         * Kernel of every (output, input) pair, Count if not connected
+         */
+        std::array<size_t, Inputs * Outputs> index {};
+    };
+
+    template<typename Connectivity, size_t Inputs, size_t Outputs>
+    constexpr size_t count_connections() {
+        size_t count = 0;
+        for(size_t od = 0; od < Outputs; ++od) {
+            for(size_t id = 0; id < Inputs; ++id) {
+                count += Connectivity::connected(od, id) ? 1 : 0;
+            }
+        }
+        return count;
+    }
+
+    template<typename Connectivity, size_t Inputs, size_t Outputs, size_t Count>
+    constexpr connection_tables<Count, Inputs, Outputs> compile_connections() {
+        connection_tables<Count, Inputs, Outputs> tables {};
+        size_t k = 0;
+        for(size_t od = 0; od < Outputs; ++od) {
+            tables.offsets[od] = k;
+            for(size_t id = 0; id < Inputs; ++id) {
+                if(Connectivity::connected(od, id)) {
+                    tables.inputs[k] = id;
+                    tables.outputs[k] = od;
+                    tables.index[od * Inputs + id] = k++;
+                } else {
+                    tables.index[od * Inputs + id] = Count;
+                }
+            }
+        }
+        tables.offsets[Outputs] = k;
+        return tables;
+    }
+
+    /**
+     * \brief Connectivity of a layer compiled into per output channel lists
+     *        of connected input channels
+     *
+     * Every connected (output, input) pair owns one kernel. Kernels are
+     * ordered by output channel and then input channel, which is the order
+     * of the compact weights of a layer, i.e. weights are only stored for
+     * connected pairs. The kernels of output channel od are
+     * '''[begin(od), end(od))''', the input channel of kernel k is
+     * '''input(k)'''.
+     *
+     * Connectivities that split the channels into equally sized groups
+     * report the number of groups, the kernels of a group then form a
+     * contiguous (outputs x inputs) block. Irregular connectivities report
+     * zero groups.
+     */
+    template<typename Connectivity, size_t Inputs, size_t Outputs>
+    struct connection_list {
+
+        static_assert(Connectivity::rows == Inputs, "Rows of the connectivity match the input depth");
+        static_assert(Connectivity::cols == Outputs, "Columns of the connectivity match the output depth");
+
+        constexpr static size_t count = count_connections<Connectivity, Inputs, Outputs>();
+
+        constexpr static size_t groups = 0;
+
+        constexpr static auto tables = compile_connections<Connectivity, Inputs, Outputs, count>();
+
+        constexpr static size_t begin(const size_t& od) {
+            return tables.offsets[od];
+        }
+
+        constexpr static size_t end(const size_t& od) {
+            return tables.offsets[od + 1];
+        }
+
+        constexpr static size_t input(const size_t& k) {
+            return tables.inputs[k];
+        }
+
+        constexpr static size_t output(const size_t& k) {
+            return tables.outputs[k];
+        }
+
+        constexpr static size_t index(const size_t& od, const size_t& id) {
+            return tables.index[od * Inputs + id];
+        }
+
+        constexpr static bool connected(const size_t& od, const size_t& id) {
+            return index(od, id) != count;
+        }
+    };
+
+    template<size_t Groups, size_t Rows, size_t Cols, size_t Inputs, size_t Outputs>
+    struct connection_list<ngroups_connectivity<Groups, Rows, Cols>, Inputs, Outputs> {
+
+        static_assert(Rows == Inputs, "Rows of the connectivity match the input depth");
+        static_assert(Cols == Outputs, "Columns of the connectivity match the output depth");
+
+        constexpr static size_t groups = Groups;
+
+        constexpr static size_t group_inputs = Inputs / Groups;
+
+        constexpr static size_t group_outputs = Outputs / Groups;
+
+        constexpr static size_t count = Outputs * group_inputs;
+
+        constexpr static size_t begin(const size_t& od) {
+            return od * group_inputs;
+        }
+
+        constexpr static size_t end(const size_t& od) {
+            return (od + 1) * group_inputs;
+        }
+
+        constexpr static size_t input(const size_t& k) {
+            return output(k) / group_outputs * group_inputs + k % group_inputs;
+        }
+
+        constexpr static size_t output(const size_t& k) {
+            return k / group_inputs;
+        }
+
+        constexpr static size_t index(const size_t& od, const size_t& id) {
+            return connected(od, id) ? od * group_inputs + id % group_inputs : count;
+        }
+
+        constexpr static bool connected(const size_t& od, const size_t& id) {
+            return od / group_outputs == id / group_inputs;
+        }
+    };
+
+    template<size_t Inputs, size_t Outputs>
+    struct connection_list<full_connectivity, Inputs, Outputs> {
+
+        constexpr static size_t groups = 1;
+
+        constexpr static size_t count = Outputs * Inputs;
+
+        constexpr static size_t begin(const size_t& od) {
+            return od * Inputs;
+        }
+
+        constexpr static size_t end(const size_t& od) {
+            return (od + 1) * Inputs;
+        }
+
+        constexpr static size_t input(const size_t& k) {
+            return k % Inputs;
+        }
+
+        constexpr static size_t output(const size_t& k) {
+            return k / Inputs;
+        }
+
+        constexpr static size_t index(const size_t& od, const size_t& id) {
+            return od * Inputs + id;
+        }
+
+        constexpr static bool connected(const size_t&, const size_t&) {
+            return true;
+        }
+    };
+
+}
+
 SP_ALGO_NN_NAMESPACE_END
 
 #endif	/* SP_ALGO_NN_LAYER_FULLY_CONNECTED_HPP */
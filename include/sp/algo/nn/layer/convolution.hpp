@@ -9,6 +9,8 @@
 #ifndef SP_ALGO_NN_LAYER_CONV_HPP
 #define SP_ALGO_NN_LAYER_CONV_HPP
 
+#include <type_traits>
+
 #include <boost/assert.hpp>
 
 #include "layer.hpp"
@@ -16,6 +18,8 @@
 #include "detail/layers.hpp"
 #include "sp/util/types.hpp"
 #include "params.hpp"
+#include "engine.hpp"
+#include "engine/blocked.hpp"
 
 
 SP_ALGO_NN_NAMESPACE_BEGIN
@@ -42,6 +46,7 @@ SP_ALGO_NN_NAMESPACE_BEGIN
  *  - V - Horizontal Stride
  *  - pad_h - Height of zero-padding
  *  - pad_w - Width of zero-padding
+ *  - dil - Dilation factor, Dilation + 1
  *
  * Output O of is a four dimensional tensor in R^NKPQ,
  *  where ```P = f(H, R, u, pad_h) and Q = f(W, S, v, pad_w)```
@@ -51,7 +56,7 @@ SP_ALGO_NN_NAMESPACE_BEGIN
  *
  * Convolution Modes (common LA terms, matlab, octave)
  *  - valid - ```pad_w = pad_h = 0```
- *  - same  - ```pad_h = R/2 and pad_w = S / 2```
+ *  - same  - ```pad_h = R/2 and pad_w = S / 2```, i.e. ```P = ceil(H / u)```
  *  - full  - ```pad_h = R - 1, pad_w = S - 1```
  *
  * \tparam InputDim, includes:
@@ -61,18 +66,26 @@ SP_ALGO_NN_NAMESPACE_BEGIN
  * \tparam KernelDim, includes:... tbd
  * \tparam Biased (optional) default true. Whether or not the layer contains bias.
  * \tparam Sparsity The sparsity object. See #group_sparsity and #no_sparsity
+ * \tparam Dilation Holes between neighbouring kernel taps, the kernel covers
+ *         ```(R - 1) * (Dilation + 1) + 1``` input rows. Zero is dense.
+ * \tparam Engine The engine performing the convolution. See #im2col_conv_engine,
+ *         #winograd_conv_engine, #fft_conv_engine and #direct_conv_engine.
+ *         Defaults to #default_conv_engine_t
  */
 template<
     typename InputVolume,
     typename KernelParams = kernel_params_default,
     bool Biased = true,
     typename Connectivity = full_connectivity,
-    size_t Dilation = 0
+    size_t Dilation = 0,
+    typename Engine = default_conv_engine_t<InputVolume, KernelParams, Dilation>
 >
 struct conv_layer : layer<
     InputVolume,
-    detail::convolution_kernel_out_dims_t<InputVolume, KernelParams>,
-    conv_layer<InputVolume, KernelParams, Biased, Connectivity, Dilation>
+    detail::convolution_kernel_out_dims_t<InputVolume, KernelParams, Dilation>,
+    conv_layer<InputVolume, KernelParams, Biased, Connectivity, Dilation, Engine>,
+    true,
+    true
 > {
 
     /**
@@ -80,8 +93,10 @@ struct conv_layer : layer<
      */
     using base = layer<
         InputVolume,
-        detail::convolution_kernel_out_dims_t<InputVolume, KernelParams>,
-        conv_layer<InputVolume, KernelParams, Biased, Connectivity, Dilation>
+        detail::convolution_kernel_out_dims_t<InputVolume, KernelParams, Dilation>,
+        conv_layer<InputVolume, KernelParams, Biased, Connectivity, Dilation, Engine>,
+        true,
+        true
     >;
 
     /**
@@ -100,10 +115,21 @@ struct conv_layer : layer<
     using connectivity_type = Connectivity;
 
     /**
-     * \brief Dilation parameter
-     * \todo TBD: https://arxiv.org/abs/1511.07122
+     * Engine type (im2col, winograd, fft, direct, etc)
+     */
+    using engine_type = Engine;
+
+    /**
+     * \brief Dilation parameter, the number of holes between two
+     *        neighbouring kernel taps (https://arxiv.org/abs/1511.07122)
      */
-    static_assert(Dilation == 0, "Dilation is not implemented");
+    constexpr static size_t dilation = Dilation;
+
+    /**
+     * \brief Padding, dilation and the output extent of the convolution.
+     *        Padding is implicit, engines clip taps against the input.
+     */
+    using geometry = detail::convolution_geometry<InputVolume, KernelParams, Dilation>;
 
     /**
      * Whether or not this layer has biased
@@ -120,141 +146,162 @@ struct conv_layer : layer<
      */
     using output_dims = typename base::output_dims;
 
+    /**
+     * \brief Connectivity compiled into the lists of connected input
+     *        channels of every output channel
+     */
+    using connection_list = detail::connection_list<connectivity_type, input_dims::d, output_dims::d>;
+
+    /**
+     * \brief Whether every output channel is connected to every input channel
+     */
+    constexpr static bool densely_connected = connection_list::count == output_dims::d * input_dims::d;
+
     /**
      * \brief Weight dimensions
+     *
+     * Kernels are only stored for connected (output, input) pairs, in the
+     * order of connection_list. Densely connected layers keep the
+     * (output, input, height, width) shape, sparsely connected layers store
+     * (kernel, 1, height, width).
      */
-    using weights_dims = weight_dims<
-        output_dims::d,
-        input_dims::d,
-        kernel_params::h,
-        kernel_params::w
+    using weights_dims = std::conditional_t<
+        densely_connected,
+        weight_dims<
+            output_dims::d,
+            input_dims::d,
+            kernel_params::h,
+            kernel_params::w
+        >,
+        weight_dims<
+            connection_list::count,
+            1,
+            kernel_params::h,
+            kernel_params::w
+        >
     >;
 
-    void forward_prop_impl(tensor_4& input, tensor_4& output) {
+    void forward_prop_impl(tensor_4_view input, tensor_4_view output) {
 
-        /**
-         * Number of samples in the input
-         */
-        const size_t samples = input.dimension(0);
+        engine.forward(*this, input, output);
 
-        /**
-         * Perform  forward propagation for every sample
-         */
-        #pragma omp parallel for simd
-        for (size_t si = 0; si < samples; ++si) {
+        if constexpr(biased) {
             /**
-             * Loop over the pairs of (D_out, D_in), i.e. input_dims::d*output_dims::d
+             * Number of samples in the input
              */
-            for (size_t od = 0; od < output_dims::d; ++od) {
-                for (size_t id = 0; id < input_dims::d; ++id) {
-                    if(connections(od, id)) {
-                        /*
-                         * If the output channel is connected to the input channel,
-                         * then perform convolution. This is done to support limited
-                         * connectivity when required
-                         *
-                         * Then, perform the convolution op
-                         *
-                         * \todo add dilation
-                         * \todo Optimize for smaller kernels (common, 2x2, 3x3, etc)
-                         */
-                        for (size_t oy = 0, iny = 0; oy < output_dims::h; ++oy, iny += kernel_params::s_h) {
-                            for (size_t ox = 0, inx = 0; ox < output_dims::w; ++ox, inx += kernel_params::s_w) {
-                                float_t sum = 0;
-                                for (size_t ky = 0; ky < kernel_params::h; ++ky) {
-                                    for (size_t kx = 0; kx < kernel_params::w; ++kx) {
-                                        auto& in_val = input(si, id, iny+ky, inx+kx);
-                                        auto& w_val = w(od, id, ky, kx);
-                                        sum += in_val * w_val;
-                                    }
-                                }
-                                output(si, od, oy, ox) += sum;
-                            }
-                        }
+            const size_t samples = input.dimension(0);
+
+            /**
+             * Add bias to every output vector the depth slice at output(od)
+             */
+            #pragma omp parallel for simd collapse(2)
+            for (size_t si = 0; si < samples; ++si) {
+                for (size_t od = 0; od < output_dims::d; ++od) {
+                    float_t* out = output.data() + (si * output_dims::d + od) * output_dims::area;
+                    const float_t bias = b(od);
+                    for(size_t i = 0; i < output_dims::area; ++i) {
+                        out[i] += bias;
                     }
                 }
-                if constexpr(biased) {
-                    /**
-                     * Add bias to every output vector the depth slice at output(od)
-                     */
-                    output.chip(si, 0).chip(od, 0) = output.chip(si, 0).chip(od, 0) + b(od);
-                }
             }
         }
     }
 
     /**
      * \brief Back propagation implementation
-     *
-     * \todo Optimize
      */
-    void backward_prop_impl(    tensor_4& prev_out,
-                                tensor_4& prev_delta,
-                                tensor_4& curr_out,
-                                tensor_4& curr_delta)  {
-
+    void backward_prop_impl(    tensor_4_view prev_out,
+                                tensor_4_view prev_delta,
+                                tensor_4_view curr_out,
+                                tensor_4_view curr_delta)  {
 
         /**
-         * Number of samples in the previous output
+         * Propagate the current delta to the previous delta through the kernels
          */
-        const size_t samples = prev_out.dimension(0);
+        engine.backward_input(*this, curr_delta, prev_delta);
 
         /**
-         * Perform back propagation
-         *
-         * For every sample in the input
+         * Accumulate the weight gradients
          */
-        #pragma omp parallel for simd
-        for(size_t si = 0; si < samples; ++si) {
+        engine.backward_weights(*this, prev_out, curr_delta);
+
+        if constexpr(biased) {
             /**
-             * For every (input depth, output depth) pair that is connected
+             * Number of samples in the previous output
              */
-            for (size_t id = 0; id < input_dims::d; ++id) {
+            const size_t samples = prev_out.dimension(0);
+
+            #pragma omp parallel for
+            for(size_t si = 0; si < samples; ++si) {
+                const size_t slot = detail::gradient_slot(db);
                 for (size_t od = 0; od < output_dims::d; ++od) {
-                    if(connections(od, id)) {
-                        /* Propagate the current delta to the previous delta through the kernel */
-                        for (size_t oy = 0, iny = 0; oy < output_dims::h; ++oy, iny += kernel_params::s_h) {
-                            for (size_t ox = 0, inx = 0; ox < output_dims::w; ++ox, inx += kernel_params::s_w) {
-                                float_t& grad = curr_delta(si, od, oy, ox);
-                                for (size_t wy = 0; wy < weights_dims::h; ++wy) {
-                                    for (size_t wx = 0; wx < weights_dims::w; ++wx) {
-                                        auto& w_val = w(od, id, wy, wx);
-                                        prev_delta(si, id, iny + wy, inx + wx) += w_val * grad;
-                                    }
-                                }
-                            }
-                        }
+                    const float_t* delta = curr_delta.data() + (si * output_dims::d + od) * output_dims::area;
+                    float_t sum = 0;
+                    for(size_t i = 0; i < output_dims::area; ++i) {
+                        sum += delta[i];
                     }
+                    db(slot, od) += sum;
                 }
             }
-            for (size_t id = 0; id < input_dims::d; ++id) {
-                for (size_t od = 0; od < output_dims::d; ++od) {
-                    if(connections(od, id)) {
-                        for (size_t wy = 0; wy < weights_dims::h; ++wy) {
-                            for (size_t wx = 0; wx < weights_dims::w; ++wx) {
-                                float_t delta = 0;
-                                for (size_t oy = 0, iny = 0; oy < output_dims::h; ++oy, iny += kernel_params::s_h) {
-                                    for (size_t ox = 0, inx = 0; ox < output_dims::w; ++ox, inx += kernel_params::s_w) {
-                                        auto& po = prev_out(si, id, oy + wy, ox + wx);
-                                        auto& cd = curr_delta(si, od, oy, ox);
-                                        delta +=  po * cd;
-                                    }
-                                }
-                                dw(si, od, id, wy, wx) += delta;
-                            }
-                        }
+        }
+    }
+
+    /**
+     * \brief Back propagation reads the input, not the output, see
+     *        detail::memory_plan
+     */
+    constexpr static bool backward_reads_input = true;
+
+    constexpr static bool backward_reads_output = false;
+
+    /**
+     * \brief Channel blocked layout is supported, see #nchwc_layout. The
+     *        blocked kernels are used regardless of the engine.
+     */
+    constexpr static bool blocked_layout = true;
+
+    template<size_t Block>
+    void forward_blocked_impl(tensor_4_view input, tensor_4_view output) {
+        blocked_kernels.template forward<Block>(*this, input, output);
+    }
+
+    template<size_t Block>
+    void backward_blocked_impl( tensor_4_view prev_out,
+                                tensor_4_view prev_delta,
+                                tensor_4_view,
+                                tensor_4_view curr_delta) {
+
+        blocked_kernels.template backward_input<Block>(*this, curr_delta, prev_delta);
+
+        blocked_kernels.template backward_weights<Block>(*this, prev_out, curr_delta);
+
+        if constexpr(biased) {
+            constexpr size_t blocks = detail::channel_blocks<output_dims::d, Block>;
+
+            const size_t samples = prev_out.dimension(0);
+
+            #pragma omp parallel for
+            for(size_t si = 0; si < samples; ++si) {
+                const size_t slot = detail::gradient_slot(db);
+                for (size_t kb = 0; kb < blocks; ++kb) {
+                    const float_t* delta = curr_delta.data() + detail::blocked_offset<output_dims, Block>(si, kb);
+                    blocked_lanes<Block> sum = blocked_lanes<Block>::Zero();
+                    for(size_t i = 0; i < output_dims::area; ++i) {
+                        sum += const_blocked_lanes_map<Block>(delta + i * Block);
+                    }
+                    for (size_t j = 0; j < Block && kb * Block + j < output_dims::d; ++j) {
+                        db(slot, kb * Block + j) += sum(j);
                     }
-                }
-            }
-            if (biased) {
-                for (size_t od = 0; od < output_dims::d; ++od) {
-                    tensor_0 sum = curr_delta.chip(si, 0).chip(od, 0).sum();
-                    db(si, od) += sum(0);
                 }
             }
         }
     }
 
+    void configuration_impl(const size_t& batch_size, bool reset) {
+        engine.configure(*this, batch_size);
+        this->default_configuration(batch_size, reset);
+    }
+
     /**
      * \brief Weights of the layer.
      */
@@ -277,6 +324,16 @@ struct conv_layer : layer<
 
     connectivity_type connections;
 
+    /**
+     * \brief The engine performing the computations of the layer
+     */
+    engine_type engine;
+
+    /**
+     * \brief Kernels of the channel blocked layout
+     */
+    blocked_conv_kernels blocked_kernels;
+
 };
 
 
@@ -9,7 +9,12 @@
 #ifndef SP_ALGO_NN_LAYER_DETAIL_LAYERS_HPP
 #define SP_ALGO_NN_LAYER_DETAIL_LAYERS_HPP
 
+#include <algorithm>
+#include <utility>
+#include <boost/assert.hpp>
+
 #include "sp/util/types.hpp"
+#include "sp/util/parallel.hpp"
 #include "../params.hpp"
 #include "../../types.hpp"
 #include "../../matrix.hpp"
@@ -42,7 +47,7 @@ bool validate_dimensions(const sample_type& sample) {
  * @return true if matching
  */
 template<typename VolumeDimsExpected>
-bool validate_dimensions(const tensor_4& t) {
+bool validate_dimensions(const tensor_4_view& t) {
     static_assert(util::is_instantiation_of_v<VolumeDimsExpected, volume_dims>, "VolumeDimsExpected is an instantiation of volume_dims");
     using expected = VolumeDimsExpected;
     auto& dims = t.dimensions();
@@ -59,7 +64,7 @@ bool validate_dimensions(const tensor_4& t) {
  * @return true if matching
  */
 template<typename VolumeDimsExpected>
-bool validate_dimensions(const size_t& batch_size, const tensor_4& t) {
+bool validate_dimensions(const size_t& batch_size, const tensor_4_view& t) {
     static_assert(util::is_instantiation_of_v<VolumeDimsExpected, volume_dims>, "VolumeDimsExpected is an instantiation of volume_dims");
     using expected = VolumeDimsExpected;
     auto& dims = t.dimensions();
@@ -69,32 +74,114 @@ bool validate_dimensions(const size_t& batch_size, const tensor_4& t) {
                 static_cast<size_t>(dims[3]) == expected::w;
 }
 
+/**
+ * \brief Geometry of a convolution over InputDim with the given kernel
+ *        parameters and dilation
+ *
+ * Dilation is the number of holes between two neighbouring kernel taps, i.e.
+ * tap (ky, kx) reads input (y + ky * dilation, x + kx * dilation) where the
+ * dilation factor is Dilation + 1. Same padding adds extent - 1 implicit
+ * zeroes, pad_top/pad_left before and the remainder after the input, such
+ * that the output is ceil(H / s_h) by ceil(W / s_w).
+ *
+ * The padding is never materialized, engines clip the taps against the
+ * input bounds instead (see #valid_range).
+ */
+template<typename InputDim, typename KernelParams, size_t Dilation = 0>
+struct convolution_geometry {
+
+    constexpr static size_t dilation = Dilation + 1;
+
+    constexpr static size_t extent_h = (KernelParams::h - 1) * dilation + 1;
+    constexpr static size_t extent_w = (KernelParams::w - 1) * dilation + 1;
+
+    constexpr static bool same = KernelParams::padding == padding_type::same;
+
+    constexpr static size_t pad_h = same ? extent_h - 1 : 0;
+    constexpr static size_t pad_w = same ? extent_w - 1 : 0;
+
+    constexpr static size_t pad_top = pad_h / 2;
+    constexpr static size_t pad_left = pad_w / 2;
+
+    constexpr static bool padded = pad_h > 0 || pad_w > 0;
+    constexpr static bool dilated = dilation > 1;
+
+    static_assert(InputDim::h + pad_h >= extent_h, "Kernel extent exceeds the input height");
+    static_assert(InputDim::w + pad_w >= extent_w, "Kernel extent exceeds the input width");
+
+    using output_dims = volume_dims<
+        KernelParams::d,
+        (InputDim::h + pad_h - extent_h)/KernelParams::s_h + 1,
+        (InputDim::w + pad_w - extent_w)/KernelParams::s_w + 1
+    >;
+
+    /**
+     * \brief Range [first, last) of the outputs of a tap that lie inside
+     *        the input
+     *
+     * Output o of the tap at offset (tap index times dilation) reads
+     * input o * stride + offset - pad, valid if within [0, size).
+     */
+    constexpr static std::pair<size_t, size_t> valid_range(
+            const size_t& outputs, const size_t& size, const size_t& stride,
+            const size_t& offset, const size_t& pad) {
+        const size_t first = offset >= pad ? 0 : (pad - offset + stride - 1) / stride;
+        const size_t last = size + pad <= offset ? 0 : (size + pad - offset - 1) / stride + 1;
+        return { std::min(first, outputs), std::min(std::max(first, last), outputs) };
+    }
+
+    /**
+     * \brief Output rows of kernel row ky reading inside the input
+     */
+    constexpr static std::pair<size_t, size_t> rows(const size_t& ky) {
+        return valid_range(output_dims::h, InputDim::h, KernelParams::s_h, ky * dilation, pad_top);
+    }
+
+    /**
+     * \brief Output columns of kernel column kx reading inside the input
+     */
+    constexpr static std::pair<size_t, size_t> cols(const size_t& kx) {
+        return valid_range(output_dims::w, InputDim::w, KernelParams::s_w, kx * dilation, pad_left);
+    }
+
+    /**
+     * \brief Output rows [first, last) for which every kernel row reads
+     *        inside the input, i.e. no bounds checks are necessary. The
+     *        first kernel row clips the top, the last one the bottom.
+     */
+    constexpr static size_t interior_top = rows(0).first;
+    constexpr static size_t interior_bottom = std::max(interior_top, rows(KernelParams::h - 1).second);
+
+    /**
+     * \brief Output columns [first, last) for which every kernel column
+     *        reads inside the input
+     */
+    constexpr static size_t interior_left = cols(0).first;
+    constexpr static size_t interior_right = std::max(interior_left, cols(KernelParams::w - 1).second);
+};
+
 /**
  * \brief Calculate the padded size of an input when using a kernel
  *
  * Modifies, if necessary, the input dimension
  */
-template<typename InputDim, typename KernelParams>
+template<typename InputDim, typename KernelParams, size_t Dilation = 0>
 using apply_padding_t = std::conditional_t<
-    KernelParams::padding = padding_type::same,
+    KernelParams::padding == padding_type::same,
     volume_dims<
         InputDim::d,
-        InputDim::h + KernelParams::h - 1,
-        InputDim::w + KernelParams::w - 1
+        InputDim::h + convolution_geometry<InputDim, KernelParams, Dilation>::pad_h,
+        InputDim::w + convolution_geometry<InputDim, KernelParams, Dilation>::pad_w
     >,
     InputDim
 >;
 
 /**
- * \brief Kernel output size, derived from Input dimensions and kernel
- *        parameters
+ * \brief Kernel output size, derived from Input dimensions, kernel
+ *        parameters and dilation
  */
-template<typename InputDim, typename KernelParams>
-using convolution_kernel_out_dims_t = volume_dims<
-    KernelParams::d,
-    (InputDim::h - KernelParams::h + 0)/KernelParams::s_h + 1,
-    (InputDim::w - KernelParams::w + 0)/KernelParams::s_w + 1
->;
+template<typename InputDim, typename KernelParams, size_t Dilation = 0>
+using convolution_kernel_out_dims_t = typename convolution_geometry<InputDim, KernelParams, Dilation>::output_dims;
 
 /**
  * \brief Kernel output size, derived from Input dimensions and kernel
@@ -131,7 +218,7 @@ void prepare_and_zero_tensor(const size_t& samples, tensor_4& tens) {
  * \brief Initialize weight sensor
  */
 template<typename WeightDims>
-void prepare_weights(tensor_4& w) {
+void prepare_weights(weights_type& w) {
     static_assert(util::is_instantiation_of_v<WeightDims, weight_dims>, "WeightDims is an instantiation of weight_dims");
     w.resize(
         WeightDims::out,
@@ -153,27 +240,170 @@ void prepare_bias(bias_type& t) {
 }
 
 /**
- * \brief Ensure that bias delta is large enough for sample imput
+ * \brief Ensure that bias delta has one zeroed slot per worker thread
  *
  * Assumes bias is 1:1 with the number of output dimensions
  */
 template<typename OutputDims>
-void prepare_and_zero_bias_delta(const size_t& batch_size, bias_delta_type& db) {
+void prepare_and_zero_bias_delta(const size_t& slots, bias_delta_type& db) {
     static_assert(util::is_instantiation_of_v<OutputDims, volume_dims>, "OutputDims is an instantiation of volume_dims");
-    db.resize(batch_size, OutputDims::d);
+    db.resize(slots, OutputDims::d);
     db.setZero();
 }
 
 /**
- * \brief Initialize weight sensor to zero
+ * \brief Ensure that weight delta has one zeroed slot per worker thread
  */
 template<typename DeltaWeightDims>
-void prepare_and_zero_delta_weights(const size_t& batch_size, weights_delta_type& t) {
+void prepare_and_zero_delta_weights(const size_t& slots, weights_delta_type& t) {
     static_assert(util::is_instantiation_of_v<DeltaWeightDims, weight_dims>, "DeltaWeightDims is an instantiation of weight_dims");
-    t.resize(batch_size, DeltaWeightDims::out, DeltaWeightDims::in, DeltaWeightDims::h, DeltaWeightDims::w);
+    t.resize(slots, DeltaWeightDims::out, DeltaWeightDims::in, DeltaWeightDims::h, DeltaWeightDims::w);
     t.setZero();
 }
 
+/**
+ * \brief Release the memory of a tensor, leaving it empty
+ */
+template<typename Tensor>
+void release_tensor(Tensor& t) {
+    t.resize(typename Tensor::Dimensions());
+}
+
+/**
+ * \brief The gradient slot of the calling thread
+ *
+ * Gradients are accumulated into one slot (first dimension) per worker
+ * thread, such that memory scales with the thread count rather than the
+ * batch size and no synchronization is required. A single slot belongs to
+ * whichever thread runs the layer, e.g. a replica of data parallel training
+ * (see #data_parallel_training) runs on one thread of an outer parallel
+ * region.
+ */
+template<typename Tensor>
+size_t gradient_slot(const Tensor& delta) {
+    const size_t slot = delta.dimension(0) == 1 ? 0 : util::thread_index();
+    BOOST_ASSERT_MSG(
+        slot < static_cast<size_t>(delta.dimension(0)),
+        "Gradient slots are allocated for every worker thread, reconfigure after changing the thread count"
+    );
+    return slot;
+}
+
+/**
+ * \brief Parallel tree reduction of the gradient slots of delta into the
+ *        first slot
+ *
+ * Pairs of slots are summed in log2(slots) rounds, every round is split
+ * into chunks such that large layers are reduced by all threads even if
+ * only few slots remain. Merged slots are zeroed, hence the reduction is
+ * idempotent and accumulation may continue after it.
+ */
+template<typename Tensor>
+void reduce_gradient_slots(Tensor& delta) {
+    constexpr size_t chunk = 1 << 12;
+    const size_t slots = delta.dimension(0);
+    if(slots <= 1) {
+        return;
+    }
+    const size_t len = delta.size() / slots;
+    const size_t chunks = (len + chunk - 1) / chunk;
+    float_t* data = delta.data();
+    for(size_t stride = 1; stride < slots; stride <<= 1) {
+        const size_t pairs = (slots - stride + 2 * stride - 1) / (2 * stride);
+        #pragma omp parallel for collapse(2)
+        for(size_t p = 0; p < pairs; ++p) {
+            for(size_t c = 0; c < chunks; ++c) {
+                float_t* to = data + (2 * stride * p) * len;
+                float_t* from = to + stride * len;
+                const size_t end = std::min(len, (c + 1) * chunk);
+                #pragma omp simd
+                for(size_t i = c * chunk; i < end; ++i) {
+                    to[i] += from[i];
+                    from[i] = 0;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * \brief Values of a tile of apply_gradient_tile, such that the tiles of
+ *        all slots (about 256 KiB) stay cache resident
+ */
+constexpr size_t gradient_tile_size(const size_t& slots) {
+    constexpr size_t budget = (256 * 1024) / sizeof(float_t);
+    constexpr size_t smallest = 256;
+    constexpr size_t largest = 1 << 12;
+    const size_t fit = budget / std::max<size_t>(slots, 1);
+    return std::max(smallest, std::min(largest, fit - fit % 16));
+}
+
+/**
+ * \brief Apply the gradients of the values [first, first + count) summed
+ *        over the slots of len values at delta to w, and clear them
+ *
+ * The slots of the tile are summed pairwise in log2(slots) rounds into the
+ * first slot and the optimizer updates the tile (update_block) while the
+ * sums are still in cache, scaling them by scale. state are the arrays of
+ * the optimizer state parallel to w.
+ */
+template<typename Optimizer, typename State>
+void apply_gradient_tile(   Optimizer& optimizer,
+                            float_t* w,
+                            float_t* delta,
+                            const size_t& slots,
+                            const size_t& len,
+                            const State& state,
+                            const float_t& scale,
+                            const size_t& first,
+                            const size_t& count) {
+    float_t* sum = delta + first;
+    for(size_t stride = 1; stride < slots; stride <<= 1) {
+        for(size_t to = 0; to + stride < slots; to += 2 * stride) {
+            float_t* lhs = sum + to * len;
+            float_t* rhs = lhs + stride * len;
+            #pragma omp simd
+            for(size_t i = 0; i < count; ++i) {
+                lhs[i] += rhs[i];
+                rhs[i] = 0;
+            }
+        }
+    }
+    State tile_state = state;
+    for(auto& st : tile_state) {
+        st += first;
+    }
+    optimizer.update_block(w + first, sum, tile_state, count, scale);
+    std::fill(sum, sum + count, float_t(0));
+}
+
+/**
+ * \brief Apply the gradients summed over the slots of delta to w, tile by
+ *        tile in parallel, see apply_gradient_tile. updated(first, count)
+ *        is called by the updating thread once the tile is updated, while
+ *        it is still in cache.
+ */
+template<typename Optimizer, typename Tensor, typename State, typename Updated>
+void apply_gradient_slots(Optimizer& optimizer, float_t* w, Tensor& delta, const State& state, const float_t& scale, Updated&& updated) {
+    const size_t slots = delta.dimension(0);
+    const size_t len = delta.size() / std::max<size_t>(slots, 1);
+    const size_t tile = gradient_tile_size(slots);
+    const size_t tiles = (len + tile - 1) / tile;
+    float_t* data = delta.data();
+    #pragma omp parallel for
+    for(size_t t = 0; t < tiles; ++t) {
+        const size_t first = t * tile;
+        const size_t count = std::min(tile, len - first);
+        apply_gradient_tile(optimizer, w, data, slots, len, state, scale, first, count);
+        updated(first, count);
+    }
+}
+
+template<typename Optimizer, typename Tensor, typename State>
+void apply_gradient_slots(Optimizer& optimizer, float_t* w, Tensor& delta, const State& state, const float_t& scale) {
+    apply_gradient_slots(optimizer, w, delta, state, scale, [](const size_t&, const size_t&) {});
+}
+
 template <typename, typename = void>
 struct has_weight_and_delta_helper : std::false_type {};
 
@@ -201,6 +431,28 @@ struct has_bias_and_delta_helper<
 > : std::true_type {};
 
 
+template <typename, typename = void>
+struct has_engine_helper : std::false_type {};
+
+template <typename T>
+struct has_engine_helper<
+    T,
+    std::void_t<
+        decltype(std::declval<T>().engine)
+    >
+> : std::true_type {};
+
+template <typename, typename = void>
+struct has_weight_storage_helper : std::false_type {};
+
+template <typename T>
+struct has_weight_storage_helper<
+    T,
+    std::void_t<
+        decltype(std::declval<T>().store_weights())
+    >
+> : std::true_type {};
+
 template<typename T, typename EnableIf = void>
 struct is_layer : std::false_type {};
 
@@ -226,6 +478,19 @@ constexpr bool has_weight_and_delta_v = has_weight_and_delta_helper<Layer>::valu
 template<typename Layer>
 constexpr bool has_bias_and_delta_v = has_bias_and_delta_helper<Layer>::value;
 
+/**
+ * \brief Check if a layer delegates its computations to an engine
+ */
+template<typename Layer>
+constexpr bool has_engine_v = has_engine_helper<Layer>::value;
+
+/**
+ * \brief Check if a layer keeps a copy of its weights in another storage
+ *        precision, see #precision
+ */
+template<typename Layer>
+constexpr bool has_weight_storage_v = has_weight_storage_helper<Layer>::value;
+
 /**
  * \brief Apply weight initialization
  *
@@ -0,0 +1,15 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#include "engine/engine.hpp"
+#include "engine/direct.hpp"
+#include "engine/im2col.hpp"
+#include "engine/winograd.hpp"
+#include "engine/fft.hpp"
+#include "engine/tiled.hpp"
+#include "engine/select.hpp"
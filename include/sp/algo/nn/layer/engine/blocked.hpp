@@ -0,0 +1,358 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_LAYER_ENGINE_BLOCKED_HPP
+#define SP_ALGO_NN_LAYER_ENGINE_BLOCKED_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include "../../config.hpp"
+#include "../../matrix.hpp"
+#include "../../layout.hpp"
+#include "../detail/layers.hpp"
+#include "sp/util/hints.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Convolution kernels of the channel blocked layout (see #nchwc_layout)
+ *
+ * Every output pixel of a block of Block output channels is accumulated in
+ * register lanes, each input channel broadcasts against the lanes of the
+ * packed kernels. Taps are clipped against the input with the geometry of
+ * the layer, i.e. supports same padding and dilation.
+ *
+ * Kernels are repacked on every call, padding channels and disconnected
+ * (output, input) pairs are zero:
+ *  - forward, (K / Block, C, R, S, Block) with output channels in the lanes
+ *  - backward, (C / Block, K, R, S, Block) with input channels in the lanes
+ */
+struct blocked_conv_kernels {
+
+    /**
+     * \brief Number of output pixels of a row sharing the loaded kernels
+     */
+    constexpr static size_t tile = 4;
+
+    template<size_t Block, typename Layer>
+    sp_hot void forward(Layer& layer, tensor_4_view input, tensor_4_view output) {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using geometry = typename Layer::geometry;
+
+        constexpr size_t in_blocks = detail::channel_blocks<input_dims::d, Block>;
+        constexpr size_t out_blocks = detail::channel_blocks<output_dims::d, Block>;
+        constexpr size_t taps = Layer::kernel_params::h * Layer::kernel_params::w;
+
+        pack_forward<Block>(layer);
+
+        const size_t samples = input.dimension(0);
+
+        #pragma omp parallel for collapse(2)
+        for (size_t si = 0; si < samples; ++si) {
+            for (size_t kb = 0; kb < out_blocks; ++kb) {
+                blocked_lanes<Block> bias = blocked_lanes<Block>::Zero();
+                if constexpr(Layer::biased) {
+                    for (size_t j = 0; j < Block && kb * Block + j < output_dims::d; ++j) {
+                        bias(j) = layer.b(kb * Block + j);
+                    }
+                }
+                const float_t* in = input.data() + detail::blocked_offset<input_dims, Block>(si, 0);
+                const float_t* w = packed.data() + kb * in_blocks * Block * taps * Block;
+                float_t* out = output.data() + detail::blocked_offset<output_dims, Block>(si, kb);
+                for (size_t oy = 0; oy < output_dims::h; ++oy) {
+                    size_t ox = 0;
+                    if(oy >= geometry::interior_top && oy < geometry::interior_bottom) {
+                        for (; ox < geometry::interior_left; ++ox) {
+                            forward_pixel<Block, Layer>(in, w, bias, out, oy, ox);
+                        }
+                        for (; ox + tile <= geometry::interior_right; ox += tile) {
+                            forward_tile<Block, Layer>(in, w, bias, out, oy, ox);
+                        }
+                    }
+                    for (; ox < output_dims::w; ++ox) {
+                        forward_pixel<Block, Layer>(in, w, bias, out, oy, ox);
+                    }
+                }
+            }
+        }
+    }
+
+    template<size_t Block, typename Layer>
+    sp_hot void backward_input(Layer& layer, tensor_4_view curr_delta, tensor_4_view prev_delta) {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+
+        constexpr size_t in_blocks = detail::channel_blocks<input_dims::d, Block>;
+        constexpr size_t out_blocks = detail::channel_blocks<output_dims::d, Block>;
+        constexpr size_t taps = kernel_params::h * kernel_params::w;
+
+        pack_backward<Block>(layer);
+
+        const size_t samples = curr_delta.dimension(0);
+
+        /**
+         * Every (sample, input channel block) scatters into its own block of
+         * the previous delta
+         */
+        #pragma omp parallel for collapse(2)
+        for (size_t si = 0; si < samples; ++si) {
+            for (size_t cb = 0; cb < in_blocks; ++cb) {
+                const float_t* w = packed.data() + cb * out_blocks * Block * taps * Block;
+                float_t* pd = prev_delta.data() + detail::blocked_offset<input_dims, Block>(si, cb);
+                const float_t* cd = curr_delta.data() + detail::blocked_offset<output_dims, Block>(si, 0);
+                for (size_t oy = 0; oy < output_dims::h; ++oy) {
+                    for (size_t ox = 0; ox < output_dims::w; ++ox) {
+                        for (size_t ky = 0; ky < kernel_params::h; ++ky) {
+                            const size_t iy = oy * kernel_params::s_h + ky * geometry::dilation - geometry::pad_top;
+                            if(iy >= input_dims::h) {
+                                continue;
+                            }
+                            for (size_t kx = 0; kx < kernel_params::w; ++kx) {
+                                const size_t ix = ox * kernel_params::s_w + kx * geometry::dilation - geometry::pad_left;
+                                if(ix >= input_dims::w) {
+                                    continue;
+                                }
+                                const size_t tap = ky * kernel_params::w + kx;
+                                blocked_lanes_map<Block> acc(pd + (iy * input_dims::w + ix) * Block);
+                                for (size_t kb = 0; kb < out_blocks; ++kb) {
+                                    const float_t* delta = cd + (kb * output_dims::area + oy * output_dims::w + ox) * Block;
+                                    for (size_t j = 0; j < Block; ++j) {
+                                        acc += delta[j] * const_blocked_lanes_map<Block>(w + ((kb * Block + j) * taps + tap) * Block);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template<size_t Block, typename Layer>
+    sp_hot void backward_weights(Layer& layer, tensor_4_view prev_out, tensor_4_view curr_delta) {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using connections = typename Layer::connection_list;
+        using geometry = typename Layer::geometry;
+
+        constexpr size_t in_blocks = detail::channel_blocks<input_dims::d, Block>;
+        constexpr size_t out_blocks = detail::channel_blocks<output_dims::d, Block>;
+        constexpr size_t taps = kernel_params::h * kernel_params::w;
+
+        const size_t samples = prev_out.dimension(0);
+
+        #pragma omp parallel
+        {
+            /**
+             * Gradient lanes of the output channels, (R, S, input lane)
+             */
+            std::vector<blocked_lanes<Block>> grad(taps * Block);
+
+            #pragma omp for collapse(3)
+            for (size_t si = 0; si < samples; ++si) {
+                for (size_t kb = 0; kb < out_blocks; ++kb) {
+                    for (size_t cb = 0; cb < in_blocks; ++cb) {
+                        std::fill(grad.begin(), grad.end(), blocked_lanes<Block>::Zero());
+                        const float_t* in = prev_out.data() + detail::blocked_offset<input_dims, Block>(si, cb);
+                        const float_t* cd = curr_delta.data() + detail::blocked_offset<output_dims, Block>(si, kb);
+                        for (size_t ky = 0; ky < kernel_params::h; ++ky) {
+                            const auto [row_first, row_last] = geometry::rows(ky);
+                            for (size_t kx = 0; kx < kernel_params::w; ++kx) {
+                                const auto [col_first, col_last] = geometry::cols(kx);
+                                blocked_lanes<Block>* g = grad.data() + (ky * kernel_params::w + kx) * Block;
+                                for (size_t oy = row_first; oy < row_last; ++oy) {
+                                    const size_t iy = oy * kernel_params::s_h + ky * geometry::dilation - geometry::pad_top;
+                                    for (size_t ox = col_first; ox < col_last; ++ox) {
+                                        const size_t ix = ox * kernel_params::s_w + kx * geometry::dilation - geometry::pad_left;
+                                        const float_t* pixel = in + (iy * input_dims::w + ix) * Block;
+                                        const const_blocked_lanes_map<Block> delta(cd + (oy * output_dims::w + ox) * Block);
+                                        for (size_t i = 0; i < Block; ++i) {
+                                            g[i] += pixel[i] * delta;
+                                        }
+                                    }
+                                }
+                            }
+                        }
+
+                        /**
+                         * Scatter the lanes to the connected kernels of the
+                         * gradient slot of this thread
+                         */
+                        float_t* dw = layer.dw.data() + detail::gradient_slot(layer.dw) * layer.w.size();
+                        for (size_t j = 0; j < Block && kb * Block + j < output_dims::d; ++j) {
+                            const size_t od = kb * Block + j;
+                            for (size_t k = connections::begin(od); k < connections::end(od); ++k) {
+                                const size_t id = connections::input(k);
+                                if(id / Block != cb) {
+                                    continue;
+                                }
+                                for (size_t tap = 0; tap < taps; ++tap) {
+                                    dw[k * taps + tap] += grad[tap * Block + id % Block](j);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+private:
+
+    /**
+     * \brief Accumulates a single output pixel, taps outside of the input
+     *        are skipped
+     */
+    template<size_t Block, typename Layer>
+    sp_hot static void forward_pixel(   const float_t* in,
+                                        const float_t* w,
+                                        const blocked_lanes<Block>& bias,
+                                        float_t* out,
+                                        const size_t& oy,
+                                        const size_t& ox) {
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+
+        constexpr size_t in_blocks = detail::channel_blocks<input_dims::d, Block>;
+        constexpr size_t taps = kernel_params::h * kernel_params::w;
+
+        blocked_lanes_map<Block> result(out + (oy * output_dims::w + ox) * Block);
+        blocked_lanes<Block> acc = result + bias;
+        for (size_t cb = 0; cb < in_blocks; ++cb) {
+            for (size_t ky = 0; ky < kernel_params::h; ++ky) {
+                const size_t iy = oy * kernel_params::s_h + ky * geometry::dilation - geometry::pad_top;
+                if(iy >= input_dims::h) {
+                    continue;
+                }
+                for (size_t kx = 0; kx < kernel_params::w; ++kx) {
+                    const size_t ix = ox * kernel_params::s_w + kx * geometry::dilation - geometry::pad_left;
+                    if(ix >= input_dims::w) {
+                        continue;
+                    }
+                    const float_t* pixel = in + (cb * input_dims::area + iy * input_dims::w + ix) * Block;
+                    const float_t* kernel = w + (cb * Block * taps + ky * kernel_params::w + kx) * Block;
+                    for (size_t i = 0; i < Block; ++i) {
+                        acc += pixel[i] * const_blocked_lanes_map<Block>(kernel + i * taps * Block);
+                    }
+                }
+            }
+        }
+        result = acc;
+    }
+
+    /**
+     * \brief Accumulates #tile neighbouring output pixels of the interior,
+     *        every loaded kernel is reused by all of them
+     */
+    template<size_t Block, typename Layer>
+    sp_hot static void forward_tile(    const float_t* in,
+                                        const float_t* w,
+                                        const blocked_lanes<Block>& bias,
+                                        float_t* out,
+                                        const size_t& oy,
+                                        const size_t& ox) {
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+
+        constexpr size_t in_blocks = detail::channel_blocks<input_dims::d, Block>;
+        constexpr size_t taps = kernel_params::h * kernel_params::w;
+        constexpr size_t pixel_stride = kernel_params::s_w * Block;
+
+        float_t* result = out + (oy * output_dims::w + ox) * Block;
+        blocked_lanes<Block> acc[tile];
+        for (size_t t = 0; t < tile; ++t) {
+            acc[t] = blocked_lanes_map<Block>(result + t * Block) + bias;
+        }
+        for (size_t cb = 0; cb < in_blocks; ++cb) {
+            for (size_t ky = 0; ky < kernel_params::h; ++ky) {
+                const size_t iy = oy * kernel_params::s_h + ky * geometry::dilation - geometry::pad_top;
+                for (size_t kx = 0; kx < kernel_params::w; ++kx) {
+                    const size_t ix = ox * kernel_params::s_w + kx * geometry::dilation - geometry::pad_left;
+                    const float_t* pixel = in + (cb * input_dims::area + iy * input_dims::w + ix) * Block;
+                    const float_t* kernel = w + (cb * Block * taps + ky * kernel_params::w + kx) * Block;
+                    for (size_t i = 0; i < Block; ++i) {
+                        const blocked_lanes<Block> k = const_blocked_lanes_map<Block>(kernel + i * taps * Block);
+                        for (size_t t = 0; t < tile; ++t) {
+                            acc[t] += pixel[t * pixel_stride + i] * k;
+                        }
+                    }
+                }
+            }
+        }
+        for (size_t t = 0; t < tile; ++t) {
+            blocked_lanes_map<Block>(result + t * Block) = acc[t];
+        }
+    }
+
+    /**
+     * \brief Packs the kernels with the output channels in the lanes
+     */
+    template<size_t Block, typename Layer>
+    void pack_forward(Layer& layer) {
+        using connections = typename Layer::connection_list;
+        constexpr size_t in_blocks = detail::channel_blocks<Layer::input_dims::d, Block>;
+        constexpr size_t out_blocks = detail::channel_blocks<Layer::output_dims::d, Block>;
+        constexpr size_t taps = Layer::kernel_params::h * Layer::kernel_params::w;
+
+        packed.assign(out_blocks * in_blocks * Block * taps * Block, float_t(0));
+        for (size_t od = 0; od < Layer::output_dims::d; ++od) {
+            for (size_t k = connections::begin(od); k < connections::end(od); ++k) {
+                const size_t id = connections::input(k);
+                float_t* dst = packed.data() + ((od / Block * in_blocks * Block + id) * taps) * Block + od % Block;
+                const float_t* src = layer.w.data() + k * taps;
+                for (size_t tap = 0; tap < taps; ++tap) {
+                    dst[tap * Block] = src[tap];
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief Packs the kernels with the input channels in the lanes
+     */
+    template<size_t Block, typename Layer>
+    void pack_backward(Layer& layer) {
+        using connections = typename Layer::connection_list;
+        constexpr size_t in_blocks = detail::channel_blocks<Layer::input_dims::d, Block>;
+        constexpr size_t out_blocks = detail::channel_blocks<Layer::output_dims::d, Block>;
+        constexpr size_t taps = Layer::kernel_params::h * Layer::kernel_params::w;
+
+        packed.assign(in_blocks * out_blocks * Block * taps * Block, float_t(0));
+        for (size_t od = 0; od < Layer::output_dims::d; ++od) {
+            for (size_t k = connections::begin(od); k < connections::end(od); ++k) {
+                const size_t id = connections::input(k);
+                float_t* dst = packed.data() + ((id / Block * out_blocks * Block + od) * taps) * Block + id % Block;
+                const float_t* src = layer.w.data() + k * taps;
+                for (size_t tap = 0; tap < taps; ++tap) {
+                    dst[tap * Block] = src[tap];
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief Packed kernels of the last call
+     */
+    std::vector<float_t> packed;
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_LAYER_ENGINE_BLOCKED_HPP */
@@ -0,0 +1,164 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_LAYER_ENGINE_DIRECT_HPP
+#define SP_ALGO_NN_LAYER_ENGINE_DIRECT_HPP
+
+#include "engine.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Direct convolution engine
+ *
+ * Performs the convolution as a straight forward loop nest over every
+ * sample and kernel, i.e. connected (output depth, input depth) pair.
+ * Requires no scratch memory. Every tap only visits the outputs that read
+ * inside the input (see detail::convolution_geometry), which implements
+ * same padding and dilation without padded copies.
+ */
+struct direct_conv_engine : layer_engine<direct_conv_engine> {
+
+    template<typename Layer>
+    void forward_impl(Layer& layer, tensor_4_view input, tensor_4_view output) {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using connections = typename Layer::connection_list;
+        using geometry = typename Layer::geometry;
+
+        constexpr size_t kernel_area = kernel_params::h * kernel_params::w;
+
+        /**
+         * Number of samples in the input
+         */
+        const size_t samples = input.dimension(0);
+
+        /**
+         * Perform  forward propagation for every sample
+         */
+        #pragma omp parallel for simd
+        for (size_t si = 0; si < samples; ++si) {
+            /**
+             * Loop over the kernels of every output depth, i.e. the connected
+             * (D_out, D_in) pairs. Limited connectivity only visits the
+             * input depths in the list of the output depth.
+             */
+            for (size_t od = 0; od < output_dims::d; ++od) {
+                for (size_t k = connections::begin(od); k < connections::end(od); ++k) {
+                    const size_t id = connections::input(k);
+                    const float_t* w = layer.w.data() + k * kernel_area;
+                    const float_t* in = input.data() + (si * input_dims::d + id) * input_dims::area;
+                    float_t* out = output.data() + (si * output_dims::d + od) * output_dims::area;
+                    for (size_t ky = 0; ky < kernel_params::h; ++ky) {
+                        const auto [row_first, row_last] = geometry::rows(ky);
+                        for (size_t kx = 0; kx < kernel_params::w; ++kx) {
+                            const auto [col_first, col_last] = geometry::cols(kx);
+                            const float_t w_val = w[ky * kernel_params::w + kx];
+                            for (size_t oy = row_first; oy < row_last; ++oy) {
+                                const float_t* in_row = in
+                                        + (oy * kernel_params::s_h + ky * geometry::dilation - geometry::pad_top) * input_dims::w
+                                        + (col_first * kernel_params::s_w + kx * geometry::dilation - geometry::pad_left);
+                                float_t* out_row = out + oy * output_dims::w;
+                                for (size_t ox = col_first; ox < col_last; ++ox) {
+                                    out_row[ox] += in_row[(ox - col_first) * kernel_params::s_w] * w_val;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Layer>
+    void backward_input_impl(Layer& layer, tensor_4_view curr_delta, tensor_4_view prev_delta) {
+
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using connections = typename Layer::connection_list;
+        using geometry = typename Layer::geometry;
+
+        constexpr size_t kernel_area = kernel_params::h * kernel_params::w;
+
+        const size_t samples = curr_delta.dimension(0);
+
+        #pragma omp parallel for simd
+        for(size_t si = 0; si < samples; ++si) {
+            /**
+             * For every kernel, i.e. connected (output depth, input depth) pair
+             */
+            for (size_t od = 0; od < output_dims::d; ++od) {
+                for (size_t k = connections::begin(od); k < connections::end(od); ++k) {
+                    const size_t id = connections::input(k);
+                    const float_t* w = layer.w.data() + k * kernel_area;
+                    /* Propagate the current delta to the previous delta through the kernel */
+                    for (size_t wy = 0; wy < kernel_params::h; ++wy) {
+                        const auto [row_first, row_last] = geometry::rows(wy);
+                        for (size_t wx = 0; wx < kernel_params::w; ++wx) {
+                            const auto [col_first, col_last] = geometry::cols(wx);
+                            auto& w_val = w[wy * kernel_params::w + wx];
+                            for (size_t oy = row_first; oy < row_last; ++oy) {
+                                const size_t iny = oy * kernel_params::s_h + wy * geometry::dilation - geometry::pad_top;
+                                for (size_t ox = col_first; ox < col_last; ++ox) {
+                                    const size_t inx = ox * kernel_params::s_w + wx * geometry::dilation - geometry::pad_left;
+                                    prev_delta(si, id, iny, inx) += w_val * curr_delta(si, od, oy, ox);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Layer>
+    void backward_weights_impl(Layer& layer, tensor_4_view prev_out, tensor_4_view curr_delta) {
+
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using connections = typename Layer::connection_list;
+        using geometry = typename Layer::geometry;
+
+        constexpr size_t kernel_area = kernel_params::h * kernel_params::w;
+
+        const size_t samples = prev_out.dimension(0);
+
+        #pragma omp parallel for
+        for(size_t si = 0; si < samples; ++si) {
+            float_t* dw = layer.dw.data() + detail::gradient_slot(layer.dw) * layer.w.size();
+            for (size_t od = 0; od < output_dims::d; ++od) {
+                for (size_t k = connections::begin(od); k < connections::end(od); ++k) {
+                    const size_t id = connections::input(k);
+                    for (size_t wy = 0; wy < kernel_params::h; ++wy) {
+                        for (size_t wx = 0; wx < kernel_params::w; ++wx) {
+                            const auto [row_first, row_last] = geometry::rows(wy);
+                            const auto [col_first, col_last] = geometry::cols(wx);
+                            float_t delta = 0;
+                            for (size_t oy = row_first; oy < row_last; ++oy) {
+                                const size_t iny = oy * kernel_params::s_h + wy * geometry::dilation - geometry::pad_top;
+                                for (size_t ox = col_first; ox < col_last; ++ox) {
+                                    const size_t inx = ox * kernel_params::s_w + wx * geometry::dilation - geometry::pad_left;
+                                    auto& po = prev_out(si, id, iny, inx);
+                                    auto& cd = curr_delta(si, od, oy, ox);
+                                    delta +=  po * cd;
+                                }
+                            }
+                            dw[k * kernel_area + wy * kernel_params::w + wx] += delta;
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_LAYER_ENGINE_DIRECT_HPP */
@@ -6,20 +6,104 @@
  * Written by Omar Thor <omarthoro@gmail.com>, 2017
  */
 
-#ifndef SP_ALGO_NN_LAYER_KERNEL_FULLY_CONNECTED_HPP
-#define SP_ALGO_NN_LAYER_KERNEL_FULLY_CONNECTED_HPP
+#ifndef SP_ALGO_NN_LAYER_ENGINE_ENGINE_HPP
+#define SP_ALGO_NN_LAYER_ENGINE_ENGINE_HPP
+
+#include "../../config.hpp"
+#include "../../matrix.hpp"
+#include "sp/util/hints.hpp"
 
 SP_ALGO_NN_NAMESPACE_BEGIN
 
 /**
- * \todo Decouple internal implementation to engine/kernel such that
- *       alternative implementations can be used (i.e. CUDA/OpenCL, AVX)
+ * \brief Layer engine abstract class
+ *
+ * Decouples the computational kernels of a layer from the layer itself such
+ * that alternative implementations (i.e. direct loops, GEMM based, CUDA/OpenCL,
+ * AVX) can be selected per layer via a template parameter.
+ *
+ * An engine operates on the state of the layer (weights, bias, connectivity)
+ * passed to it and may keep its own scratch state (packed weights, column
+ * buffers, transformed kernels).
+ *
+ * Derived engines implement:
+ *  - '''forward_impl(layer, input, output)''', accumulates into output
+ *  - '''backward_input_impl(layer, curr_delta, prev_delta)''', accumulates into prev_delta
+ *  - '''backward_weights_impl(layer, prev_out, curr_delta)''', accumulates into layer.dw, in the
+ *    gradient slot of the calling thread (see detail::gradient_slot)
+ *
+ * and optionally:
+ *  - '''configure_impl(layer, batch_size)'''
+ *  - '''weights_changed_impl(layer)''', invoked whenever the weights of the
+ *    layer have been modified (configured, loaded or updated)
  */
+template<typename Derived>
 struct layer_engine {
 
+    using derived_type = Derived;
+
+    /**
+     * \brief Prepare the engine for the given batch size
+     */
+    template<typename Layer>
+    void configure(Layer& layer, const size_t& batch_size) {
+        derived().configure_impl(layer, batch_size);
+    }
+
+    /**
+     * \brief Feed forward propagation of input into output
+     */
+    template<typename Layer>
+    sp_hot void forward(Layer& layer, tensor_4_view input, tensor_4_view output) {
+        derived().forward_impl(layer, input, output);
+    }
+
+    /**
+     * \brief Propagate the current delta through the weights into the
+     *        previous delta
+     */
+    template<typename Layer>
+    sp_hot void backward_input(Layer& layer, tensor_4_view curr_delta, tensor_4_view prev_delta) {
+        derived().backward_input_impl(layer, curr_delta, prev_delta);
+    }
+
+    /**
+     * \brief Accumulate the weight gradient of the current delta with respect
+     *        to the previous output
+     */
+    template<typename Layer>
+    sp_hot void backward_weights(Layer& layer, tensor_4_view prev_out, tensor_4_view curr_delta) {
+        derived().backward_weights_impl(layer, prev_out, curr_delta);
+    }
+
+    /**
+     * \brief Notify the engine that the weights of the layer have changed
+     */
+    template<typename Layer>
+    void weights_changed(Layer& layer) {
+        derived().weights_changed_impl(layer);
+    }
+
+    /**
+     * Default, no configuration necessary
+     */
+    template<typename Layer>
+    void configure_impl(Layer&, const size_t&) {}
+
+    /**
+     * Default, no weight dependent state
+     */
+    template<typename Layer>
+    void weights_changed_impl(Layer&) {}
+
+    /**
+     * CRTP helper
+     */
+    derived_type& derived() {
+        return *static_cast<derived_type*>(this);
+    }
 };
 
 SP_ALGO_NN_NAMESPACE_END
 
-#endif	/* SP_ALGO_NN_LAYER_KERNEL_FULLY_CONNECTED_HPP */
-
+#endif	/* SP_ALGO_NN_LAYER_ENGINE_ENGINE_HPP */
@@ -0,0 +1,461 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_LAYER_ENGINE_FFT_HPP
+#define SP_ALGO_NN_LAYER_ENGINE_FFT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include <unsupported/Eigen/FFT>
+
+#include "engine.hpp"
+#include "im2col.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+namespace detail {
+
+    /**
+     * \brief Smallest power of two greater or equal to n
+     */
+    constexpr size_t fft_size(size_t n) {
+        size_t res = 1;
+        while(res < n) {
+            res <<= 1;
+        }
+        return res;
+    }
+
+    /**
+     * \brief Dimensions of the frequency domain of a layer
+     *
+     * The input is transformed at its padded size rounded up to a power of
+     * two. Since the valid correlation of the padded input (H' x W') with a,
+     * possibly dilated, kernel only reads within the padded input, the
+     * circular correlation of size (Nh x Nw) >= (H' x W') produces it without
+     * aliasing. The same holds for the full convolution of the delta with the
+     * kernel, which is of size (H' x W'). The padding is only ever the zeros
+     * around the input in the transformed plane.
+     *
+     * Only the hermitian half (Nh x Nw / 2 + 1) of the spectra of the real
+     * signals is kept.
+     */
+    template<typename Layer>
+    struct fft_dims {
+
+        constexpr static size_t h = fft_size(Layer::input_dims::h + Layer::geometry::pad_h);
+
+        constexpr static size_t w = fft_size(Layer::input_dims::w + Layer::geometry::pad_w);
+
+        constexpr static size_t half_w = w / 2 + 1;
+
+        constexpr static size_t area = h * w;
+
+        constexpr static size_t half_area = h * half_w;
+    };
+
+    /**
+     * \brief Radix-2 decimation in time FFT along the columns of a row major
+     *        (N x cols) complex matrix
+     *
+     * Every butterfly combines two whole rows, such that the innermost loop
+     * runs over contiguous memory.
+     */
+    struct column_fft {
+
+        using complex_type = std::complex<float_t>;
+
+        void prepare(const size_t& size) {
+            if(n == size) {
+                return;
+            }
+            n = size;
+            twiddles.resize(n / 2);
+            for(size_t k = 0; k < n / 2; ++k) {
+                twiddles[k] = std::polar(1.0, -2.0 * M_PI * k / n);
+            }
+        }
+
+        /**
+         * \brief In place, unscaled, transform
+         */
+        void transform(complex_type* data, const size_t& cols, bool inverse) const {
+            /* Bit reversal permutation of the rows */
+            for(size_t i = 1, j = 0; i < n; ++i) {
+                size_t bit = n >> 1;
+                for(; j & bit; bit >>= 1) {
+                    j ^= bit;
+                }
+                j ^= bit;
+                if(i < j) {
+                    std::swap_ranges(data + i * cols, data + (i + 1) * cols, data + j * cols);
+                }
+            }
+            for(size_t len = 2; len <= n; len <<= 1) {
+                const size_t half = len / 2;
+                const size_t step = n / len;
+                for(size_t i = 0; i < n; i += len) {
+                    for(size_t k = 0; k < half; ++k) {
+                        const float_t c = twiddles[k * step].real();
+                        const float_t s = inverse ? -twiddles[k * step].imag() : twiddles[k * step].imag();
+                        float_t* a = reinterpret_cast<float_t*>(data + (i + k) * cols);
+                        float_t* b = reinterpret_cast<float_t*>(data + (i + k + half) * cols);
+                        #pragma omp simd
+                        for(size_t x = 0; x < cols; ++x) {
+                            const float_t tr = b[2 * x] * c - b[2 * x + 1] * s;
+                            const float_t ti = b[2 * x] * s + b[2 * x + 1] * c;
+                            const float_t ar = a[2 * x];
+                            const float_t ai = a[2 * x + 1];
+                            a[2 * x]     = ar + tr;
+                            a[2 * x + 1] = ai + ti;
+                            b[2 * x]     = ar - tr;
+                            b[2 * x + 1] = ai - ti;
+                        }
+                    }
+                }
+            }
+        }
+
+    private:
+
+        size_t n = 0;
+
+        std::vector<std::complex<double>> twiddles;
+    };
+}
+
+/**
+ * \brief Fast fourier transform convolution engine
+ *
+ * Performs the correlation as a point-wise product in the frequency domain,
+ * reducing the cost per (sample, input depth, output depth) pair from
+ * O(H W R S) to O(H W) plus O(H W log(H W)) transforms per sample and depth.
+ * Suited for large kernels (7x7 and up) over large inputs.
+ *
+ * The kernel spectra are computed once whenever the weights change (see
+ * layer::weights_changed) and reused across the batch for both the forward
+ * and the input gradient pass. Strides are supported by subsampling the
+ * output in the forward pass and by spreading the delta in the input
+ * gradient pass. The weight gradient is delegated to #im2col_conv_engine.
+ *
+ * The rows are transformed with Eigen's FFT (real to half spectrum), the
+ * columns with detail::column_fft.
+ */
+struct fft_conv_engine : layer_engine<fft_conv_engine> {
+
+    using complex_type = std::complex<float_t>;
+
+    /**
+     * Upper limit of complex elements in the spectrum buffer, larger batches
+     * are processed in blocks of samples
+     */
+    constexpr static size_t spectrum_buffer_limit = 1 << 20;
+
+    template<typename Layer>
+    void configure_impl(Layer& layer, const size_t& batch_size) {
+        /* Weight gradients only, not needed for inference */
+        if(layer.training()) {
+            weights_engine.configure(layer, batch_size);
+        }
+    }
+
+    /**
+     * \brief Transform the kernels of the layer into (K, C) spectra
+     */
+    template<typename Layer>
+    void weights_changed_impl(Layer& layer) {
+        using dims = detail::fft_dims<Layer>;
+        using kernel_params = typename Layer::kernel_params;
+        constexpr size_t K = Layer::output_dims::d;
+        constexpr size_t C = Layer::input_dims::d;
+        using connections = typename Layer::connection_list;
+
+        columns.prepare(dims::h);
+        kernel_spectra.resize(K * C * dims::half_area);
+
+        #pragma omp parallel
+        {
+            transform_state<Layer> state;
+            #pragma omp for collapse(2)
+            for(size_t od = 0; od < K; ++od) {
+                for(size_t id = 0; id < C; ++id) {
+                    std::fill(state.plane.begin(), state.plane.end(), float_t(0));
+                    const size_t k = connections::index(od, id);
+                    if(k != connections::count) {
+                        const float_t* w = layer.w.data() + k * kernel_params::h * kernel_params::w;
+                        for(size_t ky = 0; ky < kernel_params::h; ++ky) {
+                            for(size_t kx = 0; kx < kernel_params::w; ++kx) {
+                                state.plane[(ky * dims::w + kx) * Layer::geometry::dilation] = w[ky * kernel_params::w + kx];
+                            }
+                        }
+                    }
+                    forward_transform<Layer>(state, kernel_spectra.data() + (od * C + id) * dims::half_area);
+                }
+            }
+        }
+    }
+
+    template<typename Layer>
+    void forward_impl(Layer&, tensor_4_view input, tensor_4_view output) {
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        using dims = detail::fft_dims<Layer>;
+        constexpr size_t C = input_dims::d;
+        constexpr size_t K = output_dims::d;
+
+        const size_t samples = input.dimension(0);
+        const size_t block_samples = prepare_buffers<Layer>(samples, C);
+
+        for(size_t s = 0; s < samples; s += block_samples) {
+            const size_t n = std::min(block_samples, samples - s);
+
+            #pragma omp parallel
+            {
+                transform_state<Layer> state;
+
+                /* Spectra of the zero padded input */
+                #pragma omp for collapse(2)
+                for(size_t j = 0; j < n; ++j) {
+                    for(size_t id = 0; id < C; ++id) {
+                        const float_t* src = input.data() + ((s + j) * C + id) * input_dims::area;
+                        std::fill(state.plane.begin(), state.plane.end(), float_t(0));
+                        float_t* dst = state.plane.data() + geometry::pad_top * dims::w + geometry::pad_left;
+                        for(size_t y = 0; y < input_dims::h; ++y) {
+                            std::copy(src + y * input_dims::w, src + (y + 1) * input_dims::w, dst + y * dims::w);
+                        }
+                        forward_transform<Layer>(state, spectra.data() + (j * C + id) * dims::half_area);
+                    }
+                }
+
+                /* Correlation, Y(k) = sum_c X(c) conj(W(k, c)) */
+                #pragma omp for collapse(2)
+                for(size_t j = 0; j < n; ++j) {
+                    for(size_t od = 0; od < K; ++od) {
+                        std::fill(state.spectrum.begin(), state.spectrum.end(), complex_type(0));
+                        for(size_t id = 0; id < C; ++id) {
+                            multiply_accumulate<dims, true>(
+                                spectra.data() + (j * C + id) * dims::half_area,
+                                kernel_spectra.data() + (od * C + id) * dims::half_area,
+                                state.spectrum.data()
+                            );
+                        }
+                        inverse_transform<Layer>(state);
+
+                        /* Extract the valid, strided, part of the correlation */
+                        float_t* dst = output.data() + ((s + j) * K + od) * output_dims::area;
+                        for(size_t oy = 0; oy < output_dims::h; ++oy) {
+                            const float_t* src = state.plane.data() + oy * kernel_params::s_h * dims::w;
+                            for(size_t ox = 0; ox < output_dims::w; ++ox) {
+                                dst[oy * output_dims::w + ox] += src[ox * kernel_params::s_w] * inverse_scale<dims>;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Layer>
+    void backward_input_impl(Layer&, tensor_4_view curr_delta, tensor_4_view prev_delta) {
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        using dims = detail::fft_dims<Layer>;
+        constexpr size_t C = input_dims::d;
+        constexpr size_t K = output_dims::d;
+
+        const size_t samples = curr_delta.dimension(0);
+        const size_t block_samples = prepare_buffers<Layer>(samples, K);
+
+        for(size_t s = 0; s < samples; s += block_samples) {
+            const size_t n = std::min(block_samples, samples - s);
+
+            #pragma omp parallel
+            {
+                transform_state<Layer> state;
+
+                /* Spectra of the delta spread by the stride */
+                #pragma omp for collapse(2)
+                for(size_t j = 0; j < n; ++j) {
+                    for(size_t od = 0; od < K; ++od) {
+                        const float_t* src = curr_delta.data() + ((s + j) * K + od) * output_dims::area;
+                        std::fill(state.plane.begin(), state.plane.end(), float_t(0));
+                        for(size_t oy = 0; oy < output_dims::h; ++oy) {
+                            float_t* dst = state.plane.data() + oy * kernel_params::s_h * dims::w;
+                            for(size_t ox = 0; ox < output_dims::w; ++ox) {
+                                dst[ox * kernel_params::s_w] = src[oy * output_dims::w + ox];
+                            }
+                        }
+                        forward_transform<Layer>(state, spectra.data() + (j * K + od) * dims::half_area);
+                    }
+                }
+
+                /* Full convolution, X(c) = sum_k D(k) W(k, c) */
+                #pragma omp for collapse(2)
+                for(size_t j = 0; j < n; ++j) {
+                    for(size_t id = 0; id < C; ++id) {
+                        std::fill(state.spectrum.begin(), state.spectrum.end(), complex_type(0));
+                        for(size_t od = 0; od < K; ++od) {
+                            multiply_accumulate<dims, false>(
+                                spectra.data() + (j * K + od) * dims::half_area,
+                                kernel_spectra.data() + (od * C + id) * dims::half_area,
+                                state.spectrum.data()
+                            );
+                        }
+                        inverse_transform<Layer>(state);
+
+                        float_t* dst = prev_delta.data() + ((s + j) * C + id) * input_dims::area;
+                        for(size_t y = 0; y < input_dims::h; ++y) {
+                            const float_t* src = state.plane.data() + (y + geometry::pad_top) * dims::w + geometry::pad_left;
+                            for(size_t x = 0; x < input_dims::w; ++x) {
+                                dst[y * input_dims::w + x] += src[x] * inverse_scale<dims>;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Layer>
+    void backward_weights_impl(Layer& layer, tensor_4_view prev_out, tensor_4_view curr_delta) {
+        weights_engine.backward_weights(layer, prev_out, curr_delta);
+    }
+
+private:
+
+    /**
+     * \brief Per thread transform state
+     */
+    template<typename Layer>
+    struct transform_state {
+
+        using dims = detail::fft_dims<Layer>;
+
+        transform_state() : plane(dims::area), spectrum(dims::half_area) {
+            rows.SetFlag(Eigen::FFT<float_t>::HalfSpectrum);
+        }
+
+        /**
+         * Row transform, Eigen's FFT keeps scratch state and is therefore
+         * not shared between threads
+         */
+        Eigen::FFT<float_t> rows;
+
+        /**
+         * Spatial domain (Nh x Nw)
+         */
+        std::vector<float_t> plane;
+
+        /**
+         * Frequency domain (Nh x Nw / 2 + 1)
+         */
+        std::vector<complex_type> spectrum;
+    };
+
+    /**
+     * Scale of the inverse transform, the row transform is already scaled
+     */
+    template<typename Dims>
+    constexpr static float_t inverse_scale = float_t(1) / Dims::h;
+
+    /**
+     * \brief Transforms state.plane into the half spectrum dst
+     */
+    template<typename Layer>
+    void forward_transform(transform_state<Layer>& state, complex_type* dst) const {
+        using dims = detail::fft_dims<Layer>;
+        for(size_t y = 0; y < dims::h; ++y) {
+            state.rows.fwd(dst + y * dims::half_w, state.plane.data() + y * dims::w, dims::w);
+        }
+        columns.transform(dst, dims::half_w, false);
+    }
+
+    /**
+     * \brief Transforms the half spectrum state.spectrum into state.plane
+     *        scaled by Nh
+     */
+    template<typename Layer>
+    void inverse_transform(transform_state<Layer>& state) const {
+        using dims = detail::fft_dims<Layer>;
+        columns.transform(state.spectrum.data(), dims::half_w, true);
+        for(size_t y = 0; y < dims::h; ++y) {
+            state.rows.inv(state.plane.data() + y * dims::w, state.spectrum.data() + y * dims::half_w, dims::w);
+        }
+    }
+
+    /**
+     * \brief Ensure the spectrum buffer is large enough for a block of
+     *        samples of the given depth
+     * \return the number of samples per block
+     */
+    template<typename Layer>
+    size_t prepare_buffers(const size_t& samples, const size_t& depth) {
+        using dims = detail::fft_dims<Layer>;
+        columns.prepare(dims::h);
+        const size_t block_samples = std::clamp<size_t>(
+            spectrum_buffer_limit / (depth * dims::half_area),
+            1,
+            std::max<size_t>(samples, 1)
+        );
+        if(spectra.size() < block_samples * depth * dims::half_area) {
+            spectra.resize(block_samples * depth * dims::half_area);
+        }
+        return block_samples;
+    }
+
+    /**
+     * \brief Accumulates the point-wise product of the spectrum x and the
+     *        kernel spectrum into acc. The kernel spectrum is conjugated if
+     *        Conjugate
+     */
+    template<typename Dims, bool Conjugate>
+    sp_hot static void multiply_accumulate(const complex_type* x, const complex_type* kernel, complex_type* acc) {
+        const float_t* xr = reinterpret_cast<const float_t*>(x);
+        const float_t* kr = reinterpret_cast<const float_t*>(kernel);
+        float_t* ar = reinterpret_cast<float_t*>(acc);
+        #pragma omp simd
+        for(size_t i = 0; i < Dims::half_area; ++i) {
+            const float_t a = xr[2 * i], b = xr[2 * i + 1];
+            const float_t c = kr[2 * i], d = Conjugate ? -kr[2 * i + 1] : kr[2 * i + 1];
+            ar[2 * i]     += a * c - b * d;
+            ar[2 * i + 1] += a * d + b * c;
+        }
+    }
+
+    /**
+     * Column transform, shared by all threads
+     */
+    detail::column_fft columns;
+
+    /**
+     * Kernel spectra (K, C, Nh, Nw / 2 + 1)
+     */
+    std::vector<complex_type> kernel_spectra;
+
+    /**
+     * Spectra of a block of samples, (n, C, Nh, Nw / 2 + 1) in the forward
+     * pass and (n, K, Nh, Nw / 2 + 1) in the input gradient pass
+     */
+    std::vector<complex_type> spectra;
+
+    /**
+     * Weight gradient engine
+     */
+    im2col_conv_engine weights_engine;
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_LAYER_ENGINE_FFT_HPP */
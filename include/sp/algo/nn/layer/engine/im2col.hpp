@@ -0,0 +1,404 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_LAYER_ENGINE_IM2COL_HPP
+#define SP_ALGO_NN_LAYER_ENGINE_IM2COL_HPP
+
+#include <algorithm>
+#include <type_traits>
+
+#include "engine.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+namespace detail {
+
+    /**
+     * \brief Dimensions of the lowered (im2col) convolution of a layer
+     *
+     * The convolution of a sample is lowered to the matrix product
+     * '''O (K x PQ) = W (K x CRS) * X (CRS x PQ)'''
+     */
+    template<typename Layer>
+    struct im2col_dims {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+
+        /**
+         * Number of kernels (K)
+         */
+        constexpr static size_t kernels = output_dims::d;
+
+        /**
+         * Rows of the column matrix (CRS)
+         */
+        constexpr static size_t rows = input_dims::d * kernel_params::h * kernel_params::w;
+
+        /**
+         * Columns of the column matrix per sample (PQ)
+         */
+        constexpr static size_t cols = output_dims::area;
+    };
+
+}
+
+/**
+ * \brief Lowered convolution (im2col) engine
+ *
+ * Lowers the convolution of a block of samples to a single matrix product by
+ * unfolding every receptive field of the input into a column of a matrix
+ * (im2col). The product is then carried out by Eigen's blocked and packed
+ * GEMM kernels. The input gradient is computed as the transposed product
+ * folded back into the input (col2im) and the weight gradient as the product
+ * of the output delta and the transposed column matrix.
+ *
+ * Grouped connectivities (full, ngroups) multiply the compact weights of
+ * every group directly as independent per group products, the rows of the
+ * column matrix of a group being contiguous. Irregular connectivities
+ * (tables) expand the compact weights into a dense (K x CRS) matrix with
+ * zeros for disconnected kernels, whenever the weights change (see
+ * layer::weights_changed).
+ *
+ * Same padding and dilation are applied while unfolding, taps in the halo
+ * of the input write zeros instead of reading a padded copy of the input.
+ *
+ * The column matrix is limited to column_buffer_limit elements, larger
+ * batches are processed in blocks of samples.
+ */
+struct im2col_conv_engine : layer_engine<im2col_conv_engine> {
+
+    /**
+     * Upper limit of elements in the column buffer, sized such that a block
+     * of columns stays resident in the L2 cache
+     */
+    constexpr static size_t column_buffer_limit = 1 << 15;
+
+    template<typename Layer>
+    void configure_impl(Layer&, const size_t& batch_size) {
+        prepare_buffers<Layer>(batch_size);
+    }
+
+    /**
+     * \brief Expand the compact weights of irregular connectivities, see
+     *        pack_weights
+     */
+    template<typename Layer>
+    void weights_changed_impl(Layer& layer) {
+        if constexpr(!is_grouped_v<Layer>) {
+            pack_weights(layer);
+        }
+    }
+
+    template<typename Layer>
+    void forward_impl(Layer& layer, tensor_4_view input, tensor_4_view output) {
+        using dims = detail::im2col_dims<Layer>;
+
+        const size_t samples = input.dimension(0);
+        const size_t block_samples = prepare_buffers<Layer>(samples);
+
+        for(size_t s = 0; s < samples; s += block_samples) {
+            const size_t n = std::min(block_samples, samples - s);
+            const size_t cols = n * dims::cols;
+            im2col<Layer>(input, s, n);
+            if constexpr(is_grouped_v<Layer>) {
+                using group = group_dims<Layer>;
+                for(size_t g = 0; g < group::groups; ++g) {
+                    block.middleRows(g * group::kernels, group::kernels).leftCols(cols).noalias() =
+                            group_weights<Layer>(layer.w.data(), g) *
+                            columns.middleRows(g * group::rows, group::rows).leftCols(cols);
+                }
+            } else {
+                block.leftCols(cols).noalias() = packed * columns.leftCols(cols);
+            }
+            /* Scatter the block of (K x nPQ) into the output of (n, K, P, Q) */
+            #pragma omp parallel for collapse(2)
+            for(size_t j = 0; j < n; ++j) {
+                for(size_t od = 0; od < dims::kernels; ++od) {
+                    float_t* out = output.data() + ((s + j) * dims::kernels + od) * dims::cols;
+                    const float_t* res = block.data() + od * block.cols() + j * dims::cols;
+                    for(size_t p = 0; p < dims::cols; ++p) {
+                        out[p] += res[p];
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Layer>
+    void backward_input_impl(Layer& layer, tensor_4_view curr_delta, tensor_4_view prev_delta) {
+        using dims = detail::im2col_dims<Layer>;
+
+        const size_t samples = curr_delta.dimension(0);
+        const size_t block_samples = prepare_buffers<Layer>(samples);
+
+        for(size_t s = 0; s < samples; s += block_samples) {
+            const size_t n = std::min(block_samples, samples - s);
+            const size_t cols = n * dims::cols;
+            gather_delta<Layer>(curr_delta, s, n);
+            if constexpr(is_grouped_v<Layer>) {
+                using group = group_dims<Layer>;
+                for(size_t g = 0; g < group::groups; ++g) {
+                    columns.middleRows(g * group::rows, group::rows).leftCols(cols).noalias() =
+                            group_weights<Layer>(layer.w.data(), g).transpose() *
+                            block.middleRows(g * group::kernels, group::kernels).leftCols(cols);
+                }
+            } else {
+                columns.leftCols(cols).noalias() = packed.transpose() * block.leftCols(cols);
+            }
+            col2im<Layer>(prev_delta, s, n);
+        }
+    }
+
+    template<typename Layer>
+    void backward_weights_impl(Layer& layer, tensor_4_view prev_out, tensor_4_view curr_delta) {
+        using dims = detail::im2col_dims<Layer>;
+
+        const size_t samples = prev_out.dimension(0);
+        const size_t block_samples = prepare_buffers<Layer>(samples);
+
+        /* Gradient slot of the calling thread */
+        float_t* dw = layer.dw.data() + detail::gradient_slot(layer.dw) * layer.w.size();
+
+        if constexpr(!is_grouped_v<Layer>) {
+            gradient.setZero(dims::kernels, dims::rows);
+        }
+
+        for(size_t s = 0; s < samples; s += block_samples) {
+            const size_t n = std::min(block_samples, samples - s);
+            const size_t cols = n * dims::cols;
+            im2col<Layer>(prev_out, s, n);
+            gather_delta<Layer>(curr_delta, s, n);
+            /* Summed over the block of samples, (K x nPQ) * (nPQ x CRS) */
+            if constexpr(is_grouped_v<Layer>) {
+                using group = group_dims<Layer>;
+                for(size_t g = 0; g < group::groups; ++g) {
+                    group_weights<Layer>(dw, g).noalias() +=
+                            block.middleRows(g * group::kernels, group::kernels).leftCols(cols) *
+                            columns.middleRows(g * group::rows, group::rows).leftCols(cols).transpose();
+                }
+            } else {
+                gradient.noalias() += block.leftCols(cols) * columns.leftCols(cols).transpose();
+            }
+        }
+
+        if constexpr(!is_grouped_v<Layer>) {
+            /* Gather the gradients of the connected kernels */
+            using connections = typename Layer::connection_list;
+            constexpr size_t kernel_area = dims::rows / Layer::input_dims::d;
+            for(size_t k = 0; k < connections::count; ++k) {
+                const float_t* grad = gradient.data() + connections::output(k) * dims::rows + connections::input(k) * kernel_area;
+                for(size_t i = 0; i < kernel_area; ++i) {
+                    dw[k * kernel_area + i] += grad[i];
+                }
+            }
+        }
+    }
+
+private:
+
+    /**
+     * \brief Whether the connectivity of the layer splits into equally sized
+     *        groups of channels
+     */
+    template<typename Layer>
+    constexpr static bool is_grouped_v = Layer::connection_list::groups > 0;
+
+    /**
+     * \brief Dimensions of the lowered convolution of a single group
+     */
+    template<typename Layer>
+    struct group_dims {
+
+        constexpr static size_t groups = Layer::connection_list::groups;
+
+        /**
+         * Kernels (output channels) per group
+         */
+        constexpr static size_t kernels = Layer::output_dims::d / groups;
+
+        /**
+         * Rows of the column matrix per group
+         */
+        constexpr static size_t rows = detail::im2col_dims<Layer>::rows / groups;
+    };
+
+    /**
+     * \brief The compact weights of group g as a (K / G x CRS / G) matrix
+     */
+    template<typename Layer, typename T>
+    static auto group_weights(T* data, const size_t& g) {
+        using group = group_dims<Layer>;
+        using map = std::conditional_t<std::is_const_v<T>, const_row_matrix_map, row_matrix_map>;
+        return map(data + g * group::kernels * group::rows, group::kernels, group::rows);
+    }
+
+    /**
+     * \brief Ensure buffers are large enough for a block of samples
+     * \return the number of samples per block
+     */
+    template<typename Layer>
+    size_t prepare_buffers(const size_t& samples) {
+        using dims = detail::im2col_dims<Layer>;
+        const size_t block_samples = std::clamp<size_t>(
+            column_buffer_limit / (dims::rows * dims::cols),
+            1,
+            std::max<size_t>(samples, 1)
+        );
+        const size_t cols = block_samples * dims::cols;
+        if(static_cast<size_t>(columns.cols()) < cols) {
+            columns.resize(dims::rows, cols);
+            block.resize(dims::kernels, cols);
+        }
+        return std::min<size_t>(block_samples, columns.cols() / dims::cols);
+    }
+
+    /**
+     * \brief Expand the compact weights of the layer into a dense (K x CRS)
+     *        matrix, kernels of disconnected (output, input) pairs are zero
+     */
+    template<typename Layer>
+    void pack_weights(Layer& layer) {
+        using dims = detail::im2col_dims<Layer>;
+        using connections = typename Layer::connection_list;
+        constexpr size_t kernel_area = dims::rows / Layer::input_dims::d;
+        packed.setZero(dims::kernels, dims::rows);
+        for(size_t k = 0; k < connections::count; ++k) {
+            std::copy(
+                layer.w.data() + k * kernel_area,
+                layer.w.data() + (k + 1) * kernel_area,
+                packed.data() + connections::output(k) * dims::rows + connections::input(k) * kernel_area
+            );
+        }
+    }
+
+    /**
+     * \brief Unfold the receptive fields of samples [s, s + n) into columns
+     */
+    template<typename Layer>
+    void im2col(const tensor_4_view& input, const size_t& s, const size_t& n) {
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        using dims = detail::im2col_dims<Layer>;
+
+        const size_t ld = columns.cols();
+
+        #pragma omp parallel for collapse(2)
+        for(size_t j = 0; j < n; ++j) {
+            for(size_t id = 0; id < input_dims::d; ++id) {
+                const float_t* in = input.data() + ((s + j) * input_dims::d + id) * input_dims::area;
+                for(size_t ky = 0; ky < kernel_params::h; ++ky) {
+                    for(size_t kx = 0; kx < kernel_params::w; ++kx) {
+                        const size_t row = (id * kernel_params::h + ky) * kernel_params::w + kx;
+                        float_t* col = columns.data() + row * ld + j * dims::cols;
+                        const auto [row_first, row_last] = geometry::rows(ky);
+                        const auto [col_first, col_last] = geometry::cols(kx);
+                        const size_t offset_y = ky * geometry::dilation - geometry::pad_top;
+                        const size_t offset_x = kx * geometry::dilation - geometry::pad_left;
+                        for(size_t oy = 0; oy < output_dims::h; ++oy) {
+                            float_t* col_row = col + oy * output_dims::w;
+                            /* Halo rows and columns read the implicit zero padding */
+                            if(oy < row_first || oy >= row_last) {
+                                std::fill(col_row, col_row + output_dims::w, float_t(0));
+                                continue;
+                            }
+                            const float_t* in_row = in + (oy * kernel_params::s_h + offset_y) * input_dims::w + (col_first * kernel_params::s_w + offset_x);
+                            std::fill(col_row, col_row + col_first, float_t(0));
+                            for(size_t ox = col_first; ox < col_last; ++ox) {
+                                col_row[ox] = in_row[(ox - col_first) * kernel_params::s_w];
+                            }
+                            std::fill(col_row + col_last, col_row + output_dims::w, float_t(0));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief Fold (accumulate) the columns back into samples [s, s + n)
+     */
+    template<typename Layer>
+    void col2im(tensor_4_view output, const size_t& s, const size_t& n) {
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        using dims = detail::im2col_dims<Layer>;
+
+        const size_t ld = columns.cols();
+
+        #pragma omp parallel for collapse(2)
+        for(size_t j = 0; j < n; ++j) {
+            for(size_t id = 0; id < input_dims::d; ++id) {
+                float_t* out = output.data() + ((s + j) * input_dims::d + id) * input_dims::area;
+                for(size_t ky = 0; ky < kernel_params::h; ++ky) {
+                    for(size_t kx = 0; kx < kernel_params::w; ++kx) {
+                        const size_t row = (id * kernel_params::h + ky) * kernel_params::w + kx;
+                        const float_t* col = columns.data() + row * ld + j * dims::cols;
+                        const auto [row_first, row_last] = geometry::rows(ky);
+                        const auto [col_first, col_last] = geometry::cols(kx);
+                        const size_t offset_y = ky * geometry::dilation - geometry::pad_top;
+                        const size_t offset_x = kx * geometry::dilation - geometry::pad_left;
+                        /* Columns of the padding are dropped */
+                        for(size_t oy = row_first; oy < row_last; ++oy) {
+                            float_t* out_row = out + (oy * kernel_params::s_h + offset_y) * input_dims::w + (col_first * kernel_params::s_w + offset_x);
+                            const float_t* col_row = col + oy * output_dims::w;
+                            for(size_t ox = col_first; ox < col_last; ++ox) {
+                                out_row[(ox - col_first) * kernel_params::s_w] += col_row[ox];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief Gather the delta of samples [s, s + n) of (n, K, P, Q) into a
+     *        block of (K x nPQ)
+     */
+    template<typename Layer>
+    void gather_delta(const tensor_4_view& delta, const size_t& s, const size_t& n) {
+        using dims = detail::im2col_dims<Layer>;
+        #pragma omp parallel for collapse(2)
+        for(size_t j = 0; j < n; ++j) {
+            for(size_t od = 0; od < dims::kernels; ++od) {
+                const float_t* src = delta.data() + ((s + j) * dims::kernels + od) * dims::cols;
+                std::copy(src, src + dims::cols, block.data() + od * block.cols() + j * dims::cols);
+            }
+        }
+    }
+
+    /**
+     * Column matrix (CRS x nPQ)
+     */
+    row_matrix columns;
+
+    /**
+     * Output or delta block (K x nPQ)
+     */
+    row_matrix block;
+
+    /**
+     * Dense weights (K x CRS), only used with irregular connectivity
+     */
+    row_matrix packed;
+
+    /**
+     * Dense weight gradient (K x CRS), only used with irregular connectivity
+     */
+    row_matrix gradient;
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_LAYER_ENGINE_IM2COL_HPP */
@@ -0,0 +1,60 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_LAYER_ENGINE_SELECT_HPP
+#define SP_ALGO_NN_LAYER_ENGINE_SELECT_HPP
+
+#include <type_traits>
+
+#include "im2col.hpp"
+#include "winograd.hpp"
+#include "../detail/layers.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+namespace detail {
+
+    /**
+     * \brief Selects the convolution engine best suited for the input
+     *        dimensions and kernel parameters
+     *
+     *  - Dense 3x3 kernels with unit strides use the Winograd engine, with
+     *    F(4x4, 3x3) when the output is at least 8x8 and F(2x2, 3x3)
+     *    otherwise
+     *  - Everything else uses the im2col engine
+     */
+    template<typename InputVolume, typename KernelParams, size_t Dilation = 0>
+    struct default_conv_engine {
+
+        using output_dims = convolution_kernel_out_dims_t<InputVolume, KernelParams, Dilation>;
+
+        constexpr static bool winograd =
+                Dilation == 0 &&
+                KernelParams::h == 3 && KernelParams::w == 3 &&
+                KernelParams::s_h == 1 && KernelParams::s_w == 1;
+
+        constexpr static size_t tile = output_dims::h >= 8 && output_dims::w >= 8 ? 4 : 2;
+
+        using type = std::conditional_t<
+            winograd,
+            winograd_conv_engine<tile>,
+            im2col_conv_engine
+        >;
+    };
+
+}
+
+/**
+ * \brief The default convolution engine of a convolution layer
+ */
+template<typename InputVolume, typename KernelParams, size_t Dilation = 0>
+using default_conv_engine_t = typename detail::default_conv_engine<InputVolume, KernelParams, Dilation>::type;
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_LAYER_ENGINE_SELECT_HPP */
@@ -0,0 +1,677 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_LAYER_ENGINE_TILED_HPP
+#define SP_ALGO_NN_LAYER_ENGINE_TILED_HPP
+
+#include <algorithm>
+#include <type_traits>
+
+#include "engine.hpp"
+#include "../connectivity.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+namespace detail {
+
+    /**
+     * \brief Register tile of the tiled direct convolution engine for a
+     *        KH x KW kernel
+     *
+     * A tile of channel_block channels by tile_width columns is accumulated
+     * in registers while the kernel reduction is carried out, every loaded
+     * vector is reused channel_block times. The channels are output channels
+     * for the forward pass and input channels for the input gradient.
+     */
+    template<size_t KH, size_t KW>
+    struct direct_conv_tile {
+        constexpr static size_t channel_block = 2;
+        constexpr static size_t tile_width = 8;
+    };
+
+    /**
+     * 1x1, a single multiply-add per loaded input, maximize the reuse over
+     * output channels
+     */
+    template<>
+    struct direct_conv_tile<1, 1> {
+        constexpr static size_t channel_block = 8;
+        constexpr static size_t tile_width = 8;
+    };
+
+    template<>
+    struct direct_conv_tile<3, 3> {
+        constexpr static size_t channel_block = 4;
+        constexpr static size_t tile_width = 8;
+    };
+
+    template<>
+    struct direct_conv_tile<5, 5> {
+        constexpr static size_t channel_block = 4;
+        constexpr static size_t tile_width = 8;
+    };
+
+    /**
+     * \brief Row view of the planes of a direct convolution
+     *
+     * A 1x1 kernel with unit strides maps every input position to exactly
+     * one output position, hence the plane is treated as one long row.
+     */
+    template<typename Layer>
+    struct direct_conv_rows {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+
+        constexpr static bool pointwise =
+                kernel_params::h == 1 && kernel_params::w == 1 &&
+                kernel_params::s_h == 1 && kernel_params::s_w == 1;
+
+        /**
+         * Number of output rows per plane
+         */
+        constexpr static size_t rows = pointwise ? 1 : output_dims::h;
+
+        /**
+         * Number of output columns per row
+         */
+        constexpr static size_t cols = pointwise ? output_dims::area : output_dims::w;
+
+        /**
+         * Number of input rows per plane
+         */
+        constexpr static size_t in_rows = pointwise ? 1 : input_dims::h;
+
+        /**
+         * Number of input columns per row
+         */
+        constexpr static size_t in_cols = pointwise ? input_dims::area : input_dims::w;
+
+        /**
+         * Interior output columns [first, last), every kernel column reads
+         * within the input row, the halo around it reads the padding
+         */
+        constexpr static size_t first = pointwise ? 0 : geometry::interior_left;
+        constexpr static size_t last = pointwise ? cols : geometry::interior_right;
+    };
+
+    /**
+     * \brief Register lanes of a row of a tile
+     */
+    template<size_t Width>
+    using direct_conv_lanes = Eigen::Array<float_t, Width, 1>;
+
+    /**
+     * \brief Map of Width elements, Stride apart, as register lanes
+     */
+    template<size_t Width, size_t Stride = 1>
+    using direct_conv_lanes_map = Eigen::Map<direct_conv_lanes<Width>, Eigen::Unaligned, Eigen::InnerStride<Stride>>;
+
+    template<size_t Width, size_t Stride = 1>
+    using const_direct_conv_lanes_map = Eigen::Map<const direct_conv_lanes<Width>, Eigen::Unaligned, Eigen::InnerStride<Stride>>;
+
+}
+
+/**
+ * \brief Register tiled direct convolution engine
+ *
+ * Direct convolution fully specialized at compile time on the dimensions and
+ * kernel parameters of the layer. The kernel loops are unrolled and output
+ * tiles (see detail::direct_conv_tile) are held in registers, the columns of
+ * a tile are vectorized for any stride. Same padding and dilation are handled
+ * in the kernels, interior tiles take the unchecked path while only the halo
+ * columns are computed element by element with bounds checks and kernel rows
+ * reading the padding are skipped. Requires no scratch memory, hence it
+ * suits latency bound inference with small batches where the memory overhead
+ * of the im2col engine is unacceptable.
+ *
+ * Work is distributed over (sample, output block) for the forward pass,
+ * (sample, input depth) for the input gradient and (output depth, input
+ * depth) for the weight gradient, such that a single sample keeps every
+ * thread busy.
+ */
+struct tiled_direct_conv_engine : layer_engine<tiled_direct_conv_engine> {
+
+    template<typename Layer>
+    void forward_impl(Layer& layer, tensor_4_view input, tensor_4_view output) {
+
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using tile = detail::direct_conv_tile<kernel_params::h, kernel_params::w>;
+
+        constexpr size_t block = tile::channel_block;
+        constexpr size_t remainder = output_dims::d % block;
+        constexpr size_t blocks = (output_dims::d + block - 1) / block;
+
+        const size_t samples = input.dimension(0);
+
+        #pragma omp parallel for collapse(2)
+        for(size_t si = 0; si < samples; ++si) {
+            for(size_t b = 0; b < blocks; ++b) {
+                const size_t od = b * block;
+                if constexpr(remainder == 0) {
+                    forward_block<Layer, block>(layer, input, output, si, od);
+                } else {
+                    if(od + block <= output_dims::d) {
+                        forward_block<Layer, block>(layer, input, output, si, od);
+                    } else {
+                        forward_block<Layer, remainder>(layer, input, output, si, od);
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Layer>
+    void backward_input_impl(Layer& layer, tensor_4_view curr_delta, tensor_4_view prev_delta) {
+
+        using input_dims = typename Layer::input_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using tile = detail::direct_conv_tile<kernel_params::h, kernel_params::w>;
+
+        if constexpr(kernel_params::s_h == 1 && kernel_params::s_w == 1) {
+
+            constexpr size_t block = tile::channel_block;
+            constexpr size_t remainder = input_dims::d % block;
+            constexpr size_t blocks = (input_dims::d + block - 1) / block;
+
+            const size_t samples = curr_delta.dimension(0);
+
+            /* Every (sample, input block) of prev_delta is owned by one thread */
+            #pragma omp parallel for collapse(2)
+            for(size_t si = 0; si < samples; ++si) {
+                for(size_t b = 0; b < blocks; ++b) {
+                    const size_t id = b * block;
+                    if constexpr(remainder == 0) {
+                        backward_input_block<Layer, block>(layer, curr_delta, prev_delta, si, id);
+                    } else {
+                        if(id + block <= input_dims::d) {
+                            backward_input_block<Layer, block>(layer, curr_delta, prev_delta, si, id);
+                        } else {
+                            backward_input_block<Layer, remainder>(layer, curr_delta, prev_delta, si, id);
+                        }
+                    }
+                }
+            }
+        } else {
+            backward_input_scatter(layer, curr_delta, prev_delta);
+        }
+    }
+
+    template<typename Layer>
+    void backward_weights_impl(Layer& layer, tensor_4_view prev_out, tensor_4_view curr_delta) {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        using rows = detail::direct_conv_rows<Layer>;
+        using connections = typename Layer::connection_list;
+        using tile = detail::direct_conv_tile<kernel_params::h, kernel_params::w>;
+
+        constexpr size_t kernel_area = kernel_params::h * kernel_params::w;
+        constexpr size_t width = tile::tile_width;
+        constexpr size_t full = rows::first + (rows::last - rows::first) / width * width;
+
+        const size_t samples = prev_out.dimension(0);
+
+        /* Every kernel, i.e. connected (output depth, input depth) pair, is owned by one thread */
+        #pragma omp parallel for
+        for(size_t kernel = 0; kernel < connections::count; ++kernel) {
+            const size_t od = connections::output(kernel);
+            const size_t id = connections::input(kernel);
+            /* Lane accumulators of every kernel element, summed once at the end */
+            detail::direct_conv_lanes<width> acc[kernel_area];
+            for(size_t k = 0; k < kernel_area; ++k) {
+                acc[k].setZero();
+            }
+            float_t border[kernel_area] = {};
+            for(size_t si = 0; si < samples; ++si) {
+                const float_t* in = prev_out.data() + (si * input_dims::d + id) * input_dims::area;
+                const float_t* cd = curr_delta.data() + (si * output_dims::d + od) * output_dims::area;
+                for(size_t oy = 0; oy < rows::rows; ++oy) {
+                    const float_t* cd_row = cd + oy * rows::cols;
+                    for(size_t ox = rows::first; ox < full; ox += width) {
+                        const detail::direct_conv_lanes<width> d = detail::const_direct_conv_lanes_map<width>(cd_row + ox);
+                        #pragma GCC unroll 8
+                        for(size_t ky = 0; ky < kernel_params::h; ++ky) {
+                            const size_t iy = oy * kernel_params::s_h + ky * geometry::dilation - geometry::pad_top;
+                            if(geometry::padded && iy >= rows::in_rows) {
+                                continue;
+                            }
+                            const float_t* in_row = in + iy * rows::in_cols + ox * kernel_params::s_w - geometry::pad_left;
+                            #pragma GCC unroll 8
+                            for(size_t kx = 0; kx < kernel_params::w; ++kx) {
+                                acc[ky * kernel_params::w + kx] +=
+                                        detail::const_direct_conv_lanes_map<width, kernel_params::s_w>(in_row + kx * geometry::dilation) * d;
+                            }
+                        }
+                    }
+                    /* Halo and remaining columns, element by element */
+                    const auto border_column = [&](const size_t& ox) {
+                        for(size_t ky = 0; ky < kernel_params::h; ++ky) {
+                            const size_t iy = oy * kernel_params::s_h + ky * geometry::dilation - geometry::pad_top;
+                            if(iy >= rows::in_rows) {
+                                continue;
+                            }
+                            for(size_t kx = 0; kx < kernel_params::w; ++kx) {
+                                const size_t ix = ox * kernel_params::s_w + kx * geometry::dilation - geometry::pad_left;
+                                if(ix < rows::in_cols) {
+                                    border[ky * kernel_params::w + kx] += in[iy * rows::in_cols + ix] * cd_row[ox];
+                                }
+                            }
+                        }
+                    };
+                    for(size_t ox = 0; ox < rows::first; ++ox) {
+                        border_column(ox);
+                    }
+                    for(size_t ox = full; ox < rows::cols; ++ox) {
+                        border_column(ox);
+                    }
+                }
+            }
+            const size_t slot = detail::gradient_slot(layer.dw);
+            float_t* dw = layer.dw.data() + slot * layer.w.size() + kernel * kernel_area;
+            for(size_t k = 0; k < kernel_area; ++k) {
+                dw[k] += acc[k].sum() + border[k];
+            }
+        }
+    }
+
+private:
+
+    /**
+     * \brief Input gradient of strided convolutions, scatters every row of
+     *        the current delta through the kernel into the previous delta
+     */
+    template<typename Layer>
+    static void backward_input_scatter(Layer& layer, tensor_4_view curr_delta, tensor_4_view prev_delta) {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        using rows = detail::direct_conv_rows<Layer>;
+        using connections = typename Layer::connection_list;
+
+        constexpr size_t kernel_area = kernel_params::h * kernel_params::w;
+
+        const size_t samples = curr_delta.dimension(0);
+
+        /* Every (sample, input depth) plane of prev_delta is owned by one thread */
+        #pragma omp parallel for collapse(2)
+        for(size_t si = 0; si < samples; ++si) {
+            for(size_t id = 0; id < input_dims::d; ++id) {
+                float_t* pd = prev_delta.data() + (si * input_dims::d + id) * input_dims::area;
+                for(size_t od = 0; od < output_dims::d; ++od) {
+                    const size_t kernel = connections::index(od, id);
+                    if(kernel != connections::count) {
+                        const float_t* wk = layer.w.data() + kernel * kernel_area;
+                        const float_t* cd = curr_delta.data() + (si * output_dims::d + od) * output_dims::area;
+                        for(size_t oy = 0; oy < rows::rows; ++oy) {
+                            const float_t* cd_row = cd + oy * rows::cols;
+                            const detail::direct_conv_lanes<rows::cols> d = detail::const_direct_conv_lanes_map<rows::cols>(cd_row);
+                            #pragma GCC unroll 8
+                            for(size_t ky = 0; ky < kernel_params::h; ++ky) {
+                                const size_t iy = oy * kernel_params::s_h + ky * geometry::dilation - geometry::pad_top;
+                                if(geometry::padded && iy >= rows::in_rows) {
+                                    continue;
+                                }
+                                #pragma GCC unroll 8
+                                for(size_t kx = 0; kx < kernel_params::w; ++kx) {
+                                    const float_t w = wk[ky * kernel_params::w + kx];
+                                    const auto [first, last] = geometry::cols(kx);
+                                    if(first == 0 && last == rows::cols) {
+                                        float_t* pd_row = pd + iy * rows::in_cols + (kx * geometry::dilation - geometry::pad_left);
+                                        detail::direct_conv_lanes_map<rows::cols, kernel_params::s_w>(pd_row) += w * d;
+                                    } else {
+                                        /* Halo of the row, only the columns within the input */
+                                        for(size_t ox = first; ox < last; ++ox) {
+                                            pd[iy * rows::in_cols + ox * kernel_params::s_w + kx * geometry::dilation - geometry::pad_left] += w * cd_row[ox];
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief Input gradient of Block input channels [id, id + Block) of
+     *        sample si for unit strides
+     *
+     * Every element of the previous delta gathers the full correlation of
+     * the current delta with the kernel. Interior columns, for which every
+     * kernel column reads within the current delta, are accumulated in
+     * register tiles, the halo columns on either side element by element.
+     */
+    template<typename Layer, size_t Block>
+    static void backward_input_block(Layer& layer, const tensor_4_view& curr_delta, tensor_4_view prev_delta, const size_t& si, const size_t& id) {
+
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        using tile = detail::direct_conv_tile<kernel_params::h, kernel_params::w>;
+        using rows = detail::direct_conv_rows<Layer>;
+
+        constexpr size_t width = tile::tile_width;
+        /* Interior columns [first, last) read every kernel column from within the delta */
+        constexpr size_t reach = (kernel_params::w - 1) * geometry::dilation;
+        constexpr size_t first = std::min(rows::in_cols, reach > geometry::pad_left ? reach - geometry::pad_left : 0);
+        constexpr size_t last = std::max(first, std::min(rows::in_cols, rows::cols > geometry::pad_left ? rows::cols - geometry::pad_left : 0));
+        constexpr size_t interior = last - first;
+        constexpr size_t full = first + interior / width * width;
+
+        for(size_t iy = 0; iy < rows::in_rows; ++iy) {
+            for(size_t ix = 0; ix < first; ++ix) {
+                backward_input_element<Layer, Block>(layer, curr_delta, prev_delta, si, id, iy, ix);
+            }
+            for(size_t ix = first; ix < full; ix += width) {
+                backward_input_tile<Layer, Block, width>(layer, curr_delta, prev_delta, si, id, iy, ix);
+            }
+            if constexpr(interior % width != 0) {
+                backward_input_tile<Layer, Block, interior % width>(layer, curr_delta, prev_delta, si, id, iy, full);
+            }
+            for(size_t ix = last; ix < rows::in_cols; ++ix) {
+                backward_input_element<Layer, Block>(layer, curr_delta, prev_delta, si, id, iy, ix);
+            }
+        }
+    }
+
+    /**
+     * \brief Accumulates the (Block x Width) tile of the previous delta at
+     *        (id, iy, ix) of sample si in registers, kernel rows outside of
+     *        the current delta are skipped
+     */
+    template<typename Layer, size_t Block, size_t Width>
+    static void backward_input_tile(    Layer& layer,
+                                        const tensor_4_view& curr_delta,
+                                        tensor_4_view prev_delta,
+                                        const size_t& si,
+                                        const size_t& id,
+                                        const size_t& iy,
+                                        const size_t& ix) {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        using rows = detail::direct_conv_rows<Layer>;
+
+        constexpr size_t kernel_area = kernel_params::h * kernel_params::w;
+
+        detail::direct_conv_lanes<Width> acc[Block];
+        for(size_t b = 0; b < Block; ++b) {
+            acc[b].setZero();
+        }
+
+        for(size_t od = 0; od < output_dims::d; ++od) {
+            float_t wk[Block][kernel_area];
+            load_kernels<Layer, Block>(layer, od, id, wk);
+            const float_t* cd = curr_delta.data() + (si * output_dims::d + od) * output_dims::area + ix + geometry::pad_left;
+            #pragma GCC unroll 8
+            for(size_t ky = 0; ky < kernel_params::h; ++ky) {
+                const size_t oy = iy + geometry::pad_top - ky * geometry::dilation;
+                if(oy >= rows::rows) {
+                    continue;
+                }
+                #pragma GCC unroll 8
+                for(size_t kx = 0; kx < kernel_params::w; ++kx) {
+                    const detail::direct_conv_lanes<Width> x =
+                            detail::const_direct_conv_lanes_map<Width>(cd + oy * rows::cols - kx * geometry::dilation);
+                    #pragma GCC unroll 8
+                    for(size_t b = 0; b < Block; ++b) {
+                        acc[b] += wk[b][ky * kernel_params::w + kx] * x;
+                    }
+                }
+            }
+        }
+
+        #pragma GCC unroll 8
+        for(size_t b = 0; b < Block; ++b) {
+            float_t* pd = prev_delta.data() + (si * input_dims::d + id + b) * input_dims::area + iy * rows::in_cols + ix;
+            detail::direct_conv_lanes_map<Width>(pd) += acc[b];
+        }
+    }
+
+    /**
+     * \brief Gathers a single halo element (iy, ix) of the previous delta
+     *        for Block input channels [id, id + Block) of sample si
+     */
+    template<typename Layer, size_t Block>
+    static void backward_input_element( Layer& layer,
+                                        const tensor_4_view& curr_delta,
+                                        tensor_4_view prev_delta,
+                                        const size_t& si,
+                                        const size_t& id,
+                                        const size_t& iy,
+                                        const size_t& ix) {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        using rows = detail::direct_conv_rows<Layer>;
+
+        constexpr size_t kernel_area = kernel_params::h * kernel_params::w;
+
+        float_t acc[Block] = {};
+
+        for(size_t od = 0; od < output_dims::d; ++od) {
+            float_t wk[Block][kernel_area];
+            load_kernels<Layer, Block>(layer, od, id, wk);
+            const float_t* cd = curr_delta.data() + (si * output_dims::d + od) * output_dims::area;
+            for(size_t ky = 0; ky < kernel_params::h; ++ky) {
+                const size_t oy = iy + geometry::pad_top - ky * geometry::dilation;
+                if(oy >= rows::rows) {
+                    continue;
+                }
+                for(size_t kx = 0; kx < kernel_params::w; ++kx) {
+                    const size_t ox = ix + geometry::pad_left - kx * geometry::dilation;
+                    if(ox >= rows::cols) {
+                        continue;
+                    }
+                    const float_t x = cd[oy * rows::cols + ox];
+                    for(size_t b = 0; b < Block; ++b) {
+                        acc[b] += wk[b][ky * kernel_params::w + kx] * x;
+                    }
+                }
+            }
+        }
+
+        for(size_t b = 0; b < Block; ++b) {
+            prev_delta.data()[(si * input_dims::d + id + b) * input_dims::area + iy * rows::in_cols + ix] += acc[b];
+        }
+    }
+
+    /**
+     * \brief Loads the kernels of output depth od of Block input channels
+     *        [id, id + Block), disconnected kernels are zero
+     */
+    template<typename Layer, size_t Block, size_t KernelArea>
+    static void load_kernels(Layer& layer, const size_t& od, const size_t& id, float_t (&wk)[Block][KernelArea]) {
+        using connections = typename Layer::connection_list;
+        #pragma GCC unroll 8
+        for(size_t b = 0; b < Block; ++b) {
+            const size_t kernel = connections::index(od, id + b);
+            const float_t* w = layer.w.data() + kernel * KernelArea;
+            for(size_t k = 0; k < KernelArea; ++k) {
+                wk[b][k] = kernel != connections::count ? w[k] : float_t(0);
+            }
+        }
+    }
+
+    /**
+     * \brief Loads the kernels of Block output channels [od, od + Block) of
+     *        input depth id, disconnected kernels are zero
+     */
+    template<typename Layer, size_t Block, size_t KernelArea>
+    static void load_output_kernels(Layer& layer, const size_t& od, const size_t& id, float_t (&wk)[Block][KernelArea]) {
+        using connections = typename Layer::connection_list;
+        #pragma GCC unroll 8
+        for(size_t b = 0; b < Block; ++b) {
+            const size_t kernel = connections::index(od + b, id);
+            const float_t* w = layer.w.data() + kernel * KernelArea;
+            for(size_t k = 0; k < KernelArea; ++k) {
+                wk[b][k] = kernel != connections::count ? w[k] : float_t(0);
+            }
+        }
+    }
+
+    /**
+     * \brief Forward propagation of Block output channels [od, od + Block)
+     *        of sample si, row by row in tiles of detail::direct_conv_tile.
+     *        Halo columns reading the padding are computed element by
+     *        element.
+     */
+    template<typename Layer, size_t Block>
+    static void forward_block(Layer& layer, const tensor_4_view& input, tensor_4_view output, const size_t& si, const size_t& od) {
+
+        using kernel_params = typename Layer::kernel_params;
+        using tile = detail::direct_conv_tile<kernel_params::h, kernel_params::w>;
+        using rows = detail::direct_conv_rows<Layer>;
+
+        constexpr size_t width = tile::tile_width;
+        constexpr size_t interior = rows::last - rows::first;
+        constexpr size_t full = rows::first + interior / width * width;
+
+        for(size_t oy = 0; oy < rows::rows; ++oy) {
+            for(size_t ox = 0; ox < rows::first; ++ox) {
+                forward_element<Layer, Block>(layer, input, output, si, od, oy, ox);
+            }
+            for(size_t ox = rows::first; ox < full; ox += width) {
+                forward_tile<Layer, Block, width>(layer, input, output, si, od, oy, ox);
+            }
+            if constexpr(interior % width != 0) {
+                forward_tile<Layer, Block, interior % width>(layer, input, output, si, od, oy, full);
+            }
+            for(size_t ox = rows::last; ox < rows::cols; ++ox) {
+                forward_element<Layer, Block>(layer, input, output, si, od, oy, ox);
+            }
+        }
+    }
+
+    /**
+     * \brief Accumulates the (Block x Width) output tile at (od, oy, ox) of
+     *        sample si in registers and adds it to the output. Kernel rows
+     *        reading the padding are skipped.
+     */
+    template<typename Layer, size_t Block, size_t Width>
+    static void forward_tile(   Layer& layer,
+                                const tensor_4_view& input,
+                                tensor_4_view output,
+                                const size_t& si,
+                                const size_t& od,
+                                const size_t& oy,
+                                const size_t& ox) {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        using rows = detail::direct_conv_rows<Layer>;
+
+        constexpr size_t kernel_area = kernel_params::h * kernel_params::w;
+
+        detail::direct_conv_lanes<Width> acc[Block];
+        for(size_t b = 0; b < Block; ++b) {
+            acc[b].setZero();
+        }
+
+        for(size_t id = 0; id < input_dims::d; ++id) {
+
+            float_t wk[Block][kernel_area];
+            load_output_kernels<Layer, Block>(layer, od, id, wk);
+
+            const float_t* in = input.data()
+                    + (si * input_dims::d + id) * input_dims::area
+                    + ox * kernel_params::s_w - geometry::pad_left;
+
+            #pragma GCC unroll 8
+            for(size_t ky = 0; ky < kernel_params::h; ++ky) {
+                const size_t iy = oy * kernel_params::s_h + ky * geometry::dilation - geometry::pad_top;
+                if(geometry::padded && iy >= rows::in_rows) {
+                    continue;
+                }
+                #pragma GCC unroll 8
+                for(size_t kx = 0; kx < kernel_params::w; ++kx) {
+                    const detail::direct_conv_lanes<Width> x =
+                            detail::const_direct_conv_lanes_map<Width, kernel_params::s_w>(in + iy * rows::in_cols + kx * geometry::dilation);
+                    #pragma GCC unroll 8
+                    for(size_t b = 0; b < Block; ++b) {
+                        acc[b] += wk[b][ky * kernel_params::w + kx] * x;
+                    }
+                }
+            }
+        }
+
+        #pragma GCC unroll 8
+        for(size_t b = 0; b < Block; ++b) {
+            float_t* out = output.data() + (si * output_dims::d + od + b) * output_dims::area + oy * rows::cols + ox;
+            detail::direct_conv_lanes_map<Width>(out) += acc[b];
+        }
+    }
+
+    /**
+     * \brief Computes a single halo element (od, oy, ox) of Block output
+     *        channels of sample si, taps reading the padding are skipped
+     */
+    template<typename Layer, size_t Block>
+    static void forward_element(Layer& layer,
+                                const tensor_4_view& input,
+                                tensor_4_view output,
+                                const size_t& si,
+                                const size_t& od,
+                                const size_t& oy,
+                                const size_t& ox) {
+
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        using rows = detail::direct_conv_rows<Layer>;
+
+        constexpr size_t kernel_area = kernel_params::h * kernel_params::w;
+
+        float_t acc[Block] = {};
+
+        for(size_t id = 0; id < input_dims::d; ++id) {
+            float_t wk[Block][kernel_area];
+            load_output_kernels<Layer, Block>(layer, od, id, wk);
+            const float_t* in = input.data() + (si * input_dims::d + id) * input_dims::area;
+            for(size_t ky = 0; ky < kernel_params::h; ++ky) {
+                const size_t iy = oy * kernel_params::s_h + ky * geometry::dilation - geometry::pad_top;
+                if(iy >= rows::in_rows) {
+                    continue;
+                }
+                for(size_t kx = 0; kx < kernel_params::w; ++kx) {
+                    const size_t ix = ox * kernel_params::s_w + kx * geometry::dilation - geometry::pad_left;
+                    if(ix >= rows::in_cols) {
+                        continue;
+                    }
+                    const float_t x = in[iy * rows::in_cols + ix];
+                    for(size_t b = 0; b < Block; ++b) {
+                        acc[b] += wk[b][ky * kernel_params::w + kx] * x;
+                    }
+                }
+            }
+        }
+
+        for(size_t b = 0; b < Block; ++b) {
+            output.data()[(si * output_dims::d + od + b) * output_dims::area + oy * rows::cols + ox] += acc[b];
+        }
+    }
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_LAYER_ENGINE_TILED_HPP */
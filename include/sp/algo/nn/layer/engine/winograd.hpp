@@ -0,0 +1,412 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_LAYER_ENGINE_WINOGRAD_HPP
+#define SP_ALGO_NN_LAYER_ENGINE_WINOGRAD_HPP
+
+#include <algorithm>
+
+#include "engine.hpp"
+#include "im2col.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+namespace detail {
+
+    /**
+     * \brief Winograd minimal filtering transforms F(m x m, 3 x 3)
+     *
+     * Transforms according to Lavin & Gray, Fast Algorithms for Convolutional
+     * Neural Networks (https://arxiv.org/abs/1509.09308)
+     *
+     * '''Y = AT [(G g GT) * (BT d B)] A'''
+     */
+    template<size_t M>
+    struct winograd_transforms;
+
+    template<>
+    struct winograd_transforms<2> {
+
+        constexpr static size_t m = 2;
+        constexpr static size_t r = 3;
+        constexpr static size_t alpha = m + r - 1;
+
+        constexpr static float_t BT[alpha][alpha] = {
+            { 1,  0, -1,  0 },
+            { 0,  1,  1,  0 },
+            { 0, -1,  1,  0 },
+            { 0,  1,  0, -1 }
+        };
+
+        constexpr static float_t G[alpha][r] = {
+            { 1.0f,  0.0f, 0.0f },
+            { 0.5f,  0.5f, 0.5f },
+            { 0.5f, -0.5f, 0.5f },
+            { 0.0f,  0.0f, 1.0f }
+        };
+
+        constexpr static float_t AT[m][alpha] = {
+            { 1, 1,  1,  0 },
+            { 0, 1, -1, -1 }
+        };
+    };
+
+    template<>
+    struct winograd_transforms<4> {
+
+        constexpr static size_t m = 4;
+        constexpr static size_t r = 3;
+        constexpr static size_t alpha = m + r - 1;
+
+        constexpr static float_t BT[alpha][alpha] = {
+            { 4,  0, -5,  0, 1, 0 },
+            { 0, -4, -4,  1, 1, 0 },
+            { 0,  4, -4, -1, 1, 0 },
+            { 0, -2, -1,  2, 1, 0 },
+            { 0,  2, -1, -2, 1, 0 },
+            { 0,  4,  0, -5, 0, 1 }
+        };
+
+        constexpr static float_t G[alpha][r] = {
+            {  1.0f / 4,   0.0f,       0.0f     },
+            { -1.0f / 6,  -1.0f / 6,  -1.0f / 6 },
+            { -1.0f / 6,   1.0f / 6,  -1.0f / 6 },
+            {  1.0f / 24,  1.0f / 12,  1.0f / 6 },
+            {  1.0f / 24, -1.0f / 12,  1.0f / 6 },
+            {  0.0f,       0.0f,       1.0f     }
+        };
+
+        constexpr static float_t AT[m][alpha] = {
+            { 1, 1,  1, 1,  1, 0 },
+            { 0, 1, -1, 2, -2, 0 },
+            { 0, 1,  1, 4,  4, 0 },
+            { 0, 1, -1, 8, -8, 1 }
+        };
+    };
+
+    /**
+     * \brief Computes '''out (Rows x Rows) = T x (Cols x Cols) TT'''
+     *
+     * The transforms are compile time constants, once the loops are unrolled
+     * the zero terms are eliminated.
+     */
+    template<size_t Rows, size_t Cols>
+    sp_hot void winograd_sandwich(const float_t (&t)[Rows][Cols], const float_t* x, float_t* out) {
+        float_t tmp[Rows][Cols];
+        #pragma GCC unroll 8
+        for(size_t i = 0; i < Rows; ++i) {
+            #pragma GCC unroll 8
+            for(size_t j = 0; j < Cols; ++j) {
+                float_t sum = 0;
+                #pragma GCC unroll 8
+                for(size_t k = 0; k < Cols; ++k) {
+                    if(t[i][k] != 0) {
+                        sum += t[i][k] * x[k * Cols + j];
+                    }
+                }
+                tmp[i][j] = sum;
+            }
+        }
+        #pragma GCC unroll 8
+        for(size_t i = 0; i < Rows; ++i) {
+            #pragma GCC unroll 8
+            for(size_t j = 0; j < Rows; ++j) {
+                float_t sum = 0;
+                #pragma GCC unroll 8
+                for(size_t k = 0; k < Cols; ++k) {
+                    if(t[j][k] != 0) {
+                        sum += tmp[i][k] * t[j][k];
+                    }
+                }
+                out[i * Rows + j] = sum;
+            }
+        }
+    }
+}
+
+/**
+ * \brief Winograd F(M x M, 3 x 3) convolution engine
+ *
+ * Computes M x M output tiles of a 3 x 3, stride 1 convolution from
+ * (M + 2) x (M + 2) input tiles with (M + 2)^2 instead of 9 M^2 multiplications
+ * per (tile, input depth, output depth), i.e. a reduction of 2.25x for
+ * F(2 x 2, 3 x 3) and 4x for F(4 x 4, 3 x 3).
+ *
+ * The element-wise products of the transformed tiles and kernels are summed
+ * over the input depth as (M + 2)^2 independent matrix products of
+ * '''(tiles x C) * (C x K)'''.
+ *
+ * The kernels are transformed once whenever the weights change (see
+ * layer::weights_changed), both for the forward pass and the input gradient
+ * pass. The latter is the full correlation of the current delta with the
+ * rotated and transposed kernels. The weight gradient is delegated to
+ * #im2col_conv_engine.
+ *
+ * Same padding is the one pixel halo of zeros the boundary tiles already
+ * read, the input gradient pass pads the delta by the remainder.
+ *
+ * Only valid for dense 3 x 3 kernels with unit strides, see #default_conv_engine_t
+ *
+ * \tparam M output tile size, 2 or 4
+ */
+template<size_t M = 2>
+struct winograd_conv_engine : layer_engine<winograd_conv_engine<M>> {
+
+    using transforms = detail::winograd_transforms<M>;
+
+    /**
+     * Size of the transformed tiles
+     */
+    constexpr static size_t alpha = transforms::alpha;
+
+    /**
+     * Number of element-wise products per transformed tile
+     */
+    constexpr static size_t alpha_2 = alpha * alpha;
+
+    /**
+     * Upper limit of elements in each of the transformed tile buffers, larger
+     * batches are processed in blocks of tiles
+     */
+    constexpr static size_t tile_buffer_limit = 1 << 17;
+
+    /**
+     * Number of channels transformed at once. The transformed tiles are
+     * written alpha^2 rows apart, one cache line per row at a time.
+     */
+    constexpr static size_t channel_block = 16;
+
+    template<typename Layer>
+    void configure_impl(Layer& layer, const size_t& batch_size) {
+        static_assert(Layer::kernel_params::h == 3 && Layer::kernel_params::w == 3,
+                "Winograd engine requires 3x3 kernels");
+        static_assert(Layer::kernel_params::s_h == 1 && Layer::kernel_params::s_w == 1,
+                "Winograd engine requires unit strides");
+        static_assert(!Layer::geometry::dilated, "Winograd engine requires dense kernels");
+        /* Weight gradients only, not needed for inference */
+        if(layer.training()) {
+            weights_engine.configure(layer, batch_size);
+        }
+    }
+
+    /**
+     * \brief Transform the kernels of the layer, '''U = G g GT''', for both
+     *        the forward (C x K) and, when training, the input gradient pass
+     *        (K x C)
+     */
+    template<typename Layer>
+    void weights_changed_impl(Layer& layer) {
+        constexpr size_t K = Layer::output_dims::d;
+        constexpr size_t C = Layer::input_dims::d;
+        using connections = typename Layer::connection_list;
+
+        const bool training = layer.training();
+        forward_kernels.resize(alpha_2 * C, K);
+        backward_kernels.resize(training ? alpha_2 * K : 0, C);
+
+        #pragma omp parallel for collapse(2)
+        for(size_t od = 0; od < K; ++od) {
+            for(size_t id = 0; id < C; ++id) {
+                float_t g[9], rotated[9], u[alpha_2], u_rotated[alpha_2];
+                const size_t k = connections::index(od, id);
+                const bool connected = k != connections::count;
+                for(size_t i = 0; i < 9; ++i) {
+                    g[i] = connected ? layer.w.data()[k * 9 + i] : float_t(0);
+                    rotated[8 - i] = g[i];
+                }
+                detail::winograd_sandwich(transforms::G, g, u);
+                detail::winograd_sandwich(transforms::G, rotated, u_rotated);
+                for(size_t xi = 0; xi < alpha_2; ++xi) {
+                    forward_kernels(xi * C + id, od) = u[xi];
+                    if(training) {
+                        backward_kernels(xi * K + od, id) = u_rotated[xi];
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Layer>
+    void forward_impl(Layer&, tensor_4_view input, tensor_4_view output) {
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        correlate<input_dims::d, input_dims::h, input_dims::w, Layer::geometry::pad_top,
+                  output_dims::d, output_dims::h, output_dims::w>(
+            input.data(), input.dimension(0), forward_kernels, output.data()
+        );
+    }
+
+    template<typename Layer>
+    void backward_input_impl(Layer&, tensor_4_view curr_delta, tensor_4_view prev_delta) {
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        correlate<output_dims::d, output_dims::h, output_dims::w, 2 - Layer::geometry::pad_top,
+                  input_dims::d, input_dims::h, input_dims::w>(
+            curr_delta.data(), curr_delta.dimension(0), backward_kernels, prev_delta.data()
+        );
+    }
+
+    template<typename Layer>
+    void backward_weights_impl(Layer& layer, tensor_4_view prev_out, tensor_4_view curr_delta) {
+        weights_engine.backward_weights(layer, prev_out, curr_delta);
+    }
+
+private:
+
+    /**
+     * \brief Accumulates the correlation of the (samples, C, H, W) input,
+     *        zero padded by Pad on every side, with the transformed kernels
+     *        into the (samples, K, P, Q) output
+     *
+     * The transformed tiles and products are stored as alpha^2 consecutive
+     * (tiles x C) and (tiles x K) matrices.
+     */
+    template<size_t C, size_t H, size_t W, size_t Pad, size_t K, size_t P, size_t Q>
+    void correlate(const float_t* in, const size_t& samples, const row_matrix& kernels, float_t* out) {
+
+        constexpr size_t tiles_h = (P + M - 1) / M;
+        constexpr size_t tiles_w = (Q + M - 1) / M;
+        constexpr size_t tiles_per_sample = tiles_h * tiles_w;
+
+        const size_t tiles = samples * tiles_per_sample;
+        const size_t block_tiles = std::clamp<size_t>(
+            tile_buffer_limit / (alpha_2 * std::max(C, K)),
+            1,
+            std::max<size_t>(tiles, 1)
+        );
+
+        if(static_cast<size_t>(transformed.size()) < alpha_2 * C * block_tiles) {
+            transformed.resize(alpha_2 * block_tiles, C);
+        }
+        if(static_cast<size_t>(products.size()) < alpha_2 * K * block_tiles) {
+            products.resize(alpha_2 * block_tiles, K);
+        }
+
+        for(size_t t0 = 0; t0 < tiles; t0 += block_tiles) {
+            const size_t n = std::min(block_tiles, tiles - t0);
+            row_matrix_map V(transformed.data(), alpha_2 * n, C);
+            row_matrix_map Y(products.data(), alpha_2 * n, K);
+
+            /* Input transform, V = BT d B */
+            #pragma omp parallel for
+            for(size_t t = 0; t < n; ++t) {
+                const size_t tile = t0 + t;
+                const size_t s = tile / tiles_per_sample;
+                const size_t ty = (tile % tiles_per_sample) / tiles_w;
+                const size_t tx = tile % tiles_w;
+                /* Top left corner of the tile in the unpadded input */
+                const long y0 = static_cast<long>(ty * M) - static_cast<long>(Pad);
+                const long x0 = static_cast<long>(tx * M) - static_cast<long>(Pad);
+                const bool interior = y0 >= 0 && x0 >= 0
+                        && y0 + static_cast<long>(alpha) <= static_cast<long>(H)
+                        && x0 + static_cast<long>(alpha) <= static_cast<long>(W);
+                float_t* v_tile = V.data() + t * C;
+                for(size_t c0 = 0; c0 < C; c0 += channel_block) {
+                    const size_t cn = std::min(channel_block, C - c0);
+                    float_t v[alpha_2][channel_block];
+                    for(size_t c = 0; c < cn; ++c) {
+                        const float_t* channel = in + (s * C + c0 + c) * H * W;
+                        float_t d[alpha_2], vc[alpha_2];
+                        if(interior) {
+                            for(size_t y = 0; y < alpha; ++y) {
+                                for(size_t x = 0; x < alpha; ++x) {
+                                    d[y * alpha + x] = channel[(y0 + y) * W + x0 + x];
+                                }
+                            }
+                        } else {
+                            for(size_t y = 0; y < alpha; ++y) {
+                                const long iy = y0 + static_cast<long>(y);
+                                for(size_t x = 0; x < alpha; ++x) {
+                                    const long ix = x0 + static_cast<long>(x);
+                                    const bool inside = iy >= 0 && ix >= 0
+                                            && iy < static_cast<long>(H) && ix < static_cast<long>(W);
+                                    d[y * alpha + x] = inside ? channel[iy * W + ix] : float_t(0);
+                                }
+                            }
+                        }
+                        detail::winograd_sandwich(transforms::BT, d, vc);
+                        for(size_t xi = 0; xi < alpha_2; ++xi) {
+                            v[xi][c] = vc[xi];
+                        }
+                    }
+                    for(size_t xi = 0; xi < alpha_2; ++xi) {
+                        std::copy(v[xi], v[xi] + cn, v_tile + xi * n * C + c0);
+                    }
+                }
+            }
+
+            /* Sum of element-wise products over the input depth */
+            #pragma omp parallel for
+            for(size_t xi = 0; xi < alpha_2; ++xi) {
+                Y.middleRows(xi * n, n).noalias() =
+                    V.middleRows(xi * n, n) * kernels.middleRows(xi * C, C);
+            }
+
+            /* Output transform, O = AT y A */
+            #pragma omp parallel for
+            for(size_t t = 0; t < n; ++t) {
+                const size_t tile = t0 + t;
+                const size_t s = tile / tiles_per_sample;
+                const size_t ty = (tile % tiles_per_sample) / tiles_w;
+                const size_t tx = tile % tiles_w;
+                const size_t rows = std::min(M, P - ty * M);
+                const size_t cols = std::min(M, Q - tx * M);
+                const float_t* y_tile = Y.data() + t * K;
+                for(size_t k0 = 0; k0 < K; k0 += channel_block) {
+                    const size_t kn = std::min(channel_block, K - k0);
+                    float_t y[alpha_2][channel_block];
+                    for(size_t xi = 0; xi < alpha_2; ++xi) {
+                        std::copy(y_tile + xi * n * K + k0, y_tile + xi * n * K + k0 + kn, y[xi]);
+                    }
+                    for(size_t k = 0; k < kn; ++k) {
+                        float_t yk[alpha_2], o[M * M];
+                        for(size_t xi = 0; xi < alpha_2; ++xi) {
+                            yk[xi] = y[xi][k];
+                        }
+                        detail::winograd_sandwich(transforms::AT, yk, o);
+                        float_t* channel = out + (s * K + k0 + k) * P * Q + ty * M * Q + tx * M;
+                        for(size_t oy = 0; oy < rows; ++oy) {
+                            for(size_t ox = 0; ox < cols; ++ox) {
+                                channel[oy * Q + ox] += o[oy * M + ox];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Transformed kernels for the forward pass, alpha^2 (C x K)
+     */
+    row_matrix forward_kernels;
+
+    /**
+     * Transformed rotated kernels for the input gradient, alpha^2 (K x C)
+     */
+    row_matrix backward_kernels;
+
+    /**
+     * Transformed input tiles, alpha^2 (tiles x C)
+     */
+    row_matrix transformed;
+
+    /**
+     * Element-wise products summed over the input depth, alpha^2 (tiles x K)
+     */
+    row_matrix products;
+
+    /**
+     * Weight gradient engine
+     */
+    im2col_conv_engine weights_engine;
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_LAYER_ENGINE_WINOGRAD_HPP */
@@ -8,25 +8,44 @@
 #ifndef SP_ALGO_NN_LAYER_FULLY_CONNECTED_HPP
 #define SP_ALGO_NN_LAYER_FULLY_CONNECTED_HPP
 
+#include <vector>
+#include <algorithm>
+
+#include "sp/util/parallel.hpp"
 #include "layer.hpp"
 #include "activation.hpp"
+#include "../precision.hpp"
 
 SP_ALGO_NN_NAMESPACE_BEGIN
 
 /**
  * \brief Fully Connected Layer, also known as an inner product layer.
+ *
+ * \tparam Precision storage precision of the weights used by propagation, see
+ *         #precision. With reduced precision the weights w remain the fp32
+ *         master copy updated by the optimizer, saved and loaded, and a
+ *         bf16 or fp16 copy of them is refreshed whenever they change
+ *         (weights_changed), by the optimizer tile by tile while the
+ *         updated tile is in cache. Propagation widens the stored weights
+ *         tile by tile and accumulates in fp32, gradients are always fp32.
+ *
+ *         Forward and input delta propagation read half the weight bytes,
+ *         an update additionally writes the stored copy.
  */
 template<
     typename InputDims,
     size_t OutputSize,
-    bool Biased = true
+    bool Biased = true,
+    typename Precision = fp32_precision
 >
 struct fully_connected_layer : layer<
     InputDims,
     volume_dims<
         OutputSize
     >,
-    fully_connected_layer<InputDims, OutputSize, Biased>
+    fully_connected_layer<InputDims, OutputSize, Biased, Precision>,
+    true,
+    true
 > {
 
     /**
@@ -37,7 +56,9 @@ struct fully_connected_layer : layer<
         volume_dims<
             OutputSize
         >,
-        fully_connected_layer<InputDims, OutputSize, Biased>
+        fully_connected_layer<InputDims, OutputSize, Biased, Precision>,
+        true,
+        true
     >;
 
     /**
@@ -45,6 +66,13 @@ struct fully_connected_layer : layer<
      */
     constexpr static bool biased = Biased;
 
+    /**
+     * \brief Storage precision of the weights
+     */
+    using precision_type = Precision;
+
+    using storage_type = typename precision_type::storage_type;
+
     /**
      * \brief Input Dimensions
      */
@@ -65,78 +93,133 @@ struct fully_connected_layer : layer<
         output_dims::size
     >;
 
-    void forward_prop_impl(tensor_4& input, tensor_4& output) {
+    /**
+     * \brief Back propagation reads the input, not the output, see
+     *        detail::memory_plan
+     */
+    constexpr static bool backward_reads_input = true;
+
+    constexpr static bool backward_reads_output = false;
+
+    /**
+     * \brief Rows and columns of the tiles of stored weights widened at a
+     *        time, a panel of at most 512 KiB per thread to remain in cache
+     */
+    constexpr static size_t panel_rows = std::min<size_t>(256, input_dims::size);
+
+    constexpr static size_t panel_cols = std::min<size_t>(512, output_dims::size);
+
+    constexpr static size_t panel_size = panel_rows * panel_cols;
+
+    /**
+     * \brief Scratch panels of reduced precision propagation are allocated,
+     *        one per thread
+     */
+    void configuration_impl(const size_t& batch_size, bool reset) {
+        this->default_configuration(batch_size, reset);
+        if constexpr(precision_type::reduced) {
+            panels.resize(util::thread_count() * panel_size);
+        }
+    }
+
+    /**
+     * \brief Forward propagation of the whole batch as a single
+     *        (samples x in) * (in x out) matrix product
+     */
+    void forward_prop_impl(tensor_4_view input, tensor_4_view output) {
         /**
          * Number of samples in the input
          */
         const size_t samples = input.dimension(0);
-        /**
-         * Perform forward propagation for every sample
-         */
-        #pragma omp parallel for simd
-        for (size_t si = 0; si < samples; ++si) {
-            for(size_t od = 0; od < output_dims::size; ++od) {
-                for (size_t id = 0; id < input_dims::d; ++id) {
-                    for (size_t iy = 0; iy < input_dims::h; ++iy) {
-                        for (size_t ix = 0; ix < input_dims::w; ++ix) {
-                            output(si, od, 0, 0) += w(id, iy, ix, od) * input(si, id, iy, ix);
-                        }
-                    }
-                }
-                if constexpr(biased) {
-                    output(si, od, 0, 0) += b(od);
+
+        const_row_matrix_map in(input.data(), samples, input_dims::size);
+        row_matrix_map out(output.data(), samples, output_dims::size);
+
+        if constexpr(precision_type::reduced) {
+            /* Column blocks of the output are independent, the rows are summed */
+            constexpr size_t col_blocks = (output_dims::size + panel_cols - 1) / panel_cols;
+            #pragma omp parallel for num_threads(panel_threads()) if(col_blocks > 1)
+            for(size_t cb = 0; cb < col_blocks; ++cb) {
+                const size_t first_col = cb * panel_cols;
+                const size_t cols = std::min(panel_cols, output_dims::size - first_col);
+                for(size_t first_row = 0; first_row < input_dims::size; first_row += panel_rows) {
+                    const size_t rows = std::min(panel_rows, input_dims::size - first_row);
+                    out.middleCols(first_col, cols).noalias() +=
+                            in.middleCols(first_row, rows) * widen_panel(first_row, rows, first_col, cols);
                 }
             }
+        } else {
+            out.noalias() += in * const_row_matrix_map(w.data(), input_dims::size, output_dims::size);
+        }
+
+        if constexpr(biased) {
+            out.rowwise() += Eigen::Map<const Eigen::Matrix<float_t, 1, output_dims::size>>(b.data());
         }
     }
 
     /**
      * \brief Back propagation implementation
      *
-     * \todo Optimize
+     * The input delta is a single (samples x out) * (out x in) product, the
+     * weight gradient a single (in x samples) * (samples x out) product
+     * reduced over the batch into the gradient slot of the calling thread.
      */
-    void backward_prop_impl(    tensor_4& prev_out,
-                                tensor_4& prev_delta,
-                                tensor_4& curr_out,
-                                tensor_4& curr_delta) {
+    void backward_prop_impl(    tensor_4_view prev_out,
+                                tensor_4_view prev_delta,
+                                tensor_4_view curr_out,
+                                tensor_4_view curr_delta) {
         /**
          * Number of samples in the previous output
          */
         const size_t samples = prev_out.dimension(0);
-        /**
-         * Perform back propagation
-         *
-         * For every sample in the input
-         */
-        #pragma omp parallel for simd
-        for (size_t si = 0; si < samples; ++si) {
-            for(size_t od = 0; od < output_dims::size; ++od) {
-                auto& grad = curr_delta(si, od, 0, 0);
-                for (size_t id = 0; id < input_dims::d; ++id) {
-                    for (size_t iy = 0; iy < input_dims::h; ++iy) {
-                        for (size_t ix = 0; ix < input_dims::w; ++ix) {
-                            auto& w_i = w(id, iy, ix, od);
-                            prev_delta(si, id, iy, ix) += grad * w_i;
-                        }
-                    }
-                }
-            }
-            for(size_t od = 0; od < output_dims::size; ++od) {
-                auto& grad = curr_delta(si, od, 0, 0);
-                for (size_t id = 0; id < input_dims::d; ++id) {
-                    for (size_t iy = 0; iy < input_dims::h; ++iy) {
-                        for (size_t ix = 0; ix < input_dims::w; ++ix) {
-                            auto& p_out = prev_out(si, id, iy, ix);
-                            dw(si, id, iy, ix, od) += grad * p_out;
-                        }
-                    }
-                }
-            }
-            if constexpr(biased) {
-                for(size_t od = 0; od < output_dims::size; ++od ) {
-                    db(si, od) += curr_delta(si, od, 0, 0);
+        const size_t slot = detail::gradient_slot(dw);
+
+        const_row_matrix_map in(prev_out.data(), samples, input_dims::size);
+        const_row_matrix_map delta(curr_delta.data(), samples, output_dims::size);
+        row_matrix_map prev(prev_delta.data(), samples, input_dims::size);
+
+        if constexpr(precision_type::reduced) {
+            /* Row blocks of the input delta are independent, the columns are summed */
+            constexpr size_t row_blocks = (input_dims::size + panel_rows - 1) / panel_rows;
+            #pragma omp parallel for num_threads(panel_threads()) if(row_blocks > 1)
+            for(size_t rb = 0; rb < row_blocks; ++rb) {
+                const size_t first_row = rb * panel_rows;
+                const size_t rows = std::min(panel_rows, input_dims::size - first_row);
+                for(size_t first_col = 0; first_col < output_dims::size; first_col += panel_cols) {
+                    const size_t cols = std::min(panel_cols, output_dims::size - first_col);
+                    prev.middleCols(first_row, rows).noalias() +=
+                            delta.middleCols(first_col, cols) * widen_panel(first_row, rows, first_col, cols).transpose();
                 }
             }
+        } else {
+            prev.noalias() += delta * const_row_matrix_map(w.data(), input_dims::size, output_dims::size).transpose();
+        }
+
+        row_matrix_map(dw.data() + slot * w.size(), input_dims::size, output_dims::size).noalias() += in.transpose() * delta;
+
+        if constexpr(biased) {
+            Eigen::Map<Eigen::Matrix<float_t, 1, output_dims::size>>(db.data() + slot * b.size()) += delta.colwise().sum();
+        }
+    }
+
+    /**
+     * \brief Refresh the stored weights from w, called by weights_changed
+     */
+    void store_weights() {
+        if constexpr(precision_type::reduced) {
+            ws.resize(w.size());
+            store_weights(0, ws.size());
+        }
+    }
+
+    /**
+     * \brief Refresh the stored weights [first, first + count) from w, called
+     *        by the optimizer for every tile it has updated
+     */
+    void store_weights(const size_t& first, const size_t& count) {
+        if constexpr(precision_type::reduced) {
+            BOOST_ASSERT_MSG(ws.size() == w.size(), "Stored weights are allocated");
+            detail::to_storage(w.data() + first, ws.data() + first, count);
         }
     }
 
@@ -150,7 +233,7 @@ struct fully_connected_layer : layer<
     /**
      * Weights Delta
      *
-     * Size is (Sample, D_Out, D_in, In_H, In_W)
+     * Size is (Thread, D_Out, D_in, In_H, In_W)
      */
     weights_delta_type dw;
 
@@ -164,10 +247,44 @@ struct fully_connected_layer : layer<
     /**
      * Bias Delta.
      *
-     * Size is (Sample, D_out)
+     * Size is (Thread, D_out)
      */
     bias_delta_type db;
 
+    /**
+     * \brief Weights in storage precision, empty unless the precision is
+     *        reduced
+     */
+    std::vector<storage_type> ws;
+
+protected:
+
+    /**
+     * \brief Threads of reduced precision propagation, one per panel
+     */
+    size_t panel_threads() const {
+        return std::max<size_t>(1, std::min(util::thread_count(), panels.size() / panel_size));
+    }
+
+    /**
+     * \brief Widen the tile (first_row, first_col) of rows x cols stored
+     *        weights into the fp32 panel of the calling thread
+     */
+    const_row_matrix_map widen_panel(const size_t& first_row, const size_t& rows, const size_t& first_col, const size_t& cols) {
+        BOOST_ASSERT_MSG(ws.size() == input_dims::size * output_dims::size, "Stored weights are up to date");
+        BOOST_ASSERT_MSG((util::thread_index() + 1) * panel_size <= panels.size(), "Panel of the thread is allocated");
+        float_t* panel = panels.data() + util::thread_index() * panel_size;
+        for(size_t r = 0; r < rows; ++r) {
+            detail::from_storage(ws.data() + (first_row + r) * output_dims::size + first_col, panel + r * cols, cols);
+        }
+        return const_row_matrix_map(panel, rows, cols);
+    }
+
+    /**
+     * \brief Scratch fp32 panels, panel_size values per thread
+     */
+    std::vector<float_t, Eigen::aligned_allocator<float_t>> panels;
+
 };
 
 SP_ALGO_NN_NAMESPACE_END
@@ -9,13 +9,17 @@
 #ifndef SP_ALGO_NN_LAYER_LAYER_HPP
 #define SP_ALGO_NN_LAYER_LAYER_HPP
 
+#include <algorithm>
 #include <iosfwd>
 #include <boost/assert.hpp>
 #include "../config.hpp"
 #include "../matrix.hpp"
 #include "../types.hpp"
+#include "../layout.hpp"
 #include "params.hpp"
 #include "sp/util/types.hpp"
+#include "sp/util/hints.hpp"
+#include "sp/util/parallel.hpp"
 #include "activation/op.hpp"
 #include "detail/layers.hpp"
 
@@ -77,7 +81,7 @@ struct layer {
      *
      * \param input The input tensor
      */
-    void forward_prop(tensor_4& input, tensor_4& output) {
+    void forward_prop(tensor_4_view input, tensor_4_view output) {
         BOOST_ASSERT_MSG(
             detail::validate_dimensions<input_dims>(input),
             "Dimensions of input matches input dimension"
@@ -94,10 +98,10 @@ struct layer {
      * \param input The input tensor
      * \param output The output tensor
      */
-    void backward_prop(     tensor_4& prev_out,
-                            tensor_4& prev_delta,
-                            tensor_4& curr_out,
-                            tensor_4& curr_delta) {
+    void backward_prop(     tensor_4_view prev_out,
+                            tensor_4_view prev_delta,
+                            tensor_4_view curr_out,
+                            tensor_4_view curr_delta) {
         BOOST_ASSERT_MSG(
             detail::validate_dimensions<input_dims>(prev_out),
             "Dimensions prev_out matches input dimension"
@@ -114,42 +118,166 @@ struct layer {
             detail::validate_dimensions<output_dims>(curr_delta),
             "Dimensions of current_delta matches output dimensions"
         );
+        BOOST_ASSERT_MSG(training(), "Layer is configured for training");
         derived().backward_prop_impl(prev_out, prev_delta, curr_out, curr_delta);
+        accumulated_samples += prev_out.dimension(0);
     }
 
+    /**
+     * Feed forward propagation of activations in the channel blocked
+     * layout, see #nchwc_layout. Requires detail::supports_blocked_layout_v
+     */
+    template<size_t Block>
+    void forward_prop_blocked(tensor_4_view input, tensor_4_view output) {
+        static_assert(detail::supports_blocked_layout_v<derived_type>, "Layer implements the channel blocked layout");
+        BOOST_ASSERT_MSG(
+            (detail::validate_blocked_dimensions<input_dims, Block>(input)),
+            "Dimensions of blocked input matches input dimension"
+        );
+        BOOST_ASSERT_MSG(
+            (detail::validate_blocked_dimensions<output_dims, Block>(output)),
+            "Dimensions of blocked output matches output dimensions"
+        );
+        derived().template forward_blocked_impl<Block>(input, output);
+    }
+
+    /**
+     * Backward propagation of activations and deltas in the channel blocked
+     * layout
+     */
+    template<size_t Block>
+    void backward_prop_blocked( tensor_4_view prev_out,
+                                tensor_4_view prev_delta,
+                                tensor_4_view curr_out,
+                                tensor_4_view curr_delta) {
+        static_assert(detail::supports_blocked_layout_v<derived_type>, "Layer implements the channel blocked layout");
+        BOOST_ASSERT_MSG(
+            (detail::validate_blocked_dimensions<input_dims, Block>(prev_delta)),
+            "Dimensions of blocked prev_delta matches input dimension"
+        );
+        BOOST_ASSERT_MSG(
+            (detail::validate_blocked_dimensions<output_dims, Block>(curr_delta)),
+            "Dimensions of blocked current_delta matches output dimensions"
+        );
+        BOOST_ASSERT_MSG(training(), "Layer is configured for training");
+        derived().template backward_blocked_impl<Block>(prev_out, prev_delta, curr_out, curr_delta);
+        accumulated_samples += prev_out.dimension(0);
+    }
+
+    /**
+     * \brief Apply the gradients of the layer to its weights and biases. The
+     *        caller begins the step of the optimizer (begin_step) once
+     *        before the updates of all layers of the step, as
+     *        parameter_registry::update does.
+     */
     template<typename Optimizer>
     void update_weights(Optimizer& optimizer) {
+        BOOST_ASSERT_MSG(training(), "Layer is configured for training");
         if constexpr (detail::has_weight_and_delta_v<derived_type>) {
-            update_weights(optimizer, wdeltas, derived().dw, derived().w);
+            update_weights(optimizer, derived().dw, derived().w, [this](const size_t& first, const size_t& count) {
+                if constexpr(detail::has_weight_storage_v<derived_type>) {
+                    derived().store_weights(first, count);
+                }
+            });
         }
         if constexpr (detail::has_bias_and_delta_v<derived_type>) {
-            update_weights(optimizer, bdeltas, derived().db, derived().b);
+            update_weights(optimizer, derived().db, derived().b);
         }
         clear_gradients();
+        weights_updated();
     }
 
     /**
-     * \brief Helper funciton which combines delta of the layer into a combined
-     *        state which then applies the combined delta to the updating tensor
+     * \brief Helper function which applies the mean of the gradient slots of
+     *        the layer to the updating tensor, the slots are cleared
      * \tparam optimizer the Optimizing strategy
-     * \tparam combined the tensor to stored the combined delta state of all samples
+     * \tparam delta the per thread gradient slots
      * \tparam updating the sensor that is to be updated via the optimizer
+     * \tparam updated called with the first value and the count of every
+     *         tile of updating once it is updated
+     */
+    template<typename Optimizer, typename FromTensor, typename ToTensor, typename Updated>
+    void update_weights(Optimizer& optimizer, FromTensor& delta, ToTensor& updating, Updated&& updated) {
+        BOOST_ASSERT_MSG(delta.size() == delta.dimension(0) * updating.size(), "Gradient slots match the updating tensor");
+        const float_t reciprocal_batch_size = 1.0f / static_cast<float_t>(std::max<size_t>(accumulated_samples, 1));
+        const auto state = optimizer.tensor_state(&delta, updating.size());
+        detail::apply_gradient_slots(optimizer, updating.data(), delta, state, reciprocal_batch_size, updated);
+    }
+
+    template<typename Optimizer, typename FromTensor, typename ToTensor>
+    void update_weights(Optimizer& optimizer, FromTensor& delta, ToTensor& updating) {
+        update_weights(optimizer, delta, updating, [](const size_t&, const size_t&) {});
+    }
+
+    /**
+     * \brief Sums the per thread gradient slots into the first slot, i.e.
+     *        '''dw.chip(0, 0)''' and '''db.chip(0, 0)''' hold the gradients
+     *        summed over all samples since the last clear_gradients()
+     */
+    void reduce_gradients() {
+        if constexpr (detail::has_weight_and_delta_v<derived_type>) {
+            detail::reduce_gradient_slots(derived().dw);
+        }
+        if constexpr (detail::has_bias_and_delta_v<derived_type>) {
+            detail::reduce_gradient_slots(derived().db);
+        }
+    }
+
+    /**
+     * \brief Copy the weights and biases of another instance of the layer,
+     *        i.e. refresh a replica from the master of data parallel training
+     */
+    void copy_weights(const derived_type& from) {
+        if constexpr (detail::has_weight_and_delta_v<derived_type>) {
+            derived().w = from.w;
+        }
+        if constexpr (detail::has_bias_and_delta_v<derived_type>) {
+            derived().b = from.b;
+        }
+        weights_changed();
+    }
+
+    /**
+     * \brief View the weights and biases of another instance of the layer
+     *        instead of storage of its own, i.e. a replica reading the
+     *        weights of the master of data parallel training. Engine caches
+     *        are left to the caller, see weights_changed.
+     */
+    void share_weights(derived_type& from) {
+        if constexpr (detail::has_weight_and_delta_v<derived_type>) {
+            BOOST_ASSERT_MSG(derived().w.size() == from.w.size(), "Layers are configured");
+            derived().w.map(from.w.data());
+        }
+        if constexpr (detail::has_bias_and_delta_v<derived_type>) {
+            BOOST_ASSERT_MSG(derived().b.size() == from.b.size(), "Layers are configured");
+            derived().b.map(from.b.data());
+        }
+    }
+
+    /**
+     * \brief Move the gradients a replica with a single gradient slot has
+     *        accumulated into the gradient slot of this layer, clearing the
+     *        gradients of the replica. Replicas gathering into distinct slots
+     *        may run concurrently.
      */
-    template<typename Optimizer, typename CombiningTensor, typename FromTensor, typename ToTensor>
-    void update_weights(Optimizer& optimizer, CombiningTensor& combined, FromTensor& delta, ToTensor& updating) {
-        const size_t samples = delta.dimension(0);
-        BOOST_ASSERT(samples >= 1);
-        /* Sum*/
-        combined = delta.chip(0, 0);
-        for(size_t s = 1; s < samples; ++s) {
-            /* add the other delta chips */
-            combined += delta.chip(s, 0);
+    void gather_gradients(derived_type& replica, const size_t& slot) {
+        if constexpr (detail::has_weight_and_delta_v<derived_type>) {
+            gather_gradient_slot(replica.dw, derived().dw, slot);
         }
-        if(samples > 1) {
-            const float_t reciprocal_batch_size = 1.0f / static_cast<float_t>(samples);
-            combined = combined * reciprocal_batch_size;
-        };
-        optimizer.template update(combined, updating);
+        if constexpr (detail::has_bias_and_delta_v<derived_type>) {
+            gather_gradient_slot(replica.db, derived().db, slot);
+        }
+        #pragma omp atomic
+        accumulated_samples += replica.accumulated_samples;
+        replica.clear_gradients();
+    }
+
+    template<typename Tensor>
+    static void gather_gradient_slot(const Tensor& from, Tensor& to, const size_t& slot) {
+        BOOST_ASSERT_MSG(from.dimension(0) == 1, "Replica has a single gradient slot");
+        BOOST_ASSERT_MSG(slot < static_cast<size_t>(to.dimension(0)), "Gradient slot is allocated");
+        const size_t len = from.size();
+        std::copy(from.data(), from.data() + len, to.data() + slot * len);
     }
 
     void clear_gradients() {
@@ -159,13 +287,18 @@ struct layer {
         if constexpr (detail::has_bias_and_delta_v<derived_type>) {
             derived().db.setZero();
         }
+        accumulated_samples = 0;
     }
 
     /**
      * \brief Configures layer. Must be called before use. It is undefined
      *        behavior not to configure a layer before use.
+     *
+     * \param mode in inference mode only the weights and biases are
+     *        allocated, back propagation is not available
      */
-    void configure(const size_t& batch_size, bool reset = false) {
+    void configure(const size_t& batch_size, bool reset = false, network_mode mode = network_mode::training) {
+        this->mode = mode;
         if constexpr(configures_itself) {
             derived().configuration_impl(batch_size, reset);
         } else {
@@ -179,22 +312,64 @@ struct layer {
      * configuration, or alternatively called
      */
     void default_configuration(const size_t& batch_size, bool reset = false) {
+        SP_UNUSED(batch_size);
+        const size_t slots = util::thread_count();
         if constexpr(detail::has_weight_and_delta_v<derived_type>) {
             detail::prepare_weights<typename derived_type::weights_dims>(derived().w);
-            detail::prepare_and_zero_delta_weights<typename derived_type::weights_dims>(batch_size, derived().dw);
+            if(training()) {
+                detail::prepare_and_zero_delta_weights<typename derived_type::weights_dims>(slots, derived().dw);
+            } else {
+                detail::release_tensor(derived().dw);
+            }
             if(reset) {
                 detail::apply_weight_initializer(derived());
             }
         }
         if constexpr(detail::has_bias_and_delta_v<derived_type>) {
             detail::prepare_bias<typename derived_type::output_dims>(derived().b);
-            detail::prepare_and_zero_bias_delta<typename derived_type::output_dims>(batch_size, derived().db);
+            if(training()) {
+                detail::prepare_and_zero_bias_delta<typename derived_type::output_dims>(slots, derived().db);
+            } else {
+                detail::release_tensor(derived().db);
+            }
             if(reset) {
                 detail::apply_bias_initializer(derived());
             }
         }
         /* Always clear gradients */
         clear_gradients();
+        weights_changed();
+    }
+
+    /**
+     * \brief Check if the layer is configured for training, i.e. back
+     *        propagation
+     */
+    bool training() const {
+        return mode == network_mode::training;
+    }
+
+    /**
+     * \brief Notifies the engine of the layer, if any, that the weights have
+     *        been modified, and refreshes the stored weights of reduced
+     *        precision layers
+     */
+    void weights_changed() {
+        if constexpr(detail::has_weight_storage_v<derived_type>) {
+            derived().store_weights();
+        }
+        weights_updated();
+    }
+
+    /**
+     * \brief Notifies the engine of the layer, if any, that the optimizer has
+     *        updated the weights. The stored weights of reduced precision
+     *        layers are refreshed by the update itself, tile by tile.
+     */
+    void weights_updated() {
+        if constexpr(detail::has_engine_v<derived_type>) {
+            derived().engine.weights_changed(derived());
+        }
     }
 
     /**
@@ -218,6 +393,7 @@ struct layer {
                 b.data()[i] = tmp;
             }
         }
+        weights_changed();
     }
 
     /**
@@ -279,14 +455,15 @@ struct layer {
     bool is_trainable;
 
     /**
-     * \brief Temporarily used in combine_grads
+     * \brief Number of samples the gradients have been accumulated over
+     *        since the last clear_gradients()
      */
-    tensor_4 wdeltas;
+    size_t accumulated_samples = 0;
 
     /**
-     * \brief Temporarily used in combine_grads
+     * \brief The mode the layer is configured for
      */
-    tensor_1 bdeltas;
+    network_mode mode = network_mode::training;
 
     /**
      * \brief Customization point for controlling weight initialization strategy of this layer
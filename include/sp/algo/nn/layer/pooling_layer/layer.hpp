@@ -9,8 +9,10 @@
 #ifndef SP_ALGO_NN_LAYER_POOLING_LAYER_HPP
 #define SP_ALGO_NN_LAYER_POOLING_LAYER_HPP
 
+#include <array>
 #include "../params.hpp"
 #include "../layer.hpp"
+#include "../../layout.hpp"
 #include "../detail/layers.hpp"
 #include "op.hpp"
 #include "../../weight.hpp"
@@ -23,6 +25,9 @@ SP_ALGO_NN_NAMESPACE_BEGIN
  *
  * Provides a pluggable point for extensions of the pooling layer.
  *
+ * The forward hooks take a Training flag, bookkeeping only read by back
+ * propagation is compiled out when false (see network_mode::inference).
+ *
  * See mean_pooling_algorithm and max_pooling_algorithm
  */
 template<typename PoolingOperator, typename Derived>
@@ -33,27 +38,28 @@ struct pooling_algorithm {
     using op_type = PoolingOperator;
 
     template<typename InputDims, typename OutputDims, typename KernelParams>
-    void configure(const size_t& samples) {
-        derived().template configure_impl<InputDims, OutputDims, KernelParams>(samples);
+    void configure(const size_t& samples, network_mode mode) {
+        derived().template configure_impl<InputDims, OutputDims, KernelParams>(samples, mode);
     }
 
-    template<typename InputDims, typename OutputDims, typename KernelParams>
+    template<typename InputDims, typename OutputDims, typename KernelParams, bool Training = true>
     void before_forward(const size_t& samples) {
-        derived().template before_forward_impl<InputDims, OutputDims, KernelParams>(samples);
+        derived().template before_forward_impl<InputDims, OutputDims, KernelParams, Training>(samples);
     }
 
+    template<bool Training = true>
     sp_hot auto subsample(          op_type& op,
                                     const size_t& s,
                                     const size_t& d,
                                     const size_t& y,
                                     const size_t& x) {
-        return derived().subsample_impl(op, s, d, y, x);
+        return derived().template subsample_impl<Training>(op, s, d, y, x);
     }
 
     /**
      * Return the upsampled value
      */
-    sp_hot auto upsample(   tensor_4& curr_delta,
+    sp_hot auto upsample(   tensor_4_view curr_delta,
                             const size_t& si,
                             const size_t& od,
                             const size_t& iy,
@@ -61,6 +67,33 @@ struct pooling_algorithm {
         return derived().upsample_impl(curr_delta, si, od, iy, ix);
     }
 
+    template<typename OutputDims, size_t Block, bool Training = true>
+    void before_forward_blocked(const size_t& samples) {
+        derived().template before_forward_blocked_impl<OutputDims, Block, Training>(samples);
+    }
+
+    /**
+     * Return the pooled lanes of a channel block from the Taps input pixel
+     * pointers, offset is the position of the output pixel in the blocked
+     * output tensor
+     */
+    template<size_t Block, size_t Taps, bool Training = true>
+    sp_hot blocked_lanes<Block> subsample_blocked(  const std::array<const float_t*, Taps>& taps,
+                                                    const size_t& offset) {
+        return derived().template subsample_blocked_impl<Block, Taps, Training>(taps, offset);
+    }
+
+    /**
+     * Return the share of the current delta lanes of the output pixel at
+     * offset which is propagated to its tap
+     */
+    template<size_t Block>
+    sp_hot blocked_lanes<Block> upsample_blocked(   const blocked_lanes<Block>& curr_delta,
+                                                    const size_t& offset,
+                                                    const size_t& tap) {
+        return derived().template upsample_blocked_impl<Block>(curr_delta, offset, tap);
+    }
+
     derived_type& derived() {
         return static_cast<derived_type&>(*this);
     }
@@ -128,13 +161,26 @@ struct pooling_layer : layer<
 
     using down_sampler_op_type = typename PoolingAlgorithm::op_type;
 
-    void forward_prop_impl(tensor_4& input, tensor_4& output) {
+    void forward_prop_impl(tensor_4_view input, tensor_4_view output) {
+        if(this->training()) {
+            forward_planes<true>(input, output);
+        } else {
+            forward_planes<false>(input, output);
+        }
+    }
+
+    /**
+     * \brief Forward propagation, with the bookkeeping of back propagation
+     *        when Training
+     */
+    template<bool Training>
+    void forward_planes(tensor_4_view input, tensor_4_view output) {
         /**
          * Number of samples in the input
          */
         const size_t samples = input.dimension(0);
 
-        pooling_algorithm.template before_forward<input_dims, output_dims, kernel_params>(samples);
+        pooling_algorithm.template before_forward<input_dims, output_dims, kernel_params, Training>(samples);
 
         #pragma omp parallel for simd
         for (size_t si = 0; si < samples; ++si) {
@@ -149,7 +195,7 @@ struct pooling_layer : layer<
                                 op.sample(input, si, od, iny+ky, inx+kx);
                             }
                         }
-                        float_t res = pooling_algorithm.subsample(op, si, od, oy, ox);
+                        float_t res = pooling_algorithm.template subsample<Training>(op, si, od, oy, ox);
                         res *= weight;
                         res += bias;
                         output(si, od, oy, ox) = res;
@@ -164,17 +210,18 @@ struct pooling_layer : layer<
      *
      * \todo Optimize
      */
-    void backward_prop_impl(    tensor_4& prev_out,
-                                tensor_4& prev_delta,
-                                tensor_4& curr_out,
-                                tensor_4& curr_delta) {
+    void backward_prop_impl(    tensor_4_view prev_out,
+                                tensor_4_view prev_delta,
+                                tensor_4_view curr_out,
+                                tensor_4_view curr_delta) {
         /**
          * Number of samples in the input
          */
         const size_t samples = prev_out.dimension(0);
 
-        #pragma omp parallel for simd
+        #pragma omp parallel for
         for (size_t si = 0; si < samples; ++si) {
+            const size_t slot = detail::gradient_slot(dw);
             for (size_t d = 0; d < output_dims::d; ++d) {
                 auto& weight = w(d, 0, 0, 0);
                 for (size_t iy = 0; iy < input_dims::h; ++iy) {
@@ -182,22 +229,144 @@ struct pooling_layer : layer<
                         /* Upsample the value from output delta */
                         auto upsampled_cd = pooling_algorithm.upsample(curr_delta, si, d, iy, ix);
                         prev_delta(si, d, iy, ix) += weight * upsampled_cd;
-                        dw(si, d, 0, 0, 0) += prev_out(si, d, iy, ix) * upsampled_cd;
+                        dw(slot, d, 0, 0, 0) += prev_out(si, d, iy, ix) * upsampled_cd;
                     }
                 }
 
                 for (size_t oy = 0; oy < output_dims::h; ++oy) {
                     for (size_t ox = 0; ox < output_dims::w; ++ox) {
-                        db(si, d) += curr_delta(si, d, oy, ox);
+                        db(slot, d) += curr_delta(si, d, oy, ox);
                     }
                 }
             }
         }
     }
 
+    /**
+     * \brief Back propagation reads the input, not the output, see
+     *        detail::memory_plan
+     */
+    constexpr static bool backward_reads_input = true;
+
+    constexpr static bool backward_reads_output = false;
+
+    /**
+     * \brief Channel blocked layout is supported, see #nchwc_layout
+     */
+    constexpr static bool blocked_layout = true;
+
+    /**
+     * \brief Forward propagation in the channel blocked layout, pools the
+     *        Block channels of every output pixel at once
+     */
+    template<size_t Block>
+    void forward_blocked_impl(tensor_4_view input, tensor_4_view output) {
+        if(this->training()) {
+            forward_blocked_planes<Block, true>(input, output);
+        } else {
+            forward_blocked_planes<Block, false>(input, output);
+        }
+    }
+
+    template<size_t Block, bool Training>
+    void forward_blocked_planes(tensor_4_view input, tensor_4_view output) {
+        constexpr size_t blocks = detail::channel_blocks<output_dims::d, Block>;
+        constexpr size_t taps = kernel_params::h * kernel_params::w;
+
+        const size_t samples = input.dimension(0);
+
+        pooling_algorithm.template before_forward_blocked<output_dims, Block, Training>(samples);
+
+        #pragma omp parallel for collapse(2)
+        for (size_t si = 0; si < samples; ++si) {
+            for (size_t cb = 0; cb < blocks; ++cb) {
+                blocked_lanes<Block> weight, bias;
+                blocked_parameters<Block>(cb, weight, bias);
+                const float_t* in = input.data() + detail::blocked_offset<input_dims, Block>(si, cb);
+                const size_t out_offset = detail::blocked_offset<output_dims, Block>(si, cb);
+                for (size_t oy = 0; oy < output_dims::h; ++oy) {
+                    for (size_t ox = 0; ox < output_dims::w; ++ox) {
+                        std::array<const float_t*, taps> tap;
+                        for (size_t ky = 0; ky < kernel_params::h; ++ky) {
+                            for (size_t kx = 0; kx < kernel_params::w; ++kx) {
+                                tap[ky * kernel_params::w + kx] = in
+                                        + ((oy * kernel_params::s_h + ky) * input_dims::w + ox * kernel_params::s_w + kx) * Block;
+                            }
+                        }
+                        const size_t offset = out_offset + (oy * output_dims::w + ox) * Block;
+                        blocked_lanes_map<Block>(output.data() + offset) =
+                                pooling_algorithm.template subsample_blocked<Block, taps, Training>(tap, offset) * weight + bias;
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief Back propagation in the channel blocked layout, scatters the
+     *        current delta of every output pixel to its taps
+     */
+    template<size_t Block>
+    void backward_blocked_impl( tensor_4_view prev_out,
+                                tensor_4_view prev_delta,
+                                tensor_4_view,
+                                tensor_4_view curr_delta) {
+        constexpr size_t blocks = detail::channel_blocks<output_dims::d, Block>;
+
+        const size_t samples = prev_out.dimension(0);
+
+        #pragma omp parallel for collapse(2)
+        for (size_t si = 0; si < samples; ++si) {
+            for (size_t cb = 0; cb < blocks; ++cb) {
+                const size_t slot = detail::gradient_slot(dw);
+                blocked_lanes<Block> weight, bias;
+                blocked_parameters<Block>(cb, weight, bias);
+                blocked_lanes<Block> weight_delta = blocked_lanes<Block>::Zero();
+                blocked_lanes<Block> bias_delta = blocked_lanes<Block>::Zero();
+                const size_t in_offset = detail::blocked_offset<input_dims, Block>(si, cb);
+                const size_t out_offset = detail::blocked_offset<output_dims, Block>(si, cb);
+                for (size_t oy = 0; oy < output_dims::h; ++oy) {
+                    for (size_t ox = 0; ox < output_dims::w; ++ox) {
+                        const size_t offset = out_offset + (oy * output_dims::w + ox) * Block;
+                        const blocked_lanes<Block> cd = const_blocked_lanes_map<Block>(curr_delta.data() + offset);
+                        bias_delta += cd;
+                        for (size_t ky = 0; ky < kernel_params::h; ++ky) {
+                            for (size_t kx = 0; kx < kernel_params::w; ++kx) {
+                                const size_t pos = in_offset
+                                        + ((oy * kernel_params::s_h + ky) * input_dims::w + ox * kernel_params::s_w + kx) * Block;
+                                const blocked_lanes<Block> share =
+                                        pooling_algorithm.template upsample_blocked<Block>(cd, offset, ky * kernel_params::w + kx);
+                                blocked_lanes_map<Block>(prev_delta.data() + pos) += weight * share;
+                                weight_delta += const_blocked_lanes_map<Block>(prev_out.data() + pos) * share;
+                            }
+                        }
+                    }
+                }
+                const size_t lanes = std::min(Block, output_dims::d - cb * Block);
+                for (size_t j = 0; j < lanes; ++j) {
+                    dw(slot, cb * Block + j, 0, 0, 0) += weight_delta(j);
+                    db(slot, cb * Block + j) += bias_delta(j);
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief Packs the per channel weight and bias of channel block cb into
+     *        lanes, padding channels are zero
+     */
+    template<size_t Block>
+    void blocked_parameters(const size_t& cb, blocked_lanes<Block>& weight, blocked_lanes<Block>& bias) {
+        for (size_t j = 0; j < Block; ++j) {
+            const size_t d = cb * Block + j;
+            weight(j) = d < output_dims::d ? w(d, 0, 0, 0) : float_t(0);
+            bias(j) = d < output_dims::d ? b(d) : float_t(0);
+        }
+    }
+
     void configuration_impl(const size_t& batch_size, bool reset) {
         this->default_configuration(batch_size, reset);
-        pooling_algorithm.template configure<input_dims, output_dims, kernel_params>(batch_size);
+        pooling_algorithm.template configure<input_dims, output_dims, kernel_params>(batch_size, this->mode);
     }
 
 
@@ -211,7 +380,7 @@ struct pooling_layer : layer<
     /**
      * Weights Delta
      *
-     * Size is (Sample, D_Out, D_in, H_kernel, W_Kernel)
+     * Size is (Thread, D_Out, D_in, H_kernel, W_Kernel)
      */
     weights_delta_type dw;
 
@@ -225,7 +394,7 @@ struct pooling_layer : layer<
     /**
      * Bias Delta.
      *
-     * Size is (Sample, D_out)
+     * Size is (Thread, D_out)
      */
     bias_delta_type db;
 
@@ -9,6 +9,8 @@
 #ifndef SP_ALGO_NN_LAYER_POOLING_LAYER_MAX_HPP
 #define SP_ALGO_NN_LAYER_POOLING_LAYER_MAX_HPP
 
+#include <algorithm>
+#include <vector>
 #include "op.hpp"
 #include "layer.hpp"
 #include "sp/util/hints.hpp"
@@ -20,35 +22,49 @@ SP_ALGO_NN_NAMESPACE_BEGIN
  */
 struct max_pooling_algorithm : pooling_algorithm<max_pooling_op, max_pooling_algorithm> {
 
+    /**
+     * The location of the maxima is only kept for training
+     */
     template<typename InputDims, typename OutputDims, typename KernelParams>
-    void configure_impl(const size_t& samples) {
-        max.resize(samples, InputDims::d, InputDims::h, InputDims::w);
-        is_max.resize(samples, InputDims::d, InputDims::h, InputDims::w);
+    void configure_impl(const size_t& samples, network_mode mode) {
+        if(mode == network_mode::training) {
+            max.resize(samples, InputDims::d, InputDims::h, InputDims::w);
+            is_max.resize(samples, InputDims::d, InputDims::h, InputDims::w);
+        } else {
+            detail::release_tensor(max);
+            detail::release_tensor(is_max);
+            std::vector<unsigned int>().swap(blocked_argmax);
+        }
     }
 
-    template<typename InputDims, typename OutputDims, typename KernelParams>
-    void before_forward_impl(const size_t& samples) {
-        is_max.setConstant(0.0f);
+    template<typename InputDims, typename OutputDims, typename KernelParams, bool Training>
+    void before_forward_impl(const size_t&) {
+        if constexpr(Training) {
+            is_max.setConstant(0.0f);
+        }
     }
 
+    template<bool Training>
     sp_hot auto subsample_impl(        max_pooling_op& op,
                                     const size_t& s,
                                     const size_t& d,
                                     const size_t& y,
                                     const size_t& x) {
-        /**
-         * Store the max value in max at (si, d, max_y, max_x) to
-         * a tuple of (y, x) (the input origination)
-         */
-        max(s, d, op.input_idx[2], op.input_idx[3]) = { y, x };
-        /**
-         * Set the maximum value
-         */
-        is_max(s, d, op.input_idx[2], op.input_idx[3]) = 1.0f;
+        if constexpr(Training) {
+            /**
+             * Store the max value in max at (si, d, max_y, max_x) to
+             * a tuple of (y, x) (the input origination)
+             */
+            max(s, d, op.input_idx[2], op.input_idx[3]) = { y, x };
+            /**
+             * Set the maximum value
+             */
+            is_max(s, d, op.input_idx[2], op.input_idx[3]) = 1.0f;
+        }
         return op.result();
     }
 
-    sp_hot auto upsample_impl(   tensor_4& curr_delta,
+    sp_hot auto upsample_impl(   tensor_4_view curr_delta,
                             const size_t& s,
                             const size_t& d,
                             const size_t& y,
@@ -60,11 +76,63 @@ struct max_pooling_algorithm : pooling_algorithm<max_pooling_op, max_pooling_alg
         return curr_delta(s, d, max_y, max_x) * is_max(s, d, y, x);
     }
 
+    template<typename OutputDims, size_t Block, bool Training>
+    void before_forward_blocked_impl(const size_t& samples) {
+        if constexpr(Training) {
+            blocked_argmax.resize(samples * detail::channel_blocks<OutputDims::d, Block> * OutputDims::area * Block);
+        }
+    }
+
+    /**
+     * Lane wise maximum of the taps, the tap index of every maximum is
+     * stored in blocked_argmax at the output offset
+     */
+    template<size_t Block, size_t Taps, bool Training>
+    sp_hot blocked_lanes<Block> subsample_blocked_impl(  const std::array<const float_t*, Taps>& taps,
+                                                         const size_t& offset) {
+        blocked_lanes<Block> max_lanes = blocked_lanes<Block>::Constant(std::numeric_limits<float_t>::lowest());
+        if constexpr(Training) {
+            unsigned int* argmax = blocked_argmax.data() + offset;
+            std::fill(argmax, argmax + Block, static_cast<unsigned int>(Taps));
+            for (size_t t = 0; t < Taps; ++t) {
+                for (size_t j = 0; j < Block; ++j) {
+                    if(taps[t][j] > max_lanes(j)) {
+                        max_lanes(j) = taps[t][j];
+                        argmax[j] = t;
+                    }
+                }
+            }
+        } else {
+            for (size_t t = 0; t < Taps; ++t) {
+                max_lanes = max_lanes.max(const_blocked_lanes_map<Block>(taps[t]));
+            }
+        }
+        return max_lanes;
+    }
+
+    template<size_t Block>
+    sp_hot blocked_lanes<Block> upsample_blocked_impl(   const blocked_lanes<Block>& curr_delta,
+                                                         const size_t& offset,
+                                                         const size_t& tap) {
+        const unsigned int* argmax = blocked_argmax.data() + offset;
+        blocked_lanes<Block> share;
+        for (size_t j = 0; j < Block; ++j) {
+            share(j) = argmax[j] == tap ? curr_delta(j) : float_t(0);
+        }
+        return share;
+    }
+
     /**
      * Tensor, rank 4, (si, od, oy, ox), stored tuple of (y, x)
      */
     tensor_n<4, std::tuple<size_t, size_t>> max;
     tensor_n<4, float_t> is_max;
+
+    /**
+     * Tap index of the maximum of every output lane in the channel blocked
+     * layout, the tap count when no input exceeded the initial maximum
+     */
+    std::vector<unsigned int> blocked_argmax;
 };
 
 
@@ -21,15 +21,16 @@ SP_ALGO_NN_NAMESPACE_BEGIN
 struct mean_pooling_algorithm : pooling_algorithm<mean_pooling_op, mean_pooling_algorithm> {
 
     template<typename InputDims, typename OutputDims, typename KernelParams>
-    void configure_impl(const size_t&) {
+    void configure_impl(const size_t&, network_mode) {
         stride_h = KernelParams::s_h;
         stride_w = KernelParams::s_w;
         upsample_scaling = float_t(1.0) / (KernelParams::w * KernelParams::h);
     }
 
-    template<typename InputDims, typename OutputDims, typename KernelParams>
+    template<typename InputDims, typename OutputDims, typename KernelParams, bool Training>
     void before_forward_impl(const size_t&) {}
 
+    template<bool Training>
     sp_hot auto subsample_impl(     mean_pooling_op& op,
                                     const size_t&,
                                     const size_t&,
@@ -38,7 +39,7 @@ struct mean_pooling_algorithm : pooling_algorithm<mean_pooling_op, mean_pooling_
         return op.result();
     }
 
-    sp_hot auto upsample_impl(   tensor_4& curr_delta,
+    sp_hot auto upsample_impl(   tensor_4_view curr_delta,
                             const size_t& s,
                             const size_t& d,
                             const size_t& y,
@@ -46,6 +47,26 @@ struct mean_pooling_algorithm : pooling_algorithm<mean_pooling_op, mean_pooling_
         return curr_delta(s, d, y / stride_h , x / stride_w) * upsample_scaling;
     }
 
+    template<typename OutputDims, size_t Block, bool Training>
+    void before_forward_blocked_impl(const size_t&) {}
+
+    template<size_t Block, size_t Taps, bool Training>
+    sp_hot blocked_lanes<Block> subsample_blocked_impl(  const std::array<const float_t*, Taps>& taps,
+                                                         const size_t&) {
+        blocked_lanes<Block> total = blocked_lanes<Block>::Zero();
+        for (size_t t = 0; t < Taps; ++t) {
+            total += const_blocked_lanes_map<Block>(taps[t]);
+        }
+        return total * (float_t(1.0) / Taps);
+    }
+
+    template<size_t Block>
+    sp_hot blocked_lanes<Block> upsample_blocked_impl(   const blocked_lanes<Block>& curr_delta,
+                                                         const size_t&,
+                                                         const size_t&) {
+        return curr_delta * upsample_scaling;
+    }
+
     size_t stride_h, stride_w;
     float_t upsample_scaling;
 };
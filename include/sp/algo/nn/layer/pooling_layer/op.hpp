@@ -59,7 +59,7 @@ struct mean_pooling_op : pool_op<mean_pooling_op> {
 
     mean_pooling_op(float_t samples_total) : total(0), samples(samples_total) {}
 
-    sp_hot void sample(     const tensor_4& in,
+    sp_hot void sample(     const tensor_4_view& in,
                             const size_t& s,
                             const size_t& d,
                             const size_t& y,
@@ -82,9 +82,9 @@ struct mean_pooling_op : pool_op<mean_pooling_op> {
 struct max_pooling_op : pool_op<max_pooling_op> {
 
     using indices_array = std::array<size_t, 4>;
-    max_pooling_op(float_t /* sample_count, ignore */) : max(std::numeric_limits<float_t>::min()), input_idx() {}
+    max_pooling_op(float_t /* sample_count, ignore */) : max(std::numeric_limits<float_t>::lowest()), input_idx() {}
 
-    sp_hot void sample( const tensor_4& in,
+    sp_hot void sample( const tensor_4_view& in,
                         const size_t& s,
                         const size_t& d,
                         const size_t& y,
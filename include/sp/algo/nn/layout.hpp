@@ -0,0 +1,245 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_LAYOUT_HPP
+#define SP_ALGO_NN_LAYOUT_HPP
+
+#include <algorithm>
+#include <type_traits>
+#include <boost/assert.hpp>
+
+#include "sp/util/types.hpp"
+#include "config.hpp"
+#include "matrix.hpp"
+#include "layer/params.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \file Activation memory layouts of a network
+ *
+ * A layout policy decides how the activations (and their deltas) between
+ * the layers of a network are stored. See #basic_network.
+ */
+
+/**
+ * \brief Plain (N, C, H, W) layout, the default layout of every layer
+ */
+struct nchw_layout {
+
+    constexpr static bool blocked = false;
+
+    constexpr static size_t block = 1;
+};
+
+/**
+ * \brief Channel blocked (N, C / Block, H, W, Block) layout
+ *
+ * Block consecutive channels of a pixel are stored contiguously, such that
+ * kernels vectorize along the channels with full SIMD width. The channel
+ * count is padded to a multiple of Block, the padding lanes are undefined
+ * in activations, zero in deltas and ignored by every layer.
+ *
+ * Stored in a tensor_4 of (N, C / Block, H * W, Block).
+ */
+template<size_t Block>
+struct nchwc_layout {
+
+    static_assert(Block > 0, "Block must be greater than zero");
+
+    constexpr static bool blocked = true;
+
+    constexpr static size_t block = Block;
+};
+
+/**
+ * \brief Channel blocks of a 256 bit vector (AVX2)
+ */
+using nchw8c_layout = nchwc_layout<8>;
+
+/**
+ * \brief Channel blocks of a 512 bit vector (AVX-512)
+ */
+using nchw16c_layout = nchwc_layout<16>;
+
+/**
+ * \brief Channel blocked layout matching the SIMD width of the target
+ */
+#ifdef __AVX512F__
+using native_blocked_layout = nchw16c_layout;
+#else
+using native_blocked_layout = nchw8c_layout;
+#endif
+
+/**
+ * \brief Register lanes of a channel block
+ */
+template<size_t Block>
+using blocked_lanes = Eigen::Array<float_t, Block, 1>;
+
+/**
+ * \brief Map of the Block channels of a pixel as register lanes
+ */
+template<size_t Block>
+using blocked_lanes_map = Eigen::Map<blocked_lanes<Block>, Eigen::Unaligned>;
+
+template<size_t Block>
+using const_blocked_lanes_map = Eigen::Map<const blocked_lanes<Block>, Eigen::Unaligned>;
+
+SP_ALGO_NN_NAMESPACE_END
+
+SP_ALGO_NN_DETAIL_NAMESPACE_BEGIN
+
+/**
+ * \brief Number of channel blocks of Depth channels
+ */
+template<size_t Depth, size_t Block>
+constexpr size_t channel_blocks = (Depth + Block - 1) / Block;
+
+/**
+ * \brief Offset of the channel block cb of sample si in a blocked tensor of
+ *        VolumeDims, the pixels of the block follow with a stride of Block
+ */
+template<typename VolumeDims, size_t Block>
+constexpr size_t blocked_offset(const size_t& si, const size_t& cb) {
+    return (si * channel_blocks<VolumeDims::d, Block> + cb) * VolumeDims::area * Block;
+}
+
+/**
+ * \brief Initializes a blocked tensor of VolumeDims and zeroes it
+ */
+template<typename VolumeDims, size_t Block>
+void prepare_blocked_tensor(const size_t& samples, tensor_4& tens) {
+    static_assert(util::is_instantiation_of_v<VolumeDims, volume_dims>, "VolumeDims is an instantiation of volume_dims");
+    tens.resize(samples, channel_blocks<VolumeDims::d, Block>, VolumeDims::area, Block);
+    tens.setZero();
+}
+
+/**
+ * \brief Validate that the blocked tensor matches the volume expected. Note
+ *        that it does not consider sample index
+ */
+template<typename VolumeDimsExpected, size_t Block>
+bool validate_blocked_dimensions(const tensor_4_view& t) {
+    auto& dims = t.dimensions();
+    return      static_cast<size_t>(dims[1]) == channel_blocks<VolumeDimsExpected::d, Block> &&
+                static_cast<size_t>(dims[2]) == VolumeDimsExpected::area &&
+                static_cast<size_t>(dims[3]) == Block;
+}
+
+/**
+ * \brief Reorder a plain (N, C, H, W) tensor into the blocked layout,
+ *        padding channels are zeroed
+ */
+template<typename VolumeDims, size_t Block>
+void to_blocked(const tensor_4_view& plain, tensor_4_view blocked) {
+    constexpr size_t blocks = channel_blocks<VolumeDims::d, Block>;
+    const size_t samples = plain.dimension(0);
+    BOOST_ASSERT_MSG(
+        (static_cast<size_t>(blocked.dimension(0)) == samples && validate_blocked_dimensions<VolumeDims, Block>(blocked)),
+        "Blocked dimensions match the plain tensor"
+    );
+    #pragma omp parallel for collapse(2)
+    for(size_t si = 0; si < samples; ++si) {
+        for(size_t cb = 0; cb < blocks; ++cb) {
+            float_t* dst = blocked.data() + blocked_offset<VolumeDims, Block>(si, cb);
+            const size_t lanes = std::min(Block, VolumeDims::d - cb * Block);
+            for(size_t p = 0; p < VolumeDims::area; ++p) {
+                for(size_t j = 0; j < Block; ++j) {
+                    dst[p * Block + j] = j < lanes
+                            ? plain.data()[(si * VolumeDims::d + cb * Block + j) * VolumeDims::area + p]
+                            : float_t(0);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * \brief Reorder a blocked tensor into the plain (N, C, H, W) layout,
+ *        padding channels are dropped
+ */
+template<typename VolumeDims, size_t Block>
+void from_blocked(const tensor_4_view& blocked, tensor_4_view plain) {
+    constexpr size_t blocks = channel_blocks<VolumeDims::d, Block>;
+    const size_t samples = blocked.dimension(0);
+    BOOST_ASSERT_MSG(
+        static_cast<size_t>(plain.dimension(0)) == samples && static_cast<size_t>(plain.size()) == samples * VolumeDims::size,
+        "Plain dimensions match the blocked tensor"
+    );
+    #pragma omp parallel for collapse(2)
+    for(size_t si = 0; si < samples; ++si) {
+        for(size_t cb = 0; cb < blocks; ++cb) {
+            const float_t* src = blocked.data() + blocked_offset<VolumeDims, Block>(si, cb);
+            const size_t lanes = std::min(Block, VolumeDims::d - cb * Block);
+            for(size_t j = 0; j < lanes; ++j) {
+                float_t* dst = plain.data() + (si * VolumeDims::d + cb * Block + j) * VolumeDims::area;
+                for(size_t p = 0; p < VolumeDims::area; ++p) {
+                    dst[p] = src[p * Block + j];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * \brief Reorder a plain tensor into the blocked layout, resizing the owned
+ *        blocked tensor if needed
+ */
+template<typename VolumeDims, size_t Block>
+void to_blocked(const tensor_4_view& plain, tensor_4& blocked) {
+    const size_t samples = plain.dimension(0);
+    if(static_cast<size_t>(blocked.dimension(0)) != samples || !validate_blocked_dimensions<VolumeDims, Block>(blocked)) {
+        blocked.resize(samples, channel_blocks<VolumeDims::d, Block>, VolumeDims::area, Block);
+    }
+    to_blocked<VolumeDims, Block>(plain, tensor_4_view(blocked));
+}
+
+/**
+ * \brief Reorder a blocked tensor into the plain layout, resizing the owned
+ *        plain tensor if needed
+ */
+template<typename VolumeDims, size_t Block>
+void from_blocked(const tensor_4_view& blocked, tensor_4& plain) {
+    const size_t samples = blocked.dimension(0);
+    if(static_cast<size_t>(plain.dimension(0)) != samples || static_cast<size_t>(plain.size()) != samples * VolumeDims::size) {
+        plain.resize(samples, VolumeDims::d, VolumeDims::h, VolumeDims::w);
+    }
+    from_blocked<VolumeDims, Block>(blocked, tensor_4_view(plain));
+}
+
+template<typename T, typename EnableIf = void>
+struct supports_blocked_layout : std::false_type {};
+
+template<typename T>
+struct supports_blocked_layout<T, std::enable_if_t<T::blocked_layout>> : std::true_type {};
+
+/**
+ * \brief Check if a layer has kernels operating natively on the channel
+ *        blocked layout, i.e. implements
+ *        '''forward_blocked_impl<Block>(input, output)''' and
+ *        '''backward_blocked_impl<Block>(prev_out, prev_delta, curr_out, curr_delta)'''
+ */
+template<typename Layer>
+constexpr bool supports_blocked_layout_v = supports_blocked_layout<Layer>::value;
+
+/**
+ * \brief Number of leading layers supporting the channel blocked layout,
+ *        i.e. the layers of a network operating on blocked activations
+ */
+template<typename... Layers>
+constexpr size_t blocked_prefix() {
+    size_t count = 0;
+    bool blocked = true;
+    ((blocked = blocked && supports_blocked_layout_v<Layers>, count += blocked ? 1 : 0), ...);
+    return count;
+}
+
+SP_ALGO_NN_DETAIL_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_LAYOUT_HPP */
@@ -8,3 +8,4 @@
 
 #include "loss/gradient.hpp"
 #include "loss/mean_square_error.hpp"
+#include "loss/cross_entropy.hpp"
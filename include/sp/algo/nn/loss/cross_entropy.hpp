@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+#ifndef SP_ALGO_NN_LOSS_CROSS_ENTROPY_HPP
+#define SP_ALGO_NN_LOSS_CROSS_ENTROPY_HPP
+
+#include <boost/assert.hpp>
+#include "../config.hpp"
+#include "../matrix.hpp"
+#include "../types.hpp"
+#include "sp/util/hints.hpp"
+
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Smallest predicted probability, the logarithm of zero is not taken
+ */
+constexpr float_t cross_entropy_epsilon = 1e-7f;
+
+/**
+ * \brief Cross Entropy Derivative, with respect to the predicted
+ *        probabilities
+ */
+struct cross_entropy_derivative {
+
+    sp_hot void operator()(         const size_t& si,
+                                    const tensor_4_view& predicted,
+                                    const tensor_4_view& observed,
+                                    tensor_4_view result) {
+
+        BOOST_ASSERT(predicted.dimensions() == observed.dimensions());
+
+        result.chip(si, 0) = -observed.chip(si, 0) / predicted.chip(si, 0).cwiseMax(cross_entropy_epsilon);
+    }
+};
+
+/**
+ * \brief Cross Entropy Derivative, with respect to the input of a softmax
+ *        producing the predicted probabilities
+ *
+ * The Jacobian of the softmax and the derivative of the loss cancel to
+ * predicted - observed, given the observed values of a sample sum to one
+ * (e.g. one hot labels).
+ */
+struct softmax_cross_entropy_derivative {
+
+    sp_hot void operator()(         const size_t& si,
+                                    const tensor_4_view& predicted,
+                                    const tensor_4_view& observed,
+                                    tensor_4_view result) {
+
+        BOOST_ASSERT(predicted.dimensions() == observed.dimensions());
+
+        result.chip(si, 0) = predicted.chip(si, 0) - observed.chip(si, 0);
+    }
+};
+
+/**
+ * \brief Cross Entropy, of a predicted distribution (i.e. softmax output)
+ *
+ * Fused with a softmax output layer, see basic_network::backward
+ */
+struct cross_entropy {
+
+    using derivative_type = cross_entropy_derivative;
+
+    using softmax_derivative_type = softmax_cross_entropy_derivative;
+
+    auto operator()(                    const size_t& si,
+                                        const tensor_4_view& predicted,
+                                        const tensor_4_view& observed) {
+        BOOST_ASSERT(predicted.dimensions() == observed.dimensions());
+
+        tensor_0 d = -(
+            observed.chip(si, 0) * predicted.chip(si, 0).cwiseMax(cross_entropy_epsilon).log()
+        ).sum();
+
+        return d(0);
+    }
+
+    derivative_type derivative;
+
+    softmax_derivative_type softmax_derivative;
+};
+
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_LOSS_CROSS_ENTROPY_HPP */
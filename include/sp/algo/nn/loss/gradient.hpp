@@ -8,6 +8,7 @@
 #ifndef SP_ALGO_NN_LOSS_GRADIENT_HPP
 #define SP_ALGO_NN_LOSS_GRADIENT_HPP
 
+#include <type_traits>
 #include <boost/assert.hpp>
 #include "../config.hpp"
 #include "../matrix.hpp"
@@ -26,7 +27,7 @@ SP_ALGO_NN_NAMESPACE_BEGIN
  *        a mini-batch
  */
 template<typename LossFunction>
-void gradient(LossFunction& loss, tensor_4& predicted, tensor_4& expected, tensor_4& result) {
+void gradient(LossFunction& loss, tensor_4_view predicted, tensor_4_view expected, tensor_4_view result) {
     BOOST_ASSERT_MSG(
         predicted.dimensions() == expected.dimensions(),
         "Dimensions of Expected and Actual must match"
@@ -37,6 +38,36 @@ void gradient(LossFunction& loss, tensor_4& predicted, tensor_4& expected, tenso
     }
 }
 
+/**
+ * \brief Calculate the gradient of a mini-batch with respect to the input of
+ *        a softmax output layer, for losses fused with softmax (see
+ *        has_softmax_derivative)
+ */
+template<typename LossFunction>
+void softmax_gradient(LossFunction& loss, tensor_4_view predicted, tensor_4_view expected, tensor_4_view result) {
+    BOOST_ASSERT_MSG(
+        predicted.dimensions() == expected.dimensions(),
+        "Dimensions of Expected and Actual must match"
+    );
+    const size_t sample_count = predicted.dimension(0);
+    for(size_t si = 0; si < sample_count; ++si) {
+        loss.softmax_derivative(si, predicted, expected, result);
+    }
+}
+
+/**
+ * \brief Whether the loss provides its derivative with respect to the input
+ *        of a softmax (softmax_derivative)
+ */
+template<typename LossFunction, typename = void>
+struct has_softmax_derivative : std::false_type {};
+
+template<typename LossFunction>
+struct has_softmax_derivative<LossFunction, std::void_t<typename LossFunction::softmax_derivative_type>> : std::true_type {};
+
+template<typename LossFunction>
+constexpr bool has_softmax_derivative_v = has_softmax_derivative<LossFunction>::value;
+
 SP_ALGO_NN_NAMESPACE_END
 
 #endif	/* SP_ALGO_NN_LOSS_GRADIENT_HPP */
@@ -23,9 +23,9 @@ SP_ALGO_NN_NAMESPACE_BEGIN
 struct mean_square_error_derivative {
 
     sp_hot void operator()(         const size_t& si,
-                                    const tensor_4& predicted,
-                                    const tensor_4& observed,
-                                    tensor_4& result) {
+                                    const tensor_4_view& predicted,
+                                    const tensor_4_view& observed,
+                                    tensor_4_view result) {
 
         BOOST_ASSERT(predicted.dimensions() == observed.dimensions());
 
@@ -45,8 +45,8 @@ struct mean_square_error {
     using derivative_type = mean_square_error_derivative;
 
     auto operator()(                    const size_t& si,
-                                        const tensor_4& predicted,
-                                        const tensor_4& observed) {
+                                        const tensor_4_view& predicted,
+                                        const tensor_4_view& observed) {
         BOOST_ASSERT(predicted.dimensions() == observed.dimensions());
 
         tensor_0 d = (
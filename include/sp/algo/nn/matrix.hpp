@@ -11,6 +11,9 @@
 
 #include "config.hpp"
 
+#include <new>
+#include <type_traits>
+#include <vector>
 #include <eigen3/Eigen/Dense>
 #include <eigen3/Eigen/Sparse>
 #include <eigen3/unsupported/Eigen/CXX11/Tensor>
@@ -43,6 +46,21 @@ using vector_fixed = Eigen::Matrix<float_t, size, 1>;
 
 using vector = Eigen::Matrix<float_t, Eigen::Dynamic, 1>;
 
+/**
+ * Dynamic row major matrix typedef, matches the memory layout of tensors
+ */
+using row_matrix = Eigen::Matrix<float_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+/**
+ * Row major matrix view of existing (i.e. tensor) memory
+ */
+using row_matrix_map = Eigen::Map<row_matrix, Eigen::Unaligned>;
+
+/**
+ * Constant row major matrix view of existing (i.e. tensor) memory
+ */
+using const_row_matrix_map = Eigen::Map<const row_matrix, Eigen::Unaligned>;
+
 template<typename ... Parameters>
 using tensor_base = Eigen::TensorBase<Parameters...>;
 
@@ -75,6 +93,13 @@ using tensor_4 = tensor_n<4>;
  */
 using tensor_4_ref = tensor_n_ref<4>;
 
+/**
+ * Tensor view, Rank 4. Non-owning view of a tensor_4 or of (aligned) memory
+ * of a network arena, implicitly constructible from a tensor_4. Passed by
+ * value, assignment copies the elements.
+ */
+using tensor_4_view = Eigen::TensorMap<tensor_4, Eigen::Aligned>;
+
 /**
  * Tensor, Rank 3,
  *
@@ -116,6 +141,111 @@ using tensor_0 = tensor_n<0>;
  */
 using tensor_0_ref = tensor_n_ref<0>;
 
+/**
+ * \brief Tensor of trainable parameters (weights, biases and their gradients)
+ *
+ * Owns its elements like a tensor_n until bound to external memory, e.g. the
+ * arenas of a parameter_registry, from then on it is a view of that memory.
+ * Copies always own their elements. Resizing a bound tensor to another shape
+ * of the same size keeps it bound, any other size returns it to storage of
+ * its own.
+ */
+template<size_t Rank>
+struct parameter_tensor : Eigen::TensorMap<tensor_n<Rank>, Eigen::Aligned> {
+
+    using base_type = Eigen::TensorMap<tensor_n<Rank>, Eigen::Aligned>;
+    using dimensions_type = typename base_type::Dimensions;
+
+    parameter_tensor() : base_type(nullptr, dimensions_type()) {}
+
+    template<typename... Indices, typename = std::enable_if_t<(std::is_integral_v<Indices> && ...)>>
+    explicit parameter_tensor(Indices... dims) : parameter_tensor() {
+        resize(dims...);
+    }
+
+    parameter_tensor(const parameter_tensor& other) : base_type(nullptr, dimensions_type()) {
+        *this = other;
+    }
+
+    parameter_tensor& operator=(const parameter_tensor& other) {
+        if(this != &other) {
+            resize(other.dimensions());
+            std::copy(other.data(), other.data() + other.size(), this->data());
+        }
+        return *this;
+    }
+
+    /**
+     * \brief Assign a tensor expression of the same dimensions
+     */
+    template<typename Other>
+    parameter_tensor& operator=(const Other& other) {
+        base_type::operator=(other);
+        return *this;
+    }
+
+    template<typename... Indices>
+    void resize(Indices... dims) {
+        resize(dimensions_type(static_cast<Eigen::DenseIndex>(dims)...));
+    }
+
+    void resize(const dimensions_type& dims) {
+        const size_t size = dims.TotalSize();
+        if(bound && size == static_cast<size_t>(this->size())) {
+            rebind(this->data(), dims, true);
+            return;
+        }
+        if(size != owned.size()) {
+            owned.resize(size);
+        }
+        rebind(owned.data(), dims, false);
+    }
+
+    /**
+     * \brief View size() elements at data instead, the current elements are
+     *        copied there. data is aligned as an Eigen::Aligned map requires.
+     */
+    void bind(float_t* data) {
+        std::copy(this->data(), this->data() + this->size(), data);
+        owned = storage_type();
+        rebind(data, this->dimensions(), true);
+    }
+
+    /**
+     * \brief View size() elements at data, which hold the values already
+     *        (e.g. a mapped checkpoint), the current elements are released
+     */
+    void map(float_t* data) {
+        owned = storage_type();
+        rebind(data, this->dimensions(), true);
+    }
+
+    /**
+     * \brief Whether the elements are external memory, see bind and map
+     */
+    bool is_bound() const {
+        return bound;
+    }
+
+private:
+
+    using storage_type = std::vector<float_t, Eigen::aligned_allocator<float_t>>;
+
+    static_assert(std::is_trivially_destructible_v<base_type>, "The map holds a pointer and dimensions only");
+
+    /**
+     * \brief Assigning a map copies elements, the map (the base subobject
+     *        only) is constructed anew instead, which does not throw
+     */
+    void rebind(float_t* data, const dimensions_type& dims, bool external) {
+        new (static_cast<base_type*>(this)) base_type(data, dims);
+        bound = external;
+    }
+
+    storage_type owned;
+    bool bound = false;
+};
+
 /**
  * \brief Convert a tensor (rank 2) to a matrix
  */
@@ -144,6 +274,32 @@ auto as_tensor(matrix& mat) {
 
 SP_ALGO_NN_NAMESPACE_END
 
+/**
+ * parameter_tensor is evaluated as the TensorMap it derives from
+ */
+namespace Eigen {
+namespace internal {
+
+template<size_t Rank>
+struct traits<sp::algo::nn::parameter_tensor<Rank>> :
+    traits<TensorMap<sp::algo::nn::tensor_n<Rank>, Aligned>> {};
+
+} // namespace internal
+
+template<size_t Rank, typename Device>
+struct TensorEvaluator<sp::algo::nn::parameter_tensor<Rank>, Device> :
+        TensorEvaluator<TensorMap<sp::algo::nn::tensor_n<Rank>, Aligned>, Device> {
+    using TensorEvaluator<TensorMap<sp::algo::nn::tensor_n<Rank>, Aligned>, Device>::TensorEvaluator;
+};
+
+template<size_t Rank, typename Device>
+struct TensorEvaluator<const sp::algo::nn::parameter_tensor<Rank>, Device> :
+        TensorEvaluator<const TensorMap<sp::algo::nn::tensor_n<Rank>, Aligned>, Device> {
+    using TensorEvaluator<const TensorMap<sp::algo::nn::tensor_n<Rank>, Aligned>, Device>::TensorEvaluator;
+};
+
+} // namespace Eigen
+
 #endif	/* SP_ALGO_NN_MATRIX_HPP */
 
 
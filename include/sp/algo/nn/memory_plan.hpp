@@ -0,0 +1,218 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_MEMORY_PLAN_HPP
+#define SP_ALGO_NN_MEMORY_PLAN_HPP
+
+#include <array>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <algorithm>
+#include <type_traits>
+
+#include "config.hpp"
+#include "matrix.hpp"
+
+/**
+ * \file Static activation memory planning of a network
+ *
+ * The values and deltas between the layers of a network live in a single
+ * aligned arena. Every buffer is touched on a timeline of 2 * S steps for S
+ * stages: the forward propagation of stage s is step s and its back
+ * propagation step 2 * S - 1 - s. Buffers whose lifetimes (first to last
+ * touching step) do not overlap share memory. The lifetimes, sizes and
+ * offsets (per sample) are computed at compile time, the network scales the
+ * offsets by the batch size when it is configured.
+ */
+
+SP_ALGO_NN_DETAIL_NAMESPACE_BEGIN
+
+/**
+ * \brief Alignment of the arena and of every buffer in it, in bytes
+ */
+constexpr size_t arena_alignment = 64;
+
+/**
+ * \brief Floats per sample of a buffer, padded to the arena alignment
+ */
+constexpr size_t arena_padded(const size_t& floats) {
+    constexpr size_t granule = arena_alignment / sizeof(float_t);
+    return (floats + granule - 1) / granule * granule;
+}
+
+template<typename T, typename EnableIf = void>
+struct backward_reads_input : std::true_type {};
+
+template<typename T>
+struct backward_reads_input<T, std::void_t<decltype(T::backward_reads_input)>> : std::bool_constant<T::backward_reads_input> {};
+
+template<typename T, typename EnableIf = void>
+struct backward_reads_output : std::true_type {};
+
+template<typename T>
+struct backward_reads_output<T, std::void_t<decltype(T::backward_reads_output)>> : std::bool_constant<T::backward_reads_output> {};
+
+/**
+ * \brief Check if the back propagation of a layer reads its input (previous
+ *        output), layers not declaring '''backward_reads_input''' are
+ *        assumed to
+ */
+template<typename Layer>
+constexpr bool backward_reads_input_v = backward_reads_input<Layer>::value;
+
+/**
+ * \brief Check if the back propagation of a layer reads its output, layers
+ *        not declaring '''backward_reads_output''' are assumed to
+ */
+template<typename Layer>
+constexpr bool backward_reads_output_v = backward_reads_output<Layer>::value;
+
+/**
+ * \brief Steps of the timeline a buffer is touched at, from first to last
+ */
+struct buffer_lifetime {
+
+    constexpr void touch(const size_t& step) {
+        first = touched ? std::min(first, step) : step;
+        last = touched ? std::max(last, step) : step;
+        touched = true;
+    }
+
+    constexpr bool overlaps(const buffer_lifetime& other) const {
+        return touched && other.touched && first <= other.last && other.first <= last;
+    }
+
+    size_t first = 0;
+    size_t last = 0;
+    bool touched = false;
+};
+
+/**
+ * \brief Memory plan of the values and deltas of a network of Layers
+ *        layers, all sizes and offsets are in floats per sample
+ *
+ * Buffers: values [0, Layers], deltas [0, Layers] followed by the blocked
+ * boundary value and delta (see #basic_network).
+ */
+template<size_t Layers>
+struct memory_plan {
+
+    constexpr static size_t buffers = 2 * (Layers + 1) + 2;
+
+    constexpr static size_t boundary_value = 2 * (Layers + 1);
+
+    constexpr static size_t boundary_delta = boundary_value + 1;
+
+    constexpr static size_t value(const size_t& i) {
+        return i;
+    }
+
+    constexpr static size_t delta(const size_t& i) {
+        return Layers + 1 + i;
+    }
+
+    constexpr void touch(const size_t& buffer, const size_t& step) {
+        lifetime[buffer].touch(step);
+    }
+
+    /**
+     * \brief Assign offsets by greedy first fit, largest buffers first. A
+     *        buffer never touched may alias any other buffer.
+     */
+    constexpr void allocate() {
+        std::array<size_t, buffers> order{};
+        for(size_t i = 0; i < buffers; ++i) {
+            order[i] = i;
+        }
+        /* Stable insertion sort, descending size */
+        for(size_t i = 1; i < buffers; ++i) {
+            for(size_t j = i; j > 0 && size[order[j - 1]] < size[order[j]]; --j) {
+                const size_t tmp = order[j];
+                order[j] = order[j - 1];
+                order[j - 1] = tmp;
+            }
+        }
+
+        std::array<bool, buffers> placed{};
+        arena = 0;
+        unshared = 0;
+        for(size_t n = 0; n < buffers; ++n) {
+            const size_t b = order[n];
+            size_t candidate = 0;
+            for(bool moved = true; moved; ) {
+                moved = false;
+                for(size_t p = 0; p < buffers; ++p) {
+                    if(     placed[p] && lifetime[p].overlaps(lifetime[b]) &&
+                            candidate < offset[p] + size[p] && offset[p] < candidate + size[b]) {
+                        candidate = offset[p] + size[p];
+                        moved = true;
+                    }
+                }
+            }
+            offset[b] = candidate;
+            placed[b] = true;
+            arena = std::max(arena, candidate + size[b]);
+            unshared += size[b];
+        }
+    }
+
+    std::array<size_t, buffers> size{};
+    std::array<size_t, buffers> offset{};
+    std::array<buffer_lifetime, buffers> lifetime{};
+
+    /**
+     * \brief Size of the arena, i.e. the planned peak
+     */
+    size_t arena = 0;
+
+    /**
+     * \brief Sum of the sizes of all buffers, i.e. the peak without planning
+     */
+    size_t unshared = 0;
+};
+
+/**
+ * \brief Aligned storage of the arena, only grows
+ */
+struct arena_storage {
+
+    /**
+     * \brief Ensure room for floats and zero them. Allocates only if the
+     *        arena grows.
+     */
+    void prepare(const size_t& floats) {
+        if(floats > capacity) {
+            const size_t bytes = arena_padded(floats) * sizeof(float_t);
+            float_t* ptr = static_cast<float_t*>(std::aligned_alloc(arena_alignment, bytes));
+            if(!ptr) {
+                throw std::bad_alloc();
+            }
+            storage.reset(ptr);
+            capacity = floats;
+        }
+        std::fill(storage.get(), storage.get() + floats, float_t(0));
+    }
+
+    float_t* data() {
+        return storage.get();
+    }
+
+    struct deleter {
+        void operator()(float_t* ptr) const {
+            std::free(ptr);
+        }
+    };
+
+    std::unique_ptr<float_t, deleter> storage;
+    size_t capacity = 0;
+};
+
+SP_ALGO_NN_DETAIL_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_MEMORY_PLAN_HPP */
@@ -11,6 +11,11 @@
 
 #include <tuple>
 #include <array>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <atomic>
 #include <fstream>
 #include <iosfwd>
 #include <experimental/filesystem>
@@ -29,6 +34,11 @@
 #include "types.hpp"
 #include "normalize.hpp"
 #include "weight.hpp"
+#include "layout.hpp"
+#include "fusion.hpp"
+#include "memory_plan.hpp"
+#include "parameters.hpp"
+#include "checkpoint.hpp"
 
 
 SP_ALGO_NN_NAMESPACE_BEGIN
@@ -38,35 +48,69 @@ SP_ALGO_NN_NAMESPACE_BEGIN
  */
 
 /**
- * \brief Test result (alias, tuple)
+ * \brief Dense confusion matrix, the count of samples of every (predicted,
+ *        actual) class pair
+ */
+using confusion_matrix = Eigen::Matrix<size_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+/**
+ * \brief Test result (alias, tuple) of correct, total and the confusion
+ *        matrix
  */
 using test_results = std::tuple<
     size_t,
     size_t,
-    std::unordered_map<
-        size_t,
-        std::unordered_map<
-            size_t,
-            size_t
-        >
-    >
+    confusion_matrix
 >;
 
 /**
  * \brief Generic Neural Network composite structure
+ *
+ * \tparam Layout the layout of the activations between layers, see
+ *         #nchw_layout and #nchwc_layout. With a channel blocked layout the
+ *         leading layers supporting it (see detail::supports_blocked_layout_v)
+ *         exchange blocked activations, which are reordered once at the input
+ *         and once at the boundary to the first layer without blocked kernels
+ *         (or the output). Inputs, outputs and deltas of the network are
+ *         always plain (N, C, H, W) tensors.
+ *
+ * Adjacent plain layers forming a recognized sequence (e.g. conv, tanh,
+ * pooling, tanh) are executed as one fused stage, see fusion.hpp. The values
+ * of a fused stage that back propagation does not read are not materialized.
+ *
+ * The values and deltas are views into a single aligned arena, buffers with
+ * disjoint lifetimes share memory, see memory_plan.hpp. The plan is computed
+ * at compile time, configure allocates the arena and nothing is allocated
+ * by forward and backward propagation.
+ *
+ * The weights, biases and gradients of the layers are bound into the arenas
+ * of a parameter_registry, update_weights is a single pass over them.
  */
-template<typename ... Layers>
-struct network {
+template<typename Layout, typename ... Layers>
+struct basic_network {
 
     using layers_type = std::tuple<Layers...>;
     constexpr static size_t layers_count = std::tuple_size_v<layers_type>;
 
+    using layout_type = Layout;
+
+    /**
+     * \brief Channel block size of the blocked activations
+     */
+    constexpr static size_t block = layout_type::block;
+
+    /**
+     * \brief Number of leading layers operating on blocked activations,
+     *        values[0, blocked_layers) are blocked
+     */
+    constexpr static size_t blocked_layers = layout_type::blocked ? detail::blocked_prefix<Layers...>() : 0;
+
     using input_layer_type = typename std::tuple_element_t<0, layers_type>;
     using output_layer_type = typename std::tuple_element_t<layers_count-1, layers_type>;
     using input_dims  = typename std::tuple_element_t<0, layers_type>::input_dims;
     using output_dims = typename std::tuple_element_t<layers_count-1, layers_type>::output_dims;
 
-    network() : layers() {
+    basic_network() : layers() {
         weight_initializer = glorot_weight_initializer();
         bias_initializer = fixed_weight_initializer(0);
     }
@@ -75,103 +119,242 @@ struct network {
      * \brief Configure and prepare network for the given batch size and
      *        optionally reset the weights. Must be called before use. It is
      *        undefined behavior not to configure network before use.
+     *
+     * The storage is sized for the largest batch size configured, any batch
+     * size up to it only re-targets the values and deltas, without
+     * allocating or reconfiguring the layers. See set_batch_size.
+     *
+     * \param mode in inference mode only the weights and the values of
+     *        forward propagation are allocated, see configure_inference
      */
-    sp_hot void configure(const size_t& batch_size, bool reset = false) {
-        size_t idx = 0;
-        if(batch_size != batch_size_config || reset) {
-            util::for_each(layers, [&](auto& layer) {
-                using layer_type = std::decay_t<decltype(layer)>;
-
-                /**
-                 * Check if layer has weight or biases, then propagate
-                 * default network initializers to those, if not explicitly configured
-                 */
-                if constexpr(detail::has_weight_and_delta_v<layer_type>) {
-                    if(!layer.weight_initializer) {
-                        layer.weight_initializer = weight_initializer;
-                    };
-                }
-                if constexpr(detail::has_bias_and_delta_v<layer_type>) {
-                    if(!layer.bias_initializer) {
-                        layer.bias_initializer = bias_initializer;
-                    }
+    sp_hot void configure(const size_t& batch_size, bool reset = false, network_mode mode = network_mode::training) {
+        BOOST_ASSERT_MSG(batch_size > 0, "Batch size is greater than zero");
+        if(batch_size <= batch_capacity && !reset && mode == mode_config) {
+            set_batch_size(batch_size);
+            return;
+        }
+        const size_t capacity = std::max(batch_size, batch_capacity);
+        util::for_each(layers, [&](auto& layer) {
+            using layer_type = std::decay_t<decltype(layer)>;
+
+            /**
+             * Check if layer has weight or biases, then propagate
+             * default network initializers to those, if not explicitly configured
+             */
+            if constexpr(detail::has_weight_and_delta_v<layer_type>) {
+                if(!layer.weight_initializer) {
+                    layer.weight_initializer = weight_initializer;
+                };
+            }
+            if constexpr(detail::has_bias_and_delta_v<layer_type>) {
+                if(!layer.bias_initializer) {
+                    layer.bias_initializer = bias_initializer;
                 }
+            }
 
-                /* prepare input and input deltas */
-                detail::prepare_tensor<typename layer_type::input_dims >(batch_size, values[idx]);
-                detail::prepare_tensor<typename layer_type::input_dims>(batch_size, values_delta[idx]);
-
-                layer.configure(batch_size, reset);
+            layer.configure(capacity, reset, mode);
+        });
+        if(mapped && mode == network_mode::inference && !reset) {
+            /* The weights stay on the pages of the mapped checkpoint */
+            parameters.release();
+        } else {
+            parameters.configure(layers, mode == network_mode::training);
+            mapped.reset();
+        }
+        batch_capacity = capacity;
+        mode_config = mode;
+        arena.prepare((training() ? memory_plan<true>() : memory_plan<false>()).arena * capacity);
+        /* Views are carved anew */
+        batch_size_config = 0;
+        set_batch_size(batch_size);
+    }
 
-                ++idx;
-            });
+    /**
+     * \brief Run batches of batch_size samples, at most max_batch_size().
+     *        The values and deltas are views of the storage of the maximum
+     *        batch, nothing is allocated. Called by forward for inputs of
+     *        another batch size.
+     */
+    void set_batch_size(const size_t& batch_size) {
+        BOOST_ASSERT_MSG(batch_size > 0 && batch_size <= batch_capacity, "Batch size is within the configured maximum");
+        if(batch_size == batch_size_config) {
+            return;
         }
         batch_size_config = batch_size;
-        /* output of network */
-        detail::prepare_tensor<output_dims>  (batch_size, values[layers_count]);
-        detail::prepare_tensor<output_dims>  (batch_size, values_delta[layers_count]);
+        if(training()) {
+            configure_arena<true>(batch_size, std::make_index_sequence<layers_count + 1>());
+        } else {
+            configure_arena<false>(batch_size, std::make_index_sequence<layers_count + 1>());
+        }
     }
 
-    sp_hot tensor_4& forward(tensor_4& input) {
-        values[0] = input;
-        size_t idx = 0;
-            BOOST_ASSERT_MSG(
+    /**
+     * \brief Configure the network for inference (forward propagation only)
+     *        of the given batch size. Deltas and gradients are not
+     *        allocated and the bookkeeping of back propagation is skipped,
+     *        backward and update_weights must not be called.
+     */
+    void configure_inference(const size_t& batch_size, bool reset = false) {
+        configure(batch_size, reset, network_mode::inference);
+    }
+
+    sp_hot tensor_4_view forward(tensor_4_view input) {
+        set_batch_size(input.dimension(0));
+        BOOST_ASSERT_MSG(
             detail::validate_dimensions<input_dims>(batch_size(), input),
             "Input dimensions match configuration"
         );
-        util::for_each(layers, [&](auto& layer) {
-            /* clear output */
-            values[idx+1].setZero();
-            layer.forward_prop(values[idx], values[idx+1]);
-            ++idx;
-        });
+        if constexpr(blocked_layers > 0) {
+            detail::to_blocked<input_dims, block>(input, values[0]);
+        } else {
+            values[0] = input;
+        }
+        if(training()) {
+            forward_stage<0, true>();
+        } else {
+            forward_stage<0, false>();
+        }
         return values[layers_count];
     }
 
-    sp_hot void backward(tensor_4& delta) {
+    sp_hot void backward(tensor_4_view delta) {
+        BOOST_ASSERT_MSG(training(), "Network is configured for training");
         BOOST_ASSERT_MSG(
             detail::validate_dimensions<output_dims>(batch_size(), delta),
             "Delta dimensions match configuration"
         );
-        size_t idx = layers_count;
         /* Set the current delta of the output layer */
         values_delta[layers_count] = delta;
-        util::for_each(util::reverse(layers), [&](auto& layer) {
-            values_delta[idx-1].setZero();
-            layer.backward_prop(
-                values[idx-1], /* previous layer input */
-                values_delta[idx-1], /* previous layer delta */
-                values[idx], /* current output */
-                values_delta[idx] /* current delta */
-            );
-            --idx;
-        });
+        backward_stage<0>();
     }
 
     /**
-     * \brief Update weights of network
+     * \brief Back propagate the gradient of loss between the output of the
+     *        last forward propagation and expected
+     *
+     * A softmax output layer and a loss providing its derivative with
+     * respect to the softmax input (e.g. cross_entropy, p - y) are fused:
+     * the gradient is computed as the delta of the softmax input and the
+     * back propagation of the softmax is skipped.
+     */
+    template<typename LossFunction>
+    sp_hot void backward(LossFunction& loss, tensor_4_view expected) {
+        BOOST_ASSERT_MSG(training(), "Network is configured for training");
+        if constexpr(fused_output_loss<LossFunction>) {
+            softmax_gradient(loss, values[layers_count], expected, values_delta[layers_count-1]);
+            backward_stage<0, layers_count-1>();
+        } else {
+            gradient(loss, values[layers_count], expected, values_delta[layers_count]);
+            backward_stage<0>();
+        }
+    }
+
+    /**
+     * \brief Whether backward fuses the loss with the output layer
+     */
+    template<typename LossFunction>
+    constexpr static bool fused_output_loss =
+        detail::is_softmax_layer<output_layer_type>::value && has_softmax_derivative_v<LossFunction>;
+
+    /**
+     * \brief Update weights of network, one pass of the optimizer over the
+     *        parameter registry
      */
     template<typename Optimizer>
     sp_hot void update_weights(Optimizer& optimizer) {
         //util::scoped_timer t("update_weights(..)");
+        BOOST_ASSERT_MSG(training(), "Network is configured for training");
+        parameters.update(optimizer, layers, parameters.parameters());
+        util::for_each(layers, [&](auto& layer) {
+            layer.accumulated_samples = 0;
+            layer.weights_updated();
+        });
+        ++weights_revision;
+    }
+
+    /**
+     * \brief Copy the weights of another network of the same type, see
+     *        layer::copy_weights
+     */
+    void copy_weights(const basic_network& from) {
+        copy_weights(from, std::make_index_sequence<layers_count>());
+    }
+
+    /**
+     * \brief View the weights and biases of a configured network of the
+     *        same type, e.g. the trained network of data parallel training,
+     *        instead of copying them. The viewed network must outlive this
+     *        one and keep its configuration. Reconfiguring this network
+     *        copies the weights into storage of its own.
+     */
+    void share_weights(basic_network& from) {
+        BOOST_ASSERT_MSG(from.parameters.size() == parameters.size(), "Networks are configured");
+        share_weights(from, std::make_index_sequence<layers_count>());
+        weights_changed();
+        shared_revision = from.weights_revision;
+    }
+
+    /**
+     * \brief Refresh the engine caches of the layers (see
+     *        layer::weights_changed) if the weights of the network viewed
+     *        have changed since the last refresh, see share_weights
+     */
+    void shared_weights_changed(const basic_network& from) {
+        const size_t revision = from.weights_revision;
+        if(revision != shared_revision) {
+            weights_changed();
+            shared_revision = revision;
+        }
+    }
+
+    /**
+     * \brief Move the gradients of a replica configured with a single
+     *        gradient slot into the gradient slot of this network, see
+     *        layer::gather_gradients
+     */
+    void gather_gradients(basic_network& replica, const size_t& slot) {
+        gather_gradients(replica, slot, std::make_index_sequence<layers_count>());
+    }
+
+    /**
+     * \brief Apply the gradients of this network to the weights of another
+     *        network of the same type, see layer::update_weights. The
+     *        registries of both share the layout of the parameters.
+     */
+    template<typename Optimizer>
+    sp_hot void update_weights(Optimizer& optimizer, basic_network& shared) {
+        BOOST_ASSERT_MSG(training(), "Network is configured for training");
+        BOOST_ASSERT_MSG(shared.parameters.size() == parameters.size(), "Shared network is configured");
+        parameters.update(optimizer, layers, shared.parameters.parameters());
+        util::for_each(layers, [&](auto& layer) {
+            layer.accumulated_samples = 0;
+        });
+        ++shared.weights_revision;
+    }
+
+    /**
+     * \brief Notify the layers that their weights have been modified
+     *        externally
+     */
+    void weights_changed() {
         util::for_each(layers, [&](auto& layer) {
-            layer.update_weights(optimizer);
+            layer.weights_changed();
         });
+        ++weights_revision;
     }
 
     /**
      * \brief Perform forward propagation and return index
      * @return the maximum index vector of samples
      */
-    std::vector<size_t> forward_max_index(tensor_4& input) {
-        BOOST_ASSERT(input.dimension(0) == 1); // only supported for now
+    std::vector<size_t> forward_max_index(tensor_4_view input) {
         const size_t batch_size = input.dimension(0);
-        tensor_4& out = forward(input);
+        tensor_4_view out = forward(input);
         std::vector<size_t> res(batch_size);
-        res[0] = std::distance(
-            out.data(),
-            std::max_element(out.data(), out.data()+out.size())
-        );
+        #pragma omp parallel for
+        for(size_t s = 0; s < batch_size; ++s) {
+            res[s] = max_index(out, s);
+        }
         return res;
     }
 
@@ -179,38 +362,52 @@ struct network {
      * \brief Perform testing on the neural network by performing  forward
      *        propagation on samples and compare with the labels using
      *        maximum index. Assumes inputs are normalized.
+     *
+     * Evaluates in batches of the configured batch size (the configuration
+     * is kept), the last batch holds the remaining samples. The confusion
+     * matrix is accumulated per thread and has one row and column per
+     * output.
      */
     auto test(sample_vector_type& samples, class_vector_type& classes) {
         BOOST_ASSERT(samples.size() > 0);
         BOOST_ASSERT(classes.size() > 0);
         BOOST_ASSERT(samples.size() == classes.size());
-        test_results result;
-
+        BOOST_ASSERT_MSG(batch_size() > 0, "Network is configured");
 
+        constexpr size_t class_count = output_dims::size;
         const size_t sample_count = samples.size();
+        const size_t batch = batch_size();
+
+        tensor_4 input(batch, input_dims::d, input_dims::h, input_dims::w);
 
-        const size_t prev_batch_size = batch_size();
+        std::vector<confusion_matrix> partial(util::thread_count(), confusion_matrix::Zero(class_count, class_count));
 
-        /**
-         * Reconfigure for testing, resizes the layer buffers
-         * \todo Test in batches
-         */
-        configure(1);
+        for(size_t first = 0; first < sample_count; first += batch) {
+            const size_t n = std::min(batch, sample_count - first);
 
-        for(size_t s = 0; s < sample_count; ++s) {
-            values[0].chip(0, 0) = samples[s]; //omit copying
-            auto predicted = this->forward_max_index(values[0])[0];
-            auto actual = classes[s];
-            if(predicted == actual) {
-                std::get<0>(result) += 1;
+            #pragma omp parallel for
+            for(size_t s = 0; s < n; ++s) {
+                const sample_type& sample = samples[first + s];
+                BOOST_ASSERT(detail::validate_dimensions<input_dims>(sample));
+                std::copy(sample.data(), sample.data() + input_dims::size, input.data() + s * input_dims::size);
             }
-            std::get<2>(result)[predicted][actual] += 1;
-        }
-        std::get<1>(result)= sample_count;
 
-        /* restore previous configuration */
-        configure(prev_batch_size);
+            tensor_4_view out = forward(tensor_4_view(input.data(), n, input_dims::d, input_dims::h, input_dims::w));
+
+            #pragma omp parallel for
+            for(size_t s = 0; s < n; ++s) {
+                const size_t actual = classes[first + s];
+                BOOST_ASSERT(actual < class_count);
+                partial[util::thread_index()](max_index(out, s), actual) += 1;
+            }
+        }
+        set_batch_size(batch);
 
+        test_results result{0, sample_count, confusion_matrix::Zero(class_count, class_count)};
+        for(auto& p : partial) {
+            std::get<2>(result) += p;
+        }
+        std::get<0>(result) = std::get<2>(result).trace();
         return result;
     }
 
@@ -252,6 +449,72 @@ struct network {
         return save(fs);
     }
 
+    /**
+     * \brief Save the weights in the binary checkpoint format, see
+     *        checkpoint.hpp
+     */
+    bool save_checkpoint(std::ostream& os) {
+        return detail::write_checkpoint(layers, os);
+    }
+
+    bool save_checkpoint(const std::string& file) {
+        std::ofstream fs(file, std::ios::out | std::ios::binary);
+        return save_checkpoint(fs) && fs.flush();
+    }
+
+    /**
+     * \brief Load the weights of a binary checkpoint, the network is
+     *        configured (batch size 1) unless it has been. The weights are
+     *        left unchanged if the checkpoint is of another network or is
+     *        corrupt.
+     */
+    bool load_checkpoint(std::istream& is) {
+        if(batch_capacity == 0) {
+            this->configure(1);
+        }
+        if(!detail::read_checkpoint(layers, is)) {
+            return false;
+        }
+        weights_changed();
+        return true;
+    }
+
+    bool load_checkpoint(const std::string& file) {
+        std::ifstream fs(file, std::ios::in | std::ios::binary);
+        return load_checkpoint(fs);
+    }
+
+    /**
+     * \brief Point the weights at a binary checkpoint mapped into memory,
+     *        without copying. Processes mapping the same file share its
+     *        pages, pages written become private copies. The network is
+     *        configured for inference (batch size 1) unless it has been.
+     *
+     * In inference the parameter registry releases its arena, the weights
+     * are only held by the mapping, also when reconfigured for inference.
+     * Configured for training, or reset, the values are copied into the
+     * registry and the file is unmapped.
+     *
+     * \param verify whether to verify the checksum, reads every page
+     */
+    bool map_checkpoint(const std::string& file, bool verify = true) {
+        if(batch_capacity == 0) {
+            configure_inference(1);
+        }
+        auto mapping = std::make_shared<detail::mapped_checkpoint>(file);
+        if(!detail::map_checkpoint(layers, *mapping, verify)) {
+            return false;
+        }
+        if(training()) {
+            parameters.configure(layers, true);
+        } else {
+            mapped = mapping;
+            parameters.release();
+        }
+        weights_changed();
+        return true;
+    }
+
     auto& out_layer() {
         return std::get<layers_count-1>(layers);
     }
@@ -291,15 +554,95 @@ struct network {
         return batch_size_config;
     }
 
+    /**
+     * \brief The largest batch size the network has been configured for
+     */
+    size_t max_batch_size() const {
+        return batch_capacity;
+    }
+
+    network_mode mode() const {
+        return mode_config;
+    }
+
+    bool training() const {
+        return mode_config == network_mode::training;
+    }
+
+    /**
+     * \brief Number of layers executed as one stage starting at layer I,
+     *        see fusion.hpp. Blocked layers are never fused.
+     */
+    template<size_t I>
+    constexpr static size_t stage_length() {
+        if constexpr(I < blocked_layers) {
+            return 1;
+        } else {
+            return detail::fused_stage_length_v<I, layers_type>;
+        }
+    }
+
+    using memory_plan_type = detail::memory_plan<layers_count>;
+
+    /**
+     * \brief Number of stages, see stage_length
+     */
+    template<size_t I = 0>
+    constexpr static size_t stages_count() {
+        if constexpr(I < layers_count) {
+            return 1 + stages_count<I + stage_length<I>()>();
+        } else {
+            return 0;
+        }
+    }
+
+    /**
+     * \brief Memory plan of the values and deltas, sizes and offsets are
+     *        floats per sample. Without Training (inference) only forward
+     *        propagation is planned and the deltas are empty.
+     */
+    template<bool Training = true>
+    constexpr static memory_plan_type memory_plan() {
+        memory_plan_type plan;
+        plan_sizes<Training>(plan, std::make_index_sequence<layers_count + 1>());
+        if constexpr(blocked_layers > 0) {
+            constexpr size_t boundary_size = detail::arena_padded(blocked_size<blocked_layers>());
+            plan.size[memory_plan_type::boundary_value] = boundary_size;
+            plan.size[memory_plan_type::boundary_delta] = Training ? boundary_size : 0;
+        }
+        plan_lifetimes<0, Training>(plan, 0);
+        plan.allocate();
+        return plan;
+    }
+
     //Tuple holds all the layers of this network
     std::tuple<Layers...> layers;
 
+    /**
+     * \brief Storage of the weights, biases and gradients of the layers
+     */
+    parameter_registry parameters;
+
+    /**
+     * \brief The checkpoint the weights are mapped from, see map_checkpoint
+     */
+    std::shared_ptr<const detail::mapped_checkpoint> mapped;
+
+    /**
+     * \brief Incremented whenever the weights change, and the revision of
+     *        the viewed network the engine caches were last refreshed at,
+     *        see share_weights. Updated by concurrent workers of
+     *        asynchronous training.
+     */
+    std::atomic<size_t> weights_revision{0};
+    size_t shared_revision = 0;
+
     /**
      * Store values and values delta of inputs and ouputs
-     * + 1 (input layer)
+     * + 1 (input layer), views into the arena
      */
-    std::array<tensor_4, layers_count + 1> values;
-    std::array<tensor_4, layers_count + 1> values_delta;
+    std::vector<tensor_4_view> values;
+    std::vector<tensor_4_view> values_delta;
 
     /**
      * \brief Provides a plug-in point for custom weight initialization strategy
@@ -311,9 +654,241 @@ struct network {
     std::function<void(float_t*, float_t*, const size_t&, const size_t&)> bias_initializer;
 
 protected:
-    size_t batch_size_config;
+
+    /**
+     * \brief Index of the maximum output of sample s
+     */
+    static size_t max_index(const tensor_4_view& out, const size_t& s) {
+        const float_t* first = out.data() + s * output_dims::size;
+        return std::distance(first, std::max_element(first, first + output_dims::size));
+    }
+
+    template<size_t... I>
+    void copy_weights(const basic_network& from, std::index_sequence<I...>) {
+        (std::get<I>(layers).copy_weights(std::get<I>(from.layers)), ...);
+    }
+
+    template<size_t... I>
+    void share_weights(basic_network& from, std::index_sequence<I...>) {
+        (std::get<I>(layers).share_weights(std::get<I>(from.layers)), ...);
+    }
+
+    template<size_t... I>
+    void gather_gradients(basic_network& replica, const size_t& slot, std::index_sequence<I...>) {
+        (std::get<I>(layers).gather_gradients(std::get<I>(replica.layers), slot), ...);
+    }
+
+    /**
+     * \brief Volume of values[I]
+     */
+    template<size_t I>
+    using volume_dims_at = std::tuple_element_t<I, std::tuple<typename Layers::input_dims..., output_dims>>;
+
+    /**
+     * \brief Floats per sample of values[I] in the channel blocked layout
+     */
+    template<size_t I>
+    constexpr static size_t blocked_size() {
+        using dims = volume_dims_at<I>;
+        return detail::channel_blocks<dims::d, block> * dims::area * block;
+    }
+
+    template<bool Training, size_t... I>
+    constexpr static void plan_sizes(memory_plan_type& plan, std::index_sequence<I...>) {
+        ((
+            plan.size[memory_plan_type::value(I)] = detail::arena_padded(I < blocked_layers ? blocked_size<I>() : volume_dims_at<I>::size),
+            plan.size[memory_plan_type::delta(I)] = Training ? plan.size[memory_plan_type::value(I)] : 0
+        ), ...);
+    }
+
+    /**
+     * \brief Marks the buffers touched by the stage s starting at layer I
+     *        and by all following stages
+     */
+    template<size_t I, bool Training>
+    constexpr static void plan_lifetimes(memory_plan_type& plan, const size_t& s) {
+        if constexpr(I < layers_count) {
+            using layer_type = std::tuple_element_t<I, layers_type>;
+            using plan_type = memory_plan_type;
+            constexpr size_t length = stage_length<I>();
+            constexpr size_t steps = Training ? 2 * stages_count() : stages_count();
+            const size_t f = s;
+            const size_t b = steps - 1 - s;
+            if constexpr(length > 1) {
+                detail::fused_lifetimes<I, length, layers_type, Training>(plan, f, b);
+            } else if constexpr(!Training) {
+                plan.touch(plan_type::value(I), f);
+                plan.touch(plan_type::value(I + 1), f);
+                if constexpr(I + 1 == blocked_layers) {
+                    plan.touch(plan_type::boundary_value, f);
+                }
+            } else {
+                constexpr bool boundary = I < blocked_layers && I + 1 == blocked_layers;
+                const size_t output = boundary ? plan_type::boundary_value : plan_type::value(I + 1);
+                const size_t output_delta = boundary ? plan_type::boundary_delta : plan_type::delta(I + 1);
+                plan.touch(plan_type::value(I), f);
+                plan.touch(output, f);
+                plan.touch(plan_type::value(I + 1), f);
+                plan.touch(plan_type::delta(I + 1), b);
+                plan.touch(output_delta, b);
+                plan.touch(plan_type::delta(I), b);
+                if constexpr(detail::backward_reads_input_v<layer_type>) {
+                    plan.touch(plan_type::value(I), b);
+                }
+                if constexpr(detail::backward_reads_output_v<layer_type>) {
+                    plan.touch(output, b);
+                }
+            }
+            if constexpr(I + length == layers_count) {
+                /* The output is read by the caller until the next forward propagation */
+                plan.touch(plan_type::value(layers_count), steps - 1);
+            }
+            plan_lifetimes<I + length, Training>(plan, s + 1);
+        }
+    }
+
+    /**
+     * \brief Carve the values and deltas of batch_size samples from the
+     *        arena
+     */
+    template<bool Training, size_t... I>
+    void configure_arena(const size_t& batch_size, std::index_sequence<I...>) {
+        constexpr memory_plan_type plan = memory_plan<Training>();
+        values.clear();
+        values_delta.clear();
+        boundary.clear();
+        (values.push_back(arena_view<I>(plan.offset[memory_plan_type::value(I)], batch_size, I < blocked_layers)), ...);
+        if constexpr(Training) {
+            (values_delta.push_back(arena_view<I>(plan.offset[memory_plan_type::delta(I)], batch_size, I < blocked_layers)), ...);
+        }
+        if constexpr(blocked_layers > 0) {
+            boundary.push_back(arena_view<blocked_layers>(plan.offset[memory_plan_type::boundary_value], batch_size, true));
+            if constexpr(Training) {
+                boundary.push_back(arena_view<blocked_layers>(plan.offset[memory_plan_type::boundary_delta], batch_size, true));
+            }
+        }
+    }
+
+    /**
+     * \brief View of the volume of values[I] at offset (per sample) of the
+     *        arena, plain or channel blocked
+     */
+    template<size_t I>
+    tensor_4_view arena_view(const size_t& offset, const size_t& batch_size, bool blocked) {
+        using dims = volume_dims_at<I>;
+        float_t* data = arena.data() + offset * batch_size;
+        if(blocked) {
+            return tensor_4_view(data, batch_size, detail::channel_blocks<dims::d, block>, dims::area, block);
+        }
+        return tensor_4_view(data, batch_size, dims::d, dims::h, dims::w);
+    }
+
+    /**
+     * \brief Blocked output and delta of the last blocked layer, reordered
+     *        to and from values[blocked_layers]
+     */
+    tensor_4_view& boundary_value() {
+        return boundary[0];
+    }
+
+    tensor_4_view& boundary_delta() {
+        return boundary[1];
+    }
+
+    /**
+     * \brief Forward propagation of the stage starting at layer I and of
+     *        all following stages, Training keeps the bookkeeping of back
+     *        propagation in fused stages
+     */
+    template<size_t I, bool Training>
+    sp_hot void forward_stage() {
+        if constexpr(I < layers_count) {
+            using layer_type = std::tuple_element_t<I, layers_type>;
+            constexpr size_t length = stage_length<I>();
+            auto& layer = std::get<I>(layers);
+            if constexpr(I < blocked_layers) {
+                constexpr bool boundary = I + 1 == blocked_layers;
+                tensor_4_view output = boundary ? boundary_value() : values[I+1];
+                output.setZero();
+                layer.template forward_prop_blocked<block>(values[I], output);
+                if constexpr(boundary) {
+                    detail::from_blocked<typename layer_type::output_dims, block>(boundary_value(), values[I+1]);
+                }
+            } else if constexpr(length > 1) {
+                detail::fused_forward<I, length, Training>(layers, values);
+            } else {
+                /* clear output */
+                values[I+1].setZero();
+                layer.forward_prop(values[I], values[I+1]);
+            }
+            forward_stage<I + length, Training>();
+        }
+    }
+
+    /**
+     * \brief Back propagation of all stages following the stage starting at
+     *        layer I, then of the stage itself. Stages from layer End on are
+     *        skipped, End is the first layer of a stage.
+     */
+    template<size_t I, size_t End = layers_count>
+    sp_hot void backward_stage() {
+        if constexpr(I < End) {
+            using layer_type = std::tuple_element_t<I, layers_type>;
+            constexpr size_t length = stage_length<I>();
+            backward_stage<I + length, End>();
+            auto& layer = std::get<I>(layers);
+            if constexpr(I < blocked_layers) {
+                constexpr bool boundary = I + 1 == blocked_layers;
+                if constexpr(boundary) {
+                    detail::to_blocked<typename layer_type::output_dims, block>(values_delta[I+1], boundary_delta());
+                }
+                values_delta[I].setZero();
+                layer.template backward_prop_blocked<block>(
+                    values[I],
+                    values_delta[I],
+                    boundary ? boundary_value() : values[I+1],
+                    boundary ? boundary_delta() : values_delta[I+1]
+                );
+            } else if constexpr(length > 1) {
+                detail::fused_backward<I, length>(layers, values, values_delta);
+            } else {
+                values_delta[I].setZero();
+                layer.backward_prop(
+                    values[I], /* previous layer input */
+                    values_delta[I], /* previous layer delta */
+                    values[I+1], /* current output */
+                    values_delta[I+1] /* current delta */
+                );
+            }
+        }
+    }
+
+    size_t batch_size_config = 0;
+
+    /**
+     * \brief Batch size the layers and the arena are sized for
+     */
+    size_t batch_capacity = 0;
+
+    network_mode mode_config = network_mode::training;
+
+    /**
+     * \brief Storage of the values and deltas
+     */
+    detail::arena_storage arena;
+
+    /**
+     * \brief Blocked boundary value and delta, see boundary_value
+     */
+    std::vector<tensor_4_view> boundary;
 };
 
+/**
+ * \brief Neural Network with plain (N, C, H, W) activations (alias)
+ */
+template<typename ... Layers>
+using network = basic_network<nchw_layout, Layers...>;
+
 SP_ALGO_NN_NAMESPACE_END
 
 #endif	/* SP_ALGO_NN_NETWORK_HPP */
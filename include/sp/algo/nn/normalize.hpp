@@ -9,6 +9,7 @@
 #ifndef SP_ALGO_NN_NORMALIZE_HPP
 #define SP_ALGO_NN_NORMALIZE_HPP
 
+#include <algorithm>
 #include <boost/assert.hpp>
 #include "sp/config.hpp"
 #include "matrix.hpp"
@@ -123,20 +124,21 @@ namespace detail {
     auto normalize_label_to_vector_helper(Network& network, const size_t& batch_size, class_vector_type& classes) {
 
         const size_t class_count = classes.size();
-        const size_t batch_count = class_count / batch_size;
+        /* The last batch holds the remaining classes */
+        const size_t batch_count = (class_count + batch_size - 1) / batch_size;
 
         /* Output is a vector of output_type */
-        std::vector<tensor_4> vec(
-            /* of dimensions (1, 1, 1, the size of the output of the last layer) */
-            batch_count, tensor_4(batch_size, Network::output_dims::size, 1, 1)
-        );
+        std::vector<tensor_4> vec(batch_count);
 
         auto[min, max] = network.out_target_range();
 
         for(size_t b = 0; b < batch_count; ++b) {
+            const size_t samples = std::min(batch_size, class_count - b * batch_size);
+            /* of dimensions (samples, the size of the output of the last layer, 1, 1) */
+            vec[b].resize(samples, Network::output_dims::size, 1, 1);
             /* default to minimum value */
             vec[b].setConstant(min);
-            for(size_t s = 0; s < batch_size; ++s) {
+            for(size_t s = 0; s < samples; ++s) {
                 const size_t idx = b * batch_size + s;
 
                 BOOST_ASSERT_MSG(
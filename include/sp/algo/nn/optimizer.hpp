@@ -9,4 +9,9 @@
 #include "optimizer/optimizer.hpp"
 #include "optimizer/ada_grad.hpp"
 #include "optimizer/grad_desc.hpp"
+#include "optimizer/stochastic_grad_desc.hpp"
+#include "optimizer/momentum.hpp"
+#include "optimizer/nesterov.hpp"
+#include "optimizer/rmsprop.hpp"
+#include "optimizer/adam.hpp"
 
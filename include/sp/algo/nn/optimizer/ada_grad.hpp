@@ -12,6 +12,8 @@
 #include "../config.hpp"
 #include "optimizer.hpp"
 
+#include <array>
+#include <cmath>
 #include <boost/assert.hpp>
 
 SP_ALGO_NN_NAMESPACE_BEGIN
@@ -28,31 +30,20 @@ struct ada_gradient_optimizer : stateful_optimizer<1, ada_gradient_optimizer<Lea
 
     constexpr static float_t epsilon = 1.0e-8f;
 
-    template<typename Tensor>
-    void update_impl(Tensor& dw, Tensor& w) {
-
+    /**
+     * \brief Update n contiguous parameters w by their gradient dw times
+     *        scale, state holds the sum of squared gradients
+     */
+    void update_block(float_t* w, const float_t* dw, const std::array<float_t*, 1>& state, const size_t& n, const float_t& scale) const {
         BOOST_ASSERT_MSG(alpha > 0 && alpha < 1.0, "Alpha is in the range of (0, 1)");
-
-        tensor_1& g = this->state[0][&dw];
-
-        auto& dims = w.dimensions();
-
-        /* initialize g size */
-        if(g.size() != w.size()) {
-            g.resize(w.size());
-            g.setZero();
+        float_t* g = state[0];
+        #pragma omp simd
+        for(size_t i = 0; i < n; ++i) {
+            const float_t d = dw[i] * scale;
+            g[i] += d * d;
+            w[i] -= (alpha * d) / (std::sqrt(g[i]) + epsilon);
         }
-
-        BOOST_ASSERT(g.size() == w.size());
-        BOOST_ASSERT(g.size() == dw.size());
-        BOOST_ASSERT(dw.size() == w.size());
-        BOOST_ASSERT(dw.dimensions() == w.dimensions());
-
-        g.reshape(dims) += dw.square();
-        w -= (alpha * dw) / (g.reshape(dims).sqrt() + epsilon);
     }
-
-
 };
 
 SP_ALGO_NN_NAMESPACE_END
@@ -9,23 +9,74 @@
 #ifndef SP_ALGO_NN_OPTIMIZER_ADAM_HPP
 #define SP_ALGO_NN_OPTIMIZER_ADAM_HPP
 
-#include "optimizer.hpp"
+#include <array>
+#include <cmath>
 #include <ratio>
+#include <boost/assert.hpp>
+
+#include "../config.hpp"
+#include "optimizer.hpp"
 
-enum policy {
-    fixed,
-    step,
-} sdg_optimizer_policy;
+SP_ALGO_NN_NAMESPACE_BEGIN
 
+/**
+ * \brief Adaptive Moment Estimation (Adam) Optimizer
+ *
+ * Keeps running averages of the gradients (first moment) and of the squared
+ * gradients (second moment), the step is bias corrected for the zero
+ * initialized moments. begin_step must be called before the updates of
+ * every step.
+ *
+ * \tparam LearningRate, a std::ratio instantiation designating the learning ratio
+ * \tparam Beta1 decay of the first moment
+ * \tparam Beta2 decay of the second moment
+ */
 template<
-    sdg_optimizer_policy Policy = fixed,
-    typename InitialRatio,
-    size_t Step,
-    typename Gamma
+    typename LearningRate = std::ratio<1, 1000>,
+    typename Beta1 = std::ratio<9, 10>,
+    typename Beta2 = std::ratio<999, 1000>
 >
-struct sdg_optimizer : optimizer<sdg_optimizer> {
+struct adam_optimizer : stateful_optimizer<2, adam_optimizer<LearningRate, Beta1, Beta2>> {
+
+    float_t alpha = static_cast<float_t>(LearningRate::num) / static_cast<float_t>(LearningRate::den);
 
+    float_t beta1 = static_cast<float_t>(Beta1::num) / static_cast<float_t>(Beta1::den);
+
+    float_t beta2 = static_cast<float_t>(Beta2::num) / static_cast<float_t>(Beta2::den);
+
+    constexpr static float_t epsilon = 1.0e-8f;
+
+    /**
+     * \brief Advance the bias correction, beta1 and beta2 to the power of
+     *        the step
+     */
+    void begin_step() {
+        beta1_t *= beta1;
+        beta2_t *= beta2;
+    }
+
+    /**
+     * \brief Update n contiguous parameters w by their gradient dw times
+     *        scale, state holds the first and second moments
+     */
+    void update_block(float_t* w, const float_t* dw, const std::array<float_t*, 2>& state, const size_t& n, const float_t& scale) const {
+        BOOST_ASSERT_MSG(beta1_t < 1, "begin_step has been called");
+        const float_t rate = alpha * std::sqrt(1 - beta2_t) / (1 - beta1_t);
+        float_t* m = state[0];
+        float_t* v = state[1];
+        #pragma omp simd
+        for(size_t i = 0; i < n; ++i) {
+            const float_t d = dw[i] * scale;
+            m[i] = beta1 * m[i] + (1 - beta1) * d;
+            v[i] = beta2 * v[i] + (1 - beta2) * d * d;
+            w[i] -= rate * m[i] / (std::sqrt(v[i]) + epsilon);
+        }
+    }
+
+    float_t beta1_t = 1;
+    float_t beta2_t = 1;
 };
 
-#endif	/* SP_ALGO_NN_OPTIMIZER_ADAM_HPP */
+SP_ALGO_NN_NAMESPACE_END
 
+#endif	/* SP_ALGO_NN_OPTIMIZER_ADAM_HPP */
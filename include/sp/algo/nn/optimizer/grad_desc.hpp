@@ -11,6 +11,7 @@
 
 #include "optimizer.hpp"
 
+#include <array>
 #include <boost/assert.hpp>
 
 SP_ALGO_NN_NAMESPACE_BEGIN
@@ -31,11 +32,17 @@ struct gradient_descent_optimizer : optimizer<gradient_descent_optimizer<Learnin
 
     constexpr static float_t epsilon = 1.0e-8f;
 
-    template<typename Tensor>
-    void update_impl(Tensor& dw, Tensor& w) {
-        BOOST_ASSERT(dw.size() == w.size());
-        BOOST_ASSERT(dw.dimensions() == w.dimensions());
-        w -= (alpha * dw);
+    /**
+     * \brief Update n contiguous parameters w by their gradient dw times
+     *        scale
+     */
+    void update_block(float_t* w, const float_t* dw, const std::array<float_t*, 0>& state, const size_t& n, const float_t& scale) const {
+        SP_UNUSED(state);
+        const float_t rate = alpha * scale;
+        #pragma omp simd
+        for(size_t i = 0; i < n; ++i) {
+            w[i] -= rate * dw[i];
+        }
     }
 
 };
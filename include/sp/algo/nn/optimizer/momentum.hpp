@@ -9,15 +9,42 @@
 #ifndef SP_ALGO_NN_OPTIMIZER_MOMENTUM_HPP
 #define SP_ALGO_NN_OPTIMIZER_MOMENTUM_HPP
 
-template<
-    sdg_optimizer_policy Policy = fixed,
-    typename InitialRatio,
-    size_t Step,
-    typename Gamma
->
-struct ada_grad_optimizer : optimizer<ada_grad_optimizer> {
+#include <array>
+#include <ratio>
 
+#include "../config.hpp"
+#include "optimizer.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Gradient descent with (classical) momentum
+ *
+ * \tparam LearningRate, a std::ratio instantiation designating the learning ratio
+ * \tparam Momentum the decay of the velocity
+ */
+template<typename LearningRate = default_learning_rate, typename Momentum = std::ratio<9, 10>>
+struct momentum_optimizer : stateful_optimizer<1, momentum_optimizer<LearningRate, Momentum>> {
+
+    float_t alpha = static_cast<float_t>(LearningRate::num) / static_cast<float_t>(LearningRate::den);
+
+    float_t mu = static_cast<float_t>(Momentum::num) / static_cast<float_t>(Momentum::den);
+
+    /**
+     * \brief Update n contiguous parameters w by their gradient dw times
+     *        scale, state holds the velocity
+     */
+    void update_block(float_t* w, const float_t* dw, const std::array<float_t*, 1>& state, const size_t& n, const float_t& scale) const {
+        const float_t rate = alpha * scale;
+        float_t* v = state[0];
+        #pragma omp simd
+        for(size_t i = 0; i < n; ++i) {
+            v[i] = mu * v[i] - rate * dw[i];
+            w[i] += v[i];
+        }
+    }
 };
 
-#endif	/* SP_ALGO_NN_OPTIMIZER_MOMENTUM_HPP */
+SP_ALGO_NN_NAMESPACE_END
 
+#endif	/* SP_ALGO_NN_OPTIMIZER_MOMENTUM_HPP */
@@ -9,7 +9,46 @@
 #ifndef SP_ALGO_NN_OPTIMIZER_NESTEROV_HPP
 #define SP_ALGO_NN_OPTIMIZER_NESTEROV_HPP
 
+#include <array>
+#include <ratio>
 
+#include "../config.hpp"
+#include "optimizer.hpp"
 
-#endif	/* SP_ALGO_NN_OPTIMIZER_NESTEROV_HPP */
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Gradient descent with Nesterov accelerated momentum
+ *
+ * The weights are kept at the look ahead position, i.e. the gradient is
+ * evaluated where the momentum is about to take them.
+ *
+ * \tparam LearningRate, a std::ratio instantiation designating the learning ratio
+ * \tparam Momentum the decay of the velocity
+ */
+template<typename LearningRate = default_learning_rate, typename Momentum = std::ratio<9, 10>>
+struct nesterov_optimizer : stateful_optimizer<1, nesterov_optimizer<LearningRate, Momentum>> {
 
+    float_t alpha = static_cast<float_t>(LearningRate::num) / static_cast<float_t>(LearningRate::den);
+
+    float_t mu = static_cast<float_t>(Momentum::num) / static_cast<float_t>(Momentum::den);
+
+    /**
+     * \brief Update n contiguous parameters w by their gradient dw times
+     *        scale, state holds the velocity
+     */
+    void update_block(float_t* w, const float_t* dw, const std::array<float_t*, 1>& state, const size_t& n, const float_t& scale) const {
+        const float_t rate = alpha * scale;
+        float_t* v = state[0];
+        #pragma omp simd
+        for(size_t i = 0; i < n; ++i) {
+            const float_t previous = v[i];
+            v[i] = mu * previous - rate * dw[i];
+            w[i] += (1 + mu) * v[i] - mu * previous;
+        }
+    }
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_OPTIMIZER_NESTEROV_HPP */
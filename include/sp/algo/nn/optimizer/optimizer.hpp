@@ -11,6 +11,7 @@
 
 #include <unordered_map>
 #include <array>
+#include <vector>
 #include <ratio>
 #include "../layer/layer.hpp"
 
@@ -24,19 +25,58 @@ using default_learning_rate = std::ratio<4, 100>;
 
 /**
  * \brief Optimizer abstract struct
+ *
+ * An optimizer implements one fused kernel, update_block, updating n
+ * contiguous parameters from their gradients, scaled by scale (i.e. the
+ * reciprocal of the batch size), and their state in a single sweep. The
+ * kernel is called concurrently for disjoint ranges, see
+ * parameter_registry. begin_step is called once before the updates of a
+ * step, e.g. to advance learning rate schedules or bias corrections.
  */
 template<typename Derived>
 struct optimizer {
 
     using derived_type = Derived;
 
-    template<typename Tensor>
-    void update(Tensor& dw, Tensor& w) {
+    /**
+     * \brief Number of values of state per parameter
+     */
+    constexpr static size_t state_size = 0;
+
+    /**
+     * \brief Update the parameters w of a tensor by the gradients dw times
+     *        scale
+     */
+    template<typename DeltaTensor, typename Tensor>
+    void update(DeltaTensor& dw, Tensor& w, const float_t& scale = 1.0f) {
         BOOST_ASSERT_MSG(
             dw.dimensions() == w.dimensions(),
             "dw and w dimensions must match"
         );
-        derived().update_impl(dw, w);
+        const size_t size = w.size();
+        derived().update_block(w.data(), dw.data(), derived().tensor_state(&dw, size), size, scale);
+    }
+
+    void begin_step() {}
+
+    /**
+     * \brief The state of the parameters of a tensor, keyed by the address
+     *        of its gradients
+     */
+    std::array<float_t*, 0> tensor_state(const void* key, const size_t& size) {
+        SP_UNUSED(key);
+        SP_UNUSED(size);
+        return {};
+    }
+
+    /**
+     * \brief The state of the parameters of a parameter_registry, see
+     *        stateful_optimizer::flat_state
+     */
+    std::array<float_t*, 0> flat_state(const void* owner, const size_t& size) {
+        SP_UNUSED(owner);
+        SP_UNUSED(size);
+        return {};
     }
 
     derived_type& derived() {
@@ -54,11 +94,50 @@ struct stateful_optimizer : optimizer<Derived> {
     /**
      * \brief Maps a memory address to a tensor of rank 1
      */
-    using state_map_type = std::unordered_map<void*, tensor_1>;
+    using state_map_type = std::unordered_map<const void*, tensor_1>;
 
     std::array<state_map_type, state_size> state;
-};
 
+    /**
+     * \brief The state of the size parameters of a single tensor, zeroed
+     *        on first use
+     */
+    std::array<float_t*, state_size> tensor_state(const void* key, const size_t& size) {
+        std::array<float_t*, state_size> arrays;
+        for(size_t i = 0; i < state_size; ++i) {
+            tensor_1& t = state[i][key];
+            if(static_cast<size_t>(t.size()) != size) {
+                t.resize(size);
+                t.setZero();
+            }
+            arrays[i] = t.data();
+        }
+        return arrays;
+    }
+
+    /**
+     * \brief The state of the size parameters of a parameter_registry,
+     *        state_size arrays parallel to its parameters. Zeroed whenever
+     *        the registry (owner) or its size changes, i.e. one optimizer
+     *        follows one registry.
+     */
+    std::array<float_t*, state_size> flat_state(const void* owner, const size_t& size) {
+        if(owner != flat_owner || size != flat_size) {
+            flat.assign(state_size * size, float_t(0));
+            flat_owner = owner;
+            flat_size = size;
+        }
+        std::array<float_t*, state_size> arrays;
+        for(size_t i = 0; i < state_size; ++i) {
+            arrays[i] = flat.data() + i * size;
+        }
+        return arrays;
+    }
+
+    std::vector<float_t, Eigen::aligned_allocator<float_t>> flat;
+    const void* flat_owner = nullptr;
+    size_t flat_size = 0;
+};
 
 SP_ALGO_NN_NAMESPACE_END
 
@@ -9,7 +9,46 @@
 #ifndef SP_ALGO_NN_OPTIMIZER_RMSPROP_HPP
 #define SP_ALGO_NN_OPTIMIZER_RMSPROP_HPP
 
+#include <array>
+#include <cmath>
+#include <ratio>
 
+#include "../config.hpp"
+#include "optimizer.hpp"
 
-#endif	/* SP_ALGO_NN_OPTIMIZER_RMSPROP_HPP */
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief RMSProp Optimizer, the step is normalized by a running average of
+ *        the squared gradients
+ *
+ * \tparam LearningRate, a std::ratio instantiation designating the learning ratio
+ * \tparam Decay the decay of the running average
+ */
+template<typename LearningRate = std::ratio<1, 1000>, typename Decay = std::ratio<9, 10>>
+struct rmsprop_optimizer : stateful_optimizer<1, rmsprop_optimizer<LearningRate, Decay>> {
+
+    float_t alpha = static_cast<float_t>(LearningRate::num) / static_cast<float_t>(LearningRate::den);
 
+    float_t rho = static_cast<float_t>(Decay::num) / static_cast<float_t>(Decay::den);
+
+    constexpr static float_t epsilon = 1.0e-8f;
+
+    /**
+     * \brief Update n contiguous parameters w by their gradient dw times
+     *        scale, state holds the running average of squared gradients
+     */
+    void update_block(float_t* w, const float_t* dw, const std::array<float_t*, 1>& state, const size_t& n, const float_t& scale) const {
+        float_t* g = state[0];
+        #pragma omp simd
+        for(size_t i = 0; i < n; ++i) {
+            const float_t d = dw[i] * scale;
+            g[i] = rho * g[i] + (1 - rho) * d * d;
+            w[i] -= (alpha * d) / (std::sqrt(g[i]) + epsilon);
+        }
+    }
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_OPTIMIZER_RMSPROP_HPP */
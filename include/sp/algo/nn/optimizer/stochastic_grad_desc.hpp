@@ -9,7 +9,84 @@
 #ifndef SP_ALGO_NN_OPTIMIZER_SGD_HPP
 #define SP_ALGO_NN_OPTIMIZER_SGD_HPP
 
+#include <array>
+#include <ratio>
 
+#include "../config.hpp"
+#include "optimizer.hpp"
 
-#endif	/* SP_ALGO_NN_OPTIMIZER_SGD_HPP */
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Learning rate schedule of stochastic_gradient_descent_optimizer
+ */
+enum class learning_rate_policy {
+    /**
+     * \brief The initial learning rate throughout
+     */
+    fixed,
+
+    /**
+     * \brief The learning rate is multiplied by Gamma every Step steps
+     */
+    step
+};
+
+/**
+ * \brief Stochastic Gradient Descent Optimizer with a learning rate schedule
+ *
+ * \tparam InitialRate, a std::ratio instantiation designating the initial
+ *         learning ratio
+ * \tparam Policy the learning rate schedule
+ * \tparam Step the steps between learning rate decays (step policy)
+ * \tparam Gamma the learning rate decay (step policy)
+ */
+template<
+    typename InitialRate = default_learning_rate,
+    learning_rate_policy Policy = learning_rate_policy::fixed,
+    size_t Step = 1,
+    typename Gamma = std::ratio<1, 10>
+>
+struct stochastic_gradient_descent_optimizer :
+        optimizer<stochastic_gradient_descent_optimizer<InitialRate, Policy, Step, Gamma>> {
 
+    static_assert(Step > 0, "Step is greater than zero");
+
+    float_t alpha = static_cast<float_t>(InitialRate::num) / static_cast<float_t>(InitialRate::den);
+
+    float_t gamma = static_cast<float_t>(Gamma::num) / static_cast<float_t>(Gamma::den);
+
+    /**
+     * \brief Decay the learning rate at the end of every Step steps
+     */
+    void begin_step() {
+        if constexpr(Policy == learning_rate_policy::step) {
+            if(steps > 0 && steps % Step == 0) {
+                alpha *= gamma;
+            }
+        }
+        ++steps;
+    }
+
+    /**
+     * \brief Update n contiguous parameters w by their gradient dw times
+     *        scale
+     */
+    void update_block(float_t* w, const float_t* dw, const std::array<float_t*, 0>& state, const size_t& n, const float_t& scale) const {
+        SP_UNUSED(state);
+        const float_t rate = alpha * scale;
+        #pragma omp simd
+        for(size_t i = 0; i < n; ++i) {
+            w[i] -= rate * dw[i];
+        }
+    }
+
+    /**
+     * \brief Steps begun
+     */
+    size_t steps = 0;
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_OPTIMIZER_SGD_HPP */
@@ -0,0 +1,284 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_PARAMETERS_HPP
+#define SP_ALGO_NN_PARAMETERS_HPP
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <boost/assert.hpp>
+
+#include "sp/util/for_each.hpp"
+#include "sp/util/hints.hpp"
+
+#include "config.hpp"
+#include "matrix.hpp"
+#include "types.hpp"
+#include "memory_plan.hpp"
+#include "layer/detail/layers.hpp"
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Flat storage of the trainable parameters of a network
+ *
+ * The weights and biases of all layers are laid out back to back in one
+ * aligned arena and their gradient slots in another, every tensor padded to
+ * the arena alignment. The tensors of the layers are bound to the arenas
+ * (see parameter_tensor::bind), layers and engines use them as before.
+ *
+ * An optimizer step is one pass over the arenas, split into cache sized
+ * tiles run in parallel: the gradient slots of a tile are reduced and the
+ * optimizer updates the tile in place right away (update_block), scaling the
+ * sums by the reciprocal of the samples the layer accumulated. Stateful
+ * optimizers keep their state in arrays parallel to the parameters
+ * (flat_state), i.e. a step does not look up state per tensor.
+ */
+struct parameter_registry {
+
+    /**
+     * \brief A tensor of the registry, the weights or biases of a layer
+     */
+    struct segment {
+
+        /**
+         * \brief Offset of the parameters, and of the optimizer state
+         */
+        size_t offset;
+
+        /**
+         * \brief Number of parameters
+         */
+        size_t size;
+
+        /**
+         * \brief Offset of the gradient slots, slots times size values
+         */
+        size_t gradients;
+
+        size_t slots;
+
+        /**
+         * \brief Index of the layer within the network
+         */
+        size_t layer;
+
+        /**
+         * \brief The layer keeps a copy of the parameters in storage
+         *        precision, refreshed by the update tile by tile
+         */
+        bool stored;
+    };
+
+    /**
+     * \brief A tile of a segment updated by one thread, see
+     *        detail::apply_gradient_tile
+     */
+    struct chunk {
+        size_t segment;
+        size_t first;
+        size_t size;
+    };
+
+    parameter_registry() = default;
+    parameter_registry(const parameter_registry&) = delete;
+    parameter_registry& operator=(const parameter_registry&) = delete;
+
+    /**
+     * \brief Lay out the parameters of the configured layers and bind them,
+     *        the current values are kept. The gradient slots are bound in
+     *        training mode only.
+     */
+    template<typename Layers>
+    void configure(Layers& layers, bool training) {
+        std::vector<segment> layout;
+        size_t parameters_floats = 0;
+        size_t gradients_floats = 0;
+        for_each_parameter(layers, [&](const size_t& layer, auto& w, auto& dw, bool stored) {
+            const size_t size = w.size();
+            const size_t slots = training && size > 0 ? dw.size() / size : 0;
+            layout.push_back({parameters_floats, size, gradients_floats, slots, layer, stored});
+            parameters_floats += detail::arena_padded(size);
+            gradients_floats += detail::arena_padded(slots * size);
+        });
+
+        /* Bind into new arenas before the current ones are released */
+        detail::arena_storage next_parameters;
+        detail::arena_storage next_gradients;
+        next_parameters.prepare(parameters_floats);
+        next_gradients.prepare(gradients_floats);
+        size_t n = 0;
+        for_each_parameter(layers, [&](const size_t&, auto& w, auto& dw, bool) {
+            const segment& seg = layout[n++];
+            if(seg.size > 0) {
+                w.bind(next_parameters.data() + seg.offset);
+            }
+            if(seg.slots > 0) {
+                dw.bind(next_gradients.data() + seg.gradients);
+            }
+        });
+        parameters_arena = std::move(next_parameters);
+        gradients_arena = std::move(next_gradients);
+        parameters_size = parameters_floats;
+        segments = std::move(layout);
+        scales.assign(std::tuple_size_v<std::decay_t<Layers>>, float_t(1));
+
+        chunks.clear();
+        for(size_t s = 0; s < segments.size(); ++s) {
+            if(segments[s].slots == 0) {
+                continue;
+            }
+            const size_t tile = detail::gradient_tile_size(segments[s].slots);
+            for(size_t first = 0; first < segments[s].size; first += tile) {
+                chunks.push_back({s, first, std::min(tile, segments[s].size - first)});
+            }
+        }
+    }
+
+    /**
+     * \brief Apply the gradients accumulated by the layers to weights, the
+     *        parameters of this registry or of a registry of the same layout,
+     *        and clear them. The accumulated samples of the layers are left
+     *        to the caller. Updating the parameters of this registry also
+     *        refreshes the stored weights of the layers (see
+     *        layer::weights_updated), those of another registry are left to
+     *        its network.
+     */
+    template<typename Optimizer, typename Layers>
+    void update(Optimizer& optimizer, Layers& layers, float_t* weights) {
+        BOOST_ASSERT_MSG(!chunks.empty() || segments.empty(), "Registry is configured for training");
+        size_t index = 0;
+        util::for_each(layers, [&](auto& layer) {
+            scales[index++] = 1.0f / static_cast<float_t>(std::max<size_t>(layer.accumulated_samples, 1));
+        });
+        optimizer.begin_step();
+        const auto state = optimizer.flat_state(this, parameters_size);
+        float_t* gradients = gradients_arena.data();
+        const size_t count = chunks.size();
+        const bool own = weights == parameters_arena.data();
+
+        #pragma omp parallel for
+        for(size_t c = 0; c < count; ++c) {
+            const chunk& ch = chunks[c];
+            const segment& seg = segments[ch.segment];
+            detail::apply_gradient_tile(
+                optimizer,
+                weights + seg.offset,
+                gradients + seg.gradients,
+                seg.slots,
+                seg.size,
+                offset_state(state, seg.offset),
+                scales[seg.layer],
+                ch.first,
+                ch.size
+            );
+            if(own && seg.stored) {
+                store_weights(layers, seg.layer, ch.first, ch.size);
+            }
+        }
+    }
+
+    /**
+     * \brief Release the arenas, the layers view external memory instead
+     *        (e.g. a mapped checkpoint, see parameter_tensor::map)
+     */
+    void release() {
+        parameters_arena = detail::arena_storage();
+        gradients_arena = detail::arena_storage();
+        parameters_size = 0;
+        segments.clear();
+        chunks.clear();
+    }
+
+    /**
+     * \brief Number of values of the parameter arena, including padding
+     */
+    size_t size() const {
+        return parameters_size;
+    }
+
+    float_t* parameters() {
+        return parameters_arena.data();
+    }
+
+    float_t* gradients() {
+        return gradients_arena.data();
+    }
+
+    const std::vector<segment>& layout() const {
+        return segments;
+    }
+
+protected:
+
+    /**
+     * \brief The state arrays of the segment at offset
+     */
+    template<typename State>
+    static State offset_state(State state, const size_t& offset) {
+        for(auto& st : state) {
+            st += offset;
+        }
+        return state;
+    }
+
+    /**
+     * \brief Refresh the stored weights [first, first + count) of the layer
+     *        at index
+     */
+    template<typename Layers>
+    static void store_weights(Layers& layers, const size_t& index, const size_t& first, const size_t& count) {
+        size_t i = 0;
+        util::for_each(layers, [&](auto& layer) {
+            if constexpr(detail::has_weight_storage_v<std::decay_t<decltype(layer)>>) {
+                if(i == index) {
+                    layer.store_weights(first, count);
+                }
+            }
+            ++i;
+        });
+    }
+
+    /**
+     * \brief Call f(layer index, parameters, gradient slots, stored) for the
+     *        weights and the biases of every layer, in network order, stored
+     *        if the layer keeps a copy of the parameters in storage precision
+     */
+    template<typename Layers, typename F>
+    static void for_each_parameter(Layers& layers, F f) {
+        size_t index = 0;
+        util::for_each(layers, [&](auto& layer) {
+            using layer_type = std::decay_t<decltype(layer)>;
+            if constexpr(detail::has_weight_and_delta_v<layer_type>) {
+                f(index, layer.w, layer.dw, detail::has_weight_storage_v<layer_type>);
+            }
+            if constexpr(detail::has_bias_and_delta_v<layer_type>) {
+                f(index, layer.b, layer.db, false);
+            }
+            ++index;
+        });
+    }
+
+    detail::arena_storage parameters_arena;
+    detail::arena_storage gradients_arena;
+    size_t parameters_size = 0;
+
+    std::vector<segment> segments;
+    std::vector<chunk> chunks;
+
+    /**
+     * \brief Gradient scale of every layer, refreshed every update
+     */
+    std::vector<float_t> scales;
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_PARAMETERS_HPP */
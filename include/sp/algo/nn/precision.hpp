@@ -0,0 +1,239 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_PRECISION_HPP
+#define SP_ALGO_NN_PRECISION_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__F16C__) || defined(__AVX2__) || defined(__AVX512BF16__)
+#include <immintrin.h>
+#endif
+
+#include "config.hpp"
+
+/**
+ * \file Storage precision policies
+ *
+ * A precision policy separates the type values are stored in from the type
+ * they are accumulated in. Only the weights of fully connected layers are
+ * stored in reduced precision, halving the weight bytes read by their
+ * propagation, activations and gradients remain float_t (fp32) as does all
+ * arithmetic. Conversions use F16C and AVX-512 BF16 where the target
+ * supports them.
+ */
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Brain floating point, the upper half of an IEEE 754 binary32
+ */
+struct bfloat16_t {
+    std::uint16_t bits;
+};
+
+/**
+ * \brief IEEE 754 binary16
+ */
+struct half_t {
+    std::uint16_t bits;
+};
+
+/**
+ * \brief Precision policy storing values as Storage and accumulating in
+ *        float_t
+ */
+template<typename Storage>
+struct precision {
+
+    using storage_type = Storage;
+
+    using accumulator_type = float_t;
+
+    /**
+     * \brief Whether storage is narrower than the accumulator, i.e. needs
+     *        conversion
+     */
+    constexpr static bool reduced = !std::is_same_v<Storage, float_t>;
+
+    static_assert(!reduced || std::is_same_v<float_t, float>, "Reduced precision storage requires a binary32 float_t");
+};
+
+using fp32_precision = precision<float_t>;
+
+using bf16_precision = precision<bfloat16_t>;
+
+using fp16_precision = precision<half_t>;
+
+SP_ALGO_NN_NAMESPACE_END
+
+SP_ALGO_NN_DETAIL_NAMESPACE_BEGIN
+
+inline std::uint32_t float_bits(const float& f) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+inline float bits_float(const std::uint32_t& bits) {
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/**
+ * \brief Round to nearest even, NaN stays a (quiet) NaN
+ */
+inline bfloat16_t to_bfloat16(const float& f) {
+    const std::uint32_t bits = float_bits(f);
+    if((bits & 0x7fffffffu) > 0x7f800000u) {
+        return {static_cast<std::uint16_t>((bits >> 16) | 0x40u)};
+    }
+    return {static_cast<std::uint16_t>((bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16)};
+}
+
+inline float from_bfloat16(const bfloat16_t& h) {
+    return bits_float(static_cast<std::uint32_t>(h.bits) << 16);
+}
+
+/**
+ * \brief Round to nearest even, with subnormals, overflow to infinity
+ */
+inline half_t to_half(const float& f) {
+    const std::uint32_t bits = float_bits(f);
+    const std::uint16_t sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+    const std::uint32_t abs = bits & 0x7fffffffu;
+    if(abs >= 0x7f800000u) {
+        /* Infinity or NaN */
+        return {static_cast<std::uint16_t>(sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0u))};
+    }
+    if(abs >= 0x477ff000u) {
+        /* Rounds above the largest half (65504) */
+        return {static_cast<std::uint16_t>(sign | 0x7c00u)};
+    }
+    if(abs < 0x38800000u) {
+        /* Subnormal half (or zero), align the implicit bit and round */
+        if(abs < 0x33000000u) {
+            return {sign};
+        }
+        const std::uint32_t exponent = abs >> 23;
+        const std::uint32_t mantissa = (abs & 0x7fffffu) | 0x800000u;
+        const std::uint32_t shift = 126 - exponent;
+        const std::uint32_t half = 1u << (shift - 1);
+        const std::uint32_t rest = mantissa & ((1u << shift) - 1);
+        std::uint32_t value = mantissa >> shift;
+        if(rest > half || (rest == half && (value & 1u))) {
+            ++value;
+        }
+        return {static_cast<std::uint16_t>(sign | value)};
+    }
+    /* Normal, rebias the exponent and round the mantissa */
+    const std::uint32_t rounded = abs + 0xfffu + ((abs >> 13) & 1u);
+    return {static_cast<std::uint16_t>(sign | ((rounded - 0x38000000u) >> 13))};
+}
+
+inline float from_half(const half_t& h) {
+    const std::uint32_t sign = static_cast<std::uint32_t>(h.bits & 0x8000u) << 16;
+    const std::uint32_t exponent = (h.bits >> 10) & 0x1fu;
+    const std::uint32_t mantissa = h.bits & 0x3ffu;
+    if(exponent == 0x1fu) {
+        return bits_float(sign | 0x7f800000u | (mantissa << 13));
+    }
+    if(exponent == 0) {
+        /* Zero or subnormal, exactly representable as float */
+        const float value = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+        return sign ? -value : value;
+    }
+    return bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+/**
+ * \brief Convert n accumulator values into storage
+ */
+inline void to_storage(const float_t* src, float_t* dst, const size_t& n) {
+    std::copy(src, src + n, dst);
+}
+
+inline void to_storage(const float* src, bfloat16_t* dst, const size_t& n) {
+    size_t i = 0;
+#ifdef __AVX512BF16__
+    for(; i + 16 <= n; i += 16) {
+        const __m256bh v = _mm512_cvtneps_pbh(_mm512_loadu_ps(src + i));
+        std::memcpy(dst + i, &v, sizeof(v));
+    }
+#elif defined(__AVX2__)
+    /* Rounds as to_bfloat16, NaN are kept quiet */
+    const __m256i magnitude = _mm256_set1_epi32(0x7fffffff);
+    const __m256i infinity = _mm256_set1_epi32(0x7f800000);
+    const __m256i half = _mm256_set1_epi32(0x7fff);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i quiet = _mm256_set1_epi32(0x400000);
+    for(; i + 16 <= n; i += 16) {
+        __m256i upper[2];
+        for(size_t h = 0; h < 2; ++h) {
+            const __m256i bits = _mm256_castps_si256(_mm256_loadu_ps(src + i + h * 8));
+            const __m256i rounded = _mm256_add_epi32(bits, _mm256_add_epi32(half, _mm256_and_si256(_mm256_srli_epi32(bits, 16), one)));
+            const __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(bits, magnitude), infinity);
+            upper[h] = _mm256_srli_epi32(_mm256_blendv_epi8(rounded, _mm256_or_si256(bits, quiet), nan), 16);
+        }
+        /* The pack interleaves the 128 bit lanes of both halves */
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(upper[0], upper[1]), 0xd8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+#endif
+    for(; i < n; ++i) {
+        dst[i] = to_bfloat16(src[i]);
+    }
+}
+
+inline void to_storage(const float* src, half_t* dst, const size_t& n) {
+    size_t i = 0;
+#ifdef __F16C__
+    for(; i + 8 <= n; i += 8) {
+        const __m128i v = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+#endif
+    for(; i < n; ++i) {
+        dst[i] = to_half(src[i]);
+    }
+}
+
+/**
+ * \brief Convert n stored values into accumulator values
+ */
+inline void from_storage(const float_t* src, float_t* dst, const size_t& n) {
+    std::copy(src, src + n, dst);
+}
+
+inline void from_storage(const bfloat16_t* src, float* dst, const size_t& n) {
+    /* A shift, vectorized by the compiler */
+    for(size_t i = 0; i < n; ++i) {
+        dst[i] = from_bfloat16(src[i]);
+    }
+}
+
+inline void from_storage(const half_t* src, float* dst, const size_t& n) {
+    size_t i = 0;
+#ifdef __F16C__
+    for(; i + 8 <= n; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(v));
+    }
+#endif
+    for(; i < n; ++i) {
+        dst[i] = from_half(src[i]);
+    }
+}
+
+SP_ALGO_NN_DETAIL_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_PRECISION_HPP */
@@ -0,0 +1,828 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_ALGO_NN_QUANTIZATION_HPP
+#define SP_ALGO_NN_QUANTIZATION_HPP
+
+#include <tuple>
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <boost/assert.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "sp/util/parallel.hpp"
+#include "sp/util/hints.hpp"
+
+#include "config.hpp"
+#include "matrix.hpp"
+#include "types.hpp"
+#include "network.hpp"
+#include "fusion.hpp"
+#include "layer.hpp"
+
+/**
+ * \file Post-training int8 quantization
+ *
+ * A trained network is quantized by calibrating the range of the inputs of
+ * its fully connected and convolutional layers on a set of samples. Weights
+ * are quantized symmetrically to int8 with one scale per output channel,
+ * inputs asymmetrically to unsigned integers with a scale and zero point per
+ * layer. The products are accumulated in int32 and dequantized in the
+ * epilogue of the kernel, fused with the bias and the following unary
+ * activation. If the next quantized layer directly follows, the epilogue
+ * requantizes into its input instead of writing floats.
+ */
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Affine quantization of floats into [0, levels] as
+ *        '''q = round(x / scale) + zero_point'''
+ */
+struct quantization_params {
+
+    /**
+     * \brief Largest quantized input. Without VNNI (AVX-512 VNNI on 256 bit
+     *        vectors, or AVX-VNNI) the products are summed pairwise into
+     *        int16 (pmaddubsw) which saturates for 8 bit inputs, inputs are
+     *        then limited to 7 bits.
+     */
+#if (defined(__AVX512VNNI__) && defined(__AVX512VL__)) || defined(__AVXVNNI__)
+    constexpr static std::int32_t levels = 255;
+#else
+    constexpr static std::int32_t levels = 127;
+#endif
+
+    /**
+     * \brief Parameters covering [min, max], the range is extended to
+     *        include zero such that zero (padding) is exact
+     */
+    static quantization_params from_range(float_t min, float_t max) {
+        min = std::min<float_t>(min, 0);
+        max = std::max<float_t>(max, 0);
+        quantization_params params;
+        params.scale = max > min ? (max - min) / levels : float_t(1);
+        params.inverse_scale = 1 / params.scale;
+        params.zero_point = std::clamp<std::int32_t>(static_cast<std::int32_t>(std::nearbyint(-min / params.scale)), 0, levels);
+        return params;
+    }
+
+    std::uint8_t quantize(const float_t& x) const {
+        const std::int32_t q = static_cast<std::int32_t>(std::nearbyint(x * inverse_scale)) + zero_point;
+        return static_cast<std::uint8_t>(std::clamp<std::int32_t>(q, 0, levels));
+    }
+
+    float_t dequantize(const std::uint8_t& q) const {
+        return (static_cast<std::int32_t>(q) - zero_point) * scale;
+    }
+
+    float_t scale = 1;
+    float_t inverse_scale = 1;
+    std::int32_t zero_point = 0;
+};
+
+/**
+ * \brief Accuracy of a network and its quantized counterpart on the same
+ *        samples, see compare_quantization
+ */
+struct quantization_report {
+    size_t samples = 0;
+    size_t reference_correct = 0;
+    size_t quantized_correct = 0;
+
+    float_t reference_accuracy() const {
+        return static_cast<float_t>(reference_correct) / samples;
+    }
+
+    float_t quantized_accuracy() const {
+        return static_cast<float_t>(quantized_correct) / samples;
+    }
+
+    /**
+     * \brief Accuracy lost by quantization, negative if it improved
+     */
+    float_t accuracy_delta() const {
+        return reference_accuracy() - quantized_accuracy();
+    }
+};
+
+SP_ALGO_NN_NAMESPACE_END
+
+SP_ALGO_NN_DETAIL_NAMESPACE_BEGIN
+
+/**
+ * \brief Length of the rows of the quantized operands, rows are zero
+ *        padded to the width of the (256 bit) vectors of the kernels such
+ *        that the dot products need no tail
+ */
+constexpr size_t quantized_row_alignment = 32;
+
+constexpr size_t quantized_row_length(const size_t& n) {
+    return (n + quantized_row_alignment - 1) / quantized_row_alignment * quantized_row_alignment;
+}
+
+/**
+ * \brief Register tile of the int8 kernels, rows of the inputs (samples or
+ *        output pixels) times output channels. The operands are padded to
+ *        whole tiles with zero rows.
+ */
+constexpr size_t quantized_tile_rows = 2;
+constexpr size_t quantized_tile_kernels = 4;
+
+constexpr size_t quantized_tile_padded(const size_t& n, const size_t& tile) {
+    return (n + tile - 1) / tile * tile;
+}
+
+#if defined(__AVX2__)
+/**
+ * \brief acc plus the sums of groups of four products of unsigned 8 bit a
+ *        and signed 8 bit b
+ */
+inline __m256i dpbusd_u8s8(const __m256i& acc, const __m256i& a, const __m256i& b) {
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+    return _mm256_dpbusd_epi32(acc, a, b);
+#elif defined(__AVXVNNI__)
+    return _mm256_dpbusd_avx_epi32(acc, a, b);
+#else
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(a, b), _mm256_set1_epi16(1)));
+#endif
+}
+#endif
+
+/**
+ * \brief Dot products of a tile, acc[r][k] of row r of the unsigned 8 bit
+ *        inputs a and row k of the signed 8 bit weights b, accumulated in
+ *        int32. The rows of both are n apart and n is a multiple of
+ *        quantized_row_alignment.
+ *
+ * Every row of a is loaded once for all kernels of the tile, and the four
+ * sums of a row are reduced together.
+ */
+inline void dot_tile_u8s8(const std::uint8_t* a, const std::int8_t* b, const size_t& n, std::int32_t (&acc)[quantized_tile_rows][quantized_tile_kernels]) {
+#if defined(__AVX2__)
+    static_assert(quantized_tile_kernels == 4, "The sums of a row are reduced into one 128 bit vector");
+    __m256i sums[quantized_tile_rows][quantized_tile_kernels];
+    for(auto& row : sums) {
+        for(auto& sum : row) {
+            sum = _mm256_setzero_si256();
+        }
+    }
+    for(size_t i = 0; i < n; i += 32) {
+        __m256i w[quantized_tile_kernels];
+        for(size_t k = 0; k < quantized_tile_kernels; ++k) {
+            w[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + k * n + i));
+        }
+        for(size_t r = 0; r < quantized_tile_rows; ++r) {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + r * n + i));
+            for(size_t k = 0; k < quantized_tile_kernels; ++k) {
+                sums[r][k] = dpbusd_u8s8(sums[r][k], x, w[k]);
+            }
+        }
+    }
+    for(size_t r = 0; r < quantized_tile_rows; ++r) {
+        const __m256i pairs = _mm256_hadd_epi32(
+            _mm256_hadd_epi32(sums[r][0], sums[r][1]),
+            _mm256_hadd_epi32(sums[r][2], sums[r][3])
+        );
+        const __m128i total = _mm_add_epi32(_mm256_castsi256_si128(pairs), _mm256_extracti128_si256(pairs, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc[r]), total);
+    }
+#else
+    for(size_t r = 0; r < quantized_tile_rows; ++r) {
+        for(size_t k = 0; k < quantized_tile_kernels; ++k) {
+            std::int32_t sum = 0;
+            for(size_t i = 0; i < n; ++i) {
+                sum += static_cast<std::int32_t>(a[r * n + i]) * static_cast<std::int32_t>(b[k * n + i]);
+            }
+            acc[r][k] = sum;
+        }
+    }
+#endif
+}
+
+/**
+ * \brief Quantized weights and inputs of a fully connected or
+ *        convolutional layer
+ *
+ * The weights are a (kernels x ld) matrix, row k holds the kernel of output
+ * channel k in the order of the (lowered) input, i.e. (C, R, S) for
+ * convolutions, padded with zero rows to whole tiles of kernels. The accumulator of output channel k is dequantized by
+ * '''(acc - zero_point * weight_sums[k]) * scales[k]'''.
+ */
+struct quantized_kernel {
+
+    /**
+     * \brief Quantize the weights (kernels x depth, row major) per output
+     *        channel, and the bias
+     */
+    void quantize_weights(const std::vector<float_t>& dense, const float_t* b, const size_t& kernels, const size_t& depth) {
+        this->kernels = kernels;
+        this->depth = depth;
+        ld = quantized_row_length(depth);
+        weights.assign(quantized_tile_padded(kernels, quantized_tile_kernels) * ld, 0);
+        weight_sums.assign(kernels, 0);
+        scales.assign(kernels, 0);
+        if(b) {
+            bias.assign(b, b + kernels);
+        } else {
+            bias.assign(kernels, 0);
+        }
+        for(size_t k = 0; k < kernels; ++k) {
+            const float_t* row = dense.data() + k * depth;
+            float_t max = 0;
+            for(size_t i = 0; i < depth; ++i) {
+                max = std::max(max, std::abs(row[i]));
+            }
+            const float_t scale = max > 0 ? max / 127 : float_t(1);
+            for(size_t i = 0; i < depth; ++i) {
+                const std::int32_t q = std::clamp<std::int32_t>(static_cast<std::int32_t>(std::nearbyint(row[i] / scale)), -127, 127);
+                weights[k * ld + i] = static_cast<std::int8_t>(q);
+                weight_sums[k] += q;
+            }
+            scales[k] = scale * input.scale;
+        }
+    }
+
+    /**
+     * \brief Quantize samples of input_size floats into the (padded) rows
+     *        of inputs
+     */
+    void quantize_inputs(const float_t* in, const size_t& samples, const size_t& input_size) {
+        #pragma omp parallel for
+        for(size_t s = 0; s < samples; ++s) {
+            std::uint8_t* q = inputs.data() + s * input_ld;
+            for(size_t i = 0; i < input_size; ++i) {
+                q[i] = input.quantize(in[s * input_size + i]);
+            }
+        }
+    }
+
+    /**
+     * \brief Dequantized accumulator of output channel k
+     */
+    float_t dequantize(const std::int32_t& acc, const size_t& k) const {
+        return (acc - input.zero_point * weight_sums[k]) * scales[k] + bias[k];
+    }
+
+    size_t kernels = 0;
+    size_t depth = 0;
+    size_t ld = 0;
+
+    std::vector<std::int8_t> weights;
+    std::vector<std::int32_t> weight_sums;
+
+    /**
+     * \brief Input scale times the weight scale of every output channel
+     */
+    std::vector<float_t> scales;
+    std::vector<float_t> bias;
+
+    /**
+     * \brief Quantization of the input, and the quantized inputs of a
+     *        batch, input_ld per sample and padded to whole tiles of rows
+     */
+    quantization_params input;
+    std::vector<std::uint8_t> inputs;
+    size_t input_ld = 0;
+
+    /**
+     * \brief Lowered (im2col) receptive fields, one (PQ x ld) matrix per
+     *        thread, PQ padded to whole tiles of rows. Convolutions only.
+     */
+    std::vector<std::uint8_t> columns;
+
+    /**
+     * \brief Dequantized outputs awaiting the activation, one sample
+     *        (kernels x PQ) per thread for convolutions, the batch
+     *        (samples x kernels) for fully connected layers
+     */
+    std::vector<float_t> outputs;
+};
+
+/**
+ * \brief Apply the activation Op to n values in place, tanh through the
+ *        vectorized Eigen array function
+ */
+template<typename Op>
+void activate_elements(float_t* y, const size_t& n) {
+    if constexpr(std::is_same_v<Op, tanh_activation_op>) {
+        Eigen::Map<Eigen::Array<float_t, Eigen::Dynamic, 1>> values(y, n);
+        values = values.tanh();
+    } else {
+        #pragma omp simd
+        for(size_t i = 0; i < n; ++i) {
+            y[i] = static_cast<float_t>(Op()(y[i]));
+        }
+    }
+}
+
+/**
+ * \brief Check if a layer has int8 kernels, i.e. fully connected and
+ *        convolutional layers
+ */
+template<typename Layer>
+constexpr bool is_quantizable_layer_v = is_fully_connected_layer<Layer>::value || is_conv_layer<Layer>::value;
+
+/**
+ * \brief Dimensions of the values of a network, the input of every layer
+ *        and the output of the last
+ */
+template<typename Layers>
+struct layer_value_dims;
+
+template<typename... Layers>
+struct layer_value_dims<std::tuple<Layers...>> {
+    using type = std::tuple<
+        typename Layers::input_dims...,
+        typename std::tuple_element_t<sizeof...(Layers) - 1, std::tuple<Layers...>>::output_dims
+    >;
+};
+
+SP_ALGO_NN_DETAIL_NAMESPACE_END
+
+SP_ALGO_NN_NAMESPACE_BEGIN
+
+/**
+ * \brief Int8 inference network derived from a trained network
+ *
+ * Holds copies of the layers of the trained network configured for
+ * inference. Fully connected and convolutional layers run int8 kernels,
+ * every other layer runs in float as in the trained network. A unary
+ * activation following a quantized layer is applied in its epilogue.
+ *
+ * The weights are quantized from the trained network at construction, the
+ * trained network is not referenced afterwards.
+ *
+ * \tparam Network the trained network type, see #basic_network
+ */
+template<typename Network>
+struct quantized_network {
+
+    using layers_type = typename Network::layers_type;
+    constexpr static size_t layers_count = Network::layers_count;
+
+    using input_dims = typename Network::input_dims;
+    using output_dims = typename Network::output_dims;
+
+    /**
+     * \brief Whether layer I runs an int8 kernel
+     */
+    template<size_t I>
+    constexpr static bool quantized_v = detail::is_quantizable_layer_v<std::tuple_element_t<I, layers_type>>;
+
+    /**
+     * \brief Number of layers executed as one stage starting at layer I, a
+     *        quantized layer and the unary activation following it
+     */
+    template<size_t I>
+    constexpr static size_t stage_length() {
+        if constexpr(quantized_v<I> && I + 1 < layers_count) {
+            return detail::is_unary_activation_layer<std::tuple_element_t<I + 1, layers_type>>::value ? 2 : 1;
+        } else {
+            return 1;
+        }
+    }
+
+    /**
+     * \brief Whether the epilogue of the stage starting at layer I
+     *        quantizes into the input of the next stage, i.e. both are
+     *        quantized
+     */
+    template<size_t I>
+    constexpr static bool requantizes() {
+        constexpr size_t next = I + stage_length<I>();
+        if constexpr(quantized_v<I> && next < layers_count) {
+            return quantized_v<next>;
+        } else {
+            return false;
+        }
+    }
+
+    /**
+     * \brief Quantize the trained network, calibrating the inputs of the
+     *        quantized layers on the calibration samples
+     *
+     * \param batch_size the largest batch of forward, see configure
+     */
+    quantized_network(const Network& trained, const sample_vector_type& calibration, const size_t& batch_size = 64) :
+            layers(trained.layers) {
+        BOOST_ASSERT_MSG(!calibration.empty(), "Calibration samples are given");
+        configure(batch_size);
+        calibrate(calibration);
+    }
+
+    /**
+     * \brief Size the buffers for batches of up to batch_size samples
+     */
+    void configure(const size_t& batch_size) {
+        BOOST_ASSERT_MSG(batch_size > 0, "Batch size is greater than zero");
+        if(batch_size <= batch_capacity) {
+            return;
+        }
+        util::for_each(layers, [&](auto& layer) {
+            layer.configure(batch_size, false, network_mode::inference);
+        });
+        configure_values(batch_size, std::make_index_sequence<layers_count + 1>());
+        configure_kernels(batch_size, std::make_index_sequence<layers_count>());
+        batch_capacity = batch_size;
+    }
+
+    /**
+     * \brief Forward propagation of at most max_batch_size() samples, the
+     *        output is valid until the next forward
+     */
+    sp_hot tensor_4_view forward(tensor_4_view input) {
+        const size_t samples = input.dimension(0);
+        BOOST_ASSERT_MSG(samples > 0 && samples <= batch_capacity, "Batch size is within the configured maximum");
+        BOOST_ASSERT(detail::validate_dimensions<input_dims>(samples, input));
+        SP_UNUSED(samples);
+        carve_values(input, std::make_index_sequence<layers_count + 1>());
+        forward_stage<0, false>();
+        return values[layers_count];
+    }
+
+    /**
+     * \brief Test on samples as basic_network::test, in batches of
+     *        max_batch_size()
+     */
+    auto test(const sample_vector_type& samples, const class_vector_type& classes) {
+        BOOST_ASSERT(samples.size() == classes.size());
+        constexpr size_t class_count = output_dims::size;
+        test_results result{0, samples.size(), confusion_matrix::Zero(class_count, class_count)};
+        for_each_batch(samples, [&](const size_t& first, tensor_4_view in) {
+            tensor_4_view out = forward(in);
+            for(long s = 0; s < in.dimension(0); ++s) {
+                const float_t* o = out.data() + s * output_dims::size;
+                const size_t predicted = std::distance(o, std::max_element(o, o + output_dims::size));
+                BOOST_ASSERT(classes[first + s] < class_count);
+                std::get<2>(result)(predicted, classes[first + s]) += 1;
+            }
+        });
+        std::get<0>(result) = std::get<2>(result).trace();
+        return result;
+    }
+
+    size_t max_batch_size() const {
+        return batch_capacity;
+    }
+
+    /**
+     * \brief Quantization of the input of layer I
+     */
+    template<size_t I>
+    const quantization_params& input_quantization() const {
+        static_assert(quantized_v<I>, "Layer is quantized");
+        return kernels[I].input;
+    }
+
+    /**
+     * \brief Copies of the layers of the trained network
+     */
+    layers_type layers;
+
+protected:
+
+    /**
+     * \brief Copy the samples in batches into the input and invoke
+     *        f(first sample, input view)
+     */
+    template<typename Function>
+    void for_each_batch(const sample_vector_type& samples, Function&& f) {
+        const size_t count = samples.size();
+        for(size_t first = 0; first < count; first += batch_capacity) {
+            const size_t n = std::min(batch_capacity, count - first);
+            #pragma omp parallel for
+            for(size_t s = 0; s < n; ++s) {
+                BOOST_ASSERT(detail::validate_dimensions<input_dims>(samples[first + s]));
+                std::copy(samples[first + s].data(), samples[first + s].data() + input_dims::size, batch_input.data() + s * input_dims::size);
+            }
+            f(first, tensor_4_view(batch_input.data(), n, input_dims::d, input_dims::h, input_dims::w));
+        }
+    }
+
+    /**
+     * \brief Record the range of the inputs of the quantized layers in float
+     *        forward propagation, then quantize the weights
+     */
+    void calibrate(const sample_vector_type& samples) {
+        ranges.fill({0, 0});
+        for_each_batch(samples, [&](const size_t&, tensor_4_view in) {
+            carve_values(in, std::make_index_sequence<layers_count + 1>());
+            calibration_stage<0>();
+        });
+        quantize_weights(std::make_index_sequence<layers_count>());
+    }
+
+    template<size_t I>
+    void calibration_stage() {
+        if constexpr(I < layers_count) {
+            if constexpr(quantized_v<I>) {
+                const float_t* first = values[I].data();
+                const float_t* last = first + values[I].size();
+                const auto [min, max] = std::minmax_element(first, last);
+                ranges[I].first = std::min(ranges[I].first, *min);
+                ranges[I].second = std::max(ranges[I].second, *max);
+            }
+            values[I+1].setZero();
+            std::get<I>(layers).forward_prop(values[I], values[I+1]);
+            calibration_stage<I + 1>();
+        }
+    }
+
+    template<size_t... I>
+    void quantize_weights(std::index_sequence<I...>) {
+        (quantize_layer_weights<I>(), ...);
+    }
+
+    /**
+     * \brief Quantize the weights of layer I into a dense (kernels x depth)
+     *        matrix, sparsely connected kernels are expanded with zeros
+     */
+    template<size_t I>
+    void quantize_layer_weights() {
+        if constexpr(quantized_v<I>) {
+            using layer_type = std::tuple_element_t<I, layers_type>;
+            using input_dims = typename layer_type::input_dims;
+            using output_dims = typename layer_type::output_dims;
+            const auto& layer = std::get<I>(layers);
+            auto& kernel = kernels[I];
+            kernel.input = quantization_params::from_range(ranges[I].first, ranges[I].second);
+
+            std::vector<float_t> dense;
+            size_t kernel_count, depth;
+            if constexpr(detail::is_conv_layer<layer_type>::value) {
+                using connections = typename layer_type::connection_list;
+                using kernel_params = typename layer_type::kernel_params;
+                constexpr size_t area = kernel_params::h * kernel_params::w;
+                kernel_count = output_dims::d;
+                depth = input_dims::d * area;
+                dense.assign(kernel_count * depth, 0);
+                for(size_t k = 0; k < connections::count; ++k) {
+                    std::copy(
+                        layer.w.data() + k * area,
+                        layer.w.data() + (k + 1) * area,
+                        dense.data() + connections::output(k) * depth + connections::input(k) * area
+                    );
+                }
+            } else {
+                /* (in x out) weights, transposed into rows of output */
+                kernel_count = output_dims::size;
+                depth = input_dims::size;
+                dense.resize(kernel_count * depth);
+                for(size_t i = 0; i < depth; ++i) {
+                    for(size_t k = 0; k < kernel_count; ++k) {
+                        dense[k * depth + i] = layer.w.data()[i * kernel_count + k];
+                    }
+                }
+            }
+            kernel.quantize_weights(dense, layer_type::biased ? layer.b.data() : nullptr, kernel_count, depth);
+        }
+    }
+
+    /**
+     * \brief Forward propagation of the stage starting at layer I and of the
+     *        following stages, Requantized if the inputs of layer I were
+     *        quantized by the epilogue of the previous stage
+     */
+    template<size_t I, bool Requantized>
+    sp_hot void forward_stage() {
+        if constexpr(I < layers_count) {
+            constexpr size_t next = I + stage_length<I>();
+            if constexpr(quantized_v<I>) {
+                using layer_type = std::tuple_element_t<I, layers_type>;
+                auto& kernel = kernels[I];
+                const size_t samples = values[I].dimension(0);
+                if constexpr(!Requantized) {
+                    kernel.quantize_inputs(values[I].data(), samples, layer_type::input_dims::size);
+                }
+                constexpr bool requantize = requantizes<I>();
+                if constexpr(requantize) {
+                    auto& to = kernels[next];
+                    execute<I>(samples, [&](const size_t& s, const size_t& i, const float_t& y) {
+                        to.inputs[s * to.input_ld + i] = to.input.quantize(y);
+                    });
+                } else {
+                    float_t* out = values[next].data();
+                    execute<I>(samples, [&](const size_t& s, const size_t& i, const float_t& y) {
+                        out[s * layer_type::output_dims::size + i] = y;
+                    });
+                }
+                forward_stage<next, requantize>();
+            } else {
+                values[I+1].setZero();
+                std::get<I>(layers).forward_prop(values[I], values[I+1]);
+                forward_stage<next, false>();
+            }
+        }
+    }
+
+    /**
+     * \brief Run the int8 kernel of layer I on the quantized inputs and
+     *        emit(sample, output index, y) every output after the epilogue
+     */
+    template<size_t I, typename Emit>
+    sp_hot void execute(const size_t& samples, Emit&& emit) {
+        using layer_type = std::tuple_element_t<I, layers_type>;
+        auto& kernel = kernels[I];
+        /* Apply the activation of the stage to n dequantized outputs */
+        const auto activate = [](float_t* y, const size_t& n) {
+            if constexpr(stage_length<I>() > 1) {
+                detail::activate_elements<typename std::tuple_element_t<I + 1, layers_type>::activation_op_type>(y, n);
+            }
+        };
+        constexpr size_t tile_rows = detail::quantized_tile_rows;
+        constexpr size_t tile_kernels = detail::quantized_tile_kernels;
+        /* Dequantize a tile within the rows and kernels into out(row, kernel) */
+        const auto dequantize_tile = [&](const std::int32_t (&acc)[tile_rows][tile_kernels], const size_t& rows, const size_t& first_kernel, auto&& out) {
+            const size_t kernels = std::min(tile_kernels, kernel.kernels - first_kernel);
+            for(size_t r = 0; r < rows; ++r) {
+                for(size_t k = 0; k < kernels; ++k) {
+                    out(r, first_kernel + k) = kernel.dequantize(acc[r][k], first_kernel + k);
+                }
+            }
+        };
+        if constexpr(detail::is_conv_layer<layer_type>::value) {
+            using output_dims = typename layer_type::output_dims;
+            constexpr size_t area = output_dims::area;
+            constexpr size_t padded_area = detail::quantized_tile_padded(area, tile_rows);
+            #pragma omp parallel for
+            for(size_t s = 0; s < samples; ++s) {
+                const size_t thread = util::thread_index();
+                std::uint8_t* columns = kernel.columns.data() + thread * padded_area * kernel.ld;
+                float_t* outputs = kernel.outputs.data() + thread * output_dims::size;
+                lower<layer_type>(kernel, kernel.inputs.data() + s * kernel.input_ld, columns);
+                for(size_t k = 0; k < kernel.kernels; k += tile_kernels) {
+                    const std::int8_t* w = kernel.weights.data() + k * kernel.ld;
+                    for(size_t p = 0; p < area; p += tile_rows) {
+                        std::int32_t acc[tile_rows][tile_kernels];
+                        detail::dot_tile_u8s8(columns + p * kernel.ld, w, kernel.ld, acc);
+                        dequantize_tile(acc, std::min(tile_rows, area - p), k, [&](const size_t& r, const size_t& o) -> float_t& {
+                            return outputs[o * area + p + r];
+                        });
+                    }
+                }
+                activate(outputs, output_dims::size);
+                for(size_t i = 0; i < output_dims::size; ++i) {
+                    emit(s, i, outputs[i]);
+                }
+            }
+        } else {
+            const size_t kernels = kernel.kernels;
+            const size_t row_tiles = (samples + tile_rows - 1) / tile_rows;
+            const size_t kernel_tiles = (kernels + tile_kernels - 1) / tile_kernels;
+            float_t* outputs = kernel.outputs.data();
+            #pragma omp parallel for collapse(2)
+            for(size_t t = 0; t < row_tiles; ++t) {
+                for(size_t kt = 0; kt < kernel_tiles; ++kt) {
+                    const size_t s = t * tile_rows;
+                    std::int32_t acc[tile_rows][tile_kernels];
+                    detail::dot_tile_u8s8(
+                        kernel.inputs.data() + s * kernel.input_ld,
+                        kernel.weights.data() + kt * tile_kernels * kernel.ld,
+                        kernel.ld,
+                        acc
+                    );
+                    dequantize_tile(acc, std::min(tile_rows, samples - s), kt * tile_kernels, [&](const size_t& r, const size_t& o) -> float_t& {
+                        return outputs[(s + r) * kernels + o];
+                    });
+                }
+            }
+            #pragma omp parallel for
+            for(size_t s = 0; s < samples; ++s) {
+                activate(outputs + s * kernels, kernels);
+                for(size_t o = 0; o < kernels; ++o) {
+                    emit(s, o, outputs[s * kernels + o]);
+                }
+            }
+        }
+    }
+
+    /**
+     * \brief Lower the receptive fields of a quantized sample into rows of
+     *        columns, (P x Q) rows of (C, R, S). Taps in the padding read
+     *        the zero point.
+     */
+    template<typename Layer>
+    static void lower(const detail::quantized_kernel& kernel, const std::uint8_t* in, std::uint8_t* columns) {
+        using input_dims = typename Layer::input_dims;
+        using output_dims = typename Layer::output_dims;
+        using kernel_params = typename Layer::kernel_params;
+        using geometry = typename Layer::geometry;
+        const std::uint8_t zero = static_cast<std::uint8_t>(kernel.input.zero_point);
+        for(size_t oy = 0; oy < output_dims::h; ++oy) {
+            for(size_t ox = 0; ox < output_dims::w; ++ox) {
+                std::uint8_t* row = columns + (oy * output_dims::w + ox) * kernel.ld;
+                for(size_t id = 0; id < input_dims::d; ++id) {
+                    const std::uint8_t* channel = in + id * input_dims::area;
+                    for(size_t ky = 0; ky < kernel_params::h; ++ky) {
+                        const long iy = static_cast<long>(oy * kernel_params::s_h + ky * geometry::dilation) - static_cast<long>(geometry::pad_top);
+                        for(size_t kx = 0; kx < kernel_params::w; ++kx) {
+                            const long ix = static_cast<long>(ox * kernel_params::s_w + kx * geometry::dilation) - static_cast<long>(geometry::pad_left);
+                            const bool inside = iy >= 0 && iy < static_cast<long>(input_dims::h) && ix >= 0 && ix < static_cast<long>(input_dims::w);
+                            *row++ = inside ? channel[iy * input_dims::w + ix] : zero;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template<size_t... I>
+    void configure_values(const size_t& batch_size, std::index_sequence<I...>) {
+        storage.resize(layers_count + 1);
+        (configure_value<I>(batch_size), ...);
+        batch_input.resize(batch_size, input_dims::d, input_dims::h, input_dims::w);
+    }
+
+    template<size_t I>
+    void configure_value(const size_t& batch_size) {
+        using dims = dims_at<I>;
+        storage[I].resize(batch_size, dims::d, dims::h, dims::w);
+    }
+
+    template<size_t... I>
+    void configure_kernels(const size_t& batch_size, std::index_sequence<I...>) {
+        (configure_kernel<I>(batch_size), ...);
+    }
+
+    template<size_t I>
+    void configure_kernel(const size_t& batch_size) {
+        if constexpr(quantized_v<I>) {
+            using layer_type = std::tuple_element_t<I, layers_type>;
+            auto& kernel = kernels[I];
+            kernel.input_ld = detail::quantized_row_length(layer_type::input_dims::size);
+            /* Padding of the rows stays zero */
+            kernel.inputs.assign(detail::quantized_tile_padded(batch_size, detail::quantized_tile_rows) * kernel.input_ld, 0);
+            if constexpr(detail::is_conv_layer<layer_type>::value) {
+                constexpr size_t depth = layer_type::input_dims::d * layer_type::kernel_params::h * layer_type::kernel_params::w;
+                constexpr size_t padded_area = detail::quantized_tile_padded(layer_type::output_dims::area, detail::quantized_tile_rows);
+                kernel.columns.assign(util::thread_count() * padded_area * detail::quantized_row_length(depth), 0);
+                kernel.outputs.resize(util::thread_count() * layer_type::output_dims::size);
+            } else {
+                kernel.outputs.resize(batch_size * layer_type::output_dims::size);
+            }
+        }
+    }
+
+    /**
+     * \brief Views of samples of the values, the input is used as is
+     */
+    template<size_t... I>
+    void carve_values(tensor_4_view input, std::index_sequence<I...>) {
+        const size_t samples = input.dimension(0);
+        values.clear();
+        (values.push_back(I == 0 ? input : tensor_4_view(storage[I].data(), samples, dims_at<I>::d, dims_at<I>::h, dims_at<I>::w)), ...);
+    }
+
+    /**
+     * \brief Dimensions of values[I], the input of layer I
+     */
+    template<size_t I>
+    using dims_at = std::tuple_element_t<I, typename detail::layer_value_dims<layers_type>::type>;
+
+    std::array<detail::quantized_kernel, layers_count> kernels;
+
+    /**
+     * \brief Calibrated [min, max] of the input of every quantized layer
+     */
+    std::array<std::pair<float_t, float_t>, layers_count> ranges;
+
+    std::vector<tensor_4> storage;
+    std::vector<tensor_4_view> values;
+    tensor_4 batch_input;
+
+    size_t batch_capacity = 0;
+};
+
+/**
+ * \brief Test a network and its quantized counterpart on held-out samples
+ *        and report the accuracy of both. The network must be configured.
+ */
+template<typename Network>
+quantization_report compare_quantization(   Network& network,
+                                            quantized_network<Network>& quantized,
+                                            sample_vector_type& samples,
+                                            class_vector_type& classes) {
+    quantization_report report;
+    report.samples = samples.size();
+    report.reference_correct = std::get<0>(network.test(samples, classes));
+    report.quantized_correct = std::get<0>(quantized.test(samples, classes));
+    return report;
+}
+
+SP_ALGO_NN_NAMESPACE_END
+
+#endif	/* SP_ALGO_NN_QUANTIZATION_HPP */
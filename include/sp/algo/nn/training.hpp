@@ -11,6 +11,10 @@
 
 #include <tuple>
 #include <array>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iosfwd>
 #include <experimental/filesystem>
@@ -21,6 +25,7 @@
 #include "sp/util/tuples.hpp"
 #include "sp/util/hints.hpp"
 #include "sp/util/typename.hpp"
+#include "sp/util/parallel.hpp"
 
 #include "sp/config.hpp"
 #include "matrix.hpp"
@@ -29,6 +34,7 @@
 #include "types.hpp"
 #include "normalize.hpp"
 #include "weight.hpp"
+#include "batch_loader.hpp"
 
 
 SP_ALGO_NN_NAMESPACE_BEGIN
@@ -77,41 +83,20 @@ struct training {
         BOOST_ASSERT_MSG(!samples.empty(), "Samples is not empty");
         BOOST_ASSERT_MSG(samples.size() == classes.size(), "Samples and classes size match");
 
-        const size_t batch_count = samples.size() / batch_size;
-
-        /**
-         * \TODO implement remaining batch handling
-         */
-        BOOST_ASSERT_MSG(samples.size()  % batch_size == 0, "input size is divisble by batch size");
-
-        std::vector<tensor_4> expected_outputs = prepare_labels(network, batch_size, classes);
+        /* The last batch holds the remaining samples */
+        const size_t batch_count = batch_loader<Network>::batches_per_epoch(samples.size(), batch_size);
 
         network.configure(batch_size, reset_weights);
 
-        cached_gradient.resize(
-            batch_size,
-            Network::output_dims::d,
-            Network::output_dims::h,
-            Network::output_dims::w
-        );
-        cached_input_batch.resize(
-            batch_size,
-            Network::input_dims::d,
-            Network::input_dims::h,
-            Network::input_dims::w
-        );
+        /* Batches are assembled ahead on the thread of the loader */
+        batch_loader<Network> loader(samples, classes, batch_size, epochs, network.out_target_range(), shuffle);
 
         for(size_t i = 0; i < epochs; ++i) {
             for(size_t b = 0; b < batch_count; ++b) {
 
-                /* prepare samples into a batch, copying */
-                for(size_t s = 0; s < batch_size; ++s) {
-                    auto& sample = samples[b * batch_size + s];
-                    BOOST_ASSERT(detail::validate_dimensions<typename Network::input_dims>(sample));
-                    cached_input_batch.chip(s, 0) = sample;
-                }
-
-                (*this)(network, cached_input_batch, expected_outputs[b]);
+                auto& batch = loader.acquire();
+                (*this)(network, batch.input_view(), batch.expected_view());
+                loader.release();
 
                 if(on_batch) {
                     on_batch(b);
@@ -127,16 +112,21 @@ struct training {
      * \brief Perform a single training operation
      */
     template<typename Network>
-    sp_hot void operator()(Network& network, tensor_4& input, tensor_4& expected_output) {
-        tensor_4& predicted = network.forward(input);
-        gradient(loss, predicted, expected_output, cached_gradient);
-        network.backward(cached_gradient);
+    sp_hot void operator()(Network& network, tensor_4_view input, tensor_4_view expected_output) {
+        network.forward(input);
+        network.backward(loss, expected_output);
         network.template update_weights(optimizer);
     }
 
     optimizer_type optimizer;
     loss_function_type loss;
 
+    /**
+     * \brief Visit the samples in a new random order every epoch rather
+     *        than in order, see #batch_loader
+     */
+    bool shuffle = false;
+
     /**
      * \brief Can be bound to a function which is then executed
      *        on after each epoch
@@ -148,14 +138,351 @@ struct training {
      *        on before each batch
      */
     std::function<void(const size_t&)> on_batch;
+};
+
+/**
+ * \brief Synchronous data parallel training
+ *
+ * Every batch is split into one shard per worker thread. Each worker owns a
+ * replica of the network (values, deltas and gradients) and propagates its
+ * shard forward and backward independently, its layers run on the worker
+ * thread alone. Worker 0 is the trained network itself, the gradients of
+ * the other replicas are gathered into the per thread gradient slots of the
+ * network, such that the tree reduction of update_weights all-reduces them
+ * once per batch. The replicas view the weights of the network (see
+ * basic_network::share_weights), their engine caches are refreshed when the
+ * weights have been updated.
+ *
+ * The trained network is left configured for the shard of worker 0.
+ */
+template<
+    size_t BatchSize = 16,
+    size_t Epochs = 1,
+    typename Optimizer = ada_gradient_optimizer<>,
+    typename LossFunction = mean_square_error
+>
+struct data_parallel_training {
+
+    using optimizer_type = Optimizer;
+
+    using loss_function_type = LossFunction;
+
+    constexpr static size_t batch_size = BatchSize;
+
+    static_assert(BatchSize > 0, "BatchSize is greater or equal to 1");
+
+    constexpr static size_t epochs = Epochs;
+
+    template<typename Network>
+    sp_hot void operator()(Network& network, sample_vector_type& samples, class_vector_type& classes, bool reset_weights = true) {
+
+        BOOST_ASSERT_MSG(!samples.empty(), "Samples is not empty");
+        BOOST_ASSERT_MSG(samples.size() == classes.size(), "Samples and classes size match");
+
+        /* The last batch holds the remaining samples */
+        std::vector<tensor_4> expected_outputs = prepare_labels(network, batch_size, classes);
+        const size_t batch_count = expected_outputs.size();
+
+        /* Gathering requires a gradient slot of the network per worker */
+        const size_t worker_count = std::min({workers > 0 ? workers : util::thread_count(), util::thread_count(), batch_size});
+
+        configure(network, worker_count, reset_weights);
+
+        for(size_t i = 0; i < epochs; ++i) {
+            for(size_t b = 0; b < batch_count; ++b) {
+                train_batch(network, samples, expected_outputs[b], b * batch_size);
+                network.template update_weights(optimizer);
+                if(on_batch) {
+                    on_batch(b);
+                }
+            }
+            if(on_epoch) {
+                on_epoch(i);
+            }
+        }
+    }
+
+    optimizer_type optimizer;
+    loss_function_type loss;
+
+    /**
+     * \brief Number of workers, at most the thread count and the batch
+     *        size. Defaults (0) to the thread count.
+     */
+    size_t workers = 0;
+
+    std::function<void(const size_t&)> on_epoch;
+
+    std::function<void(const size_t&)> on_batch;
 
 protected:
 
-    /* Cache gradient tensor between iterations, reduce allocations */
-    tensor_4 cached_gradient;
+    /**
+     * \brief Shard of a worker, its input and expected output sized for
+     *        the shard of a full batch
+     */
+    struct shard {
+        tensor_4 input;
+        tensor_4 expected;
+    };
+
+    /**
+     * \brief Split the batch into worker_count shards and configure the
+     *        network and the replicas (one per remaining shard)
+     */
+    template<typename Network>
+    void configure(Network& network, const size_t& worker_count, bool reset_weights) {
+        shards.clear();
+        shards.resize(worker_count);
+
+        network.configure(shard_size(0, batch_size), reset_weights);
+
+        replicas.clear();
+        replicas.resize(worker_count - 1);
+
+        /* Replicas are allocated by the thread running them */
+        #pragma omp parallel for schedule(static, 1) num_threads(worker_count)
+        for(size_t w = 0; w < worker_count; ++w) {
+            util::set_thread_count(1);
+            shard& sh = shards[w];
+            const size_t samples = shard_size(w, batch_size);
+            sh.input.resize(samples, Network::input_dims::d, Network::input_dims::h, Network::input_dims::w);
+            sh.expected.resize(samples, Network::output_dims::size, 1, 1);
+            if(w > 0) {
+                auto replica = std::make_shared<Network>();
+                replica->configure(samples);
+                replica->share_weights(network);
+                replicas[w - 1] = replica;
+            }
+        }
+    }
+
+    /**
+     * \brief Forward and back propagate every shard of the batch starting at
+     *        sample first and gather the gradients into the network. The
+     *        shards of a partial batch run as views of fewer samples, a
+     *        worker without samples idles.
+     */
+    template<typename Network>
+    sp_hot void train_batch(Network& network, sample_vector_type& samples, tensor_4& expected, const size_t& first) {
+        using input_dims = typename Network::input_dims;
+        using output_dims = typename Network::output_dims;
+        const size_t worker_count = shards.size();
+        const size_t batch_samples = expected.dimension(0);
+
+        /**
+         * Static schedule of chunk 1, worker 0 (the network) runs on thread 0
+         * and hence accumulates into gradient slot 0
+         */
+        #pragma omp parallel for schedule(static, 1) num_threads(worker_count)
+        for(size_t w = 0; w < worker_count; ++w) {
+            /* Layers of a replica run on this thread alone */
+            util::set_thread_count(1);
+
+            const size_t count = shard_size(w, batch_samples);
+            if(count == 0) {
+                continue;
+            }
+            const size_t offset = shard_first(w, batch_samples);
+
+            shard& sh = shards[w];
+            Network& net = w == 0 ? network : *std::static_pointer_cast<Network>(replicas[w - 1]);
+            if(w > 0) {
+                net.shared_weights_changed(network);
+            }
+
+            for(size_t s = 0; s < count; ++s) {
+                const sample_type& sample = samples[first + offset + s];
+                BOOST_ASSERT(detail::validate_dimensions<input_dims>(sample));
+                std::copy(sample.data(), sample.data() + input_dims::size, sh.input.data() + s * input_dims::size);
+            }
+            std::copy(
+                expected.data() + offset * output_dims::size,
+                expected.data() + (offset + count) * output_dims::size,
+                sh.expected.data()
+            );
+
+            tensor_4_view input(sh.input.data(), count, input_dims::d, input_dims::h, input_dims::w);
+            tensor_4_view expected_output(sh.expected.data(), count, output_dims::size, 1, 1);
+
+            net.forward(input);
+            net.backward(loss, expected_output);
+
+            if(w > 0) {
+                network.gather_gradients(net, w);
+            }
+        }
+    }
+
+    /**
+     * \brief Samples of the shard of worker w of a batch of samples
+     */
+    size_t shard_size(const size_t& w, const size_t& samples) const {
+        return samples / shards.size() + (w < samples % shards.size() ? 1 : 0);
+    }
+
+    /**
+     * \brief First sample of the shard of worker w within the batch
+     */
+    size_t shard_first(const size_t& w, const size_t& samples) const {
+        return w * (samples / shards.size()) + std::min(w, samples % shards.size());
+    }
+
+    std::vector<shard> shards;
+
+    /**
+     * \brief Network replicas of the workers 1..n, type erased as the
+     *        network type is a parameter of operator()
+     */
+    std::vector<std::shared_ptr<void>> replicas;
+};
+
+/**
+ * \brief Asynchronous lock free training (Hogwild!), a drop in alternative
+ *        to #training
+ *
+ * Worker threads take mini-batches from a shared queue (an atomic batch
+ * counter per epoch) and propagate them through private replicas of the
+ * network, i.e. private values, deltas and gradients. Each worker applies
+ * its gradients to the weights of the trained network, shared by all
+ * workers, without locks. The replicas view the shared weights (see
+ * basic_network::share_weights), a worker refreshes the engine caches of its
+ * replica before its next mini-batch if the weights have been updated since.
+ * Concurrent updates may overwrite each other, which Hogwild! tolerates for
+ * sparse updates. Every worker keeps its own optimizer state, a copy of
+ * optimizer.
+ *
+ * on_batch is called from the workers, one call at a time. The throughput
+ * of the last call is kept in samples_per_second.
+ */
+template<
+    size_t BatchSize = 16,
+    size_t Epochs = 1,
+    typename Optimizer = ada_gradient_optimizer<>,
+    typename LossFunction = mean_square_error
+>
+struct hogwild_training {
+
+    using optimizer_type = Optimizer;
+
+    using loss_function_type = LossFunction;
+
+    constexpr static size_t batch_size = BatchSize;
+
+    static_assert(BatchSize > 0, "BatchSize is greater or equal to 1");
+
+    constexpr static size_t epochs = Epochs;
+
+    template<typename Network>
+    sp_hot void operator()(Network& network, sample_vector_type& samples, class_vector_type& classes, bool reset_weights = true) {
+
+        BOOST_ASSERT_MSG(!samples.empty(), "Samples is not empty");
+        BOOST_ASSERT_MSG(samples.size() == classes.size(), "Samples and classes size match");
+
+        using input_dims = typename Network::input_dims;
+
+        /* The last batch holds the remaining samples */
+        std::vector<tensor_4> expected_outputs = prepare_labels(network, batch_size, classes);
+        const size_t batch_count = expected_outputs.size();
+
+        network.configure(batch_size, reset_weights);
+
+        const size_t worker_count = std::min(workers > 0 ? workers : util::thread_count(), batch_count);
+
+        configure(network, worker_count);
+
+        util::scoped_timer timer("hogwild_training", false);
+
+        for(size_t i = 0; i < epochs; ++i) {
+            std::atomic<size_t> next{0};
+
+            #pragma omp parallel for schedule(static, 1) num_threads(worker_count)
+            for(size_t w = 0; w < worker_count; ++w) {
+                /* Layers of a replica run on this thread alone */
+                util::set_thread_count(1);
+                worker& wk = workers_state[w];
+                Network& replica = *std::static_pointer_cast<Network>(wk.replica);
+                for(size_t b = next++; b < batch_count; b = next++) {
+                    const size_t count = expected_outputs[b].dimension(0);
+                    replica.shared_weights_changed(network);
+                    for(size_t s = 0; s < count; ++s) {
+                        const sample_type& sample = samples[b * batch_size + s];
+                        BOOST_ASSERT(detail::validate_dimensions<input_dims>(sample));
+                        std::copy(sample.data(), sample.data() + input_dims::size, wk.input.data() + s * input_dims::size);
+                    }
+                    tensor_4_view input(wk.input.data(), count, input_dims::d, input_dims::h, input_dims::w);
+                    replica.forward(input);
+                    replica.backward(loss, expected_outputs[b]);
+                    replica.update_weights(wk.optimizer, network);
+                    if(on_batch) {
+                        #pragma omp critical(sp_algo_nn_hogwild_on_batch)
+                        on_batch(b);
+                    }
+                }
+            }
+
+            if(on_epoch) {
+                on_epoch(i);
+            }
+        }
+
+        samples_per_second = timer.per_second(epochs * samples.size());
+
+        network.weights_changed();
+    }
+
+    optimizer_type optimizer;
+    loss_function_type loss;
+
+    /**
+     * \brief Number of workers, at most the number of batches. Defaults (0)
+     *        to the thread count.
+     */
+    size_t workers = 0;
+
+    /**
+     * \brief Throughput of the last training, in samples per second
+     */
+    double samples_per_second = 0;
+
+    std::function<void(const size_t&)> on_epoch;
+
+    std::function<void(const size_t&)> on_batch;
+
+protected:
+
+    /**
+     * \brief Private state of a worker
+     */
+    struct worker {
+        std::shared_ptr<void> replica;
+        optimizer_type optimizer;
+        tensor_4 input;
+    };
+
+    /**
+     * \brief Configure a replica per worker, allocated by the thread running
+     *        it
+     */
+    template<typename Network>
+    void configure(Network& network, const size_t& worker_count) {
+        workers_state.clear();
+        workers_state.resize(worker_count);
+
+        #pragma omp parallel for schedule(static, 1) num_threads(worker_count)
+        for(size_t w = 0; w < worker_count; ++w) {
+            util::set_thread_count(1);
+            worker& wk = workers_state[w];
+            auto replica = std::make_shared<Network>();
+            replica->configure(batch_size);
+            replica->share_weights(network);
+            wk.replica = replica;
+            wk.optimizer = optimizer;
+            wk.input.resize(batch_size, Network::input_dims::d, Network::input_dims::h, Network::input_dims::w);
+        }
+    }
 
-    /* cache input batch between iterations, reduce allocations */
-    tensor_4 cached_input_batch;
+    std::vector<worker> workers_state;
 };
 
 SP_ALGO_NN_NAMESPACE_END
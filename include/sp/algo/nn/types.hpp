@@ -48,24 +48,36 @@ using class_vector_type = std::vector<size_t>;
  *
  * Size is (D_in, D_out, H_kernel, W_kernel)
  */
-using weights_type = tensor_4;
+using weights_type = parameter_tensor<4>;
 
 /**
  * \brief The weights delta type
  *
  * Size is (Sample, D_in, D_out, H_kernel, W_kernel)
  */
-using weights_delta_type = tensor_5;
+using weights_delta_type = parameter_tensor<5>;
 
 /**
  * \brief The bias type
  */
-using bias_type = tensor_1;
+using bias_type = parameter_tensor<1>;
 
 /**
  * \brief The bias delta type
  */
-using bias_delta_type = tensor_2;
+using bias_delta_type = parameter_tensor<2>;
+
+/**
+ * \brief What a network and its layers are configured for
+ *
+ * In inference mode no gradient state is allocated (deltas, weight and bias
+ * gradients) and layers skip the bookkeeping only read by back propagation
+ * (e.g. the location of the maxima of max pooling).
+ */
+enum class network_mode {
+    training,
+    inference
+};
 
 
 SP_ALGO_NN_NAMESPACE_END
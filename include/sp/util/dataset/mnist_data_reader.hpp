@@ -12,6 +12,7 @@
 #define SP_UTIL_DATASET_MNIST_DATA_READER_HPP
 
 #include <limits>
+#include <algorithm>
 #include <exception>
 #include <boost/filesystem.hpp>
 #include <boost/endian/conversion.hpp>
@@ -87,8 +88,8 @@ struct mnist_data_reader  {
                 batch_size = count;
             }
 
-            if(count % batch_size != 0) {
-                throw std::runtime_error("Batch size should be a factor of sample size");
+            if(batch_size == 0) {
+                throw std::runtime_error("Batch size should be greater than zero");
             }
 
         } else {
@@ -125,9 +126,15 @@ struct mnist_data_reader  {
         return current_labels_index < count;
     }
 
+    /**
+     * \brief Read the next frame of images, the last frame holds the
+     *        remaining images if the batch size is not a factor of the count
+     */
     mnist_images_result read_images() {
-        /* Initialize result to a vector of batch_size */
-        mnist_images_result result(batch_size,
+        const size_t frame = std::min(batch_size, count - current_images_index);
+
+        /* Initialize result to a vector of the frame size */
+        mnist_images_result result(frame,
             mnist_images_result::value_type(
                 1,
                 img_height + 2 * pad_h,
@@ -142,7 +149,7 @@ struct mnist_data_reader  {
 
         auto &[ min, max] = scaling;
 
-        for(size_t b = 0; b < batch_size; ++b) {
+        for(size_t b = 0; b < frame; ++b) {
             if(pad_w || pad_h) {
                 /* initialize whole image to scale minimum */
                 result[b].setConstant(min);
@@ -163,18 +170,22 @@ struct mnist_data_reader  {
                 );
             }
         }
-        current_images_index += batch_size;
+        current_images_index += frame;
         return result;
     }
 
+    /**
+     * \brief Read the next frame of labels, see read_images
+     */
     mnist_labels_result read_labels() {
-        mnist_labels_result result(batch_size, 0);
-        for(size_t b = 0; b < batch_size; ++b) {
+        const size_t frame = std::min(batch_size, count - current_labels_index);
+        mnist_labels_result result(frame, 0);
+        for(size_t b = 0; b < frame; ++b) {
             uint8_t label;
             labels_stream.read(reinterpret_cast<char*>(&label), 1);
             result[b] = static_cast<size_t>(label);
         }
-        current_labels_index += batch_size;
+        current_labels_index += frame;
         return result;
     }
 
@@ -0,0 +1,62 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#ifndef SP_UTIL_PARALLEL_HPP
+#define	SP_UTIL_PARALLEL_HPP
+
+#include <cstddef>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "sp/config.hpp"
+#include "sp/util/hints.hpp"
+
+SP_UTIL_NAMESPACE_BEGIN
+
+/**
+ * \brief The maximum number of threads of a parallel region, 1 if compiled
+ *        without OpenMP
+ */
+inline size_t thread_count() {
+#ifdef _OPENMP
+    return static_cast<size_t>(omp_get_max_threads());
+#else
+    return 1;
+#endif
+}
+
+/**
+ * \brief The index of the calling thread within the current parallel
+ *        region, in [0, thread_count()), 0 outside of parallel regions
+ */
+inline size_t thread_index() {
+#ifdef _OPENMP
+    return static_cast<size_t>(omp_get_thread_num());
+#else
+    return 0;
+#endif
+}
+
+/**
+ * \brief Set the number of threads of the parallel regions started by the
+ *        calling thread, i.e. thread_count() of the calling thread. Inside a
+ *        parallel region it only affects the calling thread.
+ */
+inline void set_thread_count(const size_t& count) {
+#ifdef _OPENMP
+    omp_set_num_threads(static_cast<int>(count));
+#else
+    SP_UNUSED(count);
+#endif
+}
+
+SP_UTIL_NAMESPACE_END
+
+#endif	/* SP_UTIL_PARALLEL_HPP */
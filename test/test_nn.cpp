@@ -8,11 +8,13 @@
 
 #include <iostream>
 #include <iomanip>
+#include <cstdint>
 #define BOOST_TEST_MODULE sp_algo_nn
 #include <boost/test/unit_test.hpp>
 #include "sp/algo/nn.hpp"
 #include "assert_matrix.hpp"
 #include "sp/algo/nn/random.hpp"
+#include <boost/filesystem.hpp>
 
 using namespace sp::algo::nn;
 using namespace sp::testing;
@@ -219,3 +221,928 @@ BOOST_AUTO_TEST_CASE(test_network_persistence) {
     }
 
 }
+
+template<typename Layout>
+using blocked_layout_network = basic_network<
+    Layout,
+    conv_layer<
+        volume_dims<3, 12, 12>,
+        kernel_symmetric_params<6, 3, 1, padding_type::same>
+    >,
+    /* negative and positive inputs to max pooling */
+    tanh_layer<volume_dims<6, 12, 12>>,
+    max_pooling_layer<volume_dims<6, 12, 12>, pooling_kernel_params<2, 2>>,
+    conv_layer<
+        volume_dims<6, 6, 6>,
+        kernel_symmetric_params<10, 3, 1, padding_type::same>,
+        true,
+        table_connectivity<
+            6, 10,
+            1, 0, 0, 1, 1, 0, 1, 0, 1, 1,
+            1, 1, 0, 0, 1, 1, 0, 1, 0, 1,
+            0, 1, 1, 0, 0, 1, 1, 0, 1, 1,
+            0, 0, 1, 1, 0, 0, 1, 1, 0, 1,
+            1, 0, 0, 1, 1, 0, 0, 1, 1, 1,
+            0, 1, 1, 0, 1, 1, 0, 0, 1, 1
+        >,
+        1
+    >,
+    tanh_layer<volume_dims<10, 6, 6>>,
+    mean_pooling_layer<volume_dims<10, 6, 6>, pooling_kernel_params<2, 2>>,
+    fully_connected_layer<volume_dims<10, 3, 3>, 4>,
+    tanh_layer<volume_dims<4>>
+>;
+
+template<typename Layout>
+void check_blocked_layout_matches_plain() {
+    constexpr size_t samples = 2;
+
+    using plain_type = blocked_layout_network<nchw_layout>;
+    using blocked_type = blocked_layout_network<Layout>;
+
+    static_assert(plain_type::blocked_layers == 0, "Plain network has no blocked layers");
+    static_assert(blocked_type::blocked_layers == 6, "Layers up to the fully connected layer are blocked");
+
+    plain_type plain;
+    blocked_type blocked;
+
+    plain.configure(samples, true);
+
+    std::stringstream buffer;
+    plain.save(buffer);
+    blocked.load(buffer);
+    blocked.configure(samples);
+
+    tensor_4 input(samples, 3, 12, 12);
+    input.setRandom();
+
+    tensor_4 plain_out = plain.forward(input);
+    tensor_4 blocked_out = blocked.forward(input);
+    BOOST_REQUIRE_EQUAL(plain_out.size(), blocked_out.size());
+    for(long i = 0; i < plain_out.size(); ++i) {
+        BOOST_REQUIRE_SMALL(plain_out.data()[i] - blocked_out.data()[i], 1e-4f);
+    }
+
+    tensor_4 delta(plain_out.dimensions());
+    delta.setRandom();
+    plain.backward(delta);
+    blocked.backward(delta);
+
+    tensor_4 blocked_input_delta;
+    detail::from_blocked<typename blocked_type::input_dims, blocked_type::block>(blocked.values_delta[0], blocked_input_delta);
+    for(long i = 0; i < plain.values_delta[0].size(); ++i) {
+        BOOST_REQUIRE_SMALL(plain.values_delta[0].data()[i] - blocked_input_delta.data()[i], 1e-4f);
+    }
+
+    auto compare_gradients = [](auto& plain_layer, auto& blocked_layer) {
+        plain_layer.reduce_gradients();
+        blocked_layer.reduce_gradients();
+        BOOST_REQUIRE_EQUAL(plain_layer.accumulated_samples, blocked_layer.accumulated_samples);
+        for(long i = 0; i < plain_layer.w.size(); ++i) {
+            BOOST_REQUIRE_SMALL(plain_layer.dw.data()[i] - blocked_layer.dw.data()[i], 1e-3f);
+        }
+        for(long i = 0; i < plain_layer.b.size(); ++i) {
+            BOOST_REQUIRE_SMALL(plain_layer.db.data()[i] - blocked_layer.db.data()[i], 1e-3f);
+        }
+    };
+    compare_gradients(plain.template get<0>(), blocked.template get<0>());
+    compare_gradients(plain.template get<2>(), blocked.template get<2>());
+    compare_gradients(plain.template get<3>(), blocked.template get<3>());
+    compare_gradients(plain.template get<5>(), blocked.template get<5>());
+    compare_gradients(plain.template get<6>(), blocked.template get<6>());
+}
+
+BOOST_AUTO_TEST_CASE(test_network_blocked_layout_matches_plain) {
+    check_blocked_layout_matches_plain<nchw8c_layout>();
+    check_blocked_layout_matches_plain<nchwc_layout<4>>();
+}
+
+using fused_network = network<
+    conv_layer<
+        volume_dims<1, 12, 12>,
+        kernel_symmetric_params<6, 3, 1, padding_type::valid>
+    >,
+    tanh_layer<volume_dims<6, 10, 10>>,
+    mean_pooling_layer<volume_dims<6, 10, 10>, pooling_kernel_params<2, 2>>,
+    tanh_layer<volume_dims<6, 5, 5>>,
+    max_pooling_layer<volume_dims<6, 5, 5>, pooling_kernel_params<2, 1>>,
+    tanh_layer<volume_dims<6, 4, 4>>,
+    conv_layer<
+        volume_dims<6, 4, 4>,
+        kernel_symmetric_params<4, 3, 1, padding_type::same>
+    >,
+    tanh_layer<volume_dims<4, 4, 4>>,
+    fully_connected_layer<volume_dims<4, 4, 4>, 3>,
+    tanh_layer<volume_dims<3>>
+>;
+
+static_assert(fused_network::stage_length<0>() == 4, "conv, tanh, pooling, tanh is fused");
+static_assert(fused_network::stage_length<4>() == 2, "pooling, tanh is fused");
+static_assert(fused_network::stage_length<6>() == 2, "conv, tanh is fused");
+static_assert(fused_network::stage_length<8>() == 1, "fully connected is not fused");
+
+/**
+ * Runs every layer of the network on its own
+ */
+template<typename Network>
+void layer_by_layer(Network& nn, tensor_4& input, tensor_4& delta, tensor_4& output, tensor_4& input_delta) {
+    const size_t samples = input.dimension(0);
+    std::array<tensor_4, Network::layers_count + 1> values;
+    std::array<tensor_4, Network::layers_count + 1> deltas;
+    values[0] = input;
+    size_t idx = 0;
+    sp::util::for_each(nn.layers, [&](auto& layer) {
+        using layer_type = std::decay_t<decltype(layer)>;
+        detail::prepare_tensor<typename layer_type::output_dims>(samples, values[idx+1]);
+        layer.forward_prop(values[idx], values[idx+1]);
+        ++idx;
+    });
+    deltas[idx] = delta;
+    sp::util::for_each(sp::util::reverse(nn.layers), [&](auto& layer) {
+        using layer_type = std::decay_t<decltype(layer)>;
+        detail::prepare_tensor<typename layer_type::input_dims>(samples, deltas[idx-1]);
+        layer.backward_prop(values[idx-1], deltas[idx-1], values[idx], deltas[idx]);
+        --idx;
+    });
+    output = values[Network::layers_count];
+    input_delta = deltas[0];
+}
+
+BOOST_AUTO_TEST_CASE(test_network_fused_stages_match_layer_by_layer) {
+    constexpr size_t samples = 3;
+
+    fused_network fused;
+    fused_network reference;
+
+    fused.configure(samples, true);
+
+    std::stringstream buffer;
+    fused.save(buffer);
+    reference.load(buffer);
+    reference.configure(samples);
+
+    tensor_4 input(samples, 1, 12, 12);
+    input.setRandom();
+    tensor_4 delta(samples, 3, 1, 1);
+    delta.setRandom();
+
+    tensor_4 expected_output, expected_input_delta;
+    layer_by_layer(reference, input, delta, expected_output, expected_input_delta);
+
+    tensor_4 output = fused.forward(input);
+    fused.backward(delta);
+
+    for(long i = 0; i < output.size(); ++i) {
+        BOOST_REQUIRE_SMALL(output.data()[i] - expected_output.data()[i], 1e-5f);
+    }
+    for(long i = 0; i < expected_input_delta.size(); ++i) {
+        BOOST_REQUIRE_SMALL(fused.values_delta[0].data()[i] - expected_input_delta.data()[i], 1e-5f);
+    }
+
+    auto compare_gradients = [](auto& fused_layer, auto& reference_layer) {
+        fused_layer.reduce_gradients();
+        reference_layer.reduce_gradients();
+        BOOST_REQUIRE_EQUAL(fused_layer.accumulated_samples, reference_layer.accumulated_samples);
+        for(long i = 0; i < fused_layer.w.size(); ++i) {
+            BOOST_REQUIRE_SMALL(fused_layer.dw.data()[i] - reference_layer.dw.data()[i], 1e-4f);
+        }
+        for(long i = 0; i < fused_layer.b.size(); ++i) {
+            BOOST_REQUIRE_SMALL(fused_layer.db.data()[i] - reference_layer.db.data()[i], 1e-4f);
+        }
+    };
+    compare_gradients(fused.get<0>(), reference.get<0>());
+    compare_gradients(fused.get<2>(), reference.get<2>());
+    compare_gradients(fused.get<4>(), reference.get<4>());
+    compare_gradients(fused.get<6>(), reference.get<6>());
+    compare_gradients(fused.get<8>(), reference.get<8>());
+}
+
+BOOST_AUTO_TEST_CASE(test_network_memory_plan) {
+    constexpr auto plan = fused_network::memory_plan();
+    using plan_type = std::decay_t<decltype(plan)>;
+
+    /* Buffers with overlapping lifetimes never share memory */
+    for(size_t i = 0; i < plan_type::buffers; ++i) {
+        for(size_t j = i + 1; j < plan_type::buffers; ++j) {
+            if(plan.lifetime[i].overlaps(plan.lifetime[j])) {
+                BOOST_REQUIRE(
+                    plan.offset[i] + plan.size[i] <= plan.offset[j] ||
+                    plan.offset[j] + plan.size[j] <= plan.offset[i]
+                );
+            }
+        }
+    }
+    BOOST_REQUIRE_LE(2 * plan.arena, plan.unshared);
+
+    fused_network nn;
+    nn.configure(3, true);
+    const float_t* first = nn.values[0].data();
+    for(auto& v : nn.values) {
+        BOOST_REQUIRE_EQUAL(reinterpret_cast<std::uintptr_t>(v.data()) % detail::arena_alignment, 0u);
+    }
+
+    /* Reconfiguring a smaller batch reuses the arena */
+    nn.configure(2);
+    nn.configure(3);
+    BOOST_REQUIRE_EQUAL(nn.values[0].data(), first);
+}
+
+template<typename Network>
+void check_inference_matches_training(const size_t& samples, tensor_4& input) {
+    Network trained;
+    Network served;
+
+    trained.configure(samples, true);
+
+    std::stringstream buffer;
+    trained.save(buffer);
+    served.load(buffer);
+    served.configure_inference(samples);
+
+    BOOST_REQUIRE(!served.training());
+    BOOST_REQUIRE(served.values_delta.empty());
+    BOOST_REQUIRE_LT(Network::template memory_plan<false>().arena, Network::template memory_plan<true>().arena);
+
+    /* No gradient state in any layer */
+    sp::util::for_each(served.layers, [&](auto& layer) {
+        using layer_type = std::decay_t<decltype(layer)>;
+        if constexpr(detail::has_weight_and_delta_v<layer_type>) {
+            BOOST_REQUIRE_EQUAL(layer.dw.size(), 0);
+        }
+        if constexpr(detail::has_bias_and_delta_v<layer_type>) {
+            BOOST_REQUIRE_EQUAL(layer.db.size(), 0);
+        }
+    });
+
+    tensor_4 expected = trained.forward(input);
+    tensor_4 output = served.forward(input);
+    for(long i = 0; i < expected.size(); ++i) {
+        BOOST_REQUIRE_SMALL(output.data()[i] - expected.data()[i], 1e-5f);
+    }
+
+    /* Back to training */
+    served.configure(samples);
+    BOOST_REQUIRE_EQUAL(served.values_delta.size(), Network::layers_count + 1);
+    tensor_4 retrained = served.forward(input);
+    for(long i = 0; i < expected.size(); ++i) {
+        BOOST_REQUIRE_SMALL(retrained.data()[i] - expected.data()[i], 1e-5f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_network_inference_matches_training) {
+    constexpr size_t samples = 3;
+
+    tensor_4 input(samples, 1, 12, 12);
+    input.setRandom();
+    check_inference_matches_training<fused_network>(samples, input);
+
+    tensor_4 blocked_input(samples, 3, 12, 12);
+    blocked_input.setRandom();
+    check_inference_matches_training<blocked_layout_network<nchw8c_layout>>(samples, blocked_input);
+
+    fused_network served;
+    served.configure_inference(samples, true);
+    BOOST_REQUIRE_EQUAL(served.get<4>().pooling_algorithm.max.size(), 0);
+    BOOST_REQUIRE_EQUAL(served.get<4>().pooling_algorithm.is_max.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_network_test_batched) {
+    constexpr size_t sample_count = 11;
+
+    fused_network batched;
+    fused_network single;
+
+    batched.configure(4, true);
+
+    std::stringstream buffer;
+    batched.save(buffer);
+    single.load(buffer);
+    single.configure(1);
+
+    sample_vector_type samples(sample_count, sample_type(1, 12, 12));
+    class_vector_type classes(sample_count);
+    for(size_t s = 0; s < sample_count; ++s) {
+        samples[s].setRandom();
+        classes[s] = s % fused_network::output_dims::size;
+    }
+
+    auto [correct, total, cm] = batched.test(samples, classes);
+
+    BOOST_REQUIRE_EQUAL(batched.batch_size(), 4u);
+    BOOST_REQUIRE_EQUAL(total, sample_count);
+    BOOST_REQUIRE_EQUAL(cm.rows(), fused_network::output_dims::size);
+    BOOST_REQUIRE_EQUAL(cm.sum(), sample_count);
+
+    /* Same predictions one sample at a time */
+    confusion_matrix expected = confusion_matrix::Zero(cm.rows(), cm.cols());
+    size_t expected_correct = 0;
+    tensor_4 input(1, 1, 12, 12);
+    for(size_t s = 0; s < sample_count; ++s) {
+        input.chip(0, 0) = samples[s];
+        const size_t predicted = single.forward_max_index(input)[0];
+        expected(predicted, classes[s]) += 1;
+        expected_correct += predicted == classes[s] ? 1 : 0;
+    }
+    BOOST_REQUIRE_EQUAL(correct, expected_correct);
+    BOOST_REQUIRE(cm == expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_network_data_parallel_training) {
+    constexpr size_t batch = 7;
+    constexpr size_t sample_count = 2 * batch;
+
+    /* Enough gradient slots for the workers, also without threads */
+    const size_t threads = sp::util::thread_count();
+    sp::util::set_thread_count(3);
+
+    fused_network serial;
+    fused_network parallel;
+    serial.configure(batch, true);
+
+    fused_network initial;
+    std::stringstream buffer;
+    serial.save(buffer);
+    parallel.load(buffer);
+    buffer.seekg(0);
+    initial.load(buffer);
+
+    sample_vector_type samples(sample_count, sample_type(1, 12, 12));
+    class_vector_type classes(sample_count);
+    for(size_t s = 0; s < sample_count; ++s) {
+        samples[s].setRandom();
+        classes[s] = s % fused_network::output_dims::size;
+    }
+
+    training<batch, 2, ada_gradient_optimizer<>> serial_trainer;
+    serial_trainer(serial, samples, classes, false);
+
+    data_parallel_training<batch, 2, ada_gradient_optimizer<>> parallel_trainer;
+    parallel_trainer.workers = 3;
+    parallel_trainer(parallel, samples, classes, false);
+
+    /* Shards of 3, 2 and 2 samples */
+    BOOST_REQUIRE_EQUAL(parallel.batch_size(), 3u);
+
+    sp::util::set_thread_count(threads);
+
+    tensor_4 input(batch, 1, 12, 12);
+    input.setRandom();
+    serial.configure(batch);
+    parallel.configure(batch);
+    tensor_4 expected = serial.forward(input);
+    tensor_4 output = parallel.forward(input);
+    for(long i = 0; i < expected.size(); ++i) {
+        BOOST_REQUIRE_SMALL(output.data()[i] - expected.data()[i], 1e-4f);
+    }
+
+    /* The weights have been trained */
+    initial.configure(batch);
+    tensor_4 untrained = initial.forward(input);
+    float_t difference = 0;
+    for(long i = 0; i < expected.size(); ++i) {
+        difference = std::max(difference, std::abs(untrained.data()[i] - expected.data()[i]));
+    }
+    BOOST_REQUIRE_GT(difference, 1e-3f);
+}
+
+BOOST_AUTO_TEST_CASE(test_network_shared_weights) {
+    constexpr size_t samples = 3;
+
+    fused_network master;
+    fused_network replica;
+    master.configure(samples, true);
+    replica.configure(samples);
+
+    /* The replica views the parameters of the master, nothing is copied */
+    replica.share_weights(master);
+    BOOST_REQUIRE(replica.get<0>().w.data() == master.get<0>().w.data());
+    BOOST_REQUIRE(replica.get<8>().b.data() == master.get<8>().b.data());
+
+    tensor_4 input(samples, 1, 12, 12);
+    input.setRandom();
+    tensor_4 delta(samples, 3, 1, 1);
+
+    for(size_t step = 0; step < 2; ++step) {
+        tensor_4 expected = master.forward(input);
+        tensor_4 output = replica.forward(input);
+        for(long i = 0; i < expected.size(); ++i) {
+            BOOST_REQUIRE_EQUAL(output.data()[i], expected.data()[i]);
+        }
+
+        /* The engine caches of the replica follow the updates of the master */
+        delta.setRandom();
+        master.backward(delta);
+        stochastic_gradient_descent_optimizer<> optimizer;
+        master.update_weights(optimizer);
+        replica.shared_weights_changed(master);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_network_hogwild_training) {
+    constexpr size_t batch = 4;
+    constexpr size_t sample_count = 6 * batch;
+
+    fused_network serial;
+    fused_network hogwild;
+    serial.configure(batch, true);
+
+    std::stringstream buffer;
+    serial.save(buffer);
+    hogwild.load(buffer);
+
+    sample_vector_type samples(sample_count, sample_type(1, 12, 12));
+    class_vector_type classes(sample_count);
+    for(size_t s = 0; s < sample_count; ++s) {
+        samples[s].setRandom();
+        classes[s] = s % fused_network::output_dims::size;
+    }
+
+    training<batch, 2, ada_gradient_optimizer<>> serial_trainer;
+    serial_trainer(serial, samples, classes, false);
+
+    /* A single worker takes the batches in order */
+    hogwild_training<batch, 2, ada_gradient_optimizer<>> hogwild_trainer;
+    hogwild_trainer.workers = 1;
+    hogwild_trainer(hogwild, samples, classes, false);
+    BOOST_REQUIRE_GT(hogwild_trainer.samples_per_second, 0);
+
+    tensor_4 input(batch, 1, 12, 12);
+    input.setRandom();
+    tensor_4 expected = serial.forward(input);
+    tensor_4 output = hogwild.forward(input);
+    for(long i = 0; i < expected.size(); ++i) {
+        BOOST_REQUIRE_SMALL(output.data()[i] - expected.data()[i], 1e-4f);
+    }
+
+    /* Concurrent workers visit every batch */
+    const size_t threads = sp::util::thread_count();
+    sp::util::set_thread_count(3);
+    std::vector<size_t> visits(sample_count / batch);
+    hogwild_trainer.workers = 3;
+    hogwild_trainer.on_batch = [&](const size_t& b) {
+        visits[b] += 1;
+    };
+    hogwild_trainer(hogwild, samples, classes, false);
+    sp::util::set_thread_count(threads);
+
+    for(auto& v : visits) {
+        BOOST_REQUIRE_EQUAL(v, 2u);
+    }
+    output = hogwild.forward(input);
+    for(long i = 0; i < output.size(); ++i) {
+        BOOST_REQUIRE(std::isfinite(output.data()[i]));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_network_batch_loader) {
+    constexpr size_t batch = 3;
+    constexpr size_t epochs = 3;
+    constexpr size_t sample_count = 4 * batch;
+
+    /* Sample s is filled with s, such that the batches identify the samples */
+    sample_vector_type samples(sample_count, sample_type(1, 12, 12));
+    class_vector_type classes(sample_count);
+    for(size_t s = 0; s < sample_count; ++s) {
+        samples[s].setConstant(s);
+        classes[s] = s % fused_network::output_dims::size;
+    }
+
+    batch_loader<fused_network> loader(samples, classes, batch, epochs, {-1, 1}, true);
+
+    std::vector<std::vector<size_t>> orders(epochs);
+    for(size_t e = 0; e < epochs; ++e) {
+        for(size_t b = 0; b < sample_count / batch; ++b) {
+            auto& next = loader.acquire();
+            for(size_t s = 0; s < batch; ++s) {
+                const size_t index = static_cast<size_t>(next.input(s, 0, 5, 7));
+                orders[e].push_back(index);
+                for(size_t c = 0; c < fused_network::output_dims::size; ++c) {
+                    BOOST_REQUIRE_EQUAL(next.expected(s, c, 0, 0), c == classes[index] ? 1 : -1);
+                }
+            }
+            loader.release();
+        }
+        /* Every sample once per epoch */
+        std::vector<size_t> sorted = orders[e];
+        std::sort(sorted.begin(), sorted.end());
+        for(size_t s = 0; s < sample_count; ++s) {
+            BOOST_REQUIRE_EQUAL(sorted[s], s);
+        }
+    }
+    BOOST_REQUIRE(orders[0] != orders[1] || orders[1] != orders[2]);
+
+    /* In order by default. Destroying a loader with batches in flight stops the producer */
+    batch_loader<fused_network, 2> abandoned(samples, classes, batch, epochs, {0, 1});
+    BOOST_REQUIRE_EQUAL(abandoned.acquire().input(1, 0, 0, 0), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_network_dynamic_batch_size) {
+    constexpr size_t max_batch = 5;
+
+    fused_network nn;
+    nn.configure(max_batch, true);
+
+    /* The buffer at offset zero starts the arena */
+    const float_t* storage = nn.values[0].data();
+    for(auto& v : nn.values) {
+        storage = std::min<const float_t*>(storage, v.data());
+    }
+    const float_t* storage_end = storage + fused_network::memory_plan().arena * max_batch;
+
+    tensor_4 input(max_batch, 1, 12, 12);
+    input.setRandom();
+    tensor_4 expected = nn.forward(input);
+
+    /* Smaller batches run as views over the same storage */
+    for(size_t n : {2, 1, 4}) {
+        tensor_4_view output = nn.forward(tensor_4_view(input.data(), n, 1, 12, 12));
+        BOOST_REQUIRE_EQUAL(nn.batch_size(), n);
+        BOOST_REQUIRE_EQUAL(nn.max_batch_size(), max_batch);
+        for(auto& v : nn.values) {
+            BOOST_REQUIRE(v.data() >= storage && v.data() + v.size() <= storage_end);
+        }
+        BOOST_REQUIRE_EQUAL(output.dimension(0), static_cast<long>(n));
+        for(long i = 0; i < output.size(); ++i) {
+            BOOST_REQUIRE_SMALL(output.data()[i] - expected.data()[i], 1e-5f);
+        }
+    }
+
+    nn.configure(max_batch);
+    const float_t* first = nn.values[0].data();
+    nn.configure(3);
+    nn.configure(max_batch);
+    BOOST_REQUIRE_EQUAL(nn.values[0].data(), first);
+    nn.configure(3);
+    BOOST_REQUIRE_EQUAL(nn.batch_size(), 3u);
+
+    /* Test passes with a partial last batch */
+    sample_vector_type samples(7, sample_type(1, 12, 12));
+    class_vector_type classes(7, 1);
+    for(auto& s : samples) {
+        s.setRandom();
+    }
+    auto [correct, total, cm] = nn.test(samples, classes);
+    (void)correct;
+    BOOST_REQUIRE_EQUAL(total, 7u);
+    BOOST_REQUIRE_EQUAL(cm.sum(), 7u);
+    BOOST_REQUIRE_EQUAL(nn.batch_size(), 3u);
+}
+
+BOOST_AUTO_TEST_CASE(test_network_training_remainder_batch) {
+    constexpr size_t batch = 4;
+    constexpr size_t sample_count = 10;
+
+    const size_t threads = sp::util::thread_count();
+    sp::util::set_thread_count(3);
+
+    fused_network serial;
+    fused_network parallel;
+    fused_network hogwild;
+    serial.configure(batch, true);
+
+    std::stringstream buffer;
+    serial.save(buffer);
+    parallel.load(buffer);
+    buffer.seekg(0);
+    hogwild.load(buffer);
+
+    sample_vector_type samples(sample_count, sample_type(1, 12, 12));
+    class_vector_type classes(sample_count);
+    for(size_t s = 0; s < sample_count; ++s) {
+        samples[s].setRandom();
+        classes[s] = s % fused_network::output_dims::size;
+    }
+
+    size_t batches = 0;
+    training<batch, 1, ada_gradient_optimizer<>> serial_trainer;
+    serial_trainer.on_batch = [&](const size_t&) {
+        ++batches;
+    };
+    serial_trainer(serial, samples, classes, false);
+    BOOST_REQUIRE_EQUAL(batches, 3u);
+
+    /* The last batch of two samples leaves the third worker idle */
+    data_parallel_training<batch, 1, ada_gradient_optimizer<>> parallel_trainer;
+    parallel_trainer.workers = 3;
+    parallel_trainer(parallel, samples, classes, false);
+
+    hogwild_training<batch, 1, ada_gradient_optimizer<>> hogwild_trainer;
+    hogwild_trainer.workers = 1;
+    hogwild_trainer(hogwild, samples, classes, false);
+
+    sp::util::set_thread_count(threads);
+
+    tensor_4 input(batch, 1, 12, 12);
+    input.setRandom();
+    /* The network of data parallel training is sized for its shard */
+    parallel.configure(batch);
+    tensor_4 expected = serial.forward(input);
+    tensor_4 parallel_output = parallel.forward(input);
+    tensor_4 hogwild_output = hogwild.forward(input);
+    for(long i = 0; i < expected.size(); ++i) {
+        BOOST_REQUIRE_SMALL(parallel_output.data()[i] - expected.data()[i], 1e-4f);
+        BOOST_REQUIRE_SMALL(hogwild_output.data()[i] - expected.data()[i], 1e-4f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_network_parameter_registry) {
+    constexpr size_t samples = 3;
+
+    fused_network net;
+    net.configure(samples, true);
+
+    /* Weights, biases and gradients are views of the registry, in layer order */
+    auto& conv = net.get<0>();
+    auto& fc = net.get<8>();
+    const auto& layout = net.parameters.layout();
+    BOOST_REQUIRE(conv.w.is_bound() && conv.dw.is_bound() && fc.b.is_bound() && fc.db.is_bound());
+    BOOST_REQUIRE(conv.w.data() == net.parameters.parameters() + layout.front().offset);
+    BOOST_REQUIRE(conv.dw.data() == net.parameters.gradients() + layout.front().gradients);
+    BOOST_REQUIRE(fc.b.data() == net.parameters.parameters() + layout.back().offset);
+    BOOST_REQUIRE(fc.db.data() == net.parameters.gradients() + layout.back().gradients);
+    BOOST_REQUIRE_EQUAL(layout.back().layer, 8u);
+    for(const auto& seg : layout) {
+        BOOST_REQUIRE(seg.offset % (detail::arena_alignment / sizeof(float_t)) == 0);
+        BOOST_REQUIRE(seg.offset + seg.size <= net.parameters.size());
+    }
+
+    /* The fused pass matches updating layer by layer, over the optimizer state of two steps */
+    auto conv_reference = conv;
+    auto fc_reference = fc;
+    BOOST_REQUIRE(!conv_reference.w.is_bound());
+    /* Adam advances its bias correction once per step, not once per layer */
+    adam_optimizer<> fused_optimizer;
+    adam_optimizer<> reference_optimizer;
+    tensor_4 input(samples, 1, 12, 12);
+    tensor_4 delta(samples, 3, 1, 1);
+    for(size_t step = 0; step < 2; ++step) {
+        input.setRandom();
+        delta.setRandom();
+        net.forward(input);
+        net.backward(delta);
+
+        conv_reference.dw = conv.dw;
+        conv_reference.db = conv.db;
+        conv_reference.accumulated_samples = conv.accumulated_samples;
+        fc_reference.dw = fc.dw;
+        fc_reference.db = fc.db;
+        fc_reference.accumulated_samples = fc.accumulated_samples;
+
+        net.update_weights(fused_optimizer);
+        reference_optimizer.begin_step();
+        conv_reference.update_weights(reference_optimizer);
+        fc_reference.update_weights(reference_optimizer);
+
+        BOOST_REQUIRE_EQUAL(conv.accumulated_samples, 0u);
+        for(long i = 0; i < conv.w.size(); ++i) {
+            BOOST_REQUIRE_SMALL(conv.w.data()[i] - conv_reference.w.data()[i], 1e-6f);
+        }
+        for(long i = 0; i < fc.w.size(); ++i) {
+            BOOST_REQUIRE_SMALL(fc.w.data()[i] - fc_reference.w.data()[i], 1e-6f);
+        }
+        for(long i = 0; i < fc.b.size(); ++i) {
+            BOOST_REQUIRE_SMALL(fc.b.data()[i] - fc_reference.b.data()[i], 1e-6f);
+        }
+        for(long i = 0; i < conv.dw.size(); ++i) {
+            BOOST_REQUIRE_EQUAL(conv.dw.data()[i], 0.0f);
+        }
+    }
+
+    /* Reconfiguring keeps the values, inference releases the gradients */
+    tensor_4 expected = net.forward(input);
+    net.configure_inference(samples);
+    BOOST_REQUIRE(conv.w.is_bound() && !conv.dw.is_bound());
+    BOOST_REQUIRE_EQUAL(conv.dw.size(), 0);
+    tensor_4 output = net.forward(input);
+    for(long i = 0; i < expected.size(); ++i) {
+        BOOST_REQUIRE_SMALL(output.data()[i] - expected.data()[i], 1e-6f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_network_stored_weights_follow_update) {
+    constexpr size_t samples = 4;
+
+    using bf16_network = network<
+        fully_connected_layer<volume_dims<300>, 700, true, bf16_precision>,
+        tanh_layer<volume_dims<700>>
+    >;
+    bf16_network net;
+    net.configure(samples, true);
+
+    /* The weights are refreshed in storage precision by the update, the bias is not stored */
+    auto& fc = net.get<0>();
+    const auto& layout = net.parameters.layout();
+    BOOST_REQUIRE_EQUAL(layout.size(), 2u);
+    BOOST_REQUIRE(layout.front().stored && !layout.back().stored);
+
+    adam_optimizer<> optimizer;
+    tensor_4 input(samples, 300, 1, 1);
+    tensor_4 delta(samples, 700, 1, 1);
+    for(size_t step = 0; step < 2; ++step) {
+        input.setRandom();
+        delta.setRandom();
+        net.forward(input);
+        net.backward(delta);
+        net.update_weights(optimizer);
+
+        std::vector<bfloat16_t> expected(fc.w.size());
+        detail::to_storage(fc.w.data(), expected.data(), expected.size());
+        BOOST_REQUIRE_EQUAL(fc.ws.size(), expected.size());
+        for(size_t i = 0; i < expected.size(); ++i) {
+            BOOST_REQUIRE_EQUAL(fc.ws[i].bits, expected[i].bits);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_network_binary_checkpoint) {
+    constexpr size_t samples = 3;
+    namespace fs = boost::filesystem;
+    const std::string file = (fs::temp_directory_path() / fs::unique_path("sp_nn_%%%%%%%%.ckpt")).string();
+
+    fused_network trained;
+    trained.configure(samples, true);
+    BOOST_REQUIRE(trained.save_checkpoint(file));
+
+    tensor_4 input(samples, 1, 12, 12);
+    input.setRandom();
+    tensor_4 expected = trained.forward(input);
+
+    /* Loaded by copy, bit exact */
+    fused_network loaded;
+    BOOST_REQUIRE(loaded.load_checkpoint(file));
+    loaded.configure(samples);
+    tensor_4 output = loaded.forward(input);
+    for(long i = 0; i < expected.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(output.data()[i], expected.data()[i]);
+    }
+
+    /* Mapped, the weights view the pages of the file and no private copy is held */
+    fused_network mapped;
+    mapped.configure_inference(samples);
+    BOOST_REQUIRE(mapped.map_checkpoint(file));
+    const auto in_mapping = [&](const float_t* data) {
+        const unsigned char* first = mapped.mapped->data();
+        const auto* p = reinterpret_cast<const unsigned char*>(data);
+        return p >= first + detail::checkpoint_page && p < first + mapped.mapped->size;
+    };
+    for(size_t reconfigured = 0; reconfigured < 2; ++reconfigured) {
+        BOOST_REQUIRE(in_mapping(mapped.get<0>().w.data()) && in_mapping(mapped.get<0>().b.data()));
+        BOOST_REQUIRE(in_mapping(mapped.get<8>().w.data()) && in_mapping(mapped.get<8>().b.data()));
+        BOOST_REQUIRE_EQUAL(reinterpret_cast<std::uintptr_t>(mapped.get<8>().w.data()) % detail::arena_alignment, 0u);
+        BOOST_REQUIRE(mapped.parameters.parameters() == nullptr);
+        BOOST_REQUIRE_EQUAL(mapped.parameters.size(), 0u);
+        output = mapped.forward(input);
+        for(long i = 0; i < expected.size(); ++i) {
+            BOOST_REQUIRE_EQUAL(output.data()[i], expected.data()[i]);
+        }
+        /* A larger batch reconfigures the layers, the weights stay mapped */
+        mapped.configure_inference(2 * samples);
+    }
+
+    /* Configured for training, the values are copied into the registry */
+    mapped.configure(samples);
+    BOOST_REQUIRE(!mapped.mapped);
+    BOOST_REQUIRE(mapped.get<8>().w.data() >= mapped.parameters.parameters());
+    BOOST_REQUIRE(mapped.get<8>().w.data() < mapped.parameters.parameters() + mapped.parameters.size());
+    output = mapped.forward(input);
+    for(long i = 0; i < expected.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(output.data()[i], expected.data()[i]);
+    }
+
+    /* Layers are identified by an explicit descriptor, not by their type name */
+    BOOST_REQUIRE_EQUAL(detail::checkpoint_layer_descriptor(trained.get<0>()), "convolution 1x12x12 6x10x10 w 6x1x3x3 b 6 f32");
+    BOOST_REQUIRE_EQUAL(detail::checkpoint_layer_descriptor(trained.get<8>()), "fully_connected 4x4x4 3x1x1 w 4x4x4x3 b 3 f32");
+
+    /* Another network, or a corrupt checkpoint, is rejected */
+    network<fully_connected_layer<volume_dims<1, 12, 12>, 3>> other;
+    BOOST_REQUIRE(!other.load_checkpoint(file));
+    BOOST_REQUIRE(!other.map_checkpoint(file));
+    std::stringstream corrupt;
+    trained.save_checkpoint(corrupt);
+    std::string bytes = corrupt.str();
+    bytes[detail::checkpoint_page + 8] ^= 0x10;
+    std::stringstream corrupted(bytes);
+    BOOST_REQUIRE(!loaded.load_checkpoint(corrupted));
+
+    fs::remove(file);
+}
+
+BOOST_AUTO_TEST_CASE(test_network_checkpoint_writer) {
+    constexpr size_t samples = 3;
+    namespace fs = boost::filesystem;
+    const std::string file = (fs::temp_directory_path() / fs::unique_path("sp_nn_%%%%%%%%.ckpt")).string();
+
+    fused_network net;
+    net.configure(samples, true);
+    tensor_4 input(samples, 1, 12, 12);
+    input.setRandom();
+    tensor_4 expected = net.forward(input);
+
+    {
+        checkpoint_writer<fused_network, 1> writer(net);
+        writer.save(file);
+
+        /* The snapshot is taken by save, later changes are not written */
+        net.get<8>().w.setZero();
+        net.weights_changed();
+
+        /* A single buffer, the next save waits for the first to be written */
+        writer.save(file + ".second");
+        writer.wait();
+        BOOST_REQUIRE_EQUAL(writer.written.load(), 2u);
+        BOOST_REQUIRE_EQUAL(writer.failed.load(), 0u);
+        BOOST_REQUIRE(!fs::exists(file + ".tmp"));
+
+        /* A failed rename, i.e. over a directory, removes the temporary file */
+        fs::create_directory(file + ".dir");
+        writer.save(file + ".dir");
+        writer.wait();
+        BOOST_REQUIRE_EQUAL(writer.failed.load(), 1u);
+        BOOST_REQUIRE(!fs::exists(file + ".dir.tmp"));
+        fs::remove(file + ".dir");
+    }
+
+    fused_network loaded;
+    BOOST_REQUIRE(loaded.load_checkpoint(file));
+    loaded.configure(samples);
+    tensor_4 output = loaded.forward(input);
+    for(long i = 0; i < expected.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(output.data()[i], expected.data()[i]);
+    }
+    BOOST_REQUIRE(loaded.load_checkpoint(file + ".second"));
+    for(long i = 0; i < loaded.get<8>().w.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(loaded.get<8>().w.data()[i], 0.0f);
+    }
+
+    fs::remove(file);
+    fs::remove(file + ".second");
+}
+
+BOOST_AUTO_TEST_CASE(test_network_softmax_cross_entropy) {
+    constexpr size_t samples = 4;
+
+    using network_def = network<
+        fully_connected_layer<volume_dims<1, 1, 4>, 3>,
+        softmax_layer<volume_dims<3>>
+    >;
+
+    static_assert(network_def::fused_output_loss<cross_entropy>, "Cross entropy is fused with the softmax");
+    static_assert(!network_def::fused_output_loss<mean_square_error>, "Mean square error is not fused");
+
+    network_def fused;
+    network_def reference;
+    fused.configure(samples, true);
+
+    std::stringstream buffer;
+    fused.save(buffer);
+    reference.load(buffer);
+    reference.configure(samples);
+
+    tensor_4 input(samples, 1, 1, 4);
+    input.setRandom();
+    tensor_4 expected(samples, 3, 1, 1);
+    expected.setZero();
+    for(size_t si = 0; si < samples; ++si) {
+        expected(si, si % 3, 0, 0) = 1.0f;
+    }
+
+    /* The fused gradient (p - y) matches back propagating -y / p through the softmax */
+    cross_entropy loss;
+    fused.forward(input);
+    fused.backward(loss, expected);
+
+    tensor_4 predicted = reference.forward(input);
+    tensor_4 delta(samples, 3, 1, 1);
+    gradient(loss, predicted, expected, delta);
+    reference.backward(delta);
+
+    for(long i = 0; i < input.size(); ++i) {
+        BOOST_REQUIRE_SMALL(fused.values_delta[0].data()[i] - reference.values_delta[0].data()[i], 1e-5f);
+    }
+    auto& fc = fused.get<0>();
+    auto& fc_reference = reference.get<0>();
+    fc.reduce_gradients();
+    fc_reference.reduce_gradients();
+    for(long i = 0; i < fc.w.size(); ++i) {
+        BOOST_REQUIRE_SMALL(fc.dw.data()[i] - fc_reference.dw.data()[i], 1e-5f);
+    }
+    for(long i = 0; i < fc.b.size(); ++i) {
+        BOOST_REQUIRE_SMALL(fc.db.data()[i] - fc_reference.db.data()[i], 1e-5f);
+    }
+
+    /* Training reduces the loss */
+    auto total_loss = [&]() {
+        tensor_4 output = fused.forward(input);
+        float_t sum = 0;
+        for(size_t si = 0; si < samples; ++si) {
+            sum += loss(si, output, expected);
+        }
+        return sum;
+    };
+    training<samples, 1, stochastic_gradient_descent_optimizer<>, cross_entropy> trainer;
+    const float_t initial = total_loss();
+    for(size_t step = 0; step < 50; ++step) {
+        trainer(fused, input, expected);
+    }
+    BOOST_REQUIRE_LT(total_loss(), initial);
+}
@@ -102,3 +102,68 @@ BOOST_AUTO_TEST_CASE(test_activation_layer_grad_check) {
         BOOST_CHECK_MESSAGE(std::abs(a-n) <= epsilon, "Gradient check |" << std::setprecision(15) << a << " - " << n << "| < " << epsilon);
     }
 }
+
+BOOST_AUTO_TEST_CASE(test_activation_softmax_fprop_bprop) {
+
+    /* Softmax over the depth of each of the two spatial positions */
+    using softmax_act_layer = softmax_layer<volume_dims<3, 1, 2>>;
+    softmax_act_layer layer;
+
+    layer.configure(1, true);
+
+    tensor_4 in(1, 3, 1, 2);
+    tensor_4 out(1, 3, 1, 2);
+    tensor_4 prev_delta(1, 3, 1, 2);
+    tensor_4 out_delta(1, 3, 1, 2);
+
+    /* Large inputs do not overflow */
+    in.setValues({{{{1000.0f, -1.0f}}, {{1001.0f, 0.0f}}, {{1002.0f, 1.0f}}}});
+    out_delta.setValues({{{{1.0f, -2.0f}}, {{0.5f, 3.0f}}, {{-1.0f, 0.25f}}}});
+    prev_delta.setZero();
+
+    layer.forward_prop(in, out);
+
+    for(long iw = 0; iw < 2; ++iw) {
+        const float_t m = in(0, 2, 0, iw);
+        const float_t sum = std::exp(in(0, 0, 0, iw) - m) + std::exp(in(0, 1, 0, iw) - m) + 1.0f;
+        for(long id = 0; id < 3; ++id) {
+            BOOST_CHECK_CLOSE(out(0, id, 0, iw), std::exp(in(0, id, 0, iw) - m) / sum, 1e-3);
+        }
+    }
+
+    layer.backward_prop(in, prev_delta, out, out_delta);
+
+    /* The Jacobian of the softmax, dy_i/dx_j = y_i * (delta_ij - y_j) */
+    for(long iw = 0; iw < 2; ++iw) {
+        for(long i = 0; i < 3; ++i) {
+            float_t expected = 0;
+            for(long j = 0; j < 3; ++j) {
+                const float_t jacobian = out(0, j, 0, iw) * ((i == j ? 1.0f : 0.0f) - out(0, i, 0, iw));
+                expected += out_delta(0, j, 0, iw) * jacobian;
+            }
+            BOOST_CHECK_SMALL(prev_delta(0, i, 0, iw) - expected, 1e-5f);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_activation_softmax_grad_check) {
+    using layer_type = softmax_layer<volume_dims<10, 1, 1>>;
+
+    constexpr float_t epsilon = 1e-2f;
+    constexpr size_t batch_size = 1;
+    layer_type layer;
+
+    layer.configure(batch_size, true);
+
+    auto in = generate_inputs_for(layer, batch_size);
+
+    for(size_t i = 0; i < 100; ++i) {
+        auto in_selected  = gradient_random_input(layer);
+        auto out_selected = gradient_random_output(layer);
+
+        auto n = numerical_gradient (layer, in, in_selected, out_selected);
+        auto a = analytical_gradient(layer, in, in_selected, out_selected);
+
+        BOOST_CHECK_MESSAGE(std::abs(a-n) <= epsilon, "Gradient check |" << std::setprecision(15) << a << " - " << n << "| < " << epsilon);
+    }
+}
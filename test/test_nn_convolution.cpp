@@ -197,13 +197,14 @@ BOOST_AUTO_TEST_CASE(test_conv_layer_backward_prop) {
     layer.backward_prop(prev_out, prev_delta, curr_out, curr_delta);
 
     assert_tensor_equals(expected_prev_delta, prev_delta);
-//    assert_tensor_equals(expected_dw, layer.dw);
-//    assert_tensor_equals(expectd_db, layer.db);
+    layer.reduce_gradients();
+    assert_tensor_equals(tensor_4(expected_dw.chip(0, 0)), tensor_4(layer.dw.chip(0, 0)));
+    assert_tensor_equals(tensor_1(expectd_db.chip(0, 0)), tensor_1(layer.db.chip(0, 0)));
 }
 BOOST_AUTO_TEST_CASE(test_conv_layer_forward_prop_2) {
     using input_dims = volume_dims<1, 5, 5>;
     using k_params = kernel_symmetric_params<2, 3, 1, padding_type::valid>;
-    using conv_layer_type = conv_layer<input_dims, k_params, true>;
+    using conv_layer_type = conv_layer<input_dims, k_params, true, full_connectivity, 0, direct_conv_engine>;
 
     conv_layer_type layer;
     layer.weight_initializer = vector_weight_initializer({
@@ -346,4 +347,484 @@ BOOST_AUTO_TEST_CASE(test_convolution_gradient_check) {
         /* Validate result */
         BOOST_CHECK_MESSAGE(std::abs(a-n) <= epsilon, "Gradient check |" << a << " - " << n << "| < " << epsilon);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * \brief Element-wise absolute comparison of two tensors of equal dimensions
+ */
+template<typename Tensor>
+void assert_tensor_near(const Tensor& expected, const Tensor& real, float_t tolerance = 1e-4f) {
+    BOOST_REQUIRE(expected.dimensions() == real.dimensions());
+    for(long i = 0; i < expected.size(); ++i) {
+        BOOST_REQUIRE_SMALL(expected.data()[i] - real.data()[i], tolerance);
+    }
+}
+
+/**
+ * \brief Propagates a random batch forward and backward through the layer
+ *        with the weights of reference and compares the results against
+ *        the results of the reference layer
+ */
+template<typename Layer, typename ReferenceLayer>
+void assert_conv_engine_matches(Layer& layer, ReferenceLayer& reference, const size_t& batch_size) {
+
+    reference.weight_initializer = gauss_weight_initializer(-1.0f, 1.0f);
+    reference.bias_initializer = gauss_weight_initializer(-1.0f, 1.0f);
+    reference.configure(batch_size, true);
+
+    layer.configure(batch_size, false);
+    layer.w = reference.w;
+    layer.b = reference.b;
+    layer.weights_changed();
+
+    tensor_4 in = generate_inputs_for(layer, batch_size);
+
+    tensor_4 out, expected_out, curr_delta, prev_delta, expected_prev_delta;
+    detail::prepare_and_zero_tensor<typename Layer::output_dims>(batch_size, out);
+    detail::prepare_and_zero_tensor<typename Layer::output_dims>(batch_size, expected_out);
+    detail::prepare_and_zero_tensor<typename Layer::output_dims>(batch_size, curr_delta);
+    detail::prepare_and_zero_tensor<typename Layer::input_dims>(batch_size, prev_delta);
+    detail::prepare_and_zero_tensor<typename Layer::input_dims>(batch_size, expected_prev_delta);
+    detail::generate_uniform_into(curr_delta);
+
+    reference.forward_prop(in, expected_out);
+    layer.forward_prop(in, out);
+    assert_tensor_near(expected_out, out);
+
+    reference.backward_prop(in, expected_prev_delta, expected_out, curr_delta);
+    layer.backward_prop(in, prev_delta, out, curr_delta);
+    assert_tensor_near(expected_prev_delta, prev_delta);
+    reference.reduce_gradients();
+    layer.reduce_gradients();
+    assert_tensor_near(tensor_4(reference.dw.chip(0, 0)), tensor_4(layer.dw.chip(0, 0)));
+    assert_tensor_near(tensor_1(reference.db.chip(0, 0)), tensor_1(layer.db.chip(0, 0)));
+}
+BOOST_AUTO_TEST_CASE(test_convolution_im2col_engine_matches_direct) {
+    using input_dims = volume_dims<3, 11, 9>;
+    using k_params = kernel_params<4, 3, 2, 2, 1>;
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, im2col_conv_engine> layer;
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 5);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_im2col_engine_matches_direct_table_connectivity) {
+    using input_dims = volume_dims<3, 8, 8>;
+    using k_params = kernel_symmetric_params<4, 5, 1>;
+    using connectivity = table_connectivity<
+        3, 4,
+        1, 0, 0, 1,
+        1, 1, 0, 0,
+        0, 1, 1, 1
+    >;
+
+    conv_layer<input_dims, k_params, true, connectivity, 0, im2col_conv_engine> layer;
+    conv_layer<input_dims, k_params, true, connectivity, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_default_engine_selection) {
+    using small_3x3 = default_conv_engine_t<volume_dims<2, 6, 6>, kernel_symmetric_params<4, 3, 1>>;
+    using large_3x3 = default_conv_engine_t<volume_dims<2, 16, 16>, kernel_symmetric_params<4, 3, 1>>;
+    using strided_3x3 = default_conv_engine_t<volume_dims<2, 16, 16>, kernel_symmetric_params<4, 3, 2>>;
+    using other = default_conv_engine_t<volume_dims<2, 16, 16>, kernel_symmetric_params<4, 5, 1>>;
+    BOOST_CHECK((std::is_same_v<small_3x3, winograd_conv_engine<2>>));
+    BOOST_CHECK((std::is_same_v<large_3x3, winograd_conv_engine<4>>));
+    BOOST_CHECK((std::is_same_v<strided_3x3, im2col_conv_engine>));
+    BOOST_CHECK((std::is_same_v<other, im2col_conv_engine>));
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_winograd_2x2_engine_matches_direct) {
+    using input_dims = volume_dims<3, 9, 8>;
+    using k_params = kernel_symmetric_params<5, 3, 1>;
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, winograd_conv_engine<2>> layer;
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_winograd_4x4_engine_matches_direct) {
+    using input_dims = volume_dims<4, 13, 11>;
+    using k_params = kernel_symmetric_params<3, 3, 1>;
+    using connectivity = table_connectivity<
+        4, 3,
+        1, 0, 1,
+        1, 1, 0,
+        0, 1, 1,
+        1, 1, 1
+    >;
+
+    conv_layer<input_dims, k_params, true, connectivity, 0, winograd_conv_engine<4>> layer;
+    conv_layer<input_dims, k_params, true, connectivity, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_winograd_engine_transforms_updated_weights) {
+    using input_dims = volume_dims<2, 10, 10>;
+    using k_params = kernel_symmetric_params<2, 3, 1>;
+    constexpr size_t batch_size = 2;
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, winograd_conv_engine<4>> layer;
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, batch_size);
+
+    gradient_descent_optimizer<std::ratio<1, 10>> optimizer;
+    optimizer.begin_step();
+    layer.update_weights(optimizer);
+    reference.update_weights(optimizer);
+
+    auto in = generate_inputs_for(layer, batch_size);
+    tensor_4 out, expected_out;
+    detail::prepare_and_zero_tensor<typename decltype(layer)::output_dims>(batch_size, out);
+    detail::prepare_and_zero_tensor<typename decltype(layer)::output_dims>(batch_size, expected_out);
+    reference.forward_prop(in, expected_out);
+    layer.forward_prop(in, out);
+    assert_tensor_near(expected_out, out, 1e-3f);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_fft_engine_matches_direct) {
+    using input_dims = volume_dims<3, 16, 13>;
+    using k_params = kernel_symmetric_params<4, 7, 1>;
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, fft_conv_engine> layer;
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_fft_engine_matches_direct_strided_table_connectivity) {
+    using input_dims = volume_dims<3, 15, 15>;
+    using k_params = kernel_params<4, 5, 3, 2, 3>;
+    using connectivity = table_connectivity<
+        3, 4,
+        1, 0, 0, 1,
+        1, 1, 0, 0,
+        0, 1, 1, 1
+    >;
+
+    conv_layer<input_dims, k_params, true, connectivity, 0, fft_conv_engine> layer;
+    conv_layer<input_dims, k_params, true, connectivity, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_tiled_engine_matches_direct_pointwise) {
+    using input_dims = volume_dims<10, 5, 7>;
+    using k_params = kernel_symmetric_params<11, 1, 1>;
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, tiled_direct_conv_engine> layer;
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_tiled_engine_matches_direct_3x3) {
+    using input_dims = volume_dims<6, 13, 22>;
+    using k_params = kernel_symmetric_params<5, 3, 1>;
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, tiled_direct_conv_engine> layer;
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_tiled_engine_matches_direct_5x5_table_connectivity) {
+    using input_dims = volume_dims<3, 14, 20>;
+    using k_params = kernel_symmetric_params<4, 5, 1>;
+    using connectivity = table_connectivity<
+        3, 4,
+        1, 0, 0, 1,
+        1, 1, 0, 0,
+        0, 1, 1, 1
+    >;
+
+    conv_layer<input_dims, k_params, true, connectivity, 0, tiled_direct_conv_engine> layer;
+    conv_layer<input_dims, k_params, true, connectivity, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_tiled_engine_matches_direct_strided) {
+    using input_dims = volume_dims<3, 15, 27>;
+    using k_params = kernel_params<5, 3, 2, 2, 2>;
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, tiled_direct_conv_engine> layer;
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_connection_list_table) {
+    using connectivity = table_connectivity<
+        3, 4,
+        1, 0, 0, 1,
+        1, 1, 0, 0,
+        0, 1, 1, 1
+    >;
+    using list = detail::connection_list<connectivity, 3, 4>;
+
+    BOOST_CHECK_EQUAL(list::count, 7);
+    BOOST_CHECK_EQUAL(list::groups, 0);
+
+    /* Kernels are ordered by output and then input channel */
+    constexpr size_t inputs[] = {0, 1, 1, 2, 2, 0, 2};
+    constexpr size_t outputs[] = {0, 0, 1, 1, 2, 3, 3};
+    for(size_t k = 0; k < list::count; ++k) {
+        BOOST_CHECK_EQUAL(list::input(k), inputs[k]);
+        BOOST_CHECK_EQUAL(list::output(k), outputs[k]);
+        BOOST_CHECK_EQUAL(list::index(outputs[k], inputs[k]), k);
+        BOOST_CHECK(k >= list::begin(outputs[k]) && k < list::end(outputs[k]));
+    }
+    BOOST_CHECK(!list::connected(0, 2));
+    BOOST_CHECK_EQUAL(list::index(0, 2), list::count);
+
+    /* Weights and their gradients are only stored for connected kernels */
+    conv_layer<volume_dims<3, 8, 8>, kernel_symmetric_params<4, 5, 1>, true, connectivity, 0, direct_conv_engine> layer;
+    layer.configure(1, true);
+    BOOST_CHECK_EQUAL(layer.w.size(), 7 * 5 * 5);
+    BOOST_CHECK_EQUAL(layer.dw.size() / layer.dw.dimension(0), 7 * 5 * 5);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_connection_list_ngroups) {
+    using list = detail::connection_list<ngroups_connectivity<2, 4, 6>, 4, 6>;
+
+    BOOST_CHECK_EQUAL(list::count, 12);
+    BOOST_CHECK_EQUAL(list::groups, 2);
+    for(size_t od = 0; od < 6; ++od) {
+        for(size_t id = 0; id < 4; ++id) {
+            BOOST_CHECK_EQUAL(list::connected(od, id), od / 3 == id / 2);
+            BOOST_CHECK_EQUAL((ngroups_connectivity<2, 4, 6>::connected(od, id)), od / 3 == id / 2);
+        }
+        for(size_t k = list::begin(od); k < list::end(od); ++k) {
+            BOOST_CHECK_EQUAL(list::output(k), od);
+            BOOST_CHECK_EQUAL(list::index(od, list::input(k)), k);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_im2col_engine_grouped_matches_table) {
+    using input_dims = volume_dims<4, 9, 10>;
+    using k_params = kernel_params<6, 3, 2, 1, 2>;
+    /* The table equivalent of two groups, (4 inputs x 6 outputs) */
+    using table = table_connectivity<
+        4, 6,
+        1, 1, 1, 0, 0, 0,
+        1, 1, 1, 0, 0, 0,
+        0, 0, 0, 1, 1, 1,
+        0, 0, 0, 1, 1, 1
+    >;
+
+    conv_layer<input_dims, k_params, true, ngroups_connectivity<2, 4, 6>, 0, im2col_conv_engine> layer;
+    conv_layer<input_dims, k_params, true, table, 0, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_same_padding_and_dilation_output_dims) {
+    using same_5x5 = detail::convolution_geometry<volume_dims<1, 28, 28>, kernel_symmetric_params<6, 5, 1, padding_type::same>>;
+    BOOST_CHECK_EQUAL(same_5x5::pad_top, 2);
+    BOOST_CHECK_EQUAL(same_5x5::pad_left, 2);
+    BOOST_CHECK_EQUAL(same_5x5::output_dims::h, 28);
+    BOOST_CHECK_EQUAL(same_5x5::output_dims::w, 28);
+
+    /* Same padding with strides yields ceil(H / s) */
+    using same_strided = detail::convolution_geometry<volume_dims<1, 15, 16>, kernel_params<4, 3, 4, 2, 2, padding_type::same>>;
+    BOOST_CHECK_EQUAL(same_strided::output_dims::h, 8);
+    BOOST_CHECK_EQUAL(same_strided::output_dims::w, 8);
+    BOOST_CHECK_EQUAL(same_strided::pad_top, 1);
+    BOOST_CHECK_EQUAL(same_strided::pad_left, 1);
+
+    /* A 3x3 kernel with one hole between taps covers 5x5 */
+    using dilated = detail::convolution_geometry<volume_dims<1, 13, 13>, kernel_symmetric_params<4, 3, 1>, 1>;
+    BOOST_CHECK_EQUAL(dilated::extent_h, 5);
+    BOOST_CHECK_EQUAL(dilated::output_dims::h, 9);
+    BOOST_CHECK_EQUAL(dilated::output_dims::w, 9);
+
+    using dilated_same = conv_layer<volume_dims<1, 13, 13>, kernel_symmetric_params<4, 3, 1, padding_type::same>, true, full_connectivity, 2>;
+    BOOST_CHECK_EQUAL(dilated_same::geometry::pad_top, 3);
+    BOOST_CHECK_EQUAL(dilated_same::output_dims::h, 13);
+    BOOST_CHECK_EQUAL(dilated_same::output_dims::w, 13);
+    BOOST_CHECK((std::is_same_v<dilated_same::engine_type, im2col_conv_engine>));
+
+    /* Output rows of the first and last kernel row within the input */
+    BOOST_CHECK((same_5x5::rows(0) == std::pair<size_t, size_t>(2, 28)));
+    BOOST_CHECK((same_5x5::rows(4) == std::pair<size_t, size_t>(0, 26)));
+    BOOST_CHECK_EQUAL(same_5x5::interior_top, 2);
+    BOOST_CHECK_EQUAL(same_5x5::interior_bottom, 26);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_same_padding_matches_padded_input) {
+    constexpr size_t batch_size = 2;
+    using input_dims = volume_dims<2, 7, 9>;
+    using padded_dims = volume_dims<2, 11, 13>;
+
+    conv_layer<input_dims, kernel_symmetric_params<3, 5, 1, padding_type::same>, true, full_connectivity, 0, direct_conv_engine> layer;
+    conv_layer<padded_dims, kernel_symmetric_params<3, 5, 1>, true, full_connectivity, 0, direct_conv_engine> reference;
+
+    static_assert(std::is_same_v<decltype(layer)::output_dims, decltype(reference)::output_dims>);
+
+    reference.weight_initializer = gauss_weight_initializer(-1.0f, 1.0f);
+    reference.bias_initializer = gauss_weight_initializer(-1.0f, 1.0f);
+    reference.configure(batch_size, true);
+    layer.configure(batch_size, false);
+    layer.w = reference.w;
+    layer.b = reference.b;
+    layer.weights_changed();
+
+    /* Materialize the zero padding the layer applies implicitly */
+    tensor_4 in = generate_inputs_for(layer, batch_size);
+    tensor_4 padded(batch_size, padded_dims::d, padded_dims::h, padded_dims::w);
+    padded.setZero();
+    for(size_t s = 0; s < batch_size; ++s) {
+        for(size_t d = 0; d < input_dims::d; ++d) {
+            for(size_t y = 0; y < input_dims::h; ++y) {
+                for(size_t x = 0; x < input_dims::w; ++x) {
+                    padded(s, d, y + 2, x + 2) = in(s, d, y, x);
+                }
+            }
+        }
+    }
+
+    tensor_4 out, expected_out, curr_delta, prev_delta, padded_prev_delta;
+    detail::prepare_and_zero_tensor<decltype(layer)::output_dims>(batch_size, out);
+    detail::prepare_and_zero_tensor<decltype(layer)::output_dims>(batch_size, expected_out);
+    detail::prepare_and_zero_tensor<decltype(layer)::output_dims>(batch_size, curr_delta);
+    detail::prepare_and_zero_tensor<input_dims>(batch_size, prev_delta);
+    detail::prepare_and_zero_tensor<padded_dims>(batch_size, padded_prev_delta);
+    detail::generate_uniform_into(curr_delta);
+
+    reference.forward_prop(padded, expected_out);
+    layer.forward_prop(in, out);
+    assert_tensor_near(expected_out, out);
+
+    reference.backward_prop(padded, padded_prev_delta, expected_out, curr_delta);
+    layer.backward_prop(in, prev_delta, out, curr_delta);
+    for(size_t s = 0; s < batch_size; ++s) {
+        for(size_t d = 0; d < input_dims::d; ++d) {
+            for(size_t y = 0; y < input_dims::h; ++y) {
+                for(size_t x = 0; x < input_dims::w; ++x) {
+                    BOOST_REQUIRE_SMALL(padded_prev_delta(s, d, y + 2, x + 2) - prev_delta(s, d, y, x), 1e-4f);
+                }
+            }
+        }
+    }
+    reference.reduce_gradients();
+    layer.reduce_gradients();
+    assert_tensor_near(tensor_4(reference.dw.chip(0, 0)), tensor_4(layer.dw.chip(0, 0)));
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_dilation_matches_sparse_kernel) {
+    constexpr size_t batch_size = 2;
+    using input_dims = volume_dims<2, 11, 12>;
+
+    /* A 3x3 kernel with one hole between taps equals a 5x5 kernel with zeros at odd taps */
+    conv_layer<input_dims, kernel_symmetric_params<3, 3, 1>, true, full_connectivity, 1, direct_conv_engine> layer;
+    conv_layer<input_dims, kernel_symmetric_params<3, 5, 1>, true, full_connectivity, 0, direct_conv_engine> reference;
+
+    static_assert(std::is_same_v<decltype(layer)::output_dims, decltype(reference)::output_dims>);
+
+    layer.weight_initializer = gauss_weight_initializer(-1.0f, 1.0f);
+    layer.bias_initializer = gauss_weight_initializer(-1.0f, 1.0f);
+    layer.configure(batch_size, true);
+    reference.configure(batch_size, false);
+    reference.w.setZero();
+    for(size_t od = 0; od < 3; ++od) {
+        for(size_t id = 0; id < input_dims::d; ++id) {
+            for(size_t ky = 0; ky < 3; ++ky) {
+                for(size_t kx = 0; kx < 3; ++kx) {
+                    reference.w(od, id, 2 * ky, 2 * kx) = layer.w(od, id, ky, kx);
+                }
+            }
+        }
+    }
+    reference.b = layer.b;
+    reference.weights_changed();
+
+    tensor_4 in = generate_inputs_for(layer, batch_size);
+    tensor_4 out, expected_out, curr_delta, prev_delta, expected_prev_delta;
+    detail::prepare_and_zero_tensor<decltype(layer)::output_dims>(batch_size, out);
+    detail::prepare_and_zero_tensor<decltype(layer)::output_dims>(batch_size, expected_out);
+    detail::prepare_and_zero_tensor<decltype(layer)::output_dims>(batch_size, curr_delta);
+    detail::prepare_and_zero_tensor<input_dims>(batch_size, prev_delta);
+    detail::prepare_and_zero_tensor<input_dims>(batch_size, expected_prev_delta);
+    detail::generate_uniform_into(curr_delta);
+
+    reference.forward_prop(in, expected_out);
+    layer.forward_prop(in, out);
+    assert_tensor_near(expected_out, out);
+
+    reference.backward_prop(in, expected_prev_delta, expected_out, curr_delta);
+    layer.backward_prop(in, prev_delta, out, curr_delta);
+    assert_tensor_near(expected_prev_delta, prev_delta);
+
+    reference.reduce_gradients();
+    layer.reduce_gradients();
+    for(size_t od = 0; od < 3; ++od) {
+        for(size_t id = 0; id < input_dims::d; ++id) {
+            for(size_t ky = 0; ky < 3; ++ky) {
+                for(size_t kx = 0; kx < 3; ++kx) {
+                    BOOST_REQUIRE_SMALL(reference.dw(0, od, id, 2 * ky, 2 * kx) - layer.dw(0, od, id, ky, kx), 1e-4f);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_engines_match_direct_same_padding) {
+    using input_dims = volume_dims<3, 10, 9>;
+    using k_params = kernel_symmetric_params<4, 3, 1, padding_type::same>;
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, direct_conv_engine> reference;
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, im2col_conv_engine> im2col;
+    assert_conv_engine_matches(im2col, reference, 3);
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, winograd_conv_engine<2>> winograd_2x2;
+    assert_conv_engine_matches(winograd_2x2, reference, 3);
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, winograd_conv_engine<4>> winograd_4x4;
+    assert_conv_engine_matches(winograd_4x4, reference, 3);
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, fft_conv_engine> fft;
+    assert_conv_engine_matches(fft, reference, 3);
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 0, tiled_direct_conv_engine> tiled;
+    assert_conv_engine_matches(tiled, reference, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_engines_match_direct_dilated_strided_same_padding) {
+    using input_dims = volume_dims<3, 17, 23>;
+    using k_params = kernel_params<5, 3, 4, 2, 1, padding_type::same>;
+    using connectivity = table_connectivity<
+        3, 5,
+        1, 0, 0, 1, 1,
+        1, 1, 0, 0, 1,
+        0, 1, 1, 1, 0
+    >;
+
+    conv_layer<input_dims, k_params, true, connectivity, 1, direct_conv_engine> reference;
+
+    conv_layer<input_dims, k_params, true, connectivity, 1, im2col_conv_engine> im2col;
+    assert_conv_engine_matches(im2col, reference, 2);
+
+    conv_layer<input_dims, k_params, true, connectivity, 1, fft_conv_engine> fft;
+    assert_conv_engine_matches(fft, reference, 2);
+
+    conv_layer<input_dims, k_params, true, connectivity, 1, tiled_direct_conv_engine> tiled;
+    assert_conv_engine_matches(tiled, reference, 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_convolution_tiled_engine_matches_direct_dilated_same_padding) {
+    using input_dims = volume_dims<6, 21, 30>;
+    using k_params = kernel_symmetric_params<5, 5, 1, padding_type::same>;
+
+    conv_layer<input_dims, k_params, true, full_connectivity, 2, tiled_direct_conv_engine> layer;
+    conv_layer<input_dims, k_params, true, full_connectivity, 2, direct_conv_engine> reference;
+
+    assert_conv_engine_matches(layer, reference, 2);
+}
@@ -9,6 +9,7 @@
 #include <iostream>
 #include <iomanip>
 #include <limits>
+#include <cmath>
 #define BOOST_TEST_MODULE sp_algo_nn
 
 #include <boost/test/unit_test.hpp>
@@ -16,6 +17,9 @@
 #include "sp/algo/nn/network.hpp"
 #include "assert_matrix.hpp"
 #include "sp/algo/nn/gradient_check.hpp"
+#include "sp/algo/nn/optimizer.hpp"
+#include "sp/algo/nn/precision.hpp"
+#include "sp/util/timing.hpp"
 
 #include "sp/util/typename.hpp" // @TODO REMOVE
 
@@ -126,3 +130,300 @@ BOOST_AUTO_TEST_CASE(test_fully_connected_gradient_check) {
         BOOST_CHECK_MESSAGE(std::abs(a-n) <= epsilon, "Gradient check |" << std::setprecision(15) << a << " - " << n << "| < " << epsilon);
     }
 }
+BOOST_AUTO_TEST_CASE(test_gradient_slots_tree_reduction) {
+
+    /* Odd slot count exercises the unpaired slots of every round */
+    weights_delta_type slots(5, 2, 1, 3, 1);
+    for(long s = 0; s < slots.dimension(0); ++s) {
+        for(long i = 0; i < 6; ++i) {
+            slots.data()[s * 6 + i] = static_cast<float_t>((s + 1) * (i + 1));
+        }
+    }
+
+    detail::reduce_gradient_slots(slots);
+
+    for(long i = 0; i < 6; ++i) {
+        BOOST_CHECK_CLOSE(slots.data()[i], 15.0f * (i + 1), 1e-4f);
+    }
+
+    /* Reducing again must not count the merged slots twice */
+    detail::reduce_gradient_slots(slots);
+    for(long i = 0; i < 6; ++i) {
+        BOOST_CHECK_CLOSE(slots.data()[i], 15.0f * (i + 1), 1e-4f);
+    }
+}
+BOOST_AUTO_TEST_CASE(test_gradient_slots_applied_by_tile) {
+
+    /* Several tiles, the last one partial, and an odd slot count */
+    constexpr long slots = 7;
+    const long len = 3 * detail::gradient_tile_size(slots) + 5;
+    weights_delta_type delta(slots, len, 1, 1, 1);
+    weights_type w(len, 1, 1, 1);
+    for(long i = 0; i < delta.size(); ++i) {
+        delta.data()[i] = static_cast<float_t>(i % 13) - 6.0f;
+    }
+    w.setConstant(1.0f);
+
+    /* Reference, reduced as a whole then updated */
+    weights_delta_type reduced = delta;
+    detail::reduce_gradient_slots(reduced);
+    gradient_descent_optimizer<std::ratio<1, 10>> optimizer;
+    detail::apply_gradient_slots(optimizer, w.data(), delta, optimizer.tensor_state(&delta, len), 0.5f);
+
+    for(long i = 0; i < len; ++i) {
+        BOOST_REQUIRE_SMALL(w.data()[i] - (1.0f - 0.05f * reduced.data()[i]), 1e-5f);
+    }
+    for(long i = 0; i < delta.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(delta.data()[i], 0.0f);
+    }
+}
+BOOST_AUTO_TEST_CASE(test_fully_connected_gradients_summed_over_batch) {
+
+    using layer_type = fully_connected_layer<volume_dims<3, 2, 2>, 4>;
+    constexpr size_t batch_size = 7;
+    layer_type layer;
+
+    layer.weight_initializer = gauss_weight_initializer(-1.0f, 1.0f);
+    layer.bias_initializer = gauss_weight_initializer(-1.0f, 1.0f);
+    layer.configure(batch_size, true);
+
+    /* Gradients are kept per thread, not per sample */
+    BOOST_CHECK_EQUAL(layer.dw.dimension(0), static_cast<long>(sp::util::thread_count()));
+
+    auto in = generate_inputs_for(layer, batch_size);
+    tensor_4 out(batch_size, 4, 1, 1); out.setZero();
+    tensor_4 prev_delta(batch_size, 3, 2, 2); prev_delta.setZero();
+    tensor_4 curr_delta(batch_size, 4, 1, 1);
+    detail::generate_uniform_into(curr_delta);
+
+    layer.forward_prop(in, out);
+    layer.backward_prop(in, prev_delta, out, curr_delta);
+    BOOST_CHECK_EQUAL(layer.accumulated_samples, batch_size);
+
+    layer.reduce_gradients();
+
+    for(size_t od = 0; od < 4; ++od) {
+        float_t expected_db = 0;
+        for(size_t si = 0; si < batch_size; ++si) {
+            expected_db += curr_delta(si, od, 0, 0);
+        }
+        BOOST_CHECK_SMALL(layer.db(0, od) - expected_db, 1e-4f);
+        for(size_t id = 0; id < 3; ++id) {
+            for(size_t iy = 0; iy < 2; ++iy) {
+                for(size_t ix = 0; ix < 2; ++ix) {
+                    float_t expected_dw = 0;
+                    for(size_t si = 0; si < batch_size; ++si) {
+                        expected_dw += curr_delta(si, od, 0, 0) * in(si, id, iy, ix);
+                    }
+                    BOOST_CHECK_SMALL(layer.dw(0, id, iy, ix, od) - expected_dw, 1e-4f);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_fully_connected_batch_matches_per_sample) {
+    constexpr size_t batch_size = 5;
+    using layer_type = fully_connected_layer<volume_dims<3, 2, 2>, 4>;
+    layer_type layer;
+
+    layer.weight_initializer = gauss_weight_initializer(-1.0f, 1.0f);
+    layer.bias_initializer = gauss_weight_initializer(-1.0f, 1.0f);
+    layer.configure(batch_size, true);
+
+    auto in = generate_inputs_for(layer, batch_size);
+    tensor_4 out(batch_size, 4, 1, 1); out.setZero();
+    tensor_4 prev_delta(batch_size, 3, 2, 2); prev_delta.setZero();
+    tensor_4 curr_delta(batch_size, 4, 1, 1);
+    detail::generate_uniform_into(curr_delta);
+
+    layer.forward_prop(in, out);
+    layer.backward_prop(in, prev_delta, out, curr_delta);
+
+    for(size_t si = 0; si < batch_size; ++si) {
+        for(size_t od = 0; od < 4; ++od) {
+            float_t expected = layer.b(od);
+            for(size_t id = 0; id < 3; ++id) {
+                for(size_t iy = 0; iy < 2; ++iy) {
+                    for(size_t ix = 0; ix < 2; ++ix) {
+                        expected += layer.w(id, iy, ix, od) * in(si, id, iy, ix);
+                    }
+                }
+            }
+            BOOST_CHECK_SMALL(out(si, od, 0, 0) - expected, 1e-4f);
+        }
+        for(size_t id = 0; id < 3; ++id) {
+            for(size_t iy = 0; iy < 2; ++iy) {
+                for(size_t ix = 0; ix < 2; ++ix) {
+                    float_t expected = 0;
+                    for(size_t od = 0; od < 4; ++od) {
+                        expected += layer.w(id, iy, ix, od) * curr_delta(si, od, 0, 0);
+                    }
+                    BOOST_CHECK_SMALL(prev_delta(si, id, iy, ix) - expected, 1e-4f);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_precision_conversions) {
+
+    std::vector<float> values = {0.0f, -0.0f, 1.0f, -2.5f, 0.1f, 3.14159f, 65504.0f, 1e-3f, -7e-5f, 6e-8f, 1e5f,
+                                 std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN(),
+                                 -std::numeric_limits<float>::quiet_NaN(), detail::bits_float(0x3f808000u), detail::bits_float(0x3f818000u)};
+    /* Past the vector width, so the intrinsic paths and the tail both run */
+    for(size_t i = 0; i < 40; ++i) {
+        values.push_back(static_cast<float>(i) * 0.37f - 7.0f);
+    }
+
+    std::vector<bfloat16_t> bf(values.size());
+    std::vector<half_t> half(values.size());
+    std::vector<float> bf_back(values.size()), half_back(values.size());
+
+    detail::to_storage(values.data(), bf.data(), values.size());
+    detail::from_storage(bf.data(), bf_back.data(), values.size());
+    detail::to_storage(values.data(), half.data(), values.size());
+    detail::from_storage(half.data(), half_back.data(), values.size());
+
+    for(size_t i = 0; i < values.size(); ++i) {
+        const float v = values[i];
+        /* Vector and scalar conversions agree */
+        BOOST_CHECK_EQUAL(bf[i].bits, detail::to_bfloat16(v).bits);
+        BOOST_CHECK_EQUAL(half[i].bits, detail::to_half(v).bits);
+        if(std::isnan(v)) {
+            BOOST_CHECK(std::isnan(bf_back[i]));
+            BOOST_CHECK(std::isnan(half_back[i]));
+        } else if(std::abs(v) > 65504.0f) {
+            /* Beyond the range of half, not of bfloat16 */
+            BOOST_CHECK(std::isinf(half_back[i]));
+            BOOST_CHECK(std::isinf(v) ? bf_back[i] == v : std::abs(bf_back[i] - v) <= std::abs(v) * 0x1p-8f);
+        } else {
+            /* 8 and 11 significant bits, half of the last place */
+            BOOST_CHECK_SMALL(bf_back[i] - v, std::abs(v) * 0x1p-8f);
+            BOOST_CHECK_SMALL(half_back[i] - v, std::max(std::abs(v) * 0x1p-11f, 0x1p-25f));
+        }
+    }
+
+    /* Ties round to even */
+    BOOST_CHECK_EQUAL(detail::to_bfloat16(detail::bits_float(0x3f808000u)).bits, 0x3f80u);
+    BOOST_CHECK_EQUAL(detail::to_bfloat16(detail::bits_float(0x3f818000u)).bits, 0x3f82u);
+    BOOST_CHECK_EQUAL(detail::to_half(1.0f + 0x1p-11f).bits, 0x3c00u);
+    BOOST_CHECK_EQUAL(detail::to_half(1.0f + 0x1p-10f + 0x1p-11f).bits, 0x3c02u);
+    /* Smallest subnormal half */
+    BOOST_CHECK_EQUAL(detail::to_half(0x1p-24f).bits, 0x0001u);
+    BOOST_CHECK_EQUAL(detail::from_half(half_t{0x0001u}), 0x1p-24f);
+}
+
+namespace {
+
+    /**
+     * \brief Forward and backward of a reduced precision layer against the
+     *        same weights in fp32
+     */
+    template<typename Precision, typename InputDims, size_t OutputSize>
+    void check_reduced_precision_layer(const float_t& tolerance) {
+        constexpr size_t batch_size = 6;
+        using input_dims = InputDims;
+        using reference_type = fully_connected_layer<input_dims, OutputSize>;
+        using reduced_type = fully_connected_layer<input_dims, OutputSize, true, Precision>;
+
+        reference_type reference;
+        reduced_type reduced;
+        /* Several weight tiles, the last one partial */
+        static_assert(input_dims::size % reduced_type::panel_rows != 0);
+        static_assert(input_dims::size / reduced_type::panel_rows > 1);
+
+        reduced.weight_initializer = gauss_weight_initializer(-0.1f, 0.1f);
+        reduced.bias_initializer = gauss_weight_initializer(-0.1f, 0.1f);
+        reduced.configure(batch_size, true);
+        reference.configure(batch_size);
+        reference.w = reduced.w;
+        reference.b = reduced.b;
+
+        auto in = generate_inputs_for(reduced, batch_size);
+        tensor_4 curr_delta(batch_size, OutputSize, 1, 1);
+        detail::generate_uniform_into(curr_delta);
+
+        tensor_4 expected_out(batch_size, OutputSize, 1, 1); expected_out.setZero();
+        tensor_4 out(batch_size, OutputSize, 1, 1); out.setZero();
+        tensor_4 expected_prev_delta(batch_size, input_dims::d, input_dims::h, input_dims::w); expected_prev_delta.setZero();
+        tensor_4 prev_delta(batch_size, input_dims::d, input_dims::h, input_dims::w); prev_delta.setZero();
+
+        reference.forward_prop(in, expected_out);
+        reduced.forward_prop(in, out);
+        reference.backward_prop(in, expected_prev_delta, expected_out, curr_delta);
+        reduced.backward_prop(in, prev_delta, out, curr_delta);
+
+        for(long i = 0; i < out.size(); ++i) {
+            BOOST_CHECK_SMALL(out.data()[i] - expected_out.data()[i], tolerance);
+        }
+        for(long i = 0; i < prev_delta.size(); ++i) {
+            BOOST_CHECK_SMALL(prev_delta.data()[i] - expected_prev_delta.data()[i], tolerance);
+        }
+        /* Gradients are accumulated from fp32 activations, unaffected */
+        for(long i = 0; i < reduced.w.size(); ++i) {
+            BOOST_CHECK_SMALL(reduced.dw.data()[i] - reference.dw.data()[i], 1e-4f);
+        }
+
+        /* The stored weights follow the updated master weights */
+        ada_gradient_optimizer<> optimizer;
+        optimizer.begin_step();
+        reduced.update_weights(optimizer);
+        std::vector<float_t> widened(reduced.w.size());
+        detail::from_storage(reduced.ws.data(), widened.data(), widened.size());
+        for(long i = 0; i < reduced.w.size(); ++i) {
+            BOOST_CHECK_SMALL(widened[i] - reduced.w.data()[i], std::abs(reduced.w.data()[i]) * 0x1p-7f + 1e-7f);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_fully_connected_bf16_matches_fp32) {
+    check_reduced_precision_layer<bf16_precision, volume_dims<5, 30, 30>, 3>(0.05f);
+    /* Several column tiles, the last one partial */
+    check_reduced_precision_layer<bf16_precision, volume_dims<600>, 1100>(0.05f);
+}
+
+BOOST_AUTO_TEST_CASE(test_fully_connected_fp16_matches_fp32) {
+    check_reduced_precision_layer<fp16_precision, volume_dims<5, 30, 30>, 3>(0.01f);
+    check_reduced_precision_layer<fp16_precision, volume_dims<600>, 1100>(0.01f);
+}
+
+namespace {
+
+    /**
+     * \brief Seconds of forward propagation of a batch, the best of a few
+     *        runs
+     */
+    template<typename Layer>
+    double forward_seconds(Layer& layer, tensor_4& in, tensor_4& out) {
+        double best = std::numeric_limits<double>::max();
+        for(size_t run = 0; run < 3; ++run) {
+            out.setZero();
+            sp::util::scoped_timer timer("forward", false);
+            layer.forward_prop(in, out);
+            best = std::min(best, timer.seconds());
+        }
+        return best;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_fully_connected_reduced_precision_throughput) {
+    constexpr size_t batch_size = 32;
+    /* Wide output, i.e. many columns per weight row */
+    using input_dims = volume_dims<1024>;
+    constexpr size_t output_size = 4096;
+
+    fully_connected_layer<input_dims, output_size> reference;
+    fully_connected_layer<input_dims, output_size, true, bf16_precision> reduced;
+    reference.configure(batch_size, true);
+    reduced.configure(batch_size, true);
+
+    tensor_4 in = generate_inputs_for(reference, batch_size);
+    tensor_4 out(batch_size, output_size, 1, 1);
+
+    const double fp32 = forward_seconds(reference, in, out);
+    const double bf16 = forward_seconds(reduced, in, out);
+    BOOST_TEST_MESSAGE("Forward fp32 " << fp32 << " s, bf16 " << bf16 << " s");
+    /* Widening costs, but is amortized over the batch */
+    BOOST_CHECK_LT(bf16, 3.0 * fp32);
+}
@@ -8,6 +8,8 @@
 
 #define BOOST_TEST_MODULE sp_alg_nn_optimizers
 
+#include <cmath>
+
 #include <boost/test/unit_test.hpp>
 #include "sp/algo/nn/loss.hpp"
 #include "assert_matrix.hpp"
@@ -70,4 +72,35 @@ BOOST_AUTO_TEST_CASE(test_nn_loss_mean_square_derivative) {
     mse.derivative(0, y, x, actual);
 
     assert_tensor_equals(expected, actual);
-}
\ No newline at end of file
+}
+BOOST_AUTO_TEST_CASE(test_nn_loss_cross_entropy) {
+    cross_entropy ce;
+
+    tensor_4 p(2, 3, 1, 1);
+    tensor_4 y(2, 3, 1, 1);
+
+    p.setValues({{{{0.2f}}, {{0.7f}}, {{0.1f}}}, {{{0.5f}}, {{0.0f}}, {{0.5f}}}});
+    y.setValues({{{{0.0f}}, {{1.0f}}, {{0.0f}}}, {{{0.0f}}, {{1.0f}}, {{0.0f}}}});
+
+    BOOST_CHECK_CLOSE(ce(0, p, y), -std::log(0.7f), 0.001);
+    /* A zero probability is clamped, the loss is finite */
+    BOOST_CHECK_CLOSE(ce(1, p, y), -std::log(cross_entropy_epsilon), 0.001);
+
+    tensor_4 actual(2, 3, 1, 1);
+    actual.setZero();
+    ce.derivative(0, p, y, actual);
+    BOOST_CHECK_SMALL(actual(0, 0, 0, 0), 1e-6f);
+    BOOST_CHECK_CLOSE(actual(0, 1, 0, 0), -1.0f / 0.7f, 0.001);
+    BOOST_CHECK_SMALL(actual(0, 2, 0, 0), 1e-6f);
+
+    /* With respect to the softmax input */
+    softmax_gradient(ce, p, y, actual);
+    for(long si = 0; si < 2; ++si) {
+        for(long i = 0; i < 3; ++i) {
+            BOOST_CHECK_SMALL(actual(si, i, 0, 0) - (p(si, i, 0, 0) - y(si, i, 0, 0)), 1e-6f);
+        }
+    }
+
+    BOOST_REQUIRE(has_softmax_derivative_v<cross_entropy>);
+    BOOST_REQUIRE(!has_softmax_derivative_v<mean_square_error>);
+}
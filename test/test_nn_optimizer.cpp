@@ -28,4 +28,81 @@ BOOST_AUTO_TEST_CASE(test_nn_optimizer_adaptive_gradient) {
     assert_tensor_equals(res1, w, 0.999);
     optimizer.update(dw, w);
     assert_tensor_equals(res2, w, 0.999);
-}
\ No newline at end of file
+}
+/**
+ * Two steps of optimizer from the weights and gradients of the adaptive
+ * gradient test, compared to the reference of each step
+ */
+template<typename Optimizer>
+void check_two_steps(Optimizer& optimizer, std::initializer_list<float_t> step1, std::initializer_list<float_t> step2) {
+    tensor_1 w(5); w.setValues({0.20, 0.40, 0.006, -0.77, -0.010});
+    tensor_1 dw(5); dw.setValues({1.00, -3.24, -0.600, 2.79, 1.820});
+    for(const auto& expected : {step1, step2}) {
+        optimizer.begin_step();
+        optimizer.update(dw, w);
+        size_t i = 0;
+        for(const float_t& e : expected) {
+            BOOST_REQUIRE_SMALL(w(i++) - e, 1e-5f);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_nn_optimizer_momentum) {
+    momentum_optimizer<testing_learning_rate> optimizer;
+    check_two_steps(optimizer,
+        {0.190000, 0.432400, 0.012000, -0.797900, -0.028200},
+        {0.171000, 0.493960, 0.023400, -0.850910, -0.062780});
+}
+
+BOOST_AUTO_TEST_CASE(test_nn_optimizer_nesterov) {
+    nesterov_optimizer<testing_learning_rate> optimizer;
+    check_two_steps(optimizer,
+        {0.181000, 0.461560, 0.017400, -0.823010, -0.044580},
+        {0.153900, 0.549364, 0.033660, -0.898619, -0.093902});
+}
+
+BOOST_AUTO_TEST_CASE(test_nn_optimizer_rmsprop) {
+    rmsprop_optimizer<testing_learning_rate> optimizer;
+    check_two_steps(optimizer,
+        {0.168377, 0.431623, 0.037623, -0.801623, -0.041623},
+        {0.145436, 0.454564, 0.060564, -0.824564, -0.064564});
+}
+
+BOOST_AUTO_TEST_CASE(test_nn_optimizer_adam) {
+    adam_optimizer<testing_learning_rate> optimizer;
+    check_two_steps(optimizer,
+        {0.190000, 0.410000, 0.016000, -0.780000, -0.020000},
+        {0.180000, 0.420000, 0.026000, -0.790000, -0.030000});
+}
+
+BOOST_AUTO_TEST_CASE(test_nn_optimizer_sgd_step_policy) {
+    stochastic_gradient_descent_optimizer<testing_learning_rate, learning_rate_policy::step, 2, std::ratio<1, 2>> optimizer;
+    tensor_1 w(1); w.setValues({1.0});
+    tensor_1 dw(1); dw.setValues({1.0});
+    const float_t expected[] = {0.99, 0.98, 0.975, 0.97, 0.9675};
+    for(const float_t& e : expected) {
+        optimizer.begin_step();
+        optimizer.update(dw, w);
+        BOOST_REQUIRE_SMALL(w(0) - e, 1e-6f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_nn_optimizer_scale_and_flat_state) {
+    /* The batch scale is folded into the update, the state of a registry follows its owner */
+    adam_optimizer<testing_learning_rate> tensor_optimizer;
+    adam_optimizer<testing_learning_rate> flat_optimizer;
+    tensor_1 w(5); w.setValues({0.20, 0.40, 0.006, -0.77, -0.010});
+    tensor_1 dw(5); dw.setValues({1.00, -3.24, -0.600, 2.79, 1.820});
+    tensor_1 summed = dw * 4.0f;
+    tensor_1 flat_w = w;
+    int owner = 0;
+    for(size_t step = 0; step < 3; ++step) {
+        tensor_optimizer.begin_step();
+        tensor_optimizer.update(dw, w);
+        flat_optimizer.begin_step();
+        flat_optimizer.update_block(flat_w.data(), summed.data(), flat_optimizer.flat_state(&owner, 5), 5, 0.25f);
+        for(long i = 0; i < w.size(); ++i) {
+            BOOST_REQUIRE_SMALL(flat_w(i) - w(i), 1e-6f);
+        }
+    }
+}
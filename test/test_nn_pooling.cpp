@@ -181,6 +181,48 @@ BOOST_AUTO_TEST_CASE(test_pooling_layer_max_bprop_stride) {
     assert_tensor_equals(expected_prev_delta, prev_delta);
 
 }
+BOOST_AUTO_TEST_CASE(test_pooling_layer_max_negative_inputs) {
+
+    using input_dims = volume_dims<1, 2, 4>;
+    using k_params = pooling_kernel_params<2, 2>;
+    using max_pooling_layer_type = max_pooling_layer<input_dims, k_params>;
+
+    max_pooling_layer_type layer;
+    layer.weight_initializer = fixed_weight_initializer(1.0f);
+    layer.configure(1, true);
+
+    tensor_4 prev_out(1, 1, 2, 4);
+    tensor_4 curr_out(1, 1, 1, 2); curr_out.setZero();
+    tensor_4 expected_out(1, 1, 1, 2);
+    tensor_4 prev_delta(1, 1, 2, 4); prev_delta.setZero();
+    tensor_4 expected_prev_delta(1, 1, 2, 4);
+    tensor_4 curr_delta(1, 1, 1, 2);
+
+    /* Every window is negative */
+    prev_out.setValues({{{
+        {-4, -2, -8, -7},
+        {-3, -5, -6, -9}
+    }}});
+    curr_delta.setValues({{{
+        {1, 2}
+    }}});
+    expected_out.setValues({{{
+        {-2, -6}
+    }}});
+    expected_prev_delta.setValues({{{
+        {0, 1, 0, 0},
+        {0, 0, 2, 0}
+    }}});
+
+    layer.forward_prop(prev_out, curr_out);
+
+    assert_tensor_equals(expected_out, curr_out);
+
+    layer.backward_prop(prev_out, prev_delta, curr_out, curr_delta);
+
+    assert_tensor_equals(expected_prev_delta, prev_delta);
+}
+
 BOOST_AUTO_TEST_CASE(test_pooling_layer_mean_gradient_check) {
 
     /** FIX SEED FOR TESTING, REPRODUCIBLE RESULTS< NOT TO BE COMMITTED! */
@@ -0,0 +1,184 @@
+/**
+ * Copyright (C) Omar Thor <omarthoro@gmail.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ *
+ * Written by Omar Thor <omarthoro@gmail.com>, 2017
+ */
+
+#include <iostream>
+#include <cstdint>
+#include <random>
+#define BOOST_TEST_MODULE sp_algo_nn
+#include <boost/test/unit_test.hpp>
+#include "sp/algo/nn.hpp"
+#include "sp/algo/nn/quantization.hpp"
+
+using namespace sp::algo::nn;
+
+namespace {
+
+    /**
+     * \brief Random samples of the network input uniformly in [-1, 1]
+     */
+    template<typename Network>
+    sample_vector_type random_samples(const size_t& count) {
+        using dims = typename Network::input_dims;
+        sample_vector_type samples(count, sample_type(dims::d, dims::h, dims::w));
+        for(auto& sample : samples) {
+            sample.setRandom();
+            sample = sample * 2.0f - 1.0f;
+        }
+        return samples;
+    }
+
+    /**
+     * \brief Compare the outputs of the quantized network to the trained
+     *        network on the samples
+     */
+    template<typename Network>
+    void check_quantized_matches(Network& trained, const sample_vector_type& samples, const float_t& tolerance) {
+        using dims = typename Network::input_dims;
+        quantized_network<Network> quantized(trained, samples, samples.size());
+
+        tensor_4 input(samples.size(), dims::d, dims::h, dims::w);
+        for(size_t s = 0; s < samples.size(); ++s) {
+            std::copy(samples[s].data(), samples[s].data() + dims::size, input.data() + s * dims::size);
+        }
+        tensor_4 expected = trained.forward(input);
+        tensor_4 out = quantized.forward(input);
+        BOOST_REQUIRE_EQUAL(out.size(), expected.size());
+        for(long i = 0; i < out.size(); ++i) {
+            BOOST_CHECK_SMALL(out.data()[i] - expected.data()[i], tolerance);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_quantization_params) {
+    const auto params = quantization_params::from_range(-0.5f, 2.0f);
+    BOOST_CHECK_EQUAL(params.dequantize(params.quantize(0)), 0.0f);
+    BOOST_CHECK_EQUAL(params.quantize(-10), 0);
+    BOOST_CHECK_EQUAL(params.quantize(10), quantization_params::levels);
+    for(float_t x = -0.5f; x <= 2.0f; x += 0.01f) {
+        BOOST_CHECK_SMALL(params.dequantize(params.quantize(x)) - x, params.scale / 2 + 1e-6f);
+    }
+
+    /* Positive ranges are extended to zero */
+    const auto positive = quantization_params::from_range(0.25f, 1.0f);
+    BOOST_CHECK_EQUAL(positive.zero_point, 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_quantized_dot_product) {
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> inputs(0, quantization_params::levels);
+    std::uniform_int_distribution<int> weights(-127, 127);
+    constexpr size_t rows = detail::quantized_tile_rows;
+    constexpr size_t kernels = detail::quantized_tile_kernels;
+    constexpr size_t n = 3 * detail::quantized_row_alignment;
+    std::vector<std::uint8_t> a(rows * n);
+    std::vector<std::int8_t> b(kernels * n);
+    /* Extremes, pairs of products of the largest magnitude, in the first row and kernel */
+    for(size_t i = 0; i < a.size(); ++i) {
+        a[i] = i < 64 ? quantization_params::levels : inputs(generator);
+    }
+    for(size_t i = 0; i < b.size(); ++i) {
+        b[i] = i < 32 ? 127 : (i < 64 ? -127 : weights(generator));
+    }
+    std::int32_t acc[rows][kernels];
+    detail::dot_tile_u8s8(a.data(), b.data(), n, acc);
+    for(size_t r = 0; r < rows; ++r) {
+        for(size_t k = 0; k < kernels; ++k) {
+            std::int32_t expected = 0;
+            for(size_t i = 0; i < n; ++i) {
+                expected += static_cast<std::int32_t>(a[r * n + i]) * b[k * n + i];
+            }
+            BOOST_CHECK_EQUAL(acc[r][k], expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_quantized_network_matches_float) {
+    using network_type = network<
+        conv_layer<
+            volume_dims<3, 12, 12>,
+            kernel_symmetric_params<6, 3, 1, padding_type::same>
+        >,
+        activation_layer<volume_dims<6, 12, 12>, sigmoid_activation_op>,
+        max_pooling_layer<volume_dims<6, 12, 12>, pooling_kernel_params<2, 2>>,
+        conv_layer<
+            volume_dims<6, 6, 6>,
+            kernel_symmetric_params<10, 3, 1, padding_type::same>,
+            true,
+            table_connectivity<
+                6, 10,
+                1, 0, 0, 1, 1, 0, 1, 0, 1, 1,
+                1, 1, 0, 0, 1, 1, 0, 1, 0, 1,
+                0, 1, 1, 0, 0, 1, 1, 0, 1, 1,
+                0, 0, 1, 1, 0, 0, 1, 1, 0, 1,
+                1, 0, 0, 1, 1, 0, 0, 1, 1, 1,
+                0, 1, 1, 0, 1, 1, 0, 0, 1, 1
+            >,
+            1
+        >,
+        tanh_layer<volume_dims<10, 6, 6>>,
+        /* Requantized into the following layer */
+        conv_layer<
+            volume_dims<10, 6, 6>,
+            kernel_symmetric_params<8, 2, 2, padding_type::valid>
+        >,
+        tanh_layer<volume_dims<8, 3, 3>>,
+        fully_connected_layer<volume_dims<8, 3, 3>, 4>,
+        tanh_layer<volume_dims<4>>
+    >;
+
+    static_assert(quantized_network<network_type>::stage_length<0>() == 2);
+    static_assert(quantized_network<network_type>::stage_length<2>() == 1);
+
+    constexpr size_t samples = 5;
+    network_type trained;
+    trained.configure_inference(samples, true);
+
+    check_quantized_matches(trained, random_samples<network_type>(samples), 0.05f);
+}
+
+BOOST_AUTO_TEST_CASE(test_quantized_network_accuracy) {
+    using network_type = network<
+        fully_connected_layer<volume_dims<8>, 16>,
+        tanh_layer<volume_dims<16>>,
+        fully_connected_layer<volume_dims<16>, 3>,
+        tanh_layer<volume_dims<3>>
+    >;
+    constexpr size_t batch = 10;
+
+    /* Three separable clusters, one class each */
+    std::mt19937 generator(11);
+    std::normal_distribution<float_t> noise(0, 0.3f);
+    auto make_set = [&](const size_t& count, sample_vector_type& samples, class_vector_type& classes) {
+        for(size_t s = 0; s < count; ++s) {
+            const size_t cls = s % 3;
+            sample_type sample(8, 1, 1);
+            for(long i = 0; i < 8; ++i) {
+                sample(i, 0, 0) = (static_cast<size_t>(i) % 3 == cls ? 1.0f : -1.0f) + noise(generator);
+            }
+            samples.push_back(sample);
+            classes.push_back(cls);
+        }
+    };
+    sample_vector_type train_samples, test_samples;
+    class_vector_type train_classes, test_classes;
+    make_set(300, train_samples, train_classes);
+    make_set(150, test_samples, test_classes);
+
+    network_type trained;
+    trained.configure(batch, true);
+    training<batch, 5, ada_gradient_optimizer<>> trainer;
+    trainer(trained, train_samples, train_classes);
+
+    quantized_network<network_type> quantized(trained, train_samples, batch);
+    const quantization_report report = compare_quantization(trained, quantized, test_samples, test_classes);
+
+    BOOST_TEST_MESSAGE("Accuracy " << report.reference_accuracy() << " float, " << report.quantized_accuracy() << " int8");
+    BOOST_CHECK_EQUAL(report.samples, test_samples.size());
+    BOOST_CHECK_GT(report.reference_accuracy(), 0.9f);
+    BOOST_CHECK_SMALL(report.accuracy_delta(), 0.02f);
+}